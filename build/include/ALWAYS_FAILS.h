@@ -0,0 +1 @@
+/* #undef ALWAYS_FAILS */
@@ -0,0 +1 @@
+#define ALWAYS_SUCCEEDS 1
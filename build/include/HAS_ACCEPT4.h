@@ -0,0 +1 @@
+#define HAS_ACCEPT4 1
@@ -0,0 +1 @@
+#define HAS_ANON_STRUCT_FIELDS 1
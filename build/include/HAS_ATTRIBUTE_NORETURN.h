@@ -0,0 +1 @@
+#define HAS_ATTRIBUTE_NORETURN 1
@@ -0,0 +1 @@
+#define HAS_ATTRIBUTE_WARN_UNUSED_RESULT 1
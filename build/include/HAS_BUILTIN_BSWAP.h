@@ -0,0 +1 @@
+#define HAS_BUILTIN_BSWAP 1
@@ -0,0 +1 @@
+#define HAS_BUILTIN_EXPECT 1
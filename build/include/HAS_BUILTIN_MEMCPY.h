@@ -0,0 +1 @@
+#define HAS_BUILTIN_MEMCPY 1
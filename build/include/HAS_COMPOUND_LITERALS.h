@@ -0,0 +1 @@
+#define HAS_COMPOUND_LITERALS 1
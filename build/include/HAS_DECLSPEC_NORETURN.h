@@ -0,0 +1 @@
+/* #undef HAS_DECLSPEC_NORETURN */
@@ -0,0 +1 @@
+#define HAS_DESIGNATED_INITIALIZERS 1
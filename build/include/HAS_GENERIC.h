@@ -0,0 +1 @@
+#define HAS_GENERIC 1
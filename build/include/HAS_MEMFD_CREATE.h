@@ -0,0 +1 @@
+#define HAS_MEMFD_CREATE 1
@@ -0,0 +1 @@
+#define HAS_MIXED_DECLARATIONS 1
@@ -0,0 +1 @@
+#define HAS_NORETURN 1
@@ -0,0 +1 @@
+#define HAS_RESTRICT 1
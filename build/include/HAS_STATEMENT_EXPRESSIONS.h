@@ -0,0 +1 @@
+#define HAS_STATEMENT_EXPRESSIONS 1
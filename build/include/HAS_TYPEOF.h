@@ -0,0 +1 @@
+#define HAS_TYPEOF 1
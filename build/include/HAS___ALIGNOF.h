@@ -0,0 +1 @@
+#define HAS___ALIGNOF 1
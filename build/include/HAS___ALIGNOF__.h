@@ -0,0 +1 @@
+#define HAS___ALIGNOF__ 1
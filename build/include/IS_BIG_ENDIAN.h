@@ -0,0 +1 @@
+/* #undef IS_BIG_ENDIAN */
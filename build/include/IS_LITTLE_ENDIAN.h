@@ -0,0 +1 @@
+#define IS_LITTLE_ENDIAN 1
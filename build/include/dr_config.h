@@ -0,0 +1,29 @@
+#if !defined(DR_CONFIG_H)
+#define DR_CONFIG_H
+/* #undef ALWAYS_FAILS */
+#define ALWAYS_SUCCEEDS 1
+#define HAS_ACCEPT4 1
+#define HAS_ANON_STRUCT_FIELDS 1
+#define HAS_ATTRIBUTE_NORETURN 1
+#define HAS_ATTRIBUTE_WARN_UNUSED_RESULT 1
+#define HAS_BUILTIN_BSWAP 1
+#define HAS_BUILTIN_CLZLL 1
+#define HAS_BUILTIN_EXPECT 1
+#define HAS_BUILTIN_MEMCPY 1
+#define HAS_COMPOUND_LITERALS 1
+/* #undef HAS_DECLSPEC_NORETURN */
+/* #undef HAS_DECLTYPE */
+#define HAS_DESIGNATED_INITIALIZERS 1
+#define HAS_GENERIC 1
+/* #undef HAS_KEVENT */
+#define HAS_MEMFD_CREATE 1
+#define HAS_MIXED_DECLARATIONS 1
+#define HAS_NORETURN 1
+#define HAS_RESTRICT 1
+#define HAS_STATEMENT_EXPRESSIONS 1
+#define HAS_TYPEOF 1
+#define HAS___ALIGNOF 1
+#define HAS___ALIGNOF__ 1
+/* #undef IS_BIG_ENDIAN */
+#define IS_LITTLE_ENDIAN 1
+#endif // DR_CONFIG_H
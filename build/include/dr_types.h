@@ -0,0 +1,6 @@
+struct dr_event { uint8_t  __private[0x0000000c]; };
+struct dr_equeue { uint64_t __private[0x00000003]; };
+struct dr_equeue_server { uint64_t __private[0x00000005]; };
+struct dr_equeue_client { uint64_t __private[0x00000005]; };
+struct dr_pool { uint64_t __private[0x00000018]; };
+struct dr_9p_client { uint64_t __private[0x00000063]; };
@@ -0,0 +1 @@
+ACCEPTEX_LDLIBS=
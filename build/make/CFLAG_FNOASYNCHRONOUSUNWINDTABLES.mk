@@ -0,0 +1 @@
+CFLAG_FNOASYNCHRONOUSUNWINDTABLES=-fno-asynchronous-unwind-tables
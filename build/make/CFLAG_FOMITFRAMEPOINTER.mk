@@ -0,0 +1 @@
+CFLAG_FOMITFRAMEPOINTER=-fomit-frame-pointer
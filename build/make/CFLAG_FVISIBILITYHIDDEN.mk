@@ -0,0 +1 @@
+CFLAG_FVISIBILITYHIDDEN=-fvisibility=hidden
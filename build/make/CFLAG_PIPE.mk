@@ -0,0 +1 @@
+CFLAG_PIPE=-pipe
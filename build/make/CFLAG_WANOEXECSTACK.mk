@@ -0,0 +1 @@
+CFLAG_WANOEXECSTACK=-Wa,--noexecstack
@@ -0,0 +1 @@
+CFLAG_WCASTQUAL=-Wcast-qual
@@ -0,0 +1 @@
+CFLAG_WDUPLICATEDBRANCHES=-Wduplicated-branches
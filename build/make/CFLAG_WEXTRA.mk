@@ -0,0 +1 @@
+CFLAG_WEXTRA=-Wextra
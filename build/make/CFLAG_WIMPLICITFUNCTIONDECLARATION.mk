@@ -0,0 +1 @@
+CFLAG_WIMPLICITFUNCTIONDECLARATION=-Wimplicit-function-declaration
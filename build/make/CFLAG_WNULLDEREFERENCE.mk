@@ -0,0 +1 @@
+CFLAG_WNULLDEREFERENCE=-Wnull-dereference
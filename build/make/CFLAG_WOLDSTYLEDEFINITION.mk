@@ -0,0 +1 @@
+CFLAG_WOLDSTYLEDEFINITION=-Wold-style-definition
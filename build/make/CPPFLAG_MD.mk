@@ -0,0 +1 @@
+CPPFLAG_MD=-MD
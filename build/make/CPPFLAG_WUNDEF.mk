@@ -0,0 +1 @@
+CPPFLAG_WUNDEF=-Wundef
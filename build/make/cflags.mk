@@ -0,0 +1,29 @@
+CFLAG_WFAILS=
+CFLAG_WALL=-Wall
+CFLAG_WEXTRA=-Wextra
+CFLAG_WC++COMPAT=-Wc++-compat
+CFLAG_WCASTQUAL=-Wcast-qual
+CFLAG_WMISSINGPROTOTYPES=-Wmissing-prototypes
+CFLAG_WOLDSTYLEDEFINITION=-Wold-style-definition
+CFLAG_WPOINTERARITH=-Wpointer-arith
+CFLAG_WSHADOW=-Wshadow
+CFLAG_WSTRICTPROTOTYPES=-Wstrict-prototypes
+CFLAG_WWRITESTRINGS=-Wwrite-strings
+CFLAG_WIMPLICITFUNCTIONDECLARATION=-Wimplicit-function-declaration
+CFLAG_WDUPLICATEDCOND=-Wduplicated-cond
+CFLAG_WDUPLICATEDBRANCHES=-Wduplicated-branches
+CFLAG_WLOGICALOP=-Wlogical-op
+CFLAG_WRESTRICT=-Wrestrict
+CFLAG_WNULLDEREFERENCE=-Wnull-dereference
+CFLAG_WJUMPMISSESINIT=-Wjump-misses-init
+CFLAG_WDOUBLEPROMOTION=-Wdouble-promotion
+CFLAG_WFORMAT2=-Wformat=2
+CFLAG_WANOEXECSTACK=-Wa,--noexecstack
+CFLAG_FNOASYNCHRONOUSUNWINDTABLES=-fno-asynchronous-unwind-tables
+CFLAG_FNOEXCEPTIONS=-fno-exceptions
+CFLAG_FNOUNWINDTABLES=-fno-unwind-tables
+CFLAG_FOMITFRAMEPOINTER=-fomit-frame-pointer
+CFLAG_FVISIBILITYHIDDEN=-fvisibility=hidden
+CFLAG_FPIE=-fpie
+CFLAG_PIPE=-pipe
+CFLAG_NOLOGO=
@@ -0,0 +1,272 @@
+# SPDX-License-Identifier: GPL-2.0-only
+# Copyright (c) 2018 Drew Richardson <drewrichardson@gmail.com>
+
+build/include/ALWAYS_FAILS.h: build/make/dr_config.mk $(PROJROOT)config/checks/ALWAYS_FAILS.c
+	$(E_GEN) \
+if ! (cd build/make_obj && \
+        $(CC) $(CSTD) $(CPPFLAGS) $(CFLAGS) $(LDFLAGS) ../../$(PROJROOT)config/checks/ALWAYS_FAILS.c $(OUTPUT_L)ALWAYS_FAILS$(EEXT) || \
+        echo error) 2>&1 | egrep -i 'error|warn' > /dev/null; then \
+    echo '#define ALWAYS_FAILS 1'; \
+else \
+    echo '/* #undef ALWAYS_FAILS */'; \
+fi > $@
+
+build/include/ALWAYS_SUCCEEDS.h: build/make/dr_config.mk $(PROJROOT)config/checks/ALWAYS_SUCCEEDS.c
+	$(E_GEN) \
+if ! (cd build/make_obj && \
+        $(CC) $(CSTD) $(CPPFLAGS) $(CFLAGS) $(LDFLAGS) ../../$(PROJROOT)config/checks/ALWAYS_SUCCEEDS.c $(OUTPUT_L)ALWAYS_SUCCEEDS$(EEXT) || \
+        echo error) 2>&1 | egrep -i 'error|warn' > /dev/null; then \
+    echo '#define ALWAYS_SUCCEEDS 1'; \
+else \
+    echo '/* #undef ALWAYS_SUCCEEDS */'; \
+fi > $@
+
+build/include/HAS_ACCEPT4.h: build/make/dr_config.mk $(PROJROOT)config/checks/HAS_ACCEPT4.c
+	$(E_GEN) \
+if ! (cd build/make_obj && \
+        $(CC) $(CSTD) $(CPPFLAGS) $(CFLAGS) $(LDFLAGS) ../../$(PROJROOT)config/checks/HAS_ACCEPT4.c $(OUTPUT_L)HAS_ACCEPT4$(EEXT) || \
+        echo error) 2>&1 | egrep -i 'error|warn' > /dev/null; then \
+    echo '#define HAS_ACCEPT4 1'; \
+else \
+    echo '/* #undef HAS_ACCEPT4 */'; \
+fi > $@
+
+build/include/HAS_ANON_STRUCT_FIELDS.h: build/make/dr_config.mk $(PROJROOT)config/checks/HAS_ANON_STRUCT_FIELDS.c
+	$(E_GEN) \
+if ! (cd build/make_obj && \
+        $(CC) $(CSTD) $(CPPFLAGS) $(CFLAGS) $(LDFLAGS) ../../$(PROJROOT)config/checks/HAS_ANON_STRUCT_FIELDS.c $(OUTPUT_L)HAS_ANON_STRUCT_FIELDS$(EEXT) || \
+        echo error) 2>&1 | egrep -i 'error|warn' > /dev/null; then \
+    echo '#define HAS_ANON_STRUCT_FIELDS 1'; \
+else \
+    echo '/* #undef HAS_ANON_STRUCT_FIELDS */'; \
+fi > $@
+
+build/include/HAS_ATTRIBUTE_NORETURN.h: build/make/dr_config.mk $(PROJROOT)config/checks/HAS_ATTRIBUTE_NORETURN.c
+	$(E_GEN) \
+if ! (cd build/make_obj && \
+        $(CC) $(CSTD) $(CPPFLAGS) $(CFLAGS) $(LDFLAGS) ../../$(PROJROOT)config/checks/HAS_ATTRIBUTE_NORETURN.c $(OUTPUT_L)HAS_ATTRIBUTE_NORETURN$(EEXT) || \
+        echo error) 2>&1 | egrep -i 'error|warn' > /dev/null; then \
+    echo '#define HAS_ATTRIBUTE_NORETURN 1'; \
+else \
+    echo '/* #undef HAS_ATTRIBUTE_NORETURN */'; \
+fi > $@
+
+build/include/HAS_ATTRIBUTE_WARN_UNUSED_RESULT.h: build/make/dr_config.mk $(PROJROOT)config/checks/HAS_ATTRIBUTE_WARN_UNUSED_RESULT.c
+	$(E_GEN) \
+if ! (cd build/make_obj && \
+        $(CC) $(CSTD) $(CPPFLAGS) $(CFLAGS) $(LDFLAGS) ../../$(PROJROOT)config/checks/HAS_ATTRIBUTE_WARN_UNUSED_RESULT.c $(OUTPUT_L)HAS_ATTRIBUTE_WARN_UNUSED_RESULT$(EEXT) || \
+        echo error) 2>&1 | egrep -i 'error|warn' > /dev/null; then \
+    echo '#define HAS_ATTRIBUTE_WARN_UNUSED_RESULT 1'; \
+else \
+    echo '/* #undef HAS_ATTRIBUTE_WARN_UNUSED_RESULT */'; \
+fi > $@
+
+build/include/HAS_BUILTIN_BSWAP.h: build/make/dr_config.mk $(PROJROOT)config/checks/HAS_BUILTIN_BSWAP.c
+	$(E_GEN) \
+if ! (cd build/make_obj && \
+        $(CC) $(CSTD) $(CPPFLAGS) $(CFLAGS) $(LDFLAGS) ../../$(PROJROOT)config/checks/HAS_BUILTIN_BSWAP.c $(OUTPUT_L)HAS_BUILTIN_BSWAP$(EEXT) || \
+        echo error) 2>&1 | egrep -i 'error|warn' > /dev/null; then \
+    echo '#define HAS_BUILTIN_BSWAP 1'; \
+else \
+    echo '/* #undef HAS_BUILTIN_BSWAP */'; \
+fi > $@
+
+build/include/HAS_BUILTIN_CLZLL.h: build/make/dr_config.mk $(PROJROOT)config/checks/HAS_BUILTIN_CLZLL.c
+	$(E_GEN) \
+if ! (cd build/make_obj && \
+        $(CC) $(CSTD) $(CPPFLAGS) $(CFLAGS) $(LDFLAGS) ../../$(PROJROOT)config/checks/HAS_BUILTIN_CLZLL.c $(OUTPUT_L)HAS_BUILTIN_CLZLL$(EEXT) || \
+        echo error) 2>&1 | egrep -i 'error|warn' > /dev/null; then \
+    echo '#define HAS_BUILTIN_CLZLL 1'; \
+else \
+    echo '/* #undef HAS_BUILTIN_CLZLL */'; \
+fi > $@
+
+build/include/HAS_BUILTIN_EXPECT.h: build/make/dr_config.mk $(PROJROOT)config/checks/HAS_BUILTIN_EXPECT.c
+	$(E_GEN) \
+if ! (cd build/make_obj && \
+        $(CC) $(CSTD) $(CPPFLAGS) $(CFLAGS) $(LDFLAGS) ../../$(PROJROOT)config/checks/HAS_BUILTIN_EXPECT.c $(OUTPUT_L)HAS_BUILTIN_EXPECT$(EEXT) || \
+        echo error) 2>&1 | egrep -i 'error|warn' > /dev/null; then \
+    echo '#define HAS_BUILTIN_EXPECT 1'; \
+else \
+    echo '/* #undef HAS_BUILTIN_EXPECT */'; \
+fi > $@
+
+build/include/HAS_BUILTIN_MEMCPY.h: build/make/dr_config.mk $(PROJROOT)config/checks/HAS_BUILTIN_MEMCPY.c
+	$(E_GEN) \
+if ! (cd build/make_obj && \
+        $(CC) $(CSTD) $(CPPFLAGS) $(CFLAGS) $(LDFLAGS) ../../$(PROJROOT)config/checks/HAS_BUILTIN_MEMCPY.c $(OUTPUT_L)HAS_BUILTIN_MEMCPY$(EEXT) || \
+        echo error) 2>&1 | egrep -i 'error|warn' > /dev/null; then \
+    echo '#define HAS_BUILTIN_MEMCPY 1'; \
+else \
+    echo '/* #undef HAS_BUILTIN_MEMCPY */'; \
+fi > $@
+
+build/include/HAS_COMPOUND_LITERALS.h: build/make/dr_config.mk $(PROJROOT)config/checks/HAS_COMPOUND_LITERALS.c
+	$(E_GEN) \
+if ! (cd build/make_obj && \
+        $(CC) $(CSTD) $(CPPFLAGS) $(CFLAGS) $(LDFLAGS) ../../$(PROJROOT)config/checks/HAS_COMPOUND_LITERALS.c $(OUTPUT_L)HAS_COMPOUND_LITERALS$(EEXT) || \
+        echo error) 2>&1 | egrep -i 'error|warn' > /dev/null; then \
+    echo '#define HAS_COMPOUND_LITERALS 1'; \
+else \
+    echo '/* #undef HAS_COMPOUND_LITERALS */'; \
+fi > $@
+
+build/include/HAS_DECLSPEC_NORETURN.h: build/make/dr_config.mk $(PROJROOT)config/checks/HAS_DECLSPEC_NORETURN.c
+	$(E_GEN) \
+if ! (cd build/make_obj && \
+        $(CC) $(CSTD) $(CPPFLAGS) $(CFLAGS) $(LDFLAGS) ../../$(PROJROOT)config/checks/HAS_DECLSPEC_NORETURN.c $(OUTPUT_L)HAS_DECLSPEC_NORETURN$(EEXT) || \
+        echo error) 2>&1 | egrep -i 'error|warn' > /dev/null; then \
+    echo '#define HAS_DECLSPEC_NORETURN 1'; \
+else \
+    echo '/* #undef HAS_DECLSPEC_NORETURN */'; \
+fi > $@
+
+build/include/HAS_DECLTYPE.h: build/make/dr_config.mk $(PROJROOT)config/checks/HAS_DECLTYPE.c
+	$(E_GEN) \
+if ! (cd build/make_obj && \
+        $(CC) $(CSTD) $(CPPFLAGS) $(CFLAGS) $(LDFLAGS) ../../$(PROJROOT)config/checks/HAS_DECLTYPE.c $(OUTPUT_L)HAS_DECLTYPE$(EEXT) || \
+        echo error) 2>&1 | egrep -i 'error|warn' > /dev/null; then \
+    echo '#define HAS_DECLTYPE 1'; \
+else \
+    echo '/* #undef HAS_DECLTYPE */'; \
+fi > $@
+
+build/include/HAS_DESIGNATED_INITIALIZERS.h: build/make/dr_config.mk $(PROJROOT)config/checks/HAS_DESIGNATED_INITIALIZERS.c
+	$(E_GEN) \
+if ! (cd build/make_obj && \
+        $(CC) $(CSTD) $(CPPFLAGS) $(CFLAGS) $(LDFLAGS) ../../$(PROJROOT)config/checks/HAS_DESIGNATED_INITIALIZERS.c $(OUTPUT_L)HAS_DESIGNATED_INITIALIZERS$(EEXT) || \
+        echo error) 2>&1 | egrep -i 'error|warn' > /dev/null; then \
+    echo '#define HAS_DESIGNATED_INITIALIZERS 1'; \
+else \
+    echo '/* #undef HAS_DESIGNATED_INITIALIZERS */'; \
+fi > $@
+
+build/include/HAS_GENERIC.h: build/make/dr_config.mk $(PROJROOT)config/checks/HAS_GENERIC.c
+	$(E_GEN) \
+if ! (cd build/make_obj && \
+        $(CC) $(CSTD) $(CPPFLAGS) $(CFLAGS) $(LDFLAGS) ../../$(PROJROOT)config/checks/HAS_GENERIC.c $(OUTPUT_L)HAS_GENERIC$(EEXT) || \
+        echo error) 2>&1 | egrep -i 'error|warn' > /dev/null; then \
+    echo '#define HAS_GENERIC 1'; \
+else \
+    echo '/* #undef HAS_GENERIC */'; \
+fi > $@
+
+build/include/HAS_KEVENT.h: build/make/dr_config.mk $(PROJROOT)config/checks/HAS_KEVENT.c
+	$(E_GEN) \
+if ! (cd build/make_obj && \
+        $(CC) $(CSTD) $(CPPFLAGS) $(CFLAGS) $(LDFLAGS) ../../$(PROJROOT)config/checks/HAS_KEVENT.c $(OUTPUT_L)HAS_KEVENT$(EEXT) || \
+        echo error) 2>&1 | egrep -i 'error|warn' > /dev/null; then \
+    echo '#define HAS_KEVENT 1'; \
+else \
+    echo '/* #undef HAS_KEVENT */'; \
+fi > $@
+
+build/include/HAS_MEMFD_CREATE.h: build/make/dr_config.mk $(PROJROOT)config/checks/HAS_MEMFD_CREATE.c
+	$(E_GEN) \
+if ! (cd build/make_obj && \
+        $(CC) $(CSTD) $(CPPFLAGS) $(CFLAGS) $(LDFLAGS) ../../$(PROJROOT)config/checks/HAS_MEMFD_CREATE.c $(OUTPUT_L)HAS_MEMFD_CREATE$(EEXT) || \
+        echo error) 2>&1 | egrep -i 'error|warn' > /dev/null; then \
+    echo '#define HAS_MEMFD_CREATE 1'; \
+else \
+    echo '/* #undef HAS_MEMFD_CREATE */'; \
+fi > $@
+
+build/include/HAS_MIXED_DECLARATIONS.h: build/make/dr_config.mk $(PROJROOT)config/checks/HAS_MIXED_DECLARATIONS.c
+	$(E_GEN) \
+if ! (cd build/make_obj && \
+        $(CC) $(CSTD) $(CPPFLAGS) $(CFLAGS) $(LDFLAGS) ../../$(PROJROOT)config/checks/HAS_MIXED_DECLARATIONS.c $(OUTPUT_L)HAS_MIXED_DECLARATIONS$(EEXT) || \
+        echo error) 2>&1 | egrep -i 'error|warn' > /dev/null; then \
+    echo '#define HAS_MIXED_DECLARATIONS 1'; \
+else \
+    echo '/* #undef HAS_MIXED_DECLARATIONS */'; \
+fi > $@
+
+build/include/HAS_NORETURN.h: build/make/dr_config.mk $(PROJROOT)config/checks/HAS_NORETURN.c
+	$(E_GEN) \
+if ! (cd build/make_obj && \
+        $(CC) $(CSTD) $(CPPFLAGS) $(CFLAGS) $(LDFLAGS) ../../$(PROJROOT)config/checks/HAS_NORETURN.c $(OUTPUT_L)HAS_NORETURN$(EEXT) || \
+        echo error) 2>&1 | egrep -i 'error|warn' > /dev/null; then \
+    echo '#define HAS_NORETURN 1'; \
+else \
+    echo '/* #undef HAS_NORETURN */'; \
+fi > $@
+
+build/include/HAS_RESTRICT.h: build/make/dr_config.mk $(PROJROOT)config/checks/HAS_RESTRICT.c
+	$(E_GEN) \
+if ! (cd build/make_obj && \
+        $(CC) $(CSTD) $(CPPFLAGS) $(CFLAGS) $(LDFLAGS) ../../$(PROJROOT)config/checks/HAS_RESTRICT.c $(OUTPUT_L)HAS_RESTRICT$(EEXT) || \
+        echo error) 2>&1 | egrep -i 'error|warn' > /dev/null; then \
+    echo '#define HAS_RESTRICT 1'; \
+else \
+    echo '/* #undef HAS_RESTRICT */'; \
+fi > $@
+
+build/include/HAS_STATEMENT_EXPRESSIONS.h: build/make/dr_config.mk $(PROJROOT)config/checks/HAS_STATEMENT_EXPRESSIONS.c
+	$(E_GEN) \
+if ! (cd build/make_obj && \
+        $(CC) $(CSTD) $(CPPFLAGS) $(CFLAGS) $(LDFLAGS) ../../$(PROJROOT)config/checks/HAS_STATEMENT_EXPRESSIONS.c $(OUTPUT_L)HAS_STATEMENT_EXPRESSIONS$(EEXT) || \
+        echo error) 2>&1 | egrep -i 'error|warn' > /dev/null; then \
+    echo '#define HAS_STATEMENT_EXPRESSIONS 1'; \
+else \
+    echo '/* #undef HAS_STATEMENT_EXPRESSIONS */'; \
+fi > $@
+
+build/include/HAS_TYPEOF.h: build/make/dr_config.mk $(PROJROOT)config/checks/HAS_TYPEOF.c
+	$(E_GEN) \
+if ! (cd build/make_obj && \
+        $(CC) $(CSTD) $(CPPFLAGS) $(CFLAGS) $(LDFLAGS) ../../$(PROJROOT)config/checks/HAS_TYPEOF.c $(OUTPUT_L)HAS_TYPEOF$(EEXT) || \
+        echo error) 2>&1 | egrep -i 'error|warn' > /dev/null; then \
+    echo '#define HAS_TYPEOF 1'; \
+else \
+    echo '/* #undef HAS_TYPEOF */'; \
+fi > $@
+
+build/include/HAS___ALIGNOF.h: build/make/dr_config.mk $(PROJROOT)config/checks/HAS___ALIGNOF.c
+	$(E_GEN) \
+if ! (cd build/make_obj && \
+        $(CC) $(CSTD) $(CPPFLAGS) $(CFLAGS) $(LDFLAGS) ../../$(PROJROOT)config/checks/HAS___ALIGNOF.c $(OUTPUT_L)HAS___ALIGNOF$(EEXT) || \
+        echo error) 2>&1 | egrep -i 'error|warn' > /dev/null; then \
+    echo '#define HAS___ALIGNOF 1'; \
+else \
+    echo '/* #undef HAS___ALIGNOF */'; \
+fi > $@
+
+build/include/HAS___ALIGNOF__.h: build/make/dr_config.mk $(PROJROOT)config/checks/HAS___ALIGNOF__.c
+	$(E_GEN) \
+if ! (cd build/make_obj && \
+        $(CC) $(CSTD) $(CPPFLAGS) $(CFLAGS) $(LDFLAGS) ../../$(PROJROOT)config/checks/HAS___ALIGNOF__.c $(OUTPUT_L)HAS___ALIGNOF__$(EEXT) || \
+        echo error) 2>&1 | egrep -i 'error|warn' > /dev/null; then \
+    echo '#define HAS___ALIGNOF__ 1'; \
+else \
+    echo '/* #undef HAS___ALIGNOF__ */'; \
+fi > $@
+
+build/include/IS_BIG_ENDIAN.h: build/make/dr_config.mk $(PROJROOT)config/checks/IS_BIG_ENDIAN.c
+	$(E_GEN) \
+if ! (cd build/make_obj && \
+        $(CC) $(CSTD) $(CPPFLAGS) $(CFLAGS) $(LDFLAGS) ../../$(PROJROOT)config/checks/IS_BIG_ENDIAN.c $(OUTPUT_L)IS_BIG_ENDIAN$(EEXT) || \
+        echo error) 2>&1 | egrep -i 'error|warn' > /dev/null; then \
+    echo '#define IS_BIG_ENDIAN 1'; \
+else \
+    echo '/* #undef IS_BIG_ENDIAN */'; \
+fi > $@
+
+build/include/IS_LITTLE_ENDIAN.h: build/make/dr_config.mk $(PROJROOT)config/checks/IS_LITTLE_ENDIAN.c
+	$(E_GEN) \
+if ! (cd build/make_obj && \
+        $(CC) $(CSTD) $(CPPFLAGS) $(CFLAGS) $(LDFLAGS) ../../$(PROJROOT)config/checks/IS_LITTLE_ENDIAN.c $(OUTPUT_L)IS_LITTLE_ENDIAN$(EEXT) || \
+        echo error) 2>&1 | egrep -i 'error|warn' > /dev/null; then \
+    echo '#define IS_LITTLE_ENDIAN 1'; \
+else \
+    echo '/* #undef IS_LITTLE_ENDIAN */'; \
+fi > $@
+
+build/include/dr_config.h: build/include/ALWAYS_FAILS.h build/include/ALWAYS_SUCCEEDS.h build/include/HAS_ACCEPT4.h build/include/HAS_ANON_STRUCT_FIELDS.h build/include/HAS_ATTRIBUTE_NORETURN.h build/include/HAS_ATTRIBUTE_WARN_UNUSED_RESULT.h build/include/HAS_BUILTIN_BSWAP.h build/include/HAS_BUILTIN_CLZLL.h build/include/HAS_BUILTIN_EXPECT.h build/include/HAS_BUILTIN_MEMCPY.h build/include/HAS_COMPOUND_LITERALS.h build/include/HAS_DECLSPEC_NORETURN.h build/include/HAS_DECLTYPE.h build/include/HAS_DESIGNATED_INITIALIZERS.h build/include/HAS_GENERIC.h build/include/HAS_KEVENT.h build/include/HAS_MEMFD_CREATE.h build/include/HAS_MIXED_DECLARATIONS.h build/include/HAS_NORETURN.h build/include/HAS_RESTRICT.h build/include/HAS_STATEMENT_EXPRESSIONS.h build/include/HAS_TYPEOF.h build/include/HAS___ALIGNOF.h build/include/HAS___ALIGNOF__.h build/include/IS_BIG_ENDIAN.h build/include/IS_LITTLE_ENDIAN.h
+	$(E_GEN) \
+( \
+    echo '#if !defined(DR_CONFIG_H)'; \
+    echo '#define DR_CONFIG_H'; \
+    cat  build/include/ALWAYS_FAILS.h build/include/ALWAYS_SUCCEEDS.h build/include/HAS_ACCEPT4.h build/include/HAS_ANON_STRUCT_FIELDS.h build/include/HAS_ATTRIBUTE_NORETURN.h build/include/HAS_ATTRIBUTE_WARN_UNUSED_RESULT.h build/include/HAS_BUILTIN_BSWAP.h build/include/HAS_BUILTIN_CLZLL.h build/include/HAS_BUILTIN_EXPECT.h build/include/HAS_BUILTIN_MEMCPY.h build/include/HAS_COMPOUND_LITERALS.h build/include/HAS_DECLSPEC_NORETURN.h build/include/HAS_DECLTYPE.h build/include/HAS_DESIGNATED_INITIALIZERS.h build/include/HAS_GENERIC.h build/include/HAS_KEVENT.h build/include/HAS_MEMFD_CREATE.h build/include/HAS_MIXED_DECLARATIONS.h build/include/HAS_NORETURN.h build/include/HAS_RESTRICT.h build/include/HAS_STATEMENT_EXPRESSIONS.h build/include/HAS_TYPEOF.h build/include/HAS___ALIGNOF.h build/include/HAS___ALIGNOF__.h build/include/IS_BIG_ENDIAN.h build/include/IS_LITTLE_ENDIAN.h; \
+    echo '#endif // DR_CONFIG_H'\
+) > $@
+
@@ -0,0 +1 @@
+OEXT=.o
@@ -0,0 +1,6 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// Copyright (c) 2018 Drew Richardson <drewrichardson@gmail.com>
+
+int main(void) {
+  return 0;
+}
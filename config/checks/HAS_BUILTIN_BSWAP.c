@@ -0,0 +1,9 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// Copyright (c) 2018 Drew Richardson <drewrichardson@gmail.com>
+
+int main(void) {
+  unsigned short s = 1;
+  unsigned int i = 1;
+  unsigned long long l = 1;
+  return __builtin_bswap16(s) == 0x100 && __builtin_bswap32(i) == 0x1000000 && __builtin_bswap64(l) == 0x100000000000000ULL ? 0 : -1;
+}
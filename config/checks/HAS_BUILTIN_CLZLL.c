@@ -0,0 +1,7 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// Copyright (c) 2018 Drew Richardson <drewrichardson@gmail.com>
+
+int main(void) {
+  unsigned long long i = 1;
+  return __builtin_clzll(i) == 63 ? 0 : -1;
+}
@@ -0,0 +1,9 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// Copyright (c) 2018 Drew Richardson <drewrichardson@gmail.com>
+
+int main(void) {
+  unsigned int i = 1;
+  unsigned int j = 0;
+  __builtin_memcpy(&j, &i, sizeof(j));
+  return j == 1 ? 0 : -1;
+}
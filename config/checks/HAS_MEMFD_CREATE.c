@@ -0,0 +1,16 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// Copyright (c) 2018 Drew Richardson <drewrichardson@gmail.com>
+
+#if defined(__linux__)
+#define _GNU_SOURCE
+#endif
+
+#include <sys/mman.h>
+
+int main(void) {
+  const char *name = "";
+  unsigned int flags = MFD_CLOEXEC;
+  int fd = 0;
+  fd = memfd_create(name, flags);
+  return fd;
+}
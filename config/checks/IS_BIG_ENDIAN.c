@@ -0,0 +1,11 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// Copyright (c) 2018 Drew Richardson <drewrichardson@gmail.com>
+
+// Only needs to compile, so it also works when cross compiling
+#if !defined(__BYTE_ORDER__) || !defined(__ORDER_BIG_ENDIAN__) || __BYTE_ORDER__ != __ORDER_BIG_ENDIAN__
+#error Not big endian
+#endif
+
+int main(void) {
+  return 0;
+}
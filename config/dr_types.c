@@ -44,6 +44,18 @@ int main(void) {
     DR_HEXSTR((SIZE(struct dr_equeue_client_impl) + ALIGN(struct dr_equeue_client_impl) - 1)/ALIGN(struct dr_equeue_client_impl)),
     ']',';',' ','}',';','\n',
 
+    's','t','r','u','c','t',' ','d','r','_','p','o','o','l',' ','{',' ',
+    DR_XINTXX2(ALIGN(struct dr_pool_impl), 1),
+    ' ','_','_','p','r','i','v','a','t','e','[',
+    DR_HEXSTR((SIZE(struct dr_pool_impl) + ALIGN(struct dr_pool_impl) - 1)/ALIGN(struct dr_pool_impl)),
+    ']',';',' ','}',';','\n',
+
+    's','t','r','u','c','t',' ','d','r','_','9','p','_','c','l','i','e','n','t',' ','{',' ',
+    DR_XINTXX2(ALIGN(struct dr_9p_client_impl), 1),
+    ' ','_','_','p','r','i','v','a','t','e','[',
+    DR_HEXSTR((SIZE(struct dr_9p_client_impl) + ALIGN(struct dr_9p_client_impl) - 1)/ALIGN(struct dr_9p_client_impl)),
+    ']',';',' ','}',';','\n',
+
     '\n','\0',
   };
   printf("%s", buf);
@@ -0,0 +1,26 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// Copyright (c) 2018 Drew Richardson <drewrichardson@gmail.com>
+
+#if defined(_WIN32)
+
+int main(void) {
+  return 0;
+}
+
+#else
+
+#include <pthread.h>
+
+static void *start(void *arg) {
+  return arg;
+}
+
+int main(void) {
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, start, NULL) != 0) {
+    return 1;
+  }
+  return pthread_join(thread, NULL);
+}
+
+#endif
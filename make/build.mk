@@ -10,12 +10,15 @@ include build/make/deps.mk
 include build/make/overrides.mk
 include build/make/ACCEPT_LDLIBS.mk
 include build/make/ACCEPTEX_LDLIBS.mk
+include build/make/PTHREAD_LDLIBS.mk
 
 # https://news.ycombinator.com/item?id=13993681 ?
 CPPFLAGS_linux = -D_GNU_SOURCE
 # Windows 7
 CPPFLAGS_windows = -DWINVER=0x0601 -D_WIN32_WINNT=0x0601
-CPPFLAGS_ALL = $(CPPFLAG_WUNDEF) $(CPPFLAGS_$(OS)) $(CPPFLAG_MD) -Ibuild/include -I$(PROJROOT)src
+# dr_logf calls below this level are compiled out, DR_LOG_INFO drops the per message debug logging
+LOG_MIN_LEVEL = DR_LOG_DEBUG
+CPPFLAGS_ALL = $(CPPFLAG_WUNDEF) $(CPPFLAGS_$(OS)) $(CPPFLAG_MD) -DDR_LOG_MIN_LEVEL=$(LOG_MIN_LEVEL) -Ibuild/include -I$(PROJROOT)src
 CFLAGS_ALL = $(CFLAG_WFAILS) $(CFLAG_WALL) $(CFLAG_WEXTRA) $(CFLAG_WMISSINGPROTOTYPES) $(CFLAG_WOLDSTYLEDEFINITION) $(CFLAG_WPOINTERARITH) $(CFLAG_WSHADOW) $(CFLAG_WSTRICTPROTOTYPES) $(CFLAG_WWRITESTRINGS) $(CFLAG_WIMPLICITFUNCTIONDECLARATION) $(CFLAG_WDUPLICATEDCOND) $(CFLAG_WDUPLICATEDBRANCHES) $(CFLAG_WLOGICALOP) $(CFLAG_WRESTRICT) $(CFLAG_WNULLDEREFERENCE) $(CFLAG_WJUMPMISSESINIT) $(CFLAG_WDOUBLEPROMOTION) $(CFLAG_WANOEXECSTACK) $(CFLAG_FNOASYNCHRONOUSUNWINDTABLES) $(CFLAG_FNOEXCEPTIONS) $(CFLAG_FNOUNWINDTABLES) $(CFLAG_FOMITFRAMEPOINTER) $(CFLAG_FVISIBILITYHIDDEN) $(CFLAG_FPIE) $(CFLAG_NOLOGO) $(CFLAG_PIPE)
 # -Wno-override-init -Wno-missing-field-initializers
 # These are helpful but result in some warnings I'm unsure how to fix
@@ -30,12 +33,18 @@ FLAGS_L = $(CFLAG_NOLOGO) $(CFLAG_FPIE) $(LDFLAGS)
 build/obj/getopt$(OEXT): build/make/dr_config.mk $(PROJROOT)src/getopt.c
 	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)src/getopt.c $(OUTPUT_C)$@
 
+build/obj/dr_9p_client$(OEXT): build/make/dr_config.mk $(PROJROOT)src/dr_9p_client.c
+	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)src/dr_9p_client.c $(OUTPUT_C)$@
+
 build/obj/dr_9p_decode$(OEXT): build/make/dr_config.mk $(PROJROOT)src/dr_9p_decode.c
 	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)src/dr_9p_decode.c $(OUTPUT_C)$@
 
 build/obj/dr_9p_encode$(OEXT): build/make/dr_config.mk $(PROJROOT)src/dr_9p_encode.c
 	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)src/dr_9p_encode.c $(OUTPUT_C)$@
 
+build/obj/dr_chan$(OEXT): build/make/dr_config.mk $(PROJROOT)src/dr_chan.c
+	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)src/dr_chan.c $(OUTPUT_C)$@
+
 build/obj/dr_clock$(OEXT): build/make/dr_config.mk $(PROJROOT)src/dr_clock.c
 	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)src/dr_clock.c $(OUTPUT_C)$@
 
@@ -45,6 +54,9 @@ build/obj/dr_console$(OEXT): build/make/dr_config.mk $(PROJROOT)src/dr_console.c
 build/obj/dr_event$(OEXT): build/make/dr_config.mk $(PROJROOT)src/dr_event.c
 	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)src/dr_event.c $(OUTPUT_C)$@
 
+build/obj/dr_hist$(OEXT): build/make/dr_config.mk $(PROJROOT)src/dr_hist.c
+	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)src/dr_hist.c $(OUTPUT_C)$@
+
 build/obj/dr_io$(OEXT): build/make/dr_config.mk $(PROJROOT)src/dr_io.c
 	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)src/dr_io.c $(OUTPUT_C)$@
 
@@ -57,12 +69,24 @@ build/obj/dr_pipe$(OEXT): build/make/dr_config.mk $(PROJROOT)src/dr_pipe.c
 build/obj/dr_socket$(OEXT): build/make/dr_config.mk $(PROJROOT)src/dr_socket.c
 	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)src/dr_socket.c $(OUTPUT_C)$@
 
+build/obj/dr_resolve$(OEXT): build/make/dr_config.mk $(PROJROOT)src/dr_resolve.c
+	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)src/dr_resolve.c $(OUTPUT_C)$@
+
+build/obj/dr_ring$(OEXT): build/make/dr_config.mk $(PROJROOT)src/dr_ring.c
+	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)src/dr_ring.c $(OUTPUT_C)$@
+
 build/obj/dr_sem$(OEXT): build/make/dr_config.mk $(PROJROOT)src/dr_sem.c
 	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)src/dr_sem.c $(OUTPUT_C)$@
 
+build/obj/dr_pool$(OEXT): build/make/dr_config.mk $(PROJROOT)src/dr_pool.c
+	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)src/dr_pool.c $(OUTPUT_C)$@
+
 build/obj/dr_str$(OEXT): build/make/dr_config.mk $(PROJROOT)src/dr_str.c
 	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)src/dr_str.c $(OUTPUT_C)$@
 
+build/obj/dr_tmpfs$(OEXT): build/make/dr_config.mk $(PROJROOT)src/dr_tmpfs.c
+	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)src/dr_tmpfs.c $(OUTPUT_C)$@
+
 build/obj/dr_task$(OEXT): build/make/dr_config.mk $(PROJROOT)src/dr_task.c
 	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)src/dr_task.c $(OUTPUT_C)$@
 
@@ -72,6 +96,9 @@ build/obj/$(dr_task_destroy_on_do$(AEXT))dr_task_destroy_on_do$(OEXT): build/mak
 build/obj/$(dr_task_switch$(AEXT))dr_task_switch$(OEXT): build/make/dr_config.mk $(PROJROOT)src/$(dr_task_switch$(AEXT))dr_task_switch$(AEXT)
 	$(E_CCAS)$(CCAS) $(FLAGS_C) $(OUTPUT_C)$@ $(PROJROOT)src/$(dr_task_switch$(AEXT))dr_task_switch$(AEXT)
 
+build/obj/dr_trace$(OEXT): build/make/dr_config.mk $(PROJROOT)src/dr_trace.c
+	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)src/dr_trace.c $(OUTPUT_C)$@
+
 build/obj/dr_vfs$(OEXT): build/make/dr_config.mk $(PROJROOT)src/dr_vfs.c
 	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)src/dr_vfs.c $(OUTPUT_C)$@
 
@@ -81,50 +108,140 @@ build/obj/9p_code$(OEXT): build/make/dr_config.mk $(PROJROOT)test/9p_code.c
 build/obj/9p_fuzz$(OEXT): build/make/dr_config.mk $(PROJROOT)test/9p_fuzz.c
 	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)test/9p_fuzz.c $(OUTPUT_C)$@
 
+build/obj/9p_bench$(OEXT): build/make/dr_config.mk $(PROJROOT)src/9p_bench.c
+	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)src/9p_bench.c $(OUTPUT_C)$@
+
 build/obj/9p_client$(OEXT): build/make/dr_config.mk $(PROJROOT)src/9p_client.c
 	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)src/9p_client.c $(OUTPUT_C)$@
 
 build/obj/9p_server$(OEXT): build/make/dr_config.mk $(PROJROOT)src/9p_server.c
 	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)src/9p_server.c $(OUTPUT_C)$@
 
+build/obj/9p_trace$(OEXT): build/make/dr_config.mk $(PROJROOT)src/9p_trace.c
+	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)src/9p_trace.c $(OUTPUT_C)$@
+
+build/obj/codec_bench$(OEXT): build/make/dr_config.mk $(PROJROOT)test/codec_bench.c
+	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)test/codec_bench.c $(OUTPUT_C)$@
+
+build/obj/connect$(OEXT): build/make/dr_config.mk $(PROJROOT)test/connect.c
+	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)test/connect.c $(OUTPUT_C)$@
+
+build/obj/containers$(OEXT): build/make/dr_config.mk $(PROJROOT)test/containers.c
+	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)test/containers.c $(OUTPUT_C)$@
+
+build/obj/containers_bench$(OEXT): build/make/dr_config.mk $(PROJROOT)test/containers_bench.c
+	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)test/containers_bench.c $(OUTPUT_C)$@
+
+build/obj/chan$(OEXT): build/make/dr_config.mk $(PROJROOT)test/chan.c
+	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)test/chan.c $(OUTPUT_C)$@
+
 build/obj/client$(OEXT): build/make/dr_config.mk $(PROJROOT)test/client.c
 	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)test/client.c $(OUTPUT_C)$@
 
+build/obj/cache$(OEXT): build/make/dr_config.mk $(PROJROOT)test/cache.c
+	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)test/cache.c $(OUTPUT_C)$@
+
+build/obj/hist$(OEXT): build/make/dr_config.mk $(PROJROOT)test/hist.c
+	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)test/hist.c $(OUTPUT_C)$@
+
 build/obj/perms$(OEXT): build/make/dr_config.mk $(PROJROOT)test/perms.c
 	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)test/perms.c $(OUTPUT_C)$@
 
+build/obj/pipeline$(OEXT): build/make/dr_config.mk $(PROJROOT)test/pipeline.c
+	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)test/pipeline.c $(OUTPUT_C)$@
+
+build/obj/pool$(OEXT): build/make/dr_config.mk $(PROJROOT)test/pool.c
+	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)test/pool.c $(OUTPUT_C)$@
+
 build/obj/queue$(OEXT): build/make/dr_config.mk $(PROJROOT)test/queue.c
 	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)test/queue.c $(OUTPUT_C)$@
 
+build/obj/resolve$(OEXT): build/make/dr_config.mk $(PROJROOT)test/resolve.c
+	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)test/resolve.c $(OUTPUT_C)$@
+
+build/obj/sem$(OEXT): build/make/dr_config.mk $(PROJROOT)test/sem.c
+	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)test/sem.c $(OUTPUT_C)$@
+
 build/obj/server$(OEXT): build/make/dr_config.mk $(PROJROOT)test/server.c
 	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)test/server.c $(OUTPUT_C)$@
 
 build/obj/task$(OEXT): build/make/dr_config.mk $(PROJROOT)test/task.c
 	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)test/task.c $(OUTPUT_C)$@
 
+build/obj/tmpfs$(OEXT): build/make/dr_config.mk $(PROJROOT)test/tmpfs.c
+	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)test/tmpfs.c $(OUTPUT_C)$@
+
+build/obj/trace$(OEXT): build/make/dr_config.mk $(PROJROOT)test/trace.c
+	$(E_CC)$(CC) $(FLAGS_C) $(PROJROOT)test/trace.c $(OUTPUT_C)$@
+
 build/dist/9p_code$(EEXT): build/make/dr_config.mk build/obj/dr_9p_decode$(OEXT) build/obj/dr_9p_encode$(OEXT) build/obj/dr_clock$(OEXT) build/obj/dr_log$(OEXT) build/obj/9p_code$(OEXT)
 	$(E_CCLD)$(CC) $(FLAGS_L) build/obj/dr_9p_decode$(OEXT) build/obj/dr_9p_encode$(OEXT) build/obj/dr_clock$(OEXT) build/obj/dr_log$(OEXT) build/obj/9p_code$(OEXT) $(ACCEPT_LDLIBS) $(LDLIBS) $(OUTPUT_L)$@
 
-build/dist/9p_fuzz$(EEXT): build/make/dr_config.mk build/obj/dr_9p_decode$(OEXT) build/obj/dr_clock$(OEXT) build/obj/dr_console$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/9p_fuzz$(OEXT)
-	$(E_CCLD)$(CC) $(FLAGS_L) build/obj/dr_9p_decode$(OEXT) build/obj/dr_clock$(OEXT) build/obj/dr_console$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/9p_fuzz$(OEXT) $(ACCEPT_LDLIBS) $(LDLIBS) $(OUTPUT_L)$@
+build/dist/9p_fuzz$(EEXT): build/make/dr_config.mk build/obj/dr_9p_decode$(OEXT) build/obj/dr_9p_encode$(OEXT) build/obj/dr_clock$(OEXT) build/obj/dr_console$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/9p_fuzz$(OEXT)
+	$(E_CCLD)$(CC) $(FLAGS_L) build/obj/dr_9p_decode$(OEXT) build/obj/dr_9p_encode$(OEXT) build/obj/dr_clock$(OEXT) build/obj/dr_console$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/9p_fuzz$(OEXT) $(ACCEPT_LDLIBS) $(LDLIBS) $(OUTPUT_L)$@
+
+build/dist/9p_bench$(EEXT): build/make/dr_config.mk build/obj/getopt$(OEXT) build/obj/dr_9p_client$(OEXT) build/obj/dr_9p_encode$(OEXT) build/obj/dr_9p_decode$(OEXT) build/obj/dr_clock$(OEXT) build/obj/dr_event$(OEXT) build/obj/dr_hist$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_pool$(OEXT) build/obj/dr_resolve$(OEXT) build/obj/dr_sem$(OEXT) build/obj/dr_socket$(OEXT) build/obj/dr_task$(OEXT) build/obj/$(dr_task_destroy_on_do$(AEXT))dr_task_destroy_on_do$(OEXT) build/obj/$(dr_task_switch$(AEXT))dr_task_switch$(OEXT) build/obj/9p_bench$(OEXT)
+	$(E_CCLD)$(CC) $(FLAGS_L) build/obj/getopt$(OEXT) build/obj/dr_9p_client$(OEXT) build/obj/dr_9p_encode$(OEXT) build/obj/dr_9p_decode$(OEXT) build/obj/dr_clock$(OEXT) build/obj/dr_event$(OEXT) build/obj/dr_hist$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_pool$(OEXT) build/obj/dr_resolve$(OEXT) build/obj/dr_sem$(OEXT) build/obj/dr_socket$(OEXT) build/obj/dr_task$(OEXT) build/obj/$(dr_task_destroy_on_do$(AEXT))dr_task_destroy_on_do$(OEXT) build/obj/$(dr_task_switch$(AEXT))dr_task_switch$(OEXT) build/obj/9p_bench$(OEXT) $(ACCEPT_LDLIBS) $(ACCEPTEX_LDLIBS) $(PTHREAD_LDLIBS) $(LDLIBS) $(OUTPUT_L)$@
+
+build/dist/9p_client$(EEXT): build/make/dr_config.mk build/obj/getopt$(OEXT) build/obj/dr_9p_client$(OEXT) build/obj/dr_9p_encode$(OEXT) build/obj/dr_9p_decode$(OEXT) build/obj/dr_clock$(OEXT) build/obj/dr_event$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_pipe$(OEXT) build/obj/dr_pool$(OEXT) build/obj/dr_resolve$(OEXT) build/obj/dr_sem$(OEXT) build/obj/dr_socket$(OEXT) build/obj/dr_task$(OEXT) build/obj/$(dr_task_destroy_on_do$(AEXT))dr_task_destroy_on_do$(OEXT) build/obj/$(dr_task_switch$(AEXT))dr_task_switch$(OEXT) build/obj/9p_client$(OEXT)
+	$(E_CCLD)$(CC) $(FLAGS_L) build/obj/getopt$(OEXT) build/obj/dr_9p_client$(OEXT) build/obj/dr_9p_encode$(OEXT) build/obj/dr_9p_decode$(OEXT) build/obj/dr_clock$(OEXT) build/obj/dr_event$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_pipe$(OEXT) build/obj/dr_pool$(OEXT) build/obj/dr_resolve$(OEXT) build/obj/dr_sem$(OEXT) build/obj/dr_socket$(OEXT) build/obj/dr_task$(OEXT) build/obj/$(dr_task_destroy_on_do$(AEXT))dr_task_destroy_on_do$(OEXT) build/obj/$(dr_task_switch$(AEXT))dr_task_switch$(OEXT) build/obj/9p_client$(OEXT) $(ACCEPT_LDLIBS) $(ACCEPTEX_LDLIBS) $(PTHREAD_LDLIBS) $(LDLIBS) $(OUTPUT_L)$@
+
+build/dist/9p_server$(EEXT): build/make/dr_config.mk build/obj/getopt$(OEXT) build/obj/dr_9p_decode$(OEXT) build/obj/dr_clock$(OEXT) build/obj/dr_9p_encode$(OEXT) build/obj/dr_event$(OEXT) build/obj/dr_hist$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_pipe$(OEXT) build/obj/dr_pool$(OEXT) build/obj/dr_resolve$(OEXT) build/obj/dr_sem$(OEXT) build/obj/dr_socket$(OEXT) build/obj/dr_str$(OEXT) build/obj/dr_task$(OEXT) build/obj/$(dr_task_destroy_on_do$(AEXT))dr_task_destroy_on_do$(OEXT) build/obj/$(dr_task_switch$(AEXT))dr_task_switch$(OEXT) build/obj/dr_tmpfs$(OEXT) build/obj/dr_trace$(OEXT) build/obj/dr_vfs$(OEXT) build/obj/9p_server$(OEXT)
+	$(E_CCLD)$(CC) $(FLAGS_L) build/obj/getopt$(OEXT) build/obj/dr_9p_decode$(OEXT) build/obj/dr_clock$(OEXT) build/obj/dr_9p_encode$(OEXT) build/obj/dr_event$(OEXT) build/obj/dr_hist$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_pipe$(OEXT) build/obj/dr_pool$(OEXT) build/obj/dr_resolve$(OEXT) build/obj/dr_sem$(OEXT) build/obj/dr_socket$(OEXT) build/obj/dr_str$(OEXT) build/obj/dr_task$(OEXT) build/obj/$(dr_task_destroy_on_do$(AEXT))dr_task_destroy_on_do$(OEXT) build/obj/$(dr_task_switch$(AEXT))dr_task_switch$(OEXT) build/obj/dr_tmpfs$(OEXT) build/obj/dr_trace$(OEXT) build/obj/dr_vfs$(OEXT) build/obj/9p_server$(OEXT) $(ACCEPT_LDLIBS) $(ACCEPTEX_LDLIBS) $(PTHREAD_LDLIBS) $(LDLIBS) $(OUTPUT_L)$@
+
+build/dist/9p_trace$(EEXT): build/make/dr_config.mk build/obj/getopt$(OEXT) build/obj/dr_9p_decode$(OEXT) build/obj/dr_clock$(OEXT) build/obj/dr_log$(OEXT) build/obj/9p_trace$(OEXT)
+	$(E_CCLD)$(CC) $(FLAGS_L) build/obj/getopt$(OEXT) build/obj/dr_9p_decode$(OEXT) build/obj/dr_clock$(OEXT) build/obj/dr_log$(OEXT) build/obj/9p_trace$(OEXT) $(ACCEPT_LDLIBS) $(LDLIBS) $(OUTPUT_L)$@
+
+build/dist/codec_bench$(EEXT): build/make/dr_config.mk build/obj/dr_9p_decode$(OEXT) build/obj/dr_9p_encode$(OEXT) build/obj/dr_clock$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_trace$(OEXT) build/obj/codec_bench$(OEXT)
+	$(E_CCLD)$(CC) $(FLAGS_L) build/obj/dr_9p_decode$(OEXT) build/obj/dr_9p_encode$(OEXT) build/obj/dr_clock$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_trace$(OEXT) build/obj/codec_bench$(OEXT) $(ACCEPT_LDLIBS) $(LDLIBS) $(OUTPUT_L)$@
+
+build/dist/connect$(EEXT): build/make/dr_config.mk build/obj/dr_clock$(OEXT) build/obj/dr_event$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_pool$(OEXT) build/obj/dr_resolve$(OEXT) build/obj/dr_sem$(OEXT) build/obj/dr_socket$(OEXT) build/obj/dr_task$(OEXT) build/obj/$(dr_task_destroy_on_do$(AEXT))dr_task_destroy_on_do$(OEXT) build/obj/$(dr_task_switch$(AEXT))dr_task_switch$(OEXT) build/obj/connect$(OEXT)
+	$(E_CCLD)$(CC) $(FLAGS_L) build/obj/dr_clock$(OEXT) build/obj/dr_event$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_pool$(OEXT) build/obj/dr_resolve$(OEXT) build/obj/dr_sem$(OEXT) build/obj/dr_socket$(OEXT) build/obj/dr_task$(OEXT) build/obj/$(dr_task_destroy_on_do$(AEXT))dr_task_destroy_on_do$(OEXT) build/obj/$(dr_task_switch$(AEXT))dr_task_switch$(OEXT) build/obj/connect$(OEXT) $(ACCEPT_LDLIBS) $(ACCEPTEX_LDLIBS) $(PTHREAD_LDLIBS) $(LDLIBS) $(OUTPUT_L)$@
 
-build/dist/9p_client$(EEXT): build/make/dr_config.mk build/obj/getopt$(OEXT) build/obj/dr_9p_encode$(OEXT) build/obj/dr_9p_decode$(OEXT) build/obj/dr_clock$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_pipe$(OEXT) build/obj/dr_socket$(OEXT) build/obj/9p_client$(OEXT)
-	$(E_CCLD)$(CC) $(FLAGS_L) build/obj/getopt$(OEXT) build/obj/dr_9p_encode$(OEXT) build/obj/dr_9p_decode$(OEXT) build/obj/dr_clock$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_pipe$(OEXT) build/obj/dr_socket$(OEXT) build/obj/9p_client$(OEXT) $(ACCEPT_LDLIBS) $(LDLIBS) $(OUTPUT_L)$@
+build/dist/containers$(EEXT): build/make/dr_config.mk build/obj/dr_clock$(OEXT) build/obj/dr_log$(OEXT) build/obj/containers$(OEXT)
+	$(E_CCLD)$(CC) $(FLAGS_L) build/obj/dr_clock$(OEXT) build/obj/dr_log$(OEXT) build/obj/containers$(OEXT) $(LDLIBS) $(OUTPUT_L)$@
 
-build/dist/9p_server$(EEXT): build/make/dr_config.mk build/obj/getopt$(OEXT) build/obj/dr_9p_decode$(OEXT) build/obj/dr_clock$(OEXT) build/obj/dr_9p_encode$(OEXT) build/obj/dr_event$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_pipe$(OEXT) build/obj/dr_socket$(OEXT) build/obj/dr_str$(OEXT) build/obj/dr_task$(OEXT) build/obj/$(dr_task_destroy_on_do$(AEXT))dr_task_destroy_on_do$(OEXT) build/obj/$(dr_task_switch$(AEXT))dr_task_switch$(OEXT) build/obj/dr_vfs$(OEXT) build/obj/9p_server$(OEXT)
-	$(E_CCLD)$(CC) $(FLAGS_L) build/obj/getopt$(OEXT) build/obj/dr_9p_decode$(OEXT) build/obj/dr_clock$(OEXT) build/obj/dr_9p_encode$(OEXT) build/obj/dr_event$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_pipe$(OEXT) build/obj/dr_socket$(OEXT) build/obj/dr_str$(OEXT) build/obj/dr_task$(OEXT) build/obj/$(dr_task_destroy_on_do$(AEXT))dr_task_destroy_on_do$(OEXT) build/obj/$(dr_task_switch$(AEXT))dr_task_switch$(OEXT) build/obj/dr_vfs$(OEXT) build/obj/9p_server$(OEXT) $(ACCEPT_LDLIBS) $(ACCEPTEX_LDLIBS) $(LDLIBS) $(OUTPUT_L)$@
+build/dist/containers_bench$(EEXT): build/make/dr_config.mk build/obj/dr_clock$(OEXT) build/obj/dr_log$(OEXT) build/obj/containers_bench$(OEXT)
+	$(E_CCLD)$(CC) $(FLAGS_L) build/obj/dr_clock$(OEXT) build/obj/dr_log$(OEXT) build/obj/containers_bench$(OEXT) $(LDLIBS) $(OUTPUT_L)$@
 
-build/dist/client$(EEXT): build/make/dr_config.mk build/obj/getopt$(OEXT) build/obj/dr_clock$(OEXT) build/obj/dr_console$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_socket$(OEXT) build/obj/client$(OEXT)
-	$(E_CCLD)$(CC) $(FLAGS_L) build/obj/getopt$(OEXT) build/obj/dr_clock$(OEXT) build/obj/dr_console$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_socket$(OEXT) build/obj/client$(OEXT) $(ACCEPT_LDLIBS) $(LDLIBS) $(OUTPUT_L)$@
+build/dist/chan$(EEXT): build/make/dr_config.mk build/obj/dr_chan$(OEXT) build/obj/dr_clock$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_sem$(OEXT) build/obj/dr_task$(OEXT) build/obj/$(dr_task_destroy_on_do$(AEXT))dr_task_destroy_on_do$(OEXT) build/obj/$(dr_task_switch$(AEXT))dr_task_switch$(OEXT) build/obj/chan$(OEXT)
+	$(E_CCLD)$(CC) $(FLAGS_L) build/obj/dr_chan$(OEXT) build/obj/dr_clock$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_sem$(OEXT) build/obj/dr_task$(OEXT) build/obj/$(dr_task_destroy_on_do$(AEXT))dr_task_destroy_on_do$(OEXT) build/obj/$(dr_task_switch$(AEXT))dr_task_switch$(OEXT) build/obj/chan$(OEXT) $(LDLIBS) $(OUTPUT_L)$@
 
-build/dist/perms$(EEXT): build/make/dr_config.mk build/obj/dr_clock$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_str$(OEXT) build/obj/dr_vfs$(OEXT) build/obj/perms$(OEXT)
-	$(E_CCLD)$(CC) $(FLAGS_L) build/obj/dr_clock$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_str$(OEXT) build/obj/dr_vfs$(OEXT) build/obj/perms$(OEXT) $(ACCEPT_LDLIBS) $(LDLIBS) $(OUTPUT_L)$@
+build/dist/client$(EEXT): build/make/dr_config.mk build/obj/getopt$(OEXT) build/obj/dr_clock$(OEXT) build/obj/dr_console$(OEXT) build/obj/dr_event$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_pool$(OEXT) build/obj/dr_resolve$(OEXT) build/obj/dr_sem$(OEXT) build/obj/dr_socket$(OEXT) build/obj/dr_task$(OEXT) build/obj/$(dr_task_destroy_on_do$(AEXT))dr_task_destroy_on_do$(OEXT) build/obj/$(dr_task_switch$(AEXT))dr_task_switch$(OEXT) build/obj/client$(OEXT)
+	$(E_CCLD)$(CC) $(FLAGS_L) build/obj/getopt$(OEXT) build/obj/dr_clock$(OEXT) build/obj/dr_console$(OEXT) build/obj/dr_event$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_pool$(OEXT) build/obj/dr_resolve$(OEXT) build/obj/dr_sem$(OEXT) build/obj/dr_socket$(OEXT) build/obj/dr_task$(OEXT) build/obj/$(dr_task_destroy_on_do$(AEXT))dr_task_destroy_on_do$(OEXT) build/obj/$(dr_task_switch$(AEXT))dr_task_switch$(OEXT) build/obj/client$(OEXT) $(ACCEPT_LDLIBS) $(PTHREAD_LDLIBS) $(LDLIBS) $(OUTPUT_L)$@
 
-build/dist/queue$(EEXT): build/make/dr_config.mk build/obj/dr_clock$(OEXT) build/obj/dr_log$(OEXT) build/obj/queue$(OEXT)
-	$(E_CCLD)$(CC) $(FLAGS_L) build/obj/dr_clock$(OEXT) build/obj/dr_log$(OEXT) build/obj/queue$(OEXT) $(ACCEPT_LDLIBS) $(LDLIBS) $(OUTPUT_L)$@
+build/dist/cache$(EEXT): build/make/dr_config.mk build/obj/dr_clock$(OEXT) build/obj/dr_event$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_pool$(OEXT) build/obj/dr_resolve$(OEXT) build/obj/dr_sem$(OEXT) build/obj/dr_socket$(OEXT) build/obj/dr_str$(OEXT) build/obj/dr_task$(OEXT) build/obj/$(dr_task_destroy_on_do$(AEXT))dr_task_destroy_on_do$(OEXT) build/obj/$(dr_task_switch$(AEXT))dr_task_switch$(OEXT) build/obj/dr_vfs$(OEXT) build/obj/cache$(OEXT)
+	$(E_CCLD)$(CC) $(FLAGS_L) build/obj/dr_clock$(OEXT) build/obj/dr_event$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_pool$(OEXT) build/obj/dr_resolve$(OEXT) build/obj/dr_sem$(OEXT) build/obj/dr_socket$(OEXT) build/obj/dr_str$(OEXT) build/obj/dr_task$(OEXT) build/obj/$(dr_task_destroy_on_do$(AEXT))dr_task_destroy_on_do$(OEXT) build/obj/$(dr_task_switch$(AEXT))dr_task_switch$(OEXT) build/obj/dr_vfs$(OEXT) build/obj/cache$(OEXT) $(ACCEPT_LDLIBS) $(ACCEPTEX_LDLIBS) $(PTHREAD_LDLIBS) $(LDLIBS) $(OUTPUT_L)$@
 
-build/dist/server$(EEXT): build/make/dr_config.mk build/obj/getopt$(OEXT) build/obj/dr_clock$(OEXT) build/obj/dr_event$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_sem$(OEXT) build/obj/dr_socket$(OEXT) build/obj/dr_task$(OEXT) build/obj/$(dr_task_destroy_on_do$(AEXT))dr_task_destroy_on_do$(OEXT) build/obj/$(dr_task_switch$(AEXT))dr_task_switch$(OEXT) build/obj/server$(OEXT)
-	$(E_CCLD)$(CC) $(FLAGS_L) build/obj/getopt$(OEXT) build/obj/dr_clock$(OEXT) build/obj/dr_event$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_sem$(OEXT) build/obj/dr_socket$(OEXT) build/obj/dr_task$(OEXT) build/obj/$(dr_task_destroy_on_do$(AEXT))dr_task_destroy_on_do$(OEXT) build/obj/$(dr_task_switch$(AEXT))dr_task_switch$(OEXT) build/obj/server$(OEXT) $(ACCEPT_LDLIBS) $(ACCEPTEX_LDLIBS) $(LDLIBS) $(OUTPUT_L)$@
+build/dist/hist$(EEXT): build/make/dr_config.mk build/obj/dr_clock$(OEXT) build/obj/dr_hist$(OEXT) build/obj/dr_log$(OEXT) build/obj/hist$(OEXT)
+	$(E_CCLD)$(CC) $(FLAGS_L) build/obj/dr_clock$(OEXT) build/obj/dr_hist$(OEXT) build/obj/dr_log$(OEXT) build/obj/hist$(OEXT) $(ACCEPT_LDLIBS) $(LDLIBS) $(OUTPUT_L)$@
+
+build/dist/perms$(EEXT): build/make/dr_config.mk build/obj/dr_clock$(OEXT) build/obj/dr_event$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_pool$(OEXT) build/obj/dr_resolve$(OEXT) build/obj/dr_sem$(OEXT) build/obj/dr_socket$(OEXT) build/obj/dr_str$(OEXT) build/obj/dr_task$(OEXT) build/obj/$(dr_task_destroy_on_do$(AEXT))dr_task_destroy_on_do$(OEXT) build/obj/$(dr_task_switch$(AEXT))dr_task_switch$(OEXT) build/obj/dr_vfs$(OEXT) build/obj/perms$(OEXT)
+	$(E_CCLD)$(CC) $(FLAGS_L) build/obj/dr_clock$(OEXT) build/obj/dr_event$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_pool$(OEXT) build/obj/dr_resolve$(OEXT) build/obj/dr_sem$(OEXT) build/obj/dr_socket$(OEXT) build/obj/dr_str$(OEXT) build/obj/dr_task$(OEXT) build/obj/$(dr_task_destroy_on_do$(AEXT))dr_task_destroy_on_do$(OEXT) build/obj/$(dr_task_switch$(AEXT))dr_task_switch$(OEXT) build/obj/dr_vfs$(OEXT) build/obj/perms$(OEXT) $(ACCEPT_LDLIBS) $(ACCEPTEX_LDLIBS) $(PTHREAD_LDLIBS) $(LDLIBS) $(OUTPUT_L)$@
+
+build/dist/pipeline$(EEXT): build/make/dr_config.mk build/obj/dr_9p_client$(OEXT) build/obj/dr_9p_decode$(OEXT) build/obj/dr_9p_encode$(OEXT) build/obj/dr_clock$(OEXT) build/obj/dr_event$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_pool$(OEXT) build/obj/dr_resolve$(OEXT) build/obj/dr_sem$(OEXT) build/obj/dr_socket$(OEXT) build/obj/dr_task$(OEXT) build/obj/$(dr_task_destroy_on_do$(AEXT))dr_task_destroy_on_do$(OEXT) build/obj/$(dr_task_switch$(AEXT))dr_task_switch$(OEXT) build/obj/pipeline$(OEXT)
+	$(E_CCLD)$(CC) $(FLAGS_L) build/obj/dr_9p_client$(OEXT) build/obj/dr_9p_decode$(OEXT) build/obj/dr_9p_encode$(OEXT) build/obj/dr_clock$(OEXT) build/obj/dr_event$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_pool$(OEXT) build/obj/dr_resolve$(OEXT) build/obj/dr_sem$(OEXT) build/obj/dr_socket$(OEXT) build/obj/dr_task$(OEXT) build/obj/$(dr_task_destroy_on_do$(AEXT))dr_task_destroy_on_do$(OEXT) build/obj/$(dr_task_switch$(AEXT))dr_task_switch$(OEXT) build/obj/pipeline$(OEXT) $(ACCEPT_LDLIBS) $(ACCEPTEX_LDLIBS) $(PTHREAD_LDLIBS) $(LDLIBS) $(OUTPUT_L)$@
+
+build/dist/pool$(EEXT): build/make/dr_config.mk build/obj/dr_clock$(OEXT) build/obj/dr_event$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_pool$(OEXT) build/obj/dr_resolve$(OEXT) build/obj/dr_sem$(OEXT) build/obj/dr_socket$(OEXT) build/obj/dr_str$(OEXT) build/obj/dr_task$(OEXT) build/obj/$(dr_task_destroy_on_do$(AEXT))dr_task_destroy_on_do$(OEXT) build/obj/$(dr_task_switch$(AEXT))dr_task_switch$(OEXT) build/obj/dr_vfs$(OEXT) build/obj/pool$(OEXT)
+	$(E_CCLD)$(CC) $(FLAGS_L) build/obj/dr_clock$(OEXT) build/obj/dr_event$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_pool$(OEXT) build/obj/dr_resolve$(OEXT) build/obj/dr_sem$(OEXT) build/obj/dr_socket$(OEXT) build/obj/dr_str$(OEXT) build/obj/dr_task$(OEXT) build/obj/$(dr_task_destroy_on_do$(AEXT))dr_task_destroy_on_do$(OEXT) build/obj/$(dr_task_switch$(AEXT))dr_task_switch$(OEXT) build/obj/dr_vfs$(OEXT) build/obj/pool$(OEXT) $(ACCEPT_LDLIBS) $(ACCEPTEX_LDLIBS) $(PTHREAD_LDLIBS) $(LDLIBS) $(OUTPUT_L)$@
+
+build/dist/queue$(EEXT): build/make/dr_config.mk build/obj/dr_clock$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_ring$(OEXT) build/obj/queue$(OEXT)
+	$(E_CCLD)$(CC) $(FLAGS_L) build/obj/dr_clock$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_ring$(OEXT) build/obj/queue$(OEXT) $(ACCEPT_LDLIBS) $(LDLIBS) $(OUTPUT_L)$@
+
+build/dist/resolve$(EEXT): build/make/dr_config.mk build/obj/dr_clock$(OEXT) build/obj/dr_event$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_pool$(OEXT) build/obj/dr_resolve$(OEXT) build/obj/dr_sem$(OEXT) build/obj/dr_socket$(OEXT) build/obj/dr_task$(OEXT) build/obj/$(dr_task_destroy_on_do$(AEXT))dr_task_destroy_on_do$(OEXT) build/obj/$(dr_task_switch$(AEXT))dr_task_switch$(OEXT) build/obj/resolve$(OEXT)
+	$(E_CCLD)$(CC) $(FLAGS_L) build/obj/dr_clock$(OEXT) build/obj/dr_event$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_pool$(OEXT) build/obj/dr_resolve$(OEXT) build/obj/dr_sem$(OEXT) build/obj/dr_socket$(OEXT) build/obj/dr_task$(OEXT) build/obj/$(dr_task_destroy_on_do$(AEXT))dr_task_destroy_on_do$(OEXT) build/obj/$(dr_task_switch$(AEXT))dr_task_switch$(OEXT) build/obj/resolve$(OEXT) $(ACCEPT_LDLIBS) $(ACCEPTEX_LDLIBS) $(PTHREAD_LDLIBS) $(LDLIBS) $(OUTPUT_L)$@
+
+build/dist/sem$(EEXT): build/make/dr_config.mk build/obj/dr_clock$(OEXT) build/obj/dr_event$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_pool$(OEXT) build/obj/dr_resolve$(OEXT) build/obj/dr_sem$(OEXT) build/obj/dr_socket$(OEXT) build/obj/dr_task$(OEXT) build/obj/$(dr_task_destroy_on_do$(AEXT))dr_task_destroy_on_do$(OEXT) build/obj/$(dr_task_switch$(AEXT))dr_task_switch$(OEXT) build/obj/sem$(OEXT)
+	$(E_CCLD)$(CC) $(FLAGS_L) build/obj/dr_clock$(OEXT) build/obj/dr_event$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_pool$(OEXT) build/obj/dr_resolve$(OEXT) build/obj/dr_sem$(OEXT) build/obj/dr_socket$(OEXT) build/obj/dr_task$(OEXT) build/obj/$(dr_task_destroy_on_do$(AEXT))dr_task_destroy_on_do$(OEXT) build/obj/$(dr_task_switch$(AEXT))dr_task_switch$(OEXT) build/obj/sem$(OEXT) $(ACCEPT_LDLIBS) $(ACCEPTEX_LDLIBS) $(PTHREAD_LDLIBS) $(LDLIBS) $(OUTPUT_L)$@
+
+build/dist/server$(EEXT): build/make/dr_config.mk build/obj/getopt$(OEXT) build/obj/dr_chan$(OEXT) build/obj/dr_clock$(OEXT) build/obj/dr_event$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_pool$(OEXT) build/obj/dr_resolve$(OEXT) build/obj/dr_sem$(OEXT) build/obj/dr_socket$(OEXT) build/obj/dr_task$(OEXT) build/obj/$(dr_task_destroy_on_do$(AEXT))dr_task_destroy_on_do$(OEXT) build/obj/$(dr_task_switch$(AEXT))dr_task_switch$(OEXT) build/obj/server$(OEXT)
+	$(E_CCLD)$(CC) $(FLAGS_L) build/obj/getopt$(OEXT) build/obj/dr_chan$(OEXT) build/obj/dr_clock$(OEXT) build/obj/dr_event$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_pool$(OEXT) build/obj/dr_resolve$(OEXT) build/obj/dr_sem$(OEXT) build/obj/dr_socket$(OEXT) build/obj/dr_task$(OEXT) build/obj/$(dr_task_destroy_on_do$(AEXT))dr_task_destroy_on_do$(OEXT) build/obj/$(dr_task_switch$(AEXT))dr_task_switch$(OEXT) build/obj/server$(OEXT) $(ACCEPT_LDLIBS) $(ACCEPTEX_LDLIBS) $(PTHREAD_LDLIBS) $(LDLIBS) $(OUTPUT_L)$@
 
 build/dist/task$(EEXT): build/make/dr_config.mk build/obj/dr_clock$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_task$(OEXT) build/obj/$(dr_task_destroy_on_do$(AEXT))dr_task_destroy_on_do$(OEXT) build/obj/$(dr_task_switch$(AEXT))dr_task_switch$(OEXT) build/obj/task$(OEXT)
 	$(E_CCLD)$(CC) $(FLAGS_L) build/obj/dr_clock$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_task$(OEXT) build/obj/$(dr_task_destroy_on_do$(AEXT))dr_task_destroy_on_do$(OEXT) build/obj/$(dr_task_switch$(AEXT))dr_task_switch$(OEXT) build/obj/task$(OEXT) $(ACCEPT_LDLIBS) $(LDLIBS) $(OUTPUT_L)$@
+
+build/dist/tmpfs$(EEXT): build/make/dr_config.mk build/obj/dr_9p_encode$(OEXT) build/obj/dr_clock$(OEXT) build/obj/dr_event$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_pool$(OEXT) build/obj/dr_resolve$(OEXT) build/obj/dr_sem$(OEXT) build/obj/dr_socket$(OEXT) build/obj/dr_str$(OEXT) build/obj/dr_task$(OEXT) build/obj/$(dr_task_destroy_on_do$(AEXT))dr_task_destroy_on_do$(OEXT) build/obj/$(dr_task_switch$(AEXT))dr_task_switch$(OEXT) build/obj/dr_tmpfs$(OEXT) build/obj/dr_vfs$(OEXT) build/obj/tmpfs$(OEXT)
+	$(E_CCLD)$(CC) $(FLAGS_L) build/obj/dr_9p_encode$(OEXT) build/obj/dr_clock$(OEXT) build/obj/dr_event$(OEXT) build/obj/dr_io$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_pool$(OEXT) build/obj/dr_resolve$(OEXT) build/obj/dr_sem$(OEXT) build/obj/dr_socket$(OEXT) build/obj/dr_str$(OEXT) build/obj/dr_task$(OEXT) build/obj/$(dr_task_destroy_on_do$(AEXT))dr_task_destroy_on_do$(OEXT) build/obj/$(dr_task_switch$(AEXT))dr_task_switch$(OEXT) build/obj/dr_tmpfs$(OEXT) build/obj/dr_vfs$(OEXT) build/obj/tmpfs$(OEXT) $(ACCEPT_LDLIBS) $(ACCEPTEX_LDLIBS) $(PTHREAD_LDLIBS) $(LDLIBS) $(OUTPUT_L)$@
+
+build/dist/trace$(EEXT): build/make/dr_config.mk build/obj/dr_clock$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_trace$(OEXT) build/obj/trace$(OEXT)
+	$(E_CCLD)$(CC) $(FLAGS_L) build/obj/dr_clock$(OEXT) build/obj/dr_log$(OEXT) build/obj/dr_trace$(OEXT) build/obj/trace$(OEXT) $(ACCEPT_LDLIBS) $(LDLIBS) $(OUTPUT_L)$@
@@ -5,22 +5,72 @@ include build/make/dr_config.mk
 include $(PROJROOT)make/quiet.mk
 
 all: deps
-	$(Q)$(MAKE) -f $(PROJROOT)make/build.mk build/dist/9p_client$(EEXT) build/dist/9p_code$(EEXT) build/dist/9p_fuzz$(EEXT) build/dist/9p_server$(EEXT) build/dist/client$(EEXT) build/dist/perms$(EEXT) build/dist/queue$(EEXT) build/dist/server$(EEXT) build/dist/task$(EEXT)
+	$(Q)$(MAKE) -f $(PROJROOT)make/build.mk build/dist/9p_bench$(EEXT) build/dist/9p_client$(EEXT) build/dist/9p_code$(EEXT) build/dist/9p_fuzz$(EEXT) build/dist/9p_server$(EEXT) build/dist/9p_trace$(EEXT) build/dist/cache$(EEXT) build/dist/chan$(EEXT) build/dist/client$(EEXT) build/dist/codec_bench$(EEXT) build/dist/connect$(EEXT) build/dist/containers$(EEXT) build/dist/containers_bench$(EEXT) build/dist/hist$(EEXT) build/dist/perms$(EEXT) build/dist/pipeline$(EEXT) build/dist/pool$(EEXT) build/dist/queue$(EEXT) build/dist/resolve$(EEXT) build/dist/sem$(EEXT) build/dist/server$(EEXT) build/dist/task$(EEXT) build/dist/tmpfs$(EEXT) build/dist/trace$(EEXT)
 
-check: check_9p_code check_perms check_queue check_task check_server_client
+check: check_9p_code check_9p_fuzz check_cache check_chan check_connect check_containers check_hist check_perms check_pipeline check_pool check_queue check_resolve check_sem check_task check_tmpfs check_trace check_server_client check_9p_transfer
 
 check_9p_code: all
 	$(Q)build/dist/9p_code$(EEXT)
 
+check_9p_fuzz: all
+	$(Q)RESULT=0; \
+	for f in $(PROJROOT)test/9p_fuzz_corpus/*; do \
+	    build/dist/9p_fuzz$(EEXT) < $$f || RESULT=1; \
+	done; \
+	if [ $${RESULT} -eq 0 ]; then echo OK; true; else echo FAIL; false; fi
+
+check_cache: all
+	$(Q)build/dist/cache$(EEXT)
+
+check_chan: all
+	$(Q)build/dist/chan$(EEXT)
+
+check_connect: all
+	$(Q)build/dist/connect$(EEXT)
+
+check_containers: all
+	$(Q)build/dist/containers$(EEXT)
+
+check_hist: all
+	$(Q)build/dist/hist$(EEXT)
+
 check_perms: all
 	$(Q)build/dist/perms$(EEXT)
 
+check_pipeline: all
+	$(Q)build/dist/pipeline$(EEXT)
+
+check_pool: all
+	$(Q)build/dist/pool$(EEXT)
+
 check_queue: all
 	$(Q)build/dist/queue$(EEXT)
 
+check_resolve: all
+	$(Q)build/dist/resolve$(EEXT)
+
+check_sem: all
+	$(Q)build/dist/sem$(EEXT)
+
 check_task: all
 	$(Q)if [ $$(build/dist/task$(EEXT))"x" = "aone2two3three4four5five6six7sev10bone2two3three4four5five6six7sev10cSleepingfoodone2two3three4four5five6six7sev10eone2two3three4four5five6six7sev10fone2two3three4four5five6six7sev10gExitingfoohCleanupfooiBackx" ]; then echo OK; true; else echo FAIL; false; fi
 
+check_tmpfs: all
+	$(Q)build/dist/tmpfs$(EEXT)
+
+check_trace: all
+	$(Q)build/dist/trace$(EEXT) > /dev/null && \
+	build/dist/9p_trace$(EEXT) build/trace.bin > build/trace.txt && \
+	printf '%s\n' \
+	    '2.000000002       2000      1 Tread tag 2 fid 2 offset 8192 count 512' \
+	    '3.000000003       3000      1 Tclunk tag 3 fid 3' \
+	    '4.000000004       4000      2 Tread tag 4 fid 4 offset 16384 count 512' \
+	    '5.000000005       5000      2 Tclunk tag 5' | cmp build/trace.txt - && \
+	[ $$(build/dist/9p_trace$(EEXT) -j build/trace.bin | grep -c '"ph":"X"') -eq 4 ]; \
+	RESULT=$$?; \
+	rm -f build/trace.bin build/trace.txt; \
+	if [ $${RESULT} -eq 0 ]; then echo OK; true; else echo FAIL; false; fi
+
 check_server_client: all
 	$(Q)if [ $$(build/dist/server$(EEXT) -p 6000 > /dev/null 2>&1 & \
 	SERVER_PID=$$!; \
@@ -32,6 +82,43 @@ check_server_client: all
 	sleep 2; \
 	kill $${SERVER_PID})"x" = "HelloHelloHelloworldworldworldx" ]; then echo OK; true; else echo FAIL; false; fi
 
+check_9p_transfer: all
+	$(Q)build/dist/9p_server$(EEXT) -p 6007 > /dev/null 2>&1 & \
+	SERVER_PID=$$!; \
+	sleep 1; \
+	head -c 300000 /dev/urandom > build/transfer.in && \
+	build/dist/9p_client$(EEXT) -a localhost -p 6007 -w 8 cp build/transfer.in 9p:scratch/transfer > /dev/null && \
+	build/dist/9p_client$(EEXT) -a localhost -p 6007 -w 8 cp 9p:scratch/transfer build/transfer.out && \
+	cmp build/transfer.in build/transfer.out && \
+	build/dist/9p_client$(EEXT) -a localhost -p 6007 -w 8 cat scratch/transfer | cmp build/transfer.in -; \
+	RESULT=$$?; \
+	kill $${SERVER_PID}; \
+	rm -f build/transfer.in build/transfer.out; \
+	if [ $${RESULT} -eq 0 ]; then echo OK; true; else echo FAIL; false; fi
+
+BENCH_FLAGS = -m walk,open,read,write,stat,clunk -f scratch/bench
+
+bench: bench_codec bench_containers bench_9p
+
+bench_codec: all
+	$(Q)build/dist/codec_bench$(EEXT)
+
+bench_containers: all
+	$(Q)build/dist/containers_bench$(EEXT)
+
+bench_9p: all
+	$(Q)build/dist/9p_server$(EEXT) -p 6002 > /dev/null 2>&1 & \
+	SERVER_PID=$$!; \
+	sleep 1; \
+	build/dist/9p_client$(EEXT) -a localhost -p 6002 create scratch/bench 0666 && \
+	build/dist/9p_bench$(EEXT) -a localhost -p 6002 $(BENCH_FLAGS); \
+	RESULT=$$?; \
+	kill $${SERVER_PID}; \
+	exit $${RESULT}
+
+build/dist/9p_bench$(EEXT): deps
+	$(Q)$(MAKE) -f $(PROJROOT)make/build.mk $@
+
 build/dist/9p_client$(EEXT): deps
 	$(Q)$(MAKE) -f $(PROJROOT)make/build.mk $@
 
@@ -44,21 +131,63 @@ build/dist/9p_fuzz$(EEXT): deps
 build/dist/9p_server$(EEXT): deps
 	$(Q)$(MAKE) -f $(PROJROOT)make/build.mk $@
 
+build/dist/9p_trace$(EEXT): deps
+	$(Q)$(MAKE) -f $(PROJROOT)make/build.mk $@
+
+build/dist/cache$(EEXT): deps
+	$(Q)$(MAKE) -f $(PROJROOT)make/build.mk $@
+
+build/dist/chan$(EEXT): deps
+	$(Q)$(MAKE) -f $(PROJROOT)make/build.mk $@
+
 build/dist/client$(EEXT): deps
 	$(Q)$(MAKE) -f $(PROJROOT)make/build.mk $@
 
+build/dist/codec_bench$(EEXT): deps
+	$(Q)$(MAKE) -f $(PROJROOT)make/build.mk $@
+
+build/dist/connect$(EEXT): deps
+	$(Q)$(MAKE) -f $(PROJROOT)make/build.mk $@
+
+build/dist/containers$(EEXT): deps
+	$(Q)$(MAKE) -f $(PROJROOT)make/build.mk $@
+
+build/dist/containers_bench$(EEXT): deps
+	$(Q)$(MAKE) -f $(PROJROOT)make/build.mk $@
+
+build/dist/hist$(EEXT): deps
+	$(Q)$(MAKE) -f $(PROJROOT)make/build.mk $@
+
 build/dist/perms$(EEXT): deps
 	$(Q)$(MAKE) -f $(PROJROOT)make/build.mk $@
 
+build/dist/pipeline$(EEXT): deps
+	$(Q)$(MAKE) -f $(PROJROOT)make/build.mk $@
+
+build/dist/pool$(EEXT): deps
+	$(Q)$(MAKE) -f $(PROJROOT)make/build.mk $@
+
 build/dist/queue$(EEXT): deps
 	$(Q)$(MAKE) -f $(PROJROOT)make/build.mk $@
 
+build/dist/resolve$(EEXT): deps
+	$(Q)$(MAKE) -f $(PROJROOT)make/build.mk $@
+
+build/dist/sem$(EEXT): deps
+	$(Q)$(MAKE) -f $(PROJROOT)make/build.mk $@
+
 build/dist/server$(EEXT): deps
 	$(Q)$(MAKE) -f $(PROJROOT)make/build.mk $@
 
 build/dist/task$(EEXT): deps
 	$(Q)$(MAKE) -f $(PROJROOT)make/build.mk $@
 
+build/dist/tmpfs$(EEXT): deps
+	$(Q)$(MAKE) -f $(PROJROOT)make/build.mk $@
+
+build/dist/trace$(EEXT): deps
+	$(Q)$(MAKE) -f $(PROJROOT)make/build.mk $@
+
 force:
 
 include build/make/flags.mk
@@ -113,6 +242,22 @@ else \
     fi \
 fi > $@
 
+build/make/PTHREAD_LDLIBS.mk: build/make/dr_config.mk $(PROJROOT)config/libs/pthread.c
+	$(E_GEN) \
+if ! (cd build/make_obj && \
+        $(CC) $(CSTD) $(CPPFLAGS) $(CFLAGS) $(LDFLAGS) ../../$(PROJROOT)config/libs/pthread.c $(OUTPUT_L)PTHREAD_LDLIBS$(EEXT) || \
+        echo error) 2>&1 | egrep -i 'error|warn' > /dev/null; then \
+    echo PTHREAD_LDLIBS=; \
+else \
+    if ! (cd build/make_obj && \
+            $(CC) $(CSTD) $(CPPFLAGS) $(CFLAGS) $(LDFLAGS) ../../$(PROJROOT)config/libs/pthread.c $(LDLIB_PREFIX)pthread$(LEXT) $(OUTPUT_L)PTHREAD_LDLIBS$(EEXT) || \
+            echo error) 2>&1 | egrep -i 'error|warn' > /dev/null; then \
+        echo PTHREAD_LDLIBS=$(LDLIB_PREFIX)pthread$(LEXT); \
+    else \
+        false; \
+    fi \
+fi > $@
+
 build/make/deps.mk: force
 	$(E_GEN)find build/obj -type f -name '*.d' | xargs cat > $@
 
@@ -126,7 +271,7 @@ build/include/dr_types.h: build/include/dr_config.h $(PROJROOT)config/dr_types.c
 
 #	@echo MAKECMDGOALS = $(MAKECMDGOALS)
 #	@echo .TARGETS = $(.TARGETS)
-deps: build/make/target.mk build/make/overrides.mk build/make/cppflags.mk build/make/cflags.mk build/make/ACCEPT_LDLIBS.mk build/make/ACCEPTEX_LDLIBS.mk build/make/deps.mk build/include/dr_config.h build/include/dr_types.h
+deps: build/make/target.mk build/make/overrides.mk build/make/cppflags.mk build/make/cflags.mk build/make/ACCEPT_LDLIBS.mk build/make/ACCEPTEX_LDLIBS.mk build/make/PTHREAD_LDLIBS.mk build/make/deps.mk build/include/dr_config.h build/include/dr_types.h
 	$(Q)$(SHELL) $(PROJROOT)make/mkdirs.sh
 
 clean:
@@ -141,7 +286,9 @@ install: all
 	cp build/dist/9p_client$(EEXT) $${DESTDIR}/bin && \
 	chmod 755 $${DESTDIR}/bin/9p_client$(EEXT) && \
 	cp build/dist/9p_server$(EEXT) $${DESTDIR}/bin && \
-	chmod 755 $${DESTDIR}/bin/9p_server$(EEXT)
+	chmod 755 $${DESTDIR}/bin/9p_server$(EEXT) && \
+	cp build/dist/9p_trace$(EEXT) $${DESTDIR}/bin && \
+	chmod 755 $${DESTDIR}/bin/9p_trace$(EEXT)
 
 dist: minimal.tar.gz
 
@@ -0,0 +1,617 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// Copyright (c) 2018 Drew Richardson <drewrichardson@gmail.com>
+
+#include "dr.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Every connection runs tags worker tasks that share one dr_9p_client, so up
+ * to tags requests are in flight per connection. Each worker replays the mix
+ * on its own fid until the time is up and records the latency of every
+ * request in a histogram per message type.
+ */
+
+#define DR_9P_BUF_SIZE (1<<13)
+#define STACK_SIZE (1<<16)
+#define MIX_MAX 64
+#define WALK_MAX 16
+
+enum bench_op {
+  BENCH_WALK,
+  BENCH_OPEN,
+  BENCH_READ,
+  BENCH_WRITE,
+  BENCH_STAT,
+  BENCH_CLUNK,
+  BENCH_OP_COUNT,
+};
+
+static const char *const bench_op_names[BENCH_OP_COUNT] = {
+  "walk",
+  "open",
+  "read",
+  "write",
+  "stat",
+  "clunk",
+};
+
+struct bench_conn;
+
+struct bench_worker {
+  struct bench_conn *restrict conn;
+  struct dr_task task;
+  uint32_t fid;
+  uint8_t *restrict buf;
+  struct dr_hist hist[BENCH_OP_COUNT];
+  bool failed;
+};
+
+struct bench_conn {
+  struct dr_9p_client client; // first, key==conn
+  struct dr_task client_task;
+  struct dr_task task;
+  uint32_t msize;
+  struct bench_worker *restrict workers;
+  unsigned int running;
+  bool done;
+  bool failed;
+};
+
+static enum bench_op mix[MIX_MAX];
+static unsigned int mix_len;
+static struct dr_str walk_names[WALK_MAX];
+static uint16_t walk_len;
+static uint8_t open_mode = DR_OREAD;
+static uint32_t io_size = 1024;
+static unsigned int tags = 16;
+static int64_t deadline;
+static char none[] = "none";
+
+// Splits a comma separated list of operations and checks that every fid is walked before use and clunked by the end
+WARN_UNUSED_RESULT static bool parse_mix(char *restrict const arg) {
+  enum { FID_NONE, FID_WALKED, FID_OPEN } state = FID_NONE;
+  mix_len = 0;
+  for (char *restrict name = strtok(arg, ","); name != NULL; name = strtok(NULL, ",")) {
+    enum bench_op op;
+    for (op = 0; op < BENCH_OP_COUNT; ++op) {
+      if (strcmp(name, bench_op_names[op]) == 0) {
+	break;
+      }
+    }
+    if (op == BENCH_OP_COUNT || mix_len == MIX_MAX) {
+      return false;
+    }
+    switch (op) {
+    case BENCH_WALK:
+      if (state != FID_NONE) {
+	return false;
+      }
+      state = FID_WALKED;
+      break;
+    case BENCH_OPEN:
+      if (state != FID_WALKED) {
+	return false;
+      }
+      state = FID_OPEN;
+      break;
+    case BENCH_WRITE:
+      open_mode = DR_ORDWR;
+      // Fall through
+    case BENCH_READ:
+      if (state != FID_OPEN) {
+	return false;
+      }
+      break;
+    case BENCH_STAT:
+      if (state == FID_NONE) {
+	return false;
+      }
+      break;
+    case BENCH_CLUNK:
+      if (state == FID_NONE) {
+	return false;
+      }
+      state = FID_NONE;
+      break;
+    default:
+      return false;
+    }
+    mix[mix_len++] = op;
+  }
+  return mix_len > 0 && state == FID_NONE;
+}
+
+WARN_UNUSED_RESULT static bool parse_file(char *restrict const arg) {
+  walk_len = 0;
+  for (char *restrict name = strtok(arg, "/"); name != NULL; name = strtok(NULL, "/")) {
+    if (walk_len == WALK_MAX) {
+      return false;
+    }
+    walk_names[walk_len++] = (struct dr_str) {
+      .len = strlen(name),
+      .buf = name,
+    };
+  }
+  return true;
+}
+
+WARN_UNUSED_RESULT static bool bench_call(struct bench_conn *restrict const conn, uint8_t *restrict const buf, const uint32_t tsize, uint32_t *restrict const rsize, uint32_t *restrict const rpos, const uint8_t expected_type) {
+  {
+    const struct dr_result_uint32 r = dr_9p_client_call(&conn->client, buf, tsize, conn->msize);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_9p_client_call failed", err);
+      return false;
+    } DR_ELIF_RESULT_OK(uint32_t, r, value) {
+      *rsize = value;
+    } DR_FI_RESULT;
+  }
+  uint8_t type;
+  uint16_t tag;
+  if (dr_unlikely(!dr_9p_decode_header(&type, &tag, buf, *rsize, rpos))) {
+    dr_log("dr_9p_decode_header failed");
+    return false;
+  }
+  if (dr_unlikely(type != expected_type)) {
+    struct dr_str ename;
+    if (type == DR_RERROR && dr_9p_decode_Rerror(&ename, buf, *rsize, rpos)) {
+      printf("Rerror '%.*s'\n", ename.len, ename.buf);
+    } else {
+      dr_log("Unexpected type");
+    }
+    return false;
+  }
+  return true;
+}
+
+WARN_UNUSED_RESULT static bool bench_op(struct bench_worker *restrict const w, const enum bench_op op) {
+  struct bench_conn *restrict const conn = w->conn;
+  uint8_t *restrict const buf = w->buf;
+  uint32_t tpos;
+  uint32_t rsize;
+  uint32_t rpos;
+  switch (op) {
+  case BENCH_WALK: {
+    uint16_t nwname;
+    if (dr_unlikely(!dr_9p_encode_Twalk_iterator(buf, conn->msize, &tpos, 0, 0, w->fid, &nwname))) {
+      dr_log("dr_9p_encode_Twalk_iterator failed");
+      return false;
+    }
+    for (uint16_t i = 0; i < walk_len; ++i) {
+      if (dr_unlikely(!dr_9p_encode_Twalk_add(buf, conn->msize, &tpos, &nwname, &walk_names[i]))) {
+	dr_log("dr_9p_encode_Twalk_add failed");
+	return false;
+      }
+    }
+    if (dr_unlikely(!dr_9p_encode_Twalk_finish(buf, conn->msize, &tpos, nwname))) {
+      dr_log("dr_9p_encode_Twalk_finish failed");
+      return false;
+    }
+    if (dr_unlikely(!bench_call(conn, buf, tpos, &rsize, &rpos, DR_RWALK))) {
+      return false;
+    }
+    uint16_t nwqid;
+    if (dr_unlikely(!dr_9p_decode_Rwalk_iterator(&nwqid, buf, rsize, &rpos) || nwqid != nwname)) {
+      dr_log("file not found");
+      return false;
+    }
+    return true;
+  }
+  case BENCH_OPEN:
+    if (dr_unlikely(!dr_9p_encode_Topen(buf, conn->msize, &tpos, 0, w->fid, open_mode))) {
+      dr_log("dr_9p_encode_Topen failed");
+      return false;
+    }
+    return bench_call(conn, buf, tpos, &rsize, &rpos, DR_ROPEN);
+  case BENCH_READ: {
+    if (dr_unlikely(!dr_9p_encode_Tread(buf, conn->msize, &tpos, 0, w->fid, 0, io_size))) {
+      dr_log("dr_9p_encode_Tread failed");
+      return false;
+    }
+    if (dr_unlikely(!bench_call(conn, buf, tpos, &rsize, &rpos, DR_RREAD))) {
+      return false;
+    }
+    uint32_t count;
+    const void *restrict data;
+    if (dr_unlikely(!dr_9p_decode_Rread(&count, &data, buf, rsize, &rpos))) {
+      dr_log("dr_9p_decode_Rread failed");
+      return false;
+    }
+    return true;
+  }
+  case BENCH_WRITE:
+    if (dr_unlikely(!dr_9p_encode_Twrite_iterator(buf, conn->msize, &tpos, 0, w->fid, 0))) {
+      dr_log("dr_9p_encode_Twrite_iterator failed");
+      return false;
+    }
+    memset(buf + tpos, 'x', io_size);
+    if (dr_unlikely(!dr_9p_encode_Twrite_finish(buf, conn->msize, &tpos, io_size))) {
+      dr_log("dr_9p_encode_Twrite_finish failed");
+      return false;
+    }
+    return bench_call(conn, buf, tpos, &rsize, &rpos, DR_RWRITE);
+  case BENCH_STAT:
+    if (dr_unlikely(!dr_9p_encode_Tstat(buf, conn->msize, &tpos, 0, w->fid))) {
+      dr_log("dr_9p_encode_Tstat failed");
+      return false;
+    }
+    return bench_call(conn, buf, tpos, &rsize, &rpos, DR_RSTAT);
+  case BENCH_CLUNK:
+    if (dr_unlikely(!dr_9p_encode_Tclunk(buf, conn->msize, &tpos, 0, w->fid))) {
+      dr_log("dr_9p_encode_Tclunk failed");
+      return false;
+    }
+    return bench_call(conn, buf, tpos, &rsize, &rpos, DR_RCLUNK);
+  default:
+    return false;
+  }
+}
+
+static void worker_func(void *restrict const arg) {
+  struct bench_worker *restrict const w = (struct bench_worker *)arg;
+  while (dr_now_ns() < deadline) {
+    for (unsigned int i = 0; i < mix_len; ++i) {
+      const uint64_t start = dr_ticks();
+      if (dr_unlikely(!bench_op(w, mix[i]))) {
+	// The state of the fid is unknown so stop
+	w->failed = true;
+	goto done;
+      }
+      const int64_t latency = dr_ticks_ns(dr_ticks()) - dr_ticks_ns(start);
+      dr_hist_record(&w->hist[mix[i]], latency > 0 ? latency : 0);
+    }
+  }
+ done:
+  if (--w->conn->running == 0) {
+    dr_task_runnable(&w->conn->task);
+  }
+}
+
+WARN_UNUSED_RESULT static bool conn_setup(struct bench_conn *restrict const conn, uint8_t *restrict const buf, char *restrict const uname_buf) {
+  uint32_t tpos;
+  uint32_t rsize;
+  uint32_t rpos;
+  char version_9p2000[] = {'9','P','2','0','0','0'};
+  struct dr_str version = {
+    .len = sizeof(version_9p2000),
+    .buf = version_9p2000,
+  };
+  conn->msize = DR_9P_BUF_SIZE;
+  if (dr_unlikely(!dr_9p_encode_Tversion(buf, conn->msize, &tpos, DR_NOTAG, conn->msize, &version))) {
+    dr_log("dr_9p_encode_Tversion failed");
+    return false;
+  }
+  if (dr_unlikely(!bench_call(conn, buf, tpos, &rsize, &rpos, DR_RVERSION))) {
+    return false;
+  }
+  uint32_t msize;
+  if (dr_unlikely(!dr_9p_decode_Rversion(&msize, &version, buf, rsize, &rpos) || msize > conn->msize || msize < 24)) {
+    dr_log("Invalid Rversion");
+    return false;
+  }
+  if (dr_unlikely(io_size > msize - 24)) {
+    dr_log("Too many bytes for msize");
+    return false;
+  }
+  conn->msize = msize;
+  const struct dr_str uname = {
+    .len = strlen(uname_buf),
+    .buf = uname_buf,
+  };
+  const struct dr_str aname = {
+    .len = 0,
+  };
+  if (dr_unlikely(!dr_9p_encode_Tattach(buf, conn->msize, &tpos, 0, 0, DR_NOFID, &uname, &aname))) {
+    dr_log("dr_9p_encode_Tattach failed");
+    return false;
+  }
+  return bench_call(conn, buf, tpos, &rsize, &rpos, DR_RATTACH);
+}
+
+static void conn_func(void *restrict const arg) {
+  struct bench_conn *restrict const conn = (struct bench_conn *)arg;
+  uint8_t buf[DR_9P_BUF_SIZE];
+  if (dr_unlikely(!conn_setup(conn, buf, none))) {
+    conn->failed = true;
+    goto done;
+  }
+  for (unsigned int i = 0; i < tags; ++i) {
+    struct bench_worker *restrict const w = &conn->workers[i];
+    w->conn = conn;
+    w->fid = 1 + i;
+    w->buf = (uint8_t *)malloc(conn->msize);
+    if (dr_unlikely(w->buf == NULL)) {
+      dr_log("malloc failed");
+      conn->failed = true;
+      break;
+    }
+    for (unsigned int j = 0; j < BENCH_OP_COUNT; ++j) {
+      dr_hist_init(&w->hist[j]);
+    }
+    const struct dr_result_void r = dr_task_create(&w->task, STACK_SIZE, worker_func, w);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_task_create failed", err);
+      free(w->buf);
+      w->buf = NULL;
+      conn->failed = true;
+      break;
+    } DR_FI_RESULT;
+    ++conn->running;
+  }
+  while (conn->running > 0) {
+    dr_schedule(true);
+  }
+  for (unsigned int i = 0; i < tags; ++i) {
+    struct bench_worker *restrict const w = &conn->workers[i];
+    if (w->buf != NULL) {
+      dr_task_destroy(&w->task);
+      free(w->buf);
+      conn->failed = conn->failed || w->failed;
+    }
+  }
+ done:
+  conn->done = true;
+}
+
+static void print_report(const struct bench_conn *restrict const conns, const unsigned int conn_count, const int64_t elapsed) {
+  static struct dr_hist hist[BENCH_OP_COUNT];
+  static struct dr_hist total;
+  dr_hist_init(&total);
+  for (unsigned int op = 0; op < BENCH_OP_COUNT; ++op) {
+    dr_hist_init(&hist[op]);
+    for (unsigned int i = 0; i < conn_count; ++i) {
+      for (unsigned int j = 0; j < tags; ++j) {
+	dr_hist_merge(&hist[op], &conns[i].workers[j].hist[op]);
+      }
+    }
+    dr_hist_merge(&total, &hist[op]);
+  }
+  const double seconds = (double)elapsed/DR_NS_PER_S;
+  printf("%u connections, %u tags, %" PRIu64 " requests in %.2fs, %.0f requests/s\n", conn_count, tags, total.count, seconds, total.count/seconds);
+  printf("%-6s %12s %12s %12s %12s %12s (ns)\n", "", "count", "p50", "p99", "p999", "max");
+  for (unsigned int op = 0; op <= BENCH_OP_COUNT; ++op) {
+    const struct dr_hist *restrict const h = op < BENCH_OP_COUNT ? &hist[op] : &total;
+    if (h->count == 0) {
+      continue;
+    }
+    printf("%-6s %12" PRIu64 " %12" PRIu64 " %12" PRIu64 " %12" PRIu64 " %12" PRIu64 "\n", op < BENCH_OP_COUNT ? bench_op_names[op] : "total", h->count, dr_hist_percentile(h, 500), dr_hist_percentile(h, 990), dr_hist_percentile(h, 999), h->max);
+  }
+}
+
+WARN_UNUSED_RESULT static int print_version(void) {
+  printf("9p_bench %u.%u.%u\n", DR_VERSION_MAJOR, DR_VERSION_MINOR, DR_VERSION_PATCH);
+  return 0;
+}
+
+WARN_UNUSED_RESULT static int print_usage(void) {
+  printf("Usage: 9p_bench [OPTIONS]...\n"
+	 "\n"
+	 "Options:\n"
+	 "  -a, --address      TCP/IP address name to connect to\n"
+	 "  -p, --port         TCP/IP port name to connect to\n"
+	 "  -c, --connections  Connections to open (default 4)\n"
+	 "  -t, --tags         Requests in flight per connection (default 16)\n"
+	 "  -m, --mix          Comma separated walk, open, read, write, stat and clunk\n"
+	 "                     requests to replay (default walk,open,read,clunk)\n"
+	 "  -f, --file         File to walk to (default hello/world)\n"
+	 "  -b, --bytes        Bytes per read or write (default 1024)\n"
+	 "  -s, --seconds      Time to run for (default 5)\n"
+	 "  -v, --version      Print version information\n"
+	 "  -h, --help         Print this help\n");
+  return -1;
+}
+
+int main(int argc, char *argv[]) {
+  const char *restrict address = 0;
+  const char *restrict port = 0;
+  unsigned long conn_count = 4;
+  unsigned long seconds = 5;
+  char default_mix[] = "walk,open,read,clunk";
+  char default_file[] = "hello/world";
+  char *restrict mix_arg = default_mix;
+  char *restrict file_arg = default_file;
+  {
+    static struct dr_option longopts[] = {
+      {"address", 1, 0, 'a'},
+      {"port", 1, 0, 'p'},
+      {"connections", 1, 0, 'c'},
+      {"tags", 1, 0, 't'},
+      {"mix", 1, 0, 'm'},
+      {"file", 1, 0, 'f'},
+      {"bytes", 1, 0, 'b'},
+      {"seconds", 1, 0, 's'},
+      {"version", 0, 0, 'v'},
+      {"help", 0, 0, 'h'},
+      {0, 0, 0, 0},
+    };
+    dr_optind = 0;
+    while (true) {
+      int opt = dr_getopt_long(argc, argv, "+a:p:c:t:m:f:b:s:vh", longopts, NULL);
+      if (opt == -1) {
+	break;
+      }
+      switch (opt) {
+      case 'a':
+	address = dr_optarg;
+	break;
+      case 'p':
+	port = dr_optarg;
+	break;
+      case 'c': {
+	char *end;
+	conn_count = strtoul(dr_optarg, &end, 10);
+	if (*dr_optarg == '\0' || *end != '\0' || conn_count == 0 || conn_count > 256) {
+	  return print_usage();
+	}
+	break;
+      }
+      case 't': {
+	char *end;
+	tags = strtoul(dr_optarg, &end, 10);
+	if (*dr_optarg == '\0' || *end != '\0' || tags == 0 || tags > 256) {
+	  return print_usage();
+	}
+	break;
+      }
+      case 'm':
+	mix_arg = dr_optarg;
+	break;
+      case 'f':
+	file_arg = dr_optarg;
+	break;
+      case 'b': {
+	char *end;
+	io_size = strtoul(dr_optarg, &end, 10);
+	if (*dr_optarg == '\0' || *end != '\0' || io_size > DR_9P_BUF_SIZE - 24) {
+	  return print_usage();
+	}
+	break;
+      }
+      case 's': {
+	char *end;
+	seconds = strtoul(dr_optarg, &end, 10);
+	if (*dr_optarg == '\0' || *end != '\0' || seconds == 0) {
+	  return print_usage();
+	}
+	break;
+      }
+      case 'v':
+	return print_version();
+      default:
+      case 'h':
+	return print_usage();
+      }
+    }
+  }
+  if (address == NULL || port == NULL || argc != dr_optind || !parse_mix(mix_arg) || !parse_file(file_arg)) {
+    return print_usage();
+  }
+  // Before the first request is timed
+  dr_ticks_calibrate();
+  {
+    const struct dr_result_void r = dr_socket_startup();
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_socket_startup failed", err);
+      return -1;
+    } DR_FI_RESULT;
+  }
+  int result = -1;
+  static struct dr_equeue equeue;
+  {
+    const struct dr_result_void r = dr_equeue_init(&equeue);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_equeue_init failed", err);
+      return -1;
+    } DR_FI_RESULT;
+  }
+  static struct bench_conn *restrict conns;
+  conns = (struct bench_conn *)calloc(conn_count, sizeof(*conns));
+  if (dr_unlikely(conns == NULL)) {
+    dr_log("calloc failed");
+    goto fail_equeue_destroy;
+  }
+  // Connections that were set up are torn down from the last one
+  static unsigned int count;
+  for (count = 0; count < conn_count; ++count) {
+    struct bench_conn *restrict const conn = &conns[count];
+    conn->workers = (struct bench_worker *)calloc(tags, sizeof(*conn->workers));
+    if (dr_unlikely(conn->workers == NULL)) {
+      dr_log("calloc failed");
+      goto fail_conns_destroy;
+    }
+    dr_handle_t fd;
+    {
+      const struct dr_result_handle r = dr_sock_connect(address, port, DR_CLOEXEC);
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_sock_connect failed", err);
+	goto fail_free_workers;
+      } DR_ELIF_RESULT_OK(dr_handle_t, r, value) {
+	fd = value;
+      } DR_FI_RESULT;
+    }
+    {
+      const struct dr_result_void r = dr_set_nonblock(fd);
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_set_nonblock failed", err);
+	dr_close(fd);
+	goto fail_free_workers;
+      } DR_FI_RESULT;
+    }
+    {
+      const struct dr_result_void r = dr_9p_client_init(&conn->client, &equeue, fd, DR_9P_BUF_SIZE);
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_9p_client_init failed", err);
+	dr_close(fd);
+	goto fail_free_workers;
+      } DR_FI_RESULT;
+    }
+    {
+      const struct dr_result_void r = dr_task_create(&conn->client_task, STACK_SIZE, dr_9p_client_task, &conn->client);
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_task_create failed", err);
+	dr_9p_client_destroy(&conn->client);
+	goto fail_free_workers;
+      } DR_FI_RESULT;
+    }
+  }
+  static int64_t start;
+  start = dr_monotonic_ns();
+  deadline = start + seconds*DR_NS_PER_S;
+  static unsigned int started;
+  for (started = 0; started < count; ++started) {
+    const struct dr_result_void r = dr_task_create(&conns[started].task, STACK_SIZE, conn_func, &conns[started]);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_task_create failed", err);
+      // Let the connections already running finish on their own
+      deadline = 0;
+      break;
+    } DR_FI_RESULT;
+  }
+  dr_schedule(true);
+  for (unsigned int done = 0; done < started;) {
+    struct dr_event events[64];
+    unsigned int event_count;
+    {
+      const struct dr_result_uint r = dr_equeue_dequeue(&equeue, events, sizeof(events));
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_equeue_dequeue failed", err);
+	goto fail_conns_destroy;
+      } DR_ELIF_RESULT_OK(unsigned int, r, value) {
+	event_count = value;
+      } DR_FI_RESULT;
+    }
+    for (unsigned int i = 0; i < event_count; ++i) {
+      dr_9p_client_ready((struct dr_9p_client *)dr_event_key(events, i), events, i);
+    }
+    dr_schedule(true);
+    done = 0;
+    for (unsigned int i = 0; i < started; ++i) {
+      done += conns[i].done;
+    }
+  }
+  print_report(conns, started, dr_monotonic_ns() - start);
+  result = started == count ? 0 : -1;
+  for (unsigned int i = 0; i < started; ++i) {
+    dr_task_destroy(&conns[i].task);
+    if (conns[i].failed) {
+      result = -1;
+    }
+  }
+  goto fail_conns_destroy;
+ fail_free_workers:
+  free(conns[count].workers);
+ fail_conns_destroy:
+  while (count-- > 0) {
+    dr_task_destroy(&conns[count].client_task);
+    // The client closes fd
+    dr_9p_client_destroy(&conns[count].client);
+    free(conns[count].workers);
+  }
+  free(conns);
+ fail_equeue_destroy:
+  dr_equeue_destroy(&equeue);
+  return result;
+}
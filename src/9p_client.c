@@ -10,64 +10,37 @@
 #include <time.h>
 
 #define DR_9P_BUF_SIZE (1<<13)
+#define STACK_SIZE (1<<17)
 
 static bool debug;
+static unsigned int window = 8;
+static int64_t cache_ttl = DR_NS_PER_S;
 
-WARN_UNUSED_RESULT static bool dr_9p_call(dr_handle_t fd, const uint8_t *restrict const tbuf, const uint32_t tsize, uint8_t *restrict const rbuf, const uint32_t rmax_size, uint32_t *restrict const rsize, uint32_t *restrict const rpos, const uint8_t expected_type) {
-  size_t bytes;
+WARN_UNUSED_RESULT static bool dr_9p_call(struct dr_9p_client *restrict const client, uint8_t *restrict const buf, const uint32_t tsize, const uint32_t max_size, uint32_t *restrict const rsize, uint32_t *restrict const rpos, const uint8_t expected_type) {
   {
-    const struct dr_result_size r = dr_write(fd, tbuf, tsize);
+    const struct dr_result_uint32 r = dr_9p_client_call(client, buf, tsize, max_size);
     DR_IF_RESULT_ERR(r, err) {
-      dr_log_error("dr_write failed", err);
+      dr_log_error("dr_9p_client_call failed", err);
       return false;
-    } DR_ELIF_RESULT_OK(size_t, r, value) {
-      bytes = value;
+    } DR_ELIF_RESULT_OK(uint32_t, r, value) {
+      *rsize = value;
     } DR_FI_RESULT;
   }
-  if (dr_unlikely(bytes != tsize)) {
-    dr_log("Short write");
-    return false;
-  }
-  {
-    const struct dr_result_size r = dr_read(fd, rbuf, rmax_size);
-    DR_IF_RESULT_ERR(r, err) {
-      dr_log_error("dr_read failed", err);
-      return false;
-    } DR_ELIF_RESULT_OK(size_t, r, value) {
-      bytes = value;
-    } DR_FI_RESULT;
-  }
-  if (dr_unlikely(bytes == 0)) {
-    dr_log("closing client");
-    return false;
-  }
-  if (dr_unlikely(bytes < sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint16_t))) {
-    dr_log("Short read");
-    return false;
-  }
-  *rsize = dr_decode_uint32(rbuf);
-  if (dr_unlikely(bytes != *rsize)) {
-    dr_log("Short read");
-    return false;
-  }
   uint8_t type;
   uint16_t tag;
-  if (dr_unlikely(!dr_9p_decode_header(&type, &tag, rbuf, *rsize, rpos))) {
+  if (dr_unlikely(!dr_9p_decode_header(&type, &tag, buf, *rsize, rpos))) {
     dr_log("dr_9p_decode_header failed");
     return false;
   }
-  if (dr_unlikely(tag != 0)) {
-    dr_log("Mismatched tag");
-    return false;
-  }
   if (dr_unlikely(type != expected_type)) {
     if (dr_unlikely(type != DR_RERROR)) {
       dr_log("Unexpected type");
     } else {
       struct dr_str ename;
-      if (dr_unlikely(!dr_9p_decode_Rerror(&ename, rbuf, *rsize, rpos))) {
+      if (dr_unlikely(!dr_9p_decode_Rerror(&ename, buf, *rsize, rpos))) {
 	dr_log("dr_9p_decode_Rerror failed");
       } else {
+	dr_log_flush();
 	printf("Rerror '%.*s'\n", ename.len, ename.buf);
       }
     }
@@ -76,8 +49,7 @@ WARN_UNUSED_RESULT static bool dr_9p_call(dr_handle_t fd, const uint8_t *restric
   return true;
 }
 
-WARN_UNUSED_RESULT static bool dr_9p_version(dr_handle_t fd, uint8_t *restrict const rbuf, const uint32_t rmax_size, uint32_t *restrict const msize) {
-  uint8_t tbuf[DR_9P_BUF_SIZE];
+WARN_UNUSED_RESULT static bool dr_9p_version(struct dr_9p_client *restrict const client, uint8_t *restrict const rbuf, const uint32_t rmax_size, uint32_t *restrict const msize) {
   uint32_t tpos;
   uint32_t rsize;
   uint32_t rpos;
@@ -87,12 +59,12 @@ WARN_UNUSED_RESULT static bool dr_9p_version(dr_handle_t fd, uint8_t *restrict c
       .len = sizeof(version_9p2000),
       .buf = version_9p2000,
     };
-    if (dr_unlikely(!dr_9p_encode_Tversion(tbuf, sizeof(tbuf), &tpos, 0, sizeof(tbuf), &version))) {
+    if (dr_unlikely(!dr_9p_encode_Tversion(rbuf, rmax_size, &tpos, DR_NOTAG, rmax_size, &version))) {
       dr_log("dr_9p_encode_Tversion failed");
       return false;
     }
   }
-  if (dr_unlikely(!dr_9p_call(fd, tbuf, tpos, rbuf, rmax_size, &rsize, &rpos, DR_RVERSION))) {
+  if (dr_unlikely(!dr_9p_call(client, rbuf, tpos, rmax_size, &rsize, &rpos, DR_RVERSION))) {
     return false;
   }
   {
@@ -104,7 +76,7 @@ WARN_UNUSED_RESULT static bool dr_9p_version(dr_handle_t fd, uint8_t *restrict c
     if (debug) {
       printf("Rversion %" PRIu32 " '%.*s'\n", *msize, version.len, version.buf);
     }
-    if (*msize > sizeof(tbuf)) {
+    if (*msize > rmax_size) {
       dr_log("Invalid msize");
       return false;
     }
@@ -116,16 +88,15 @@ WARN_UNUSED_RESULT static bool dr_9p_version(dr_handle_t fd, uint8_t *restrict c
   return true;
 }
 
-WARN_UNUSED_RESULT static bool dr_9p_attach(dr_handle_t fd, uint8_t *restrict const rbuf, const uint32_t rmax_size, const uint32_t fid, const struct dr_str *restrict const uname, const struct dr_str *restrict const aname, struct dr_9p_qid *restrict const qid) {
-  uint8_t tbuf[DR_9P_BUF_SIZE];
+WARN_UNUSED_RESULT static bool dr_9p_attach(struct dr_9p_client *restrict const client, uint8_t *restrict const rbuf, const uint32_t rmax_size, const uint32_t fid, const struct dr_str *restrict const uname, const struct dr_str *restrict const aname, struct dr_9p_qid *restrict const qid) {
   uint32_t tpos;
   uint32_t rsize;
   uint32_t rpos;
-  if (dr_unlikely(!dr_9p_encode_Tattach(tbuf, rmax_size, &tpos, 0, fid, DR_NOFID, uname, aname))) {
+  if (dr_unlikely(!dr_9p_encode_Tattach(rbuf, rmax_size, &tpos, 0, fid, DR_NOFID, uname, aname))) {
     dr_log("dr_9p_encode_Tattach failed");
     return false;
   }
-  if (dr_unlikely(!dr_9p_call(fd, tbuf, tpos, rbuf, rmax_size, &rsize, &rpos, DR_RATTACH))) {
+  if (dr_unlikely(!dr_9p_call(client, rbuf, tpos, rmax_size, &rsize, &rpos, DR_RATTACH))) {
     return false;
   }
   if (dr_unlikely(!dr_9p_decode_Rattach(qid, rbuf, rsize, &rpos))) {
@@ -138,13 +109,12 @@ WARN_UNUSED_RESULT static bool dr_9p_attach(dr_handle_t fd, uint8_t *restrict co
   return true;
 }
 
-WARN_UNUSED_RESULT static bool dr_9p_walk(dr_handle_t fd, uint8_t *restrict const rbuf, const uint32_t rmax_size, const uint32_t fid, const uint32_t newfid, char *restrict const name) {
-  uint8_t tbuf[DR_9P_BUF_SIZE];
+WARN_UNUSED_RESULT static bool dr_9p_walk(struct dr_9p_client *restrict const client, uint8_t *restrict const rbuf, const uint32_t rmax_size, const uint32_t fid, const uint32_t newfid, char *restrict const name) {
   uint32_t tpos;
   uint32_t rsize;
   uint32_t rpos;
   uint16_t nwname;
-  if (dr_unlikely(!dr_9p_encode_Twalk_iterator(tbuf, rmax_size, &tpos, 0, fid, newfid, &nwname))) {
+  if (dr_unlikely(!dr_9p_encode_Twalk_iterator(rbuf, rmax_size, &tpos, 0, fid, newfid, &nwname))) {
     dr_log("dr_9p_encode_Twalk_iterator failed");
     return false;
   }
@@ -166,7 +136,7 @@ WARN_UNUSED_RESULT static bool dr_9p_walk(dr_handle_t fd, uint8_t *restrict cons
 	.len = end - pos,
 	.buf = pos,
       };
-      if (dr_unlikely(!dr_9p_encode_Twalk_add(tbuf, rmax_size, &tpos, &nwname, &n))) {
+      if (dr_unlikely(!dr_9p_encode_Twalk_add(rbuf, rmax_size, &tpos, &nwname, &n))) {
 	dr_log("dr_9p_encode_Twalk_add failed");
 	return false;
       }
@@ -175,11 +145,11 @@ WARN_UNUSED_RESULT static bool dr_9p_walk(dr_handle_t fd, uint8_t *restrict cons
       }
     }
   }
-  if (dr_unlikely(!dr_9p_encode_Twalk_finish(tbuf, rmax_size, &tpos, nwname))) {
+  if (dr_unlikely(!dr_9p_encode_Twalk_finish(rbuf, rmax_size, &tpos, nwname))) {
     dr_log("dr_9p_encode_Twalk_finish failed");
     return false;
   }
-  if (dr_unlikely(!dr_9p_call(fd, tbuf, tpos, rbuf, rmax_size, &rsize, &rpos, DR_RWALK))) {
+  if (dr_unlikely(!dr_9p_call(client, rbuf, tpos, rmax_size, &rsize, &rpos, DR_RWALK))) {
     return false;
   }
   uint16_t nwqid;
@@ -214,16 +184,15 @@ WARN_UNUSED_RESULT static bool dr_9p_walk(dr_handle_t fd, uint8_t *restrict cons
   return true;
 }
 
-WARN_UNUSED_RESULT static bool dr_9p_open(dr_handle_t fd, uint8_t *restrict const rbuf, const uint32_t rmax_size, const uint32_t fid, const uint8_t mode, struct dr_9p_qid *restrict const qid, uint32_t *restrict const iounit) {
-  uint8_t tbuf[DR_9P_BUF_SIZE];
+WARN_UNUSED_RESULT static bool dr_9p_open(struct dr_9p_client *restrict const client, uint8_t *restrict const rbuf, const uint32_t rmax_size, const uint32_t fid, const uint8_t mode, struct dr_9p_qid *restrict const qid, uint32_t *restrict const iounit) {
   uint32_t tpos;
   uint32_t rsize;
   uint32_t rpos;
-  if (dr_unlikely(!dr_9p_encode_Topen(tbuf, rmax_size, &tpos, 0, fid, mode))) {
+  if (dr_unlikely(!dr_9p_encode_Topen(rbuf, rmax_size, &tpos, 0, fid, mode))) {
     dr_log("dr_9p_encode_Topen failed");
     return false;
   }
-  if (dr_unlikely(!dr_9p_call(fd, tbuf, tpos, rbuf, rmax_size, &rsize, &rpos, DR_ROPEN))) {
+  if (dr_unlikely(!dr_9p_call(client, rbuf, tpos, rmax_size, &rsize, &rpos, DR_ROPEN))) {
     return false;
   }
   if (dr_unlikely(!dr_9p_decode_Ropen(qid, iounit, rbuf, rsize, &rpos))) {
@@ -236,16 +205,15 @@ WARN_UNUSED_RESULT static bool dr_9p_open(dr_handle_t fd, uint8_t *restrict cons
   return true;
 }
 
-WARN_UNUSED_RESULT static bool dr_9p_create(dr_handle_t fd, uint8_t *restrict const rbuf, const uint32_t rmax_size, const uint32_t fid, const struct dr_str *restrict const name, const uint32_t perm, const uint8_t mode, struct dr_9p_qid *restrict const qid, uint32_t *restrict const iounit) {
-  uint8_t tbuf[DR_9P_BUF_SIZE];
+WARN_UNUSED_RESULT static bool dr_9p_create(struct dr_9p_client *restrict const client, uint8_t *restrict const rbuf, const uint32_t rmax_size, const uint32_t fid, const struct dr_str *restrict const name, const uint32_t perm, const uint8_t mode, struct dr_9p_qid *restrict const qid, uint32_t *restrict const iounit) {
   uint32_t tpos;
   uint32_t rsize;
   uint32_t rpos;
-  if (dr_unlikely(!dr_9p_encode_Tcreate(tbuf, rmax_size, &tpos, 0, fid, name, perm, mode))) {
+  if (dr_unlikely(!dr_9p_encode_Tcreate(rbuf, rmax_size, &tpos, 0, fid, name, perm, mode))) {
     dr_log("dr_9p_encode_Tcreate failed");
     return false;
   }
-  if (dr_unlikely(!dr_9p_call(fd, tbuf, tpos, rbuf, rmax_size, &rsize, &rpos, DR_RCREATE))) {
+  if (dr_unlikely(!dr_9p_call(client, rbuf, tpos, rmax_size, &rsize, &rpos, DR_RCREATE))) {
     return false;
   }
   if (dr_unlikely(!dr_9p_decode_Rcreate(qid, iounit, rbuf, rsize, &rpos))) {
@@ -258,16 +226,15 @@ WARN_UNUSED_RESULT static bool dr_9p_create(dr_handle_t fd, uint8_t *restrict co
   return true;
 }
 
-WARN_UNUSED_RESULT static bool dr_9p_read(dr_handle_t fd, uint8_t *restrict const rbuf, const uint32_t rmax_size, const uint32_t fid, const uint64_t offset, const uint32_t count, uint32_t *restrict const bytes, const void *restrict *restrict const data) {
-  uint8_t tbuf[DR_9P_BUF_SIZE];
+WARN_UNUSED_RESULT static bool dr_9p_read(struct dr_9p_client *restrict const client, uint8_t *restrict const rbuf, const uint32_t rmax_size, const uint32_t fid, const uint64_t offset, const uint32_t count, uint32_t *restrict const bytes, const void *restrict *restrict const data) {
   uint32_t tpos;
   uint32_t rsize;
   uint32_t rpos;
-  if (dr_unlikely(!dr_9p_encode_Tread(tbuf, rmax_size, &tpos, 0, fid, offset, count))) {
+  if (dr_unlikely(!dr_9p_encode_Tread(rbuf, rmax_size, &tpos, 0, fid, offset, count))) {
     dr_log("dr_9p_encode_Tread failed");
     return false;
   }
-  if (dr_unlikely(!dr_9p_call(fd, tbuf, tpos, rbuf, rmax_size, &rsize, &rpos, DR_RREAD))) {
+  if (dr_unlikely(!dr_9p_call(client, rbuf, tpos, rmax_size, &rsize, &rpos, DR_RREAD))) {
     return false;
   }
   if (dr_unlikely(!dr_9p_decode_Rread(bytes, data, rbuf, rsize, &rpos))) {
@@ -280,22 +247,21 @@ WARN_UNUSED_RESULT static bool dr_9p_read(dr_handle_t fd, uint8_t *restrict cons
   return true;
 }
 
-WARN_UNUSED_RESULT static bool dr_9p_write(dr_handle_t fd, uint8_t *restrict const rbuf, const uint32_t rmax_size, const uint32_t fid, const uint64_t offset, const uint32_t count, uint32_t *restrict const bytes, const void *restrict const data) {
-  uint8_t tbuf[DR_9P_BUF_SIZE];
+WARN_UNUSED_RESULT static bool dr_9p_write(struct dr_9p_client *restrict const client, uint8_t *restrict const rbuf, const uint32_t rmax_size, const uint32_t fid, const uint64_t offset, const uint32_t count, uint32_t *restrict const bytes, const void *restrict const data) {
   uint32_t tpos;
   uint32_t rsize;
   uint32_t rpos;
-  if (dr_unlikely(!dr_9p_encode_Twrite_iterator(tbuf, rmax_size, &tpos, 0, fid, offset))) {
+  if (dr_unlikely(!dr_9p_encode_Twrite_iterator(rbuf, rmax_size, &tpos, 0, fid, offset))) {
     dr_log("dr_9p_encode_Twrite_iterator failed");
     return false;
   }
   const uint32_t real_count = count <= rmax_size - tpos ? count : rmax_size - tpos;
-  memcpy(tbuf + tpos, data, real_count);
-  if (dr_unlikely(!dr_9p_encode_Twrite_finish(tbuf, rmax_size, &tpos, real_count))) {
+  memcpy(rbuf + tpos, data, real_count);
+  if (dr_unlikely(!dr_9p_encode_Twrite_finish(rbuf, rmax_size, &tpos, real_count))) {
     dr_log("dr_9p_encode_Twrite_finish failed");
     return false;
   }
-  if (dr_unlikely(!dr_9p_call(fd, tbuf, tpos, rbuf, rmax_size, &rsize, &rpos, DR_RWRITE))) {
+  if (dr_unlikely(!dr_9p_call(client, rbuf, tpos, rmax_size, &rsize, &rpos, DR_RWRITE))) {
     return false;
   }
   if (dr_unlikely(!dr_9p_decode_Rwrite(bytes, rbuf, rsize, &rpos))) {
@@ -308,16 +274,15 @@ WARN_UNUSED_RESULT static bool dr_9p_write(dr_handle_t fd, uint8_t *restrict con
   return true;
 }
 
-WARN_UNUSED_RESULT static bool dr_9p_clunk(dr_handle_t fd, uint8_t *restrict const rbuf, const uint32_t rmax_size, const uint32_t fid) {
-  uint8_t tbuf[DR_9P_BUF_SIZE];
+WARN_UNUSED_RESULT static bool dr_9p_clunk(struct dr_9p_client *restrict const client, uint8_t *restrict const rbuf, const uint32_t rmax_size, const uint32_t fid) {
   uint32_t tpos;
   uint32_t rsize;
   uint32_t rpos;
-  if (dr_unlikely(!dr_9p_encode_Tclunk(tbuf, rmax_size, &tpos, 0, fid))) {
+  if (dr_unlikely(!dr_9p_encode_Tclunk(rbuf, rmax_size, &tpos, 0, fid))) {
     dr_log("dr_9p_encode_Tclunk failed");
     return false;
   }
-  if (dr_unlikely(!dr_9p_call(fd, tbuf, tpos, rbuf, rmax_size, &rsize, &rpos, DR_RCLUNK))) {
+  if (dr_unlikely(!dr_9p_call(client, rbuf, tpos, rmax_size, &rsize, &rpos, DR_RCLUNK))) {
     return false;
   }
   if (dr_unlikely(!dr_9p_decode_Rclunk(rsize, &rpos))) {
@@ -330,16 +295,15 @@ WARN_UNUSED_RESULT static bool dr_9p_clunk(dr_handle_t fd, uint8_t *restrict con
   return true;
 }
 
-WARN_UNUSED_RESULT static bool dr_9p_remove(dr_handle_t fd, uint8_t *restrict const rbuf, const uint32_t rmax_size, const uint32_t fid) {
-  uint8_t tbuf[DR_9P_BUF_SIZE];
+WARN_UNUSED_RESULT static bool dr_9p_remove(struct dr_9p_client *restrict const client, uint8_t *restrict const rbuf, const uint32_t rmax_size, const uint32_t fid) {
   uint32_t tpos;
   uint32_t rsize;
   uint32_t rpos;
-  if (dr_unlikely(!dr_9p_encode_Tremove(tbuf, rmax_size, &tpos, 0, fid))) {
+  if (dr_unlikely(!dr_9p_encode_Tremove(rbuf, rmax_size, &tpos, 0, fid))) {
     dr_log("dr_9p_encode_Tremove failed");
     return false;
   }
-  if (dr_unlikely(!dr_9p_call(fd, tbuf, tpos, rbuf, rmax_size, &rsize, &rpos, DR_RREMOVE))) {
+  if (dr_unlikely(!dr_9p_call(client, rbuf, tpos, rmax_size, &rsize, &rpos, DR_RREMOVE))) {
     return false;
   }
   if (dr_unlikely(!dr_9p_decode_Rremove(rsize, &rpos))) {
@@ -352,16 +316,15 @@ WARN_UNUSED_RESULT static bool dr_9p_remove(dr_handle_t fd, uint8_t *restrict co
   return true;
 }
 
-WARN_UNUSED_RESULT static bool dr_9p_stat(dr_handle_t fd, uint8_t *restrict const rbuf, const uint32_t rmax_size, const uint32_t fid, struct dr_9p_stat *restrict const stat) {
-  uint8_t tbuf[DR_9P_BUF_SIZE];
+WARN_UNUSED_RESULT static bool dr_9p_stat(struct dr_9p_client *restrict const client, uint8_t *restrict const rbuf, const uint32_t rmax_size, const uint32_t fid, struct dr_9p_stat *restrict const stat) {
   uint32_t tpos;
   uint32_t rsize;
   uint32_t rpos;
-  if (dr_unlikely(!dr_9p_encode_Tstat(tbuf, rmax_size, &tpos, 0, fid))) {
+  if (dr_unlikely(!dr_9p_encode_Tstat(rbuf, rmax_size, &tpos, 0, fid))) {
     dr_log("dr_9p_encode_Tstat failed");
     return false;
   }
-  if (dr_unlikely(!dr_9p_call(fd, tbuf, tpos, rbuf, rmax_size, &rsize, &rpos, DR_RSTAT))) {
+  if (dr_unlikely(!dr_9p_call(client, rbuf, tpos, rmax_size, &rsize, &rpos, DR_RSTAT))) {
     return false;
   }
   if (dr_unlikely(!dr_9p_decode_Rstat(stat, rbuf, rsize, &rpos))) {
@@ -374,16 +337,15 @@ WARN_UNUSED_RESULT static bool dr_9p_stat(dr_handle_t fd, uint8_t *restrict cons
   return true;
 }
 
-WARN_UNUSED_RESULT static bool dr_9p_wstat(dr_handle_t fd, uint8_t *restrict const rbuf, const uint32_t rmax_size, const uint32_t fid, const struct dr_9p_stat *restrict const stat) {
-  uint8_t tbuf[DR_9P_BUF_SIZE];
+WARN_UNUSED_RESULT static bool dr_9p_wstat(struct dr_9p_client *restrict const client, uint8_t *restrict const rbuf, const uint32_t rmax_size, const uint32_t fid, const struct dr_9p_stat *restrict const stat) {
   uint32_t tpos;
   uint32_t rsize;
   uint32_t rpos;
-  if (dr_unlikely(!dr_9p_encode_Twstat(tbuf, rmax_size, &tpos, 0, fid, stat))) {
+  if (dr_unlikely(!dr_9p_encode_Twstat(rbuf, rmax_size, &tpos, 0, fid, stat))) {
     dr_log("dr_9p_encode_Twstat failed");
     return false;
   }
-  if (dr_unlikely(!dr_9p_call(fd, tbuf, tpos, rbuf, rmax_size, &rsize, &rpos, DR_RWSTAT))) {
+  if (dr_unlikely(!dr_9p_call(client, rbuf, tpos, rmax_size, &rsize, &rpos, DR_RWSTAT))) {
     return false;
   }
   if (dr_unlikely(!dr_9p_decode_Rwstat(rsize, &rpos))) {
@@ -396,8 +358,237 @@ WARN_UNUSED_RESULT static bool dr_9p_wstat(dr_handle_t fd, uint8_t *restrict con
   return true;
 }
 
+/*
+ * Paths walked from fid 0 keep their fid, and stats returned by Tstat or
+ * directory reads are kept with them, so repeated commands in sh do not need
+ * to walk again. Entries are trusted for cache_ttl, stats are dropped when an
+ * open returns a different qid.vers and commands that change a file drop its
+ * stat and its parent's. Paths are relative to fid 0, so cd flushes the cache.
+ */
+
+#define WALK_CACHE_SIZE 64
+#define WALK_CACHE_FID 16
+#define WALK_CACHE_PATH (1<<8)
+
+struct walk_entry {
+  char path[WALK_CACHE_PATH];
+  // DR_NOFID when only the stat is known
+  uint32_t fid;
+  bool used;
+  bool has_stat;
+  struct dr_9p_stat stat;
+  char *restrict strings;
+  int64_t expires;
+  uint64_t last_use;
+};
+
+static struct walk_entry walk_cache[WALK_CACHE_SIZE];
+static uint64_t walk_cache_clock;
+
+// Joins the non empty components of name so equivalent spellings share an entry
+WARN_UNUSED_RESULT static bool cache_key(char *restrict const key, const char *restrict const name) {
+  size_t len = 0;
+  const char *restrict pos = name == NULL ? "" : name;
+  while (*pos != '\0') {
+    const size_t n = strcspn(pos, "/");
+    if (n > 0) {
+      if (len + (len > 0) + n >= WALK_CACHE_PATH) {
+	return false;
+      }
+      if (len > 0) {
+	key[len++] = '/';
+      }
+      memcpy(key + len, pos, n);
+      len += n;
+    }
+    pos += n + (pos[n] == '/');
+  }
+  key[len] = '\0';
+  return true;
+}
+
+static void cache_clear_stat(struct walk_entry *restrict const e) {
+  free(e->strings);
+  e->strings = NULL;
+  e->has_stat = false;
+}
+
+static void cache_set_stat(struct walk_entry *restrict const e, const struct dr_9p_stat *restrict const stat) {
+  cache_clear_stat(e);
+  const size_t len = stat->name.len + stat->uid.len + stat->gid.len + stat->muid.len;
+  char *restrict const strings = (char *)malloc(len > 0 ? len : 1);
+  if (dr_unlikely(strings == NULL)) {
+    return;
+  }
+  e->stat = *stat;
+  e->strings = strings;
+  char *restrict pos = strings;
+  struct dr_str *restrict const strs[] = { &e->stat.name, &e->stat.uid, &e->stat.gid, &e->stat.muid };
+  for (size_t i = 0; i < sizeof(strs)/sizeof(strs[0]); ++i) {
+    memcpy(pos, strs[i]->buf, strs[i]->len);
+    strs[i]->buf = pos;
+    pos += strs[i]->len;
+  }
+  e->has_stat = true;
+  e->expires = dr_monotonic_ns() + cache_ttl;
+}
+
+static void cache_drop(struct dr_9p_client *restrict const client, const uint32_t msize, struct walk_entry *restrict const e) {
+  if (e->fid != DR_NOFID) {
+    uint8_t rbuf[DR_9P_BUF_SIZE];
+    if (dr_9p_clunk(client, rbuf, msize, e->fid)) {
+    }
+  }
+  cache_clear_stat(e);
+  e->used = false;
+}
+
+static void cache_flush(struct dr_9p_client *restrict const client, const uint32_t msize) {
+  for (size_t i = 0; i < WALK_CACHE_SIZE; ++i) {
+    if (walk_cache[i].used) {
+      cache_drop(client, msize, &walk_cache[i]);
+    }
+  }
+}
+
+// Returns the live entry for key, expired entries are dropped
+WARN_UNUSED_RESULT static struct walk_entry *cache_find(struct dr_9p_client *restrict const client, const uint32_t msize, const char *restrict const key) {
+  for (size_t i = 0; i < WALK_CACHE_SIZE; ++i) {
+    struct walk_entry *restrict const e = &walk_cache[i];
+    if (e->used && strcmp(e->path, key) == 0) {
+      if (e->expires <= dr_monotonic_ns()) {
+	cache_drop(client, msize, e);
+	return NULL;
+      }
+      e->last_use = ++walk_cache_clock;
+      return e;
+    }
+  }
+  return NULL;
+}
+
+// Picks a free slot or evicts the least recently used one, entries holding fids are only evicted if evict_fids is set
+WARN_UNUSED_RESULT static struct walk_entry *cache_slot(struct dr_9p_client *restrict const client, const uint32_t msize, const char *restrict const key, const bool evict_fids) {
+  struct walk_entry *restrict victim = NULL;
+  for (size_t i = 0; i < WALK_CACHE_SIZE; ++i) {
+    struct walk_entry *restrict const e = &walk_cache[i];
+    if (!e->used) {
+      victim = e;
+      break;
+    }
+    if ((evict_fids || e->fid == DR_NOFID) && (victim == NULL || e->last_use < victim->last_use)) {
+      victim = e;
+    }
+  }
+  if (victim == NULL) {
+    return NULL;
+  }
+  if (victim->used) {
+    cache_drop(client, msize, victim);
+  }
+  strcpy(victim->path, key);
+  victim->fid = DR_NOFID;
+  victim->used = true;
+  victim->expires = dr_monotonic_ns() + cache_ttl;
+  victim->last_use = ++walk_cache_clock;
+  return victim;
+}
+
+// Returns an entry with a fid walked to name
+WARN_UNUSED_RESULT static struct walk_entry *cache_walk(struct dr_9p_client *restrict const client, const uint32_t msize, char *restrict const name) {
+  char key[WALK_CACHE_PATH];
+  if (dr_unlikely(!cache_key(key, name))) {
+    dr_log("Path too long");
+    return NULL;
+  }
+  struct walk_entry *restrict e = cache_find(client, msize, key);
+  if (e != NULL && e->fid != DR_NOFID) {
+    return e;
+  }
+  if (e == NULL) {
+    e = cache_slot(client, msize, key, true);
+  }
+  const uint32_t fid = WALK_CACHE_FID + (e - walk_cache);
+  uint8_t rbuf[DR_9P_BUF_SIZE];
+  if (!dr_9p_walk(client, rbuf, msize, 0, fid, name)) {
+    cache_clear_stat(e);
+    e->used = false;
+    return NULL;
+  }
+  e->fid = fid;
+  e->expires = dr_monotonic_ns() + cache_ttl;
+  return e;
+}
+
+// Drops a cached stat of name that an open shows is out of date
+static void cache_check(struct dr_9p_client *restrict const client, const uint32_t msize, const char *restrict const name, const struct dr_9p_qid *restrict const qid) {
+  char key[WALK_CACHE_PATH];
+  if (!cache_key(key, name)) {
+    return;
+  }
+  struct walk_entry *restrict const e = cache_find(client, msize, key);
+  if (e != NULL && e->has_stat && (e->stat.qid.vers != qid->vers || e->stat.qid.path != qid->path)) {
+    cache_clear_stat(e);
+  }
+}
+
+static void cache_forget_stat(struct dr_9p_client *restrict const client, const uint32_t msize, const char *restrict const key) {
+  struct walk_entry *restrict const e = cache_find(client, msize, key);
+  if (e == NULL) {
+    return;
+  }
+  if (e->fid == DR_NOFID) {
+    cache_drop(client, msize, e);
+  } else {
+    cache_clear_stat(e);
+  }
+}
+
+// Drops the stats of name and its parent after name was changed
+static void cache_invalidate(struct dr_9p_client *restrict const client, const uint32_t msize, const char *restrict const name) {
+  char key[WALK_CACHE_PATH];
+  if (!cache_key(key, name)) {
+    return;
+  }
+  cache_forget_stat(client, msize, key);
+  char *restrict const slash = strrchr(key, '/');
+  if (slash != NULL) {
+    *slash = '\0';
+  } else {
+    key[0] = '\0';
+  }
+  cache_forget_stat(client, msize, key);
+}
+
+// Keeps the stats returned by a directory read, without evicting walked fids
+static void cache_dir_stat(struct dr_9p_client *restrict const client, const uint32_t msize, const char *restrict const dir, const struct dr_9p_stat *restrict const stat) {
+  if (cache_ttl == 0) {
+    return;
+  }
+  char key[WALK_CACHE_PATH];
+  if (!cache_key(key, dir)) {
+    return;
+  }
+  const size_t len = strlen(key);
+  if (len + 1 + stat->name.len >= WALK_CACHE_PATH) {
+    return;
+  }
+  if (len > 0) {
+    key[len] = '/';
+  }
+  memcpy(key + len + (len > 0), stat->name.buf, stat->name.len);
+  key[len + (len > 0) + stat->name.len] = '\0';
+  struct walk_entry *restrict e = cache_find(client, msize, key);
+  if (e == NULL) {
+    e = cache_slot(client, msize, key, false);
+  }
+  if (e != NULL) {
+    cache_set_stat(e, stat);
+  }
+}
+
 struct client_app {
-  bool (*const func)(dr_handle_t, const uint32_t, int, char *restrict *restrict);
+  bool (*const func)(struct dr_9p_client *restrict const, const uint32_t, int, char *restrict *restrict);
   const char *restrict const name;
   const char *restrict const help;
 };
@@ -411,7 +602,7 @@ static void format_time(char *restrict const buf, const size_t buf_len, const ui
   strftime(buf, buf_len, "%c", gmtime(&t));
 }
 
-WARN_UNUSED_RESULT static bool print_files(const uint32_t count, const void *restrict data) {
+WARN_UNUSED_RESULT static bool print_files(struct dr_9p_client *restrict const client, const uint32_t msize, const char *restrict const dir, const uint32_t count, const void *restrict data) {
   uint32_t pos = 0;
   while (pos < count) {
     struct dr_9p_stat stat;
@@ -421,8 +612,10 @@ WARN_UNUSED_RESULT static bool print_files(const uint32_t count, const void *res
       return false;
     }
     pos += read;
+    cache_dir_stat(client, msize, dir, &stat);
     char buf[64];
     format_time(buf, sizeof(buf), stat.atime);
+    dr_log_flush();
     printf("%11" PRIo32 " %.*s %.*s %s %20" PRIu64 " %.*s\n", stat.mode, stat.uid.len, stat.uid.buf, stat.gid.len, stat.gid.buf, buf, stat.length, stat.name.len, stat.name.buf);
   }
   return true;
@@ -558,7 +751,7 @@ WARN_UNUSED_RESULT static bool parse(const char *restrict input, int *restrict c
   return false;
 }
 
-WARN_UNUSED_RESULT static bool ls(dr_handle_t fd, const uint32_t msize, int argc, char *restrict *restrict argv) {
+WARN_UNUSED_RESULT static bool ls(struct dr_9p_client *restrict const client, const uint32_t msize, int argc, char *restrict *restrict argv) {
   uint8_t rbuf[DR_9P_BUF_SIZE];
   if (argc == 1) {
     ++argc;
@@ -570,15 +763,16 @@ WARN_UNUSED_RESULT static bool ls(dr_handle_t fd, const uint32_t msize, int argc
       }
       printf("%s:\n", argv[i]);
     }
-    if (dr_unlikely(!dr_9p_walk(fd, rbuf, msize, 0, 1, argv[i]))) {
+    if (dr_unlikely(!dr_9p_walk(client, rbuf, msize, 0, 1, argv[i]))) {
       continue;
     }
     {
       struct dr_9p_qid qid;
       uint32_t iounit;
-      if (dr_unlikely(!dr_9p_open(fd, rbuf, msize, 1, DR_OREAD, &qid, &iounit))) {
+      if (dr_unlikely(!dr_9p_open(client, rbuf, msize, 1, DR_OREAD, &qid, &iounit))) {
 	goto fail_clunk;
       }
+      cache_check(client, msize, argv[i], &qid);
       if (dr_unlikely(!(qid.type & DR_QTDIR))) {
 	dr_log("Expected a directory");
 	goto fail_clunk;
@@ -589,82 +783,362 @@ WARN_UNUSED_RESULT static bool ls(dr_handle_t fd, const uint32_t msize, int argc
       while (true) {
 	uint32_t count;
 	const void *restrict data;
-	if (dr_unlikely(!dr_9p_read(fd, rbuf, msize, 1, offset, msize - 24, &count, &data))) {
+	if (dr_unlikely(!dr_9p_read(client, rbuf, msize, 1, offset, msize - 24, &count, &data))) {
 	  goto fail_clunk;
 	}
 	if (count == 0) {
 	  break;
 	}
-	if (dr_unlikely(!print_files(count, data))) {
+	if (dr_unlikely(!print_files(client, msize, argv[i], count, data))) {
 	  goto fail_clunk;
 	}
 	offset += count;
       }
     }
   fail_clunk:
-    if (dr_9p_clunk(fd, rbuf, msize, 1)) {
+    if (dr_9p_clunk(client, rbuf, msize, 1)) {
     }
   }
   return true;
 }
 
-WARN_UNUSED_RESULT static bool cat(dr_handle_t fd, const uint32_t msize, int argc, char *restrict *restrict argv) {
-  bool result = false;
+struct transfer_worker {
+  struct dr_task task;
+  struct transfer *restrict t;
+  bool waiting;
+};
+
+// Chunk c is handled by worker c % window, and chunks reach ordered sinks in order
+struct transfer {
+  struct dr_9p_client *restrict client;
+  uint32_t msize;
+  uint32_t chunk;
+  uint32_t src_fid;
+  uint32_t dst_fid;
+  FILE *restrict src;
+  FILE *restrict dst;
+  // Workers stop at end, the lower of eof and the first chunk that failed
+  uint64_t end;
+  uint64_t eof;
+  uint64_t err;
+  uint64_t read_next;
+  uint64_t write_next;
+  struct transfer_worker *restrict workers;
+  unsigned int window;
+  unsigned int running;
+  struct dr_task *restrict parent;
+};
+
+static void transfer_wake(struct transfer *restrict const t, const uint64_t c) {
+  struct transfer_worker *restrict const w = &t->workers[c % t->window];
+  if (w->waiting) {
+    dr_task_runnable(&w->task);
+  }
+}
+
+static void transfer_stop(struct transfer *restrict const t, const uint64_t c) {
+  if (c < t->end) {
+    t->end = c;
+    for (unsigned int i = 0; i < t->window; ++i) {
+      transfer_wake(t, i);
+    }
+  }
+}
+
+// Reads past the end of the file may fail, so errors there are ignored
+static void transfer_fail(struct transfer *restrict const t, const uint64_t c) {
+  if (c < t->err) {
+    t->err = c;
+  }
+  transfer_stop(t, c);
+}
+
+// Returns false if chunk c is past the end
+WARN_UNUSED_RESULT static bool transfer_wait(struct transfer_worker *restrict const w, const uint64_t *restrict const next, const uint64_t c) {
+  struct transfer *restrict const t = w->t;
+  while (*next != c && c < t->end) {
+    w->waiting = true;
+    dr_schedule(true);
+    w->waiting = false;
+  }
+  return c < t->end;
+}
+
+WARN_UNUSED_RESULT static bool transfer_chunk(struct transfer_worker *restrict const w, const uint64_t c) {
+  struct transfer *restrict const t = w->t;
+  uint8_t rbuf[DR_9P_BUF_SIZE];
+  uint8_t wbuf[DR_9P_BUF_SIZE];
+  uint8_t dbuf[DR_9P_BUF_SIZE];
+  uint32_t count;
+  const void *restrict data;
+  if (t->src == NULL) {
+    if (dr_unlikely(!dr_9p_read(t->client, rbuf, t->msize, t->src_fid, c*t->chunk, t->chunk, &count, &data))) {
+      return false;
+    }
+    // Servers may return short reads anywhere, only an empty read marks the end of the file
+    if (count != 0 && count < t->chunk) {
+      memcpy(dbuf, data, count);
+      data = dbuf;
+      while (count < t->chunk) {
+	uint32_t bytes;
+	const void *restrict more;
+	if (dr_unlikely(!dr_9p_read(t->client, rbuf, t->msize, t->src_fid, c*t->chunk + count, t->chunk - count, &bytes, &more))) {
+	  return false;
+	}
+	if (bytes == 0) {
+	  break;
+	}
+	memcpy(dbuf + count, more, bytes);
+	count += bytes;
+      }
+    }
+  } else {
+    if (!transfer_wait(w, &t->read_next, c)) {
+      return true;
+    }
+    count = fread(rbuf, 1, t->chunk, t->src);
+    if (dr_unlikely(count < t->chunk && ferror(t->src))) {
+      dr_log("fread failed");
+      return false;
+    }
+    data = rbuf;
+    ++t->read_next;
+    transfer_wake(t, c + 1);
+  }
+  // A chunk is only short at the end of the file
+  if (count < t->chunk) {
+    if (c + 1 < t->eof) {
+      t->eof = c + 1;
+    }
+    transfer_stop(t, c + 1);
+  }
+  if (t->dst == NULL) {
+    for (uint32_t pos = 0; pos < count;) {
+      uint32_t bytes;
+      if (dr_unlikely(!dr_9p_write(t->client, wbuf, t->msize, t->dst_fid, c*t->chunk + pos, count - pos, &bytes, (const uint8_t *)data + pos))) {
+	return false;
+      }
+      if (dr_unlikely(bytes == 0)) {
+	dr_log("Short write");
+	return false;
+      }
+      pos += bytes;
+    }
+  } else {
+    if (!transfer_wait(w, &t->write_next, c)) {
+      return true;
+    }
+    dr_log_flush();
+    if (dr_unlikely(fwrite(data, 1, count, t->dst) != count)) {
+      dr_log("fwrite failed");
+      return false;
+    }
+    ++t->write_next;
+    transfer_wake(t, c + 1);
+  }
+  return true;
+}
+
+static void transfer_func(void *restrict const arg) {
+  struct transfer_worker *restrict const w = (struct transfer_worker *)arg;
+  struct transfer *restrict const t = w->t;
+  for (uint64_t c = w - t->workers; c < t->end; c += t->window) {
+    if (dr_unlikely(!transfer_chunk(w, c))) {
+      transfer_fail(t, c);
+      break;
+    }
+  }
+  if (--t->running == 0) {
+    dr_task_runnable(t->parent);
+  }
+}
+
+// Copies from src_fid or src to dst_fid or dst with up to window reads or writes in flight
+WARN_UNUSED_RESULT static bool transfer(struct transfer *restrict const t) {
+  t->chunk = t->msize - 24;
+  t->end = ~((uint64_t)0);
+  t->eof = t->end;
+  t->err = t->end;
+  t->workers = (struct transfer_worker *)calloc(window, sizeof(*t->workers));
+  if (dr_unlikely(t->workers == NULL)) {
+    dr_log("calloc failed");
+    return false;
+  }
+  t->parent = dr_task_self();
+  for (unsigned int i = 0; i < window; ++i) {
+    struct transfer_worker *restrict const w = &t->workers[i];
+    w->t = t;
+    const struct dr_result_void r = dr_task_create(&w->task, STACK_SIZE, transfer_func, w);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_task_create failed", err);
+      transfer_fail(t, 0);
+      break;
+    } DR_FI_RESULT;
+    ++t->window;
+    ++t->running;
+  }
+  while (t->running > 0) {
+    dr_schedule(true);
+  }
+  for (unsigned int i = 0; i < t->window; ++i) {
+    dr_task_destroy(&t->workers[i].task);
+  }
+  free(t->workers);
+  return t->err >= t->eof;
+}
+
+WARN_UNUSED_RESULT static bool open_remote(struct dr_9p_client *restrict const client, const uint32_t msize, const uint32_t fid, char *restrict const name, const uint8_t mode, const bool create) {
   uint8_t rbuf[DR_9P_BUF_SIZE];
+  struct dr_9p_qid qid;
+  uint32_t iounit;
+  if (!dr_9p_walk(client, rbuf, msize, 0, fid, name)) {
+    if (!create) {
+      return false;
+    }
+    // Walk to the parent and create the file there
+    char path[1<<8];
+    if (dr_unlikely(strlen(name) >= sizeof(path))) {
+      dr_log("Path too long");
+      return false;
+    }
+    strcpy(path, name);
+    char *restrict const slash = strrchr(path, '/');
+    char *restrict const file = slash == NULL ? path : slash + 1;
+    if (slash != NULL) {
+      *slash = '\0';
+    }
+    if (dr_unlikely(!dr_9p_walk(client, rbuf, msize, 0, fid, slash == NULL ? NULL : path))) {
+      return false;
+    }
+    const struct dr_str n = {
+      .len = strlen(file),
+      .buf = file,
+    };
+    if (dr_unlikely(!dr_9p_create(client, rbuf, msize, fid, &n, 0644, mode, &qid, &iounit))) {
+      goto fail_clunk;
+    }
+    cache_invalidate(client, msize, name);
+    return true;
+  }
+  if (dr_unlikely(!dr_9p_open(client, rbuf, msize, fid, mode, &qid, &iounit))) {
+    goto fail_clunk;
+  }
+  if (mode != DR_OREAD) {
+    cache_invalidate(client, msize, name);
+  } else {
+    cache_check(client, msize, name, &qid);
+  }
+  if (dr_unlikely((qid.type & DR_QTDIR))) {
+    dr_log("Expected a file");
+    goto fail_clunk;
+  }
+  return true;
+ fail_clunk:
+  if (dr_9p_clunk(client, rbuf, msize, fid)) {
+  }
+  return false;
+}
+
+WARN_UNUSED_RESULT static bool cat(struct dr_9p_client *restrict const client, const uint32_t msize, int argc, char *restrict *restrict argv) {
   if (argc != 2) {
     printf("Usage: cat <file>\n"); // DR ...
     return false;
   }
-  if (dr_unlikely(!dr_9p_walk(fd, rbuf, msize, 0, 1, argv[1]))) {
+  if (dr_unlikely(!open_remote(client, msize, 1, argv[1], DR_OREAD, false))) {
     return false;
   }
-  {
-    struct dr_9p_qid qid;
-    uint32_t iounit;
-    if (dr_unlikely(!dr_9p_open(fd, rbuf, msize, 1, DR_OREAD, &qid, &iounit))) {
+  struct transfer t = {
+    .client = client,
+    .msize = msize,
+    .src_fid = 1,
+    .dst = stdout,
+  };
+  const bool result = transfer(&t);
+  fflush(stdout);
+  uint8_t rbuf[DR_9P_BUF_SIZE];
+  return dr_9p_clunk(client, rbuf, msize, 1) && result;
+}
+
+static char remote_prefix[] = "9p:";
+
+WARN_UNUSED_RESULT static char *remote_path(char *restrict const name) {
+  return strncmp(name, remote_prefix, sizeof(remote_prefix) - 1) == 0 ? name + sizeof(remote_prefix) - 1 : NULL;
+}
+
+WARN_UNUSED_RESULT static bool cp(struct dr_9p_client *restrict const client, const uint32_t msize, int argc, char *restrict *restrict argv) {
+  if (argc != 3) {
+    printf("Usage: cp <source> <dest>\n"); // DR ...
+    return false;
+  }
+  char *restrict const src = remote_path(argv[1]);
+  char *restrict const dst = remote_path(argv[2]);
+  if (src == NULL && dst == NULL) {
+    printf("At least one of <source> and <dest> must start with %s\n", remote_prefix);
+    return false;
+  }
+  uint8_t rbuf[DR_9P_BUF_SIZE];
+  bool result = false;
+  struct transfer t = {
+    .client = client,
+    .msize = msize,
+    .src_fid = 1,
+    .dst_fid = 2,
+  };
+  if (src != NULL) {
+    if (dr_unlikely(!open_remote(client, msize, t.src_fid, src, DR_OREAD, false))) {
       return false;
     }
-    if (dr_unlikely((qid.type & DR_QTDIR))) {
-      dr_log("Expected a file");
-      goto fail_clunk;
+  } else {
+    t.src = fopen(argv[1], "rb");
+    if (dr_unlikely(t.src == NULL)) {
+      perror(argv[1]);
+      return false;
     }
   }
-  {
-    uint64_t offset = 0;
-    while (true) {
-      uint32_t count;
-      const void *restrict data;
-      if (dr_unlikely(!dr_9p_read(fd, rbuf, msize, 1, offset, msize - 24, &count, &data))) {
-	goto fail_clunk;
-      }
-      if (count == 0) {
-	break;
-      }
-      printf("%.*s", count, (const char *)data);
-      offset += count;
+  if (dst != NULL) {
+    if (dr_unlikely(!open_remote(client, msize, t.dst_fid, dst, DR_OWRITE | DR_OTRUNC, true))) {
+      goto fail_close_src;
+    }
+  } else {
+    t.dst = fopen(argv[2], "wb");
+    if (dr_unlikely(t.dst == NULL)) {
+      perror(argv[2]);
+      goto fail_close_src;
     }
   }
-  result = true;
- fail_clunk:
-  return dr_9p_clunk(fd, rbuf, msize, 1) || result;
+  result = transfer(&t);
+  if (dst != NULL) {
+    result = dr_9p_clunk(client, rbuf, msize, t.dst_fid) && result;
+  } else if (dr_unlikely(fclose(t.dst) != 0)) {
+    perror(argv[2]);
+    result = false;
+  }
+ fail_close_src:
+  if (src != NULL) {
+    result = dr_9p_clunk(client, rbuf, msize, t.src_fid) && result;
+  } else {
+    fclose(t.src);
+  }
+  return result;
 }
 
-WARN_UNUSED_RESULT static bool write(dr_handle_t fd, const uint32_t msize, int argc, char *restrict *restrict argv) {
+WARN_UNUSED_RESULT static bool write(struct dr_9p_client *restrict const client, const uint32_t msize, int argc, char *restrict *restrict argv) {
   bool result = false;
   uint8_t rbuf[DR_9P_BUF_SIZE];
   if (argc != 3) {
     printf("Usage: write <data> <dest>\n"); // DR ...
     return false;
   }
-  if (dr_unlikely(!dr_9p_walk(fd, rbuf, msize, 0, 1, argv[2]))) {
+  if (dr_unlikely(!dr_9p_walk(client, rbuf, msize, 0, 1, argv[2]))) {
     return false;
   }
   {
     struct dr_9p_qid qid;
     uint32_t iounit;
-    if (dr_unlikely(!dr_9p_open(fd, rbuf, msize, 1, DR_OWRITE | DR_OTRUNC, &qid, &iounit))) {
+    if (dr_unlikely(!dr_9p_open(client, rbuf, msize, 1, DR_OWRITE | DR_OTRUNC, &qid, &iounit))) {
       goto fail_clunk;
     }
+    cache_invalidate(client, msize, argv[2]);
     if (dr_unlikely((qid.type & DR_QTDIR))) {
       dr_log("Expected a file");
       goto fail_clunk;
@@ -675,7 +1149,7 @@ WARN_UNUSED_RESULT static bool write(dr_handle_t fd, const uint32_t msize, int a
     uint64_t data_len = strlen(argv[1]);
     while (offset < data_len) {
       uint32_t count;
-      if (dr_unlikely(!dr_9p_write(fd, rbuf, msize, 1, offset, data_len - offset, &count, argv[1] + offset))) {
+      if (dr_unlikely(!dr_9p_write(client, rbuf, msize, 1, offset, data_len - offset, &count, argv[1] + offset))) {
 	goto fail_clunk;
       }
       if (count == 0) {
@@ -686,48 +1160,65 @@ WARN_UNUSED_RESULT static bool write(dr_handle_t fd, const uint32_t msize, int a
   }
   result = true;
  fail_clunk:
-  return dr_9p_clunk(fd, rbuf, msize, 1) || result;
+  return dr_9p_clunk(client, rbuf, msize, 1) || result;
 }
 
-WARN_UNUSED_RESULT static bool rm(dr_handle_t fd, const uint32_t msize, int argc, char *restrict *restrict argv) {
+WARN_UNUSED_RESULT static bool rm(struct dr_9p_client *restrict const client, const uint32_t msize, int argc, char *restrict *restrict argv) {
   uint8_t rbuf[DR_9P_BUF_SIZE];
   if (argc != 2) {
     printf("Usage: rm <file>\n"); // DR ...
     return false;
   }
-  if (dr_unlikely(!dr_9p_walk(fd, rbuf, msize, 0, 1, argv[1]))) {
+  struct walk_entry *restrict const e = cache_walk(client, msize, argv[1]);
+  if (dr_unlikely(e == NULL)) {
     return false;
   }
-  return dr_9p_remove(fd, rbuf, msize, 1);
+  // Tremove clunks the fid even if it fails
+  const uint32_t fid = e->fid;
+  e->fid = DR_NOFID;
+  cache_invalidate(client, msize, argv[1]);
+  return dr_9p_remove(client, rbuf, msize, fid);
 }
 
-WARN_UNUSED_RESULT static bool stat(dr_handle_t fd, const uint32_t msize, int argc, char *restrict *restrict argv) {
-  bool result = false;
+WARN_UNUSED_RESULT static bool stat(struct dr_9p_client *restrict const client, const uint32_t msize, int argc, char *restrict *restrict argv) {
   uint8_t rbuf[DR_9P_BUF_SIZE];
   if (argc != 2) {
     printf("Usage: stat <file>\n"); // DR ...
     return false;
   }
-  if (dr_unlikely(!dr_9p_walk(fd, rbuf, msize, 0, 1, argv[1]))) {
+  char key[WALK_CACHE_PATH];
+  if (dr_unlikely(!cache_key(key, argv[1]))) {
+    dr_log("Path too long");
     return false;
   }
   struct dr_9p_stat stat;
-  if (dr_unlikely(!dr_9p_stat(fd, rbuf, msize, 1, &stat))) {
-    goto fail_clunk;
+  struct walk_entry *restrict e = cache_find(client, msize, key);
+  if (e != NULL && e->has_stat) {
+    stat = e->stat;
+  } else {
+    e = cache_walk(client, msize, argv[1]);
+    if (dr_unlikely(e == NULL)) {
+      return false;
+    }
+    if (dr_unlikely(!dr_9p_stat(client, rbuf, msize, e->fid, &stat))) {
+      cache_drop(client, msize, e);
+      return false;
+    }
+    cache_set_stat(e, &stat);
   }
   char buf[64];
   format_time(buf, sizeof(buf), stat.atime);
+  dr_log_flush();
   printf("%4" PRIx16 " %8" PRIx32 " %2" PRIx8 " %8" PRIx32 " %16" PRIx64 " %11" PRIo32 " %s", stat.type, stat.dev, stat.qid.type, stat.qid.vers, stat.qid.path, stat.mode, buf);
   format_time(buf, sizeof(buf), stat.mtime);
   printf(" %s %20" PRIu64 " %.*s %.*s %.*s %.*s\n", buf, stat.length, stat.name.len, stat.name.buf, stat.uid.len, stat.uid.buf, stat.gid.len, stat.gid.buf, stat.muid.len, stat.muid.buf);
-  result = false;
- fail_clunk:
-  return dr_9p_clunk(fd, rbuf, msize, 1) || result;
+  return true;
 }
 
-WARN_UNUSED_RESULT static bool do_create(dr_handle_t fd, const uint32_t msize, char *restrict const name_buf, const uint32_t mode) {
+WARN_UNUSED_RESULT static bool do_create(struct dr_9p_client *restrict const client, const uint32_t msize, char *restrict const name_buf, const uint32_t mode) {
   bool result = false;
   uint8_t rbuf[DR_9P_BUF_SIZE];
+  cache_invalidate(client, msize, name_buf);
   char *restrict path;
   char *restrict const slash = strrchr(name_buf, '/');
   char *restrict file;
@@ -739,7 +1230,7 @@ WARN_UNUSED_RESULT static bool do_create(dr_handle_t fd, const uint32_t msize, c
     *slash = '\0';
     file = slash + 1;
   }
-  if (dr_unlikely(!dr_9p_walk(fd, rbuf, msize, 0, 1, path))) {
+  if (dr_unlikely(!dr_9p_walk(client, rbuf, msize, 0, 1, path))) {
     return false;
   }
   struct dr_str name = {
@@ -748,38 +1239,38 @@ WARN_UNUSED_RESULT static bool do_create(dr_handle_t fd, const uint32_t msize, c
   };
   struct dr_9p_qid qid;
   uint32_t iounit;
-  if (dr_unlikely(!dr_9p_create(fd, rbuf, msize, 1, &name, mode, DR_OREAD, &qid, &iounit))) {
+  if (dr_unlikely(!dr_9p_create(client, rbuf, msize, 1, &name, mode, DR_OREAD, &qid, &iounit))) {
     goto fail_clunk;
   }
   result = true;
  fail_clunk:
-  return dr_9p_clunk(fd, rbuf, msize, 1) || result;
+  return dr_9p_clunk(client, rbuf, msize, 1) || result;
 }
 
-WARN_UNUSED_RESULT static bool create(dr_handle_t fd, const uint32_t msize, int argc, char *restrict *restrict argv) {
+WARN_UNUSED_RESULT static bool create(struct dr_9p_client *restrict const client, const uint32_t msize, int argc, char *restrict *restrict argv) {
   if (argc != 3) {
     printf("Usage: create <name> <perm>\n"); // DR ...
     return false;
   }
-  return do_create(fd, msize, argv[1], strtol(argv[2], NULL, 0));
+  return do_create(client, msize, argv[1], strtol(argv[2], NULL, 0));
 }
 
-WARN_UNUSED_RESULT static bool mkdir(dr_handle_t fd, const uint32_t msize, int argc, char *restrict *restrict argv) {
+WARN_UNUSED_RESULT static bool mkdir(struct dr_9p_client *restrict const client, const uint32_t msize, int argc, char *restrict *restrict argv) {
   if (argc != 3) {
     printf("Usage: mkdir <name> <perm>\n"); // DR ...
     return false;
   }
-  return do_create(fd, msize, argv[1], DR_DIR | strtol(argv[2], NULL, 0));
+  return do_create(client, msize, argv[1], DR_DIR | strtol(argv[2], NULL, 0));
 }
 
-WARN_UNUSED_RESULT static bool chmod(dr_handle_t fd, const uint32_t msize, int argc, char *restrict *restrict argv) {
-  bool result = false;
+WARN_UNUSED_RESULT static bool chmod(struct dr_9p_client *restrict const client, const uint32_t msize, int argc, char *restrict *restrict argv) {
   uint8_t rbuf[DR_9P_BUF_SIZE];
   if (argc != 3) {
     printf("Usage: chmod <perm> <file>\n"); // DR ...
     return false;
   }
-  if (dr_unlikely(!dr_9p_walk(fd, rbuf, msize, 0, 1, argv[2]))) {
+  struct walk_entry *restrict const e = cache_walk(client, msize, argv[2]);
+  if (dr_unlikely(e == NULL)) {
     return false;
   }
   struct dr_9p_stat stat = {
@@ -793,20 +1284,17 @@ WARN_UNUSED_RESULT static bool chmod(dr_handle_t fd, const uint32_t msize, int a
     .mtime = ~((uint32_t)0),
     .length = ~((uint64_t)0),
   };
-  if (dr_unlikely(!dr_9p_wstat(fd, rbuf, msize, 1, &stat))) {
-    goto fail_clunk;
-  }
-  result = true;
- fail_clunk:
-  return dr_9p_clunk(fd, rbuf, msize, 1) || result;
+  cache_clear_stat(e);
+  return dr_9p_wstat(client, rbuf, msize, e->fid, &stat);
 }
 
-WARN_UNUSED_RESULT static bool sh(dr_handle_t fd, const uint32_t msize, int ignored_argc, char *restrict *restrict ignored_argv);
-WARN_UNUSED_RESULT static bool help(dr_handle_t fd, const uint32_t msize, int argc, char *restrict *restrict argv);
+WARN_UNUSED_RESULT static bool sh(struct dr_9p_client *restrict const client, const uint32_t msize, int ignored_argc, char *restrict *restrict ignored_argv);
+WARN_UNUSED_RESULT static bool help(struct dr_9p_client *restrict const client, const uint32_t msize, int argc, char *restrict *restrict argv);
 
 static const struct client_app client_apps[] = {
   { ls, "ls", "<directories>" },
   { cat, "cat", "<file>" },
+  { cp, "cp", "<source> <dest>" },
   { write, "write", "<data> <file>" },
   { rm, "rm", "<name>" },
   { rm, "rmdir", "<name>" },
@@ -819,7 +1307,7 @@ static const struct client_app client_apps[] = {
   // DR wstat
 };
 
-bool sh(dr_handle_t fd, const uint32_t msize, int ignored_argc, char *restrict *restrict ignored_argv) {
+bool sh(struct dr_9p_client *restrict const client, const uint32_t msize, int ignored_argc, char *restrict *restrict ignored_argv) {
   (void)ignored_argc;
   (void)ignored_argv;
   char buf[1<<8];
@@ -828,6 +1316,8 @@ bool sh(dr_handle_t fd, const uint32_t msize, int ignored_argc, char *restrict *
   cwd[1] = '\0';
   bool accept_next = true;
   while (accept_next) {
+    // Logs from the last command come before the prompt and are not held while reading
+    dr_log_flush();
     printf("%s $ ", cwd);
     fflush(stdout);
     if (fgets(buf, sizeof(buf), stdin) == NULL) {
@@ -857,7 +1347,8 @@ bool sh(dr_handle_t fd, const uint32_t msize, int ignored_argc, char *restrict *
 	printf("Too many arguments\n");
       } else if (argv[1][0] == '/') {
 	printf("Only relative paths are permited\n");
-      } else if (dr_9p_walk(fd, rbuf, msize, 0, 0, argv[1])) {
+      } else if (dr_9p_walk(client, rbuf, msize, 0, 0, argv[1])) {
+	cache_flush(client, msize);
 	char *restrict pos = argv[1];
 	char *restrict end = pos;
 	// DR Can the terminal condition be simplified
@@ -902,7 +1393,7 @@ bool sh(dr_handle_t fd, const uint32_t msize, int ignored_argc, char *restrict *
       size_t app;
       for (app = 0; app < sizeof(client_apps)/sizeof(client_apps[0]); ++app) {
 	if (strcmp(client_apps[app].name, argv[0]) == 0) {
-	  if (dr_unlikely(!client_apps[app].func(fd, msize, argc, argv))) {
+	  if (dr_unlikely(!client_apps[app].func(client, msize, argc, argv))) {
 	    // Do nothing
 	  }
 	  break;
@@ -918,8 +1409,8 @@ bool sh(dr_handle_t fd, const uint32_t msize, int ignored_argc, char *restrict *
   return true;
 }
 
-bool help(dr_handle_t fd, const uint32_t msize, int argc, char *restrict *restrict argv) {
-  (void)fd;
+bool help(struct dr_9p_client *restrict const client, const uint32_t msize, int argc, char *restrict *restrict argv) {
+  (void)client;
   (void)msize;
   (void)argc;
   (void)argv;
@@ -942,17 +1433,71 @@ WARN_UNUSED_RESULT static int print_usage(void) {
 	 "  -p, --port     TCP/IP port name to connect to\n"
 	 "  -n, --named    Named pipe to connect to\n"
 	 "  -u, --uname    User name\n"
+	 "  -w, --window   Reads or writes in flight for cat and cp, default 8\n"
+	 "  -c, --cache    Seconds walks and stats are cached for, default 1\n"
 	 "  -d, --debug    Print received messages\n"
 	 "  -v, --version  Print version information\n"
 	 "  -h, --help     Print this help\n"
 	 "\n"
 	 "Commands:\n"
 	 "\n");
-  if (help(0, 0, 0, NULL)) {
+  if (help(NULL, 0, 0, NULL)) {
   }
   return -1;
 }
 
+struct client_run {
+  struct dr_9p_client *restrict client;
+  const struct client_app *restrict app;
+  int argc;
+  char *restrict *restrict argv;
+  char *restrict uname_buf;
+  bool done;
+  int result;
+};
+
+static void run_func(void *restrict const arg) {
+  struct client_run *restrict const run = (struct client_run *)arg;
+  struct dr_9p_client *restrict const client = run->client;
+  uint32_t msize;
+  {
+    uint8_t rbuf[DR_9P_BUF_SIZE];
+    if (!dr_9p_version(client, rbuf, sizeof(rbuf), &msize)) {
+      goto done;
+    }
+    {
+      const struct dr_str uname = {
+	.len = strlen(run->uname_buf),
+	.buf = run->uname_buf,
+      };
+      const struct dr_str aname = {
+	.len = 0,
+      };
+      struct dr_9p_qid qid;
+      if (!dr_9p_attach(client, rbuf, msize, 0, &uname, &aname, &qid)) {
+	goto done;
+      }
+      if (dr_unlikely(!(qid.type & DR_QTDIR))) {
+	dr_log("Expected a directory");
+	goto done;
+      }
+    }
+  }
+  if (dr_unlikely(!run->app->func(client, msize, run->argc, run->argv))) {
+    goto done;
+  }
+  cache_flush(client, msize);
+  {
+    uint8_t rbuf[DR_9P_BUF_SIZE];
+    if (dr_unlikely(!dr_9p_clunk(client, rbuf, msize, 0))) {
+      goto done;
+    }
+  }
+  run->result = 0;
+ done:
+  run->done = true;
+}
+
 static char none[] = "none";
 
 int main(int argc, char *argv[]) {
@@ -966,6 +1511,8 @@ int main(int argc, char *argv[]) {
       {"port", 1, 0, 'p'},
       {"named", 1, 0, 'n'},
       {"uname", 1, 0, 'u'},
+      {"window", 1, 0, 'w'},
+      {"cache", 1, 0, 'c'},
       {"debug", 0, 0, 'd'},
       {"version", 0, 0, 'v'},
       {"help", 0, 0, 'h'},
@@ -973,7 +1520,7 @@ int main(int argc, char *argv[]) {
     };
     dr_optind = 0;
     while (true) {
-      int opt = dr_getopt_long(argc, argv, "+a:p:n:u:dvh", longopts, NULL);
+      int opt = dr_getopt_long(argc, argv, "+a:p:n:u:w:c:dvh", longopts, NULL);
       if (opt == -1) {
 	break;
       }
@@ -990,6 +1537,24 @@ int main(int argc, char *argv[]) {
       case 'u':
 	uname_buf = dr_optarg;
 	break;
+      case 'w': {
+	char *end;
+	const unsigned long value = strtoul(dr_optarg, &end, 10);
+	if (*dr_optarg == '\0' || *end != '\0' || value == 0 || value > 256) {
+	  return print_usage();
+	}
+	window = (unsigned int)value;
+	break;
+      }
+      case 'c': {
+	char *end;
+	const unsigned long seconds = strtoul(dr_optarg, &end, 10);
+	if (*dr_optarg == '\0' || *end != '\0' || seconds > 3600) {
+	  return print_usage();
+	}
+	cache_ttl = seconds*DR_NS_PER_S;
+	break;
+      }
       case 'd':
 	debug = true;
 	break;
@@ -1042,40 +1607,84 @@ int main(int argc, char *argv[]) {
     printf("Incomplete connection information provided\n");
     return -1;
   }
-  uint32_t msize;
   {
-    uint8_t rbuf[DR_9P_BUF_SIZE];
-    if (!dr_9p_version(fd, rbuf, sizeof(rbuf), &msize)) {
+    const struct dr_result_void r = dr_set_nonblock(fd);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_set_nonblock failed", err);
       goto fail_close_fd;
-    }
-    {
-      const struct dr_str uname = {
-	.len = strlen(uname_buf),
-	.buf = uname_buf,
-      };
-      const struct dr_str aname = {
-	.len = 0,
-      };
-      struct dr_9p_qid qid;
-      if (!dr_9p_attach(fd, rbuf, msize, 0, &uname, &aname, &qid)) {
-	goto fail_close_fd;
-      }
-      if (dr_unlikely(!(qid.type & DR_QTDIR))) {
-	dr_log("Expected a directory");
-	goto fail_close_fd;
-      }
-    }
-  }
-  if (dr_unlikely(!client_apps[app].func(fd, msize, argc - dr_optind, argv + dr_optind))) {
-    goto fail_close_fd;
+    } DR_FI_RESULT;
   }
+  static struct dr_equeue equeue;
   {
-    uint8_t rbuf[DR_9P_BUF_SIZE];
-    if (dr_unlikely(!dr_9p_clunk(fd, rbuf, msize, 0))) {
+    const struct dr_result_void r = dr_equeue_init(&equeue);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_equeue_init failed", err);
       goto fail_close_fd;
-    }
+    } DR_FI_RESULT;
   }
-  result = 0;
+  static struct dr_9p_client client;
+  {
+    const struct dr_result_void r = dr_9p_client_init(&client, &equeue, fd, DR_9P_BUF_SIZE);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_9p_client_init failed", err);
+      goto fail_equeue_destroy;
+    } DR_FI_RESULT;
+  }
+  struct dr_task client_task;
+  {
+    const struct dr_result_void r = dr_task_create(&client_task, STACK_SIZE, dr_9p_client_task, &client);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_task_create failed", err);
+      goto fail_client_destroy;
+    } DR_FI_RESULT;
+  }
+  static struct client_run run;
+  run = (struct client_run) {
+    .client = &client,
+    .app = &client_apps[app],
+    .argc = argc - dr_optind,
+    .argv = argv + dr_optind,
+    .uname_buf = uname_buf,
+    .result = -1,
+  };
+  struct dr_task run_task;
+  {
+    const struct dr_result_void r = dr_task_create(&run_task, STACK_SIZE, run_func, &run);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_task_create failed", err);
+      goto fail_client_task_destroy;
+    } DR_FI_RESULT;
+  }
+  dr_schedule(true);
+  while (!run.done) {
+    struct dr_event events[16];
+    unsigned int count;
+    {
+      const struct dr_result_uint r = dr_equeue_dequeue(&equeue, events, sizeof(events));
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_equeue_dequeue failed", err);
+	goto fail_run_task_destroy;
+      } DR_ELIF_RESULT_OK(unsigned int, r, value) {
+	count = value;
+      } DR_FI_RESULT;
+    }
+    for (unsigned int i = 0; i < count; ++i) {
+      dr_9p_client_ready(&client, events, i);
+    }
+    dr_schedule(true);
+  }
+  result = run.result;
+ fail_run_task_destroy:
+  dr_task_destroy(&run_task);
+ fail_client_task_destroy:
+  dr_task_destroy(&client_task);
+ fail_client_destroy:
+  // The client closes fd
+  dr_9p_client_destroy(&client);
+  dr_equeue_destroy(&equeue);
+  goto fail;
+ fail_equeue_destroy:
+  dr_equeue_destroy(&equeue);
  fail_close_fd:
   dr_close(fd);
  fail:
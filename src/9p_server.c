@@ -5,14 +5,14 @@
 
 #include <errno.h>
 #include <inttypes.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "hash.h"
 #include "list.h"
 
-static bool debug;
-
 static char dr_nobody_name[] = {'n','o','b','o','d','y'};
 static char dr_group_name[] = {'u','s','e','r','s'};
 static char dr_user_name[] = {'d','r','e','w','r','i','c','h','a','r','d','s','o','n'};
@@ -83,6 +83,272 @@ static struct dr_dir dr_dir = {
   .entries = { &dr_file },
 };
 
+static char dr_scratch_name[] = {'s','c','r','a','t','c','h'};
+
+static struct dr_tmpfs dr_scratch;
+
+struct dr_stats {
+  struct list_head stats;
+  uint64_t messages[256];
+  struct dr_hist *restrict latency[256];
+  uint64_t bytes_in;
+  uint64_t bytes_out;
+  uint64_t fids_created;
+  uint64_t fids_destroyed;
+  uint64_t connections_accepted;
+  uint64_t connections_closed;
+  uint64_t wakeups;
+  uint64_t events;
+  // Requests are traced when -T opens a file
+  struct dr_trace trace;
+};
+
+// A 40MiB ring of the most recent requests
+#define DR_TRACE_RECORDS (1<<20)
+
+// Counters are only written by the scheduler thread that owns them and are summed when a stats file is read
+static struct list_head dr_stats_threads;
+static struct dr_stats dr_stats_main;
+static struct dr_stats *restrict dr_stats_self = &dr_stats_main;
+
+static void dr_stats_message(const uint8_t type, const int64_t latency) {
+  struct dr_stats *restrict const stats = dr_stats_self;
+  ++stats->messages[type];
+  struct dr_hist *restrict hist = stats->latency[type];
+  if (dr_unlikely(hist == NULL)) {
+    hist = (struct dr_hist *)malloc(sizeof(*hist));
+    if (dr_unlikely(hist == NULL)) {
+      return;
+    }
+    dr_hist_init(hist);
+    stats->latency[type] = hist;
+  }
+  dr_hist_record(hist, latency > 0 ? latency : 0);
+}
+
+// Most requests start with a fid, and reads and writes follow it with offset[8] count[4]
+static void dr_stats_trace(const uint32_t conn, const uint8_t *restrict const msg, const uint32_t size, const int64_t start, const int64_t end) {
+  const uint32_t header_size = sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint16_t);
+  const uint8_t type = dr_decode_uint8(msg + sizeof(uint32_t));
+  struct dr_trace_record record = {
+    .start = start,
+    .end = end,
+    .conn = conn,
+    .fid = DR_NOFID,
+    .tag = dr_decode_uint16(msg + sizeof(uint32_t) + sizeof(uint8_t)),
+    .type = type,
+  };
+  if (type != DR_TVERSION && size >= header_size + sizeof(uint32_t)) {
+    record.fid = dr_decode_uint32(msg + header_size);
+  }
+  if ((type == DR_TREAD || type == DR_TWRITE || type == DR_TREADDIR) && size >= header_size + sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint32_t)) {
+    record.offset = dr_decode_uint64(msg + header_size + sizeof(uint32_t));
+    record.count = dr_decode_uint32(msg + header_size + sizeof(uint32_t) + sizeof(uint64_t));
+  }
+  dr_trace_write(&dr_stats_self->trace, &record);
+}
+
+WARN_UNUSED_RESULT static uint64_t dr_stats_sum(const size_t offset) {
+  uint64_t sum = 0;
+  const struct dr_stats *restrict stats;
+  list_for_each_entry(stats, &dr_stats_threads, struct dr_stats, stats) {
+    sum += *(const uint64_t *)((const char *)stats + offset);
+  }
+  return sum;
+}
+
+#define DR_STATS_SUM(FIELD) dr_stats_sum(offsetof(struct dr_stats, FIELD))
+
+static void dr_stats_printf(char *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const char *restrict const format, ...) {
+  if (*pos >= size) {
+    return;
+  }
+  va_list ap;
+  va_start(ap, format);
+  const int written = vsnprintf(buf + *pos, size - *pos, format, ap);
+  va_end(ap);
+  if (written > 0) {
+    *pos = (uint32_t)written < size - *pos ? *pos + written : size;
+  }
+}
+
+static void dr_stats_printf_type(char *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint_fast32_t type) {
+  const char *restrict const name = dr_9p_name(type);
+  if (name != NULL) {
+    dr_stats_printf(buf, size, pos, "%s", name);
+  } else {
+    dr_stats_printf(buf, size, pos, "%" PRIuFAST32, type);
+  }
+}
+
+WARN_UNUSED_RESULT static uint32_t dr_stats_format_messages(char *restrict const buf, const uint32_t size) {
+  uint32_t pos = 0;
+  for (uint_fast32_t type = 0; type < 256; ++type) {
+    const uint64_t count = dr_stats_sum(offsetof(struct dr_stats, messages) + type*sizeof(uint64_t));
+    if (count == 0) {
+      continue;
+    }
+    dr_stats_printf_type(buf, size, &pos, type);
+    dr_stats_printf(buf, size, &pos, " %" PRIu64 "\n", count);
+  }
+  return pos;
+}
+
+WARN_UNUSED_RESULT static uint32_t dr_stats_format_latency(char *restrict const buf, const uint32_t size) {
+  uint32_t pos = 0;
+  dr_stats_printf(buf, size, &pos, "type count p50 p90 p99 p999 max\n");
+  for (uint_fast32_t type = 0; type < 256; ++type) {
+    struct dr_hist hist;
+    dr_hist_init(&hist);
+    const struct dr_stats *restrict stats;
+    list_for_each_entry(stats, &dr_stats_threads, struct dr_stats, stats) {
+      if (stats->latency[type] != NULL) {
+	dr_hist_merge(&hist, stats->latency[type]);
+      }
+    }
+    if (hist.count == 0) {
+      continue;
+    }
+    dr_stats_printf_type(buf, size, &pos, type);
+    dr_stats_printf(buf, size, &pos, " %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 "\n", hist.count, dr_hist_percentile(&hist, 500), dr_hist_percentile(&hist, 900), dr_hist_percentile(&hist, 990), dr_hist_percentile(&hist, 999), hist.max);
+  }
+  return pos;
+}
+
+WARN_UNUSED_RESULT static uint32_t dr_stats_format_bytes(char *restrict const buf, const uint32_t size) {
+  uint32_t pos = 0;
+  dr_stats_printf(buf, size, &pos, "in %" PRIu64 "\nout %" PRIu64 "\n", DR_STATS_SUM(bytes_in), DR_STATS_SUM(bytes_out));
+  return pos;
+}
+
+WARN_UNUSED_RESULT static uint32_t dr_stats_format_fids(char *restrict const buf, const uint32_t size) {
+  uint32_t pos = 0;
+  dr_stats_printf(buf, size, &pos, "%" PRIu64 "\n", DR_STATS_SUM(fids_created) - DR_STATS_SUM(fids_destroyed));
+  return pos;
+}
+
+WARN_UNUSED_RESULT static uint32_t dr_stats_format_connections(char *restrict const buf, const uint32_t size) {
+  uint32_t pos = 0;
+  const uint64_t accepted = DR_STATS_SUM(connections_accepted);
+  dr_stats_printf(buf, size, &pos, "current %" PRIu64 "\ntotal %" PRIu64 "\n", accepted - DR_STATS_SUM(connections_closed), accepted);
+  return pos;
+}
+
+WARN_UNUSED_RESULT static uint32_t dr_stats_format_runqueue(char *restrict const buf, const uint32_t size) {
+  uint32_t pos = 0;
+  dr_stats_printf(buf, size, &pos, "%u\n", dr_task_runnable_count());
+  return pos;
+}
+
+WARN_UNUSED_RESULT static uint32_t dr_stats_format_scratch(char *restrict const buf, const uint32_t size) {
+  uint32_t pos = 0;
+  dr_stats_printf(buf, size, &pos, "used %" PRIu64 "\ncap %" PRIu64 "\nnodes %" PRIu64 "\n", dr_scratch.used, dr_scratch.cap, dr_scratch.nodes);
+  return pos;
+}
+
+WARN_UNUSED_RESULT static uint32_t dr_stats_format_wakeups(char *restrict const buf, const uint32_t size) {
+  uint32_t pos = 0;
+  dr_stats_printf(buf, size, &pos, "wakeups %" PRIu64 "\nevents %" PRIu64 "\n", DR_STATS_SUM(wakeups), DR_STATS_SUM(events));
+  return pos;
+}
+
+WARN_UNUSED_RESULT static uint32_t dr_stats_format_log(char *restrict const buf, const uint32_t size) {
+  uint32_t pos = 0;
+  dr_stats_printf(buf, size, &pos, "dropped %" PRIu64 "\n", dr_log_dropped());
+  return pos;
+}
+
+struct dr_stats_file {
+  struct dr_file file;
+  uint32_t (*format)(char *restrict const buf, const uint32_t size);
+};
+
+#define DR_STATS_BUF_SIZE (1<<13)
+
+WARN_UNUSED_RESULT static struct dr_result_uint32 dr_stats_read(const struct dr_fd *restrict const fd, const uint64_t offset, const uint32_t count, void *restrict const buf) {
+  const struct dr_stats_file *restrict const sf = container_of_const(fd->file, const struct dr_stats_file, file);
+  // Regenerated on every read like /proc, so a reader that needs several reads may see values from different moments
+  char text[DR_STATS_BUF_SIZE];
+  const uint32_t len = sf->format(text, sizeof(text));
+  if (offset >= len) {
+    return DR_RESULT_OK(uint32, 0);
+  }
+  const uint32_t bytes = offset + count <= len ? count : len - offset;
+  memcpy(buf, text + offset, bytes);
+  return DR_RESULT_OK(uint32, bytes);
+}
+
+static struct dr_file_vtbl dr_stats_vtbl = {
+  .read = dr_stats_read,
+};
+
+#define DR_STATS_FILE(NAME, FORMAT) { \
+    .file = { \
+      .vers = 0, \
+      .mode = 0444, \
+      .atime = DR_TIME, \
+      .mtime = DR_TIME, \
+      .length = 0, \
+      .name.len = sizeof(NAME) - 1, \
+      .name.buf = NAME, \
+      .uid = &dr_user, \
+      .gid = &dr_group, \
+      .muid = &dr_user, \
+      .vtbl = &dr_stats_vtbl, \
+    }, \
+    .format = FORMAT, \
+  }
+
+static char dr_stats_name[] = "stats";
+static char dr_stats_messages_name[] = "messages";
+static char dr_stats_latency_name[] = "latency";
+static char dr_stats_bytes_name[] = "bytes";
+static char dr_stats_fids_name[] = "fids";
+static char dr_stats_connections_name[] = "connections";
+static char dr_stats_runqueue_name[] = "runqueue";
+static char dr_stats_wakeups_name[] = "wakeups";
+static char dr_stats_scratch_name[] = "scratch";
+static char dr_stats_log_name[] = "log";
+
+static struct dr_stats_file dr_stats_messages = DR_STATS_FILE(dr_stats_messages_name, dr_stats_format_messages);
+static struct dr_stats_file dr_stats_latency = DR_STATS_FILE(dr_stats_latency_name, dr_stats_format_latency);
+static struct dr_stats_file dr_stats_bytes = DR_STATS_FILE(dr_stats_bytes_name, dr_stats_format_bytes);
+static struct dr_stats_file dr_stats_fids = DR_STATS_FILE(dr_stats_fids_name, dr_stats_format_fids);
+static struct dr_stats_file dr_stats_connections = DR_STATS_FILE(dr_stats_connections_name, dr_stats_format_connections);
+static struct dr_stats_file dr_stats_runqueue = DR_STATS_FILE(dr_stats_runqueue_name, dr_stats_format_runqueue);
+static struct dr_stats_file dr_stats_wakeups = DR_STATS_FILE(dr_stats_wakeups_name, dr_stats_format_wakeups);
+static struct dr_stats_file dr_stats_scratch = DR_STATS_FILE(dr_stats_scratch_name, dr_stats_format_scratch);
+static struct dr_stats_file dr_stats_log = DR_STATS_FILE(dr_stats_log_name, dr_stats_format_log);
+
+static struct dr_dir dr_stats_dir = {
+  .file = {
+    .vers = 0,
+    .mode = DR_DIR | 0555,
+    .atime = DR_TIME,
+    .mtime = DR_TIME,
+    .length = 0,
+    .name.len = sizeof(dr_stats_name) - 1,
+    .name.buf = dr_stats_name,
+    .uid = &dr_user,
+    .gid = &dr_group,
+    .muid = &dr_user,
+    .vtbl = &dr_dir_vtbl,
+  },
+  .parent = &dr_root,
+  .entry_count = 9,
+  .entries = {
+    &dr_stats_messages.file,
+    &dr_stats_latency.file,
+    &dr_stats_bytes.file,
+    &dr_stats_fids.file,
+    &dr_stats_connections.file,
+    &dr_stats_runqueue.file,
+    &dr_stats_wakeups.file,
+    &dr_stats_scratch.file,
+    &dr_stats_log.file,
+  },
+};
+
 static struct dr_dir dr_root = {
   .file = {
     .vers = 0,
@@ -98,12 +364,12 @@ static struct dr_dir dr_root = {
     .vtbl = &dr_dir_vtbl,
   },
   .parent = &dr_root,
-  .entry_count = 1,
-  .entries = { &dr_dir.file },
+  .entry_count = 3,
+  .entries = { &dr_dir.file, &dr_stats_dir.file, &dr_scratch.root.file },
 };
 
 struct dr_fid {
-  struct list_head fids;
+  struct hash_node hash;
   struct dr_user *restrict user;
   union {
     struct dr_file *restrict file;
@@ -117,8 +383,8 @@ static const char HELLO_WORLD[] = { 'H', 'e', 'l', 'l', 'o', ' ', 'w', 'o', 'r',
 
 struct dr_result_uint32 file_read(const struct dr_fd *restrict const fd, const uint64_t offset, const uint32_t count, void *restrict const buf) {
   (void)fd;
-  if (dr_unlikely(offset > sizeof(HELLO_WORLD))) {
-    return DR_RESULT_ERRNUM(uint32, DR_ERR_ISO_C, EINVAL);
+  if (offset >= sizeof(HELLO_WORLD)) {
+    return DR_RESULT_OK(uint32, 0);
   }
   const uint32_t bytes = offset + count <= sizeof(HELLO_WORLD) ? count : sizeof(HELLO_WORLD) - offset;
   memcpy(buf, HELLO_WORLD + offset, bytes);
@@ -132,17 +398,21 @@ struct dr_result_uint32 file_write(const struct dr_fd *restrict const fd, const
   return DR_RESULT_OK(uint32, count);
 }
 
-WARN_UNUSED_RESULT static struct dr_fid *dr_fid_get(const struct list_head *restrict const fids, const uint32_t fid) {
-  struct dr_fid *restrict f;
-  list_for_each_entry(f, fids, struct dr_fid, fids) {
-    if (f->id == fid) {
-      return f;
-    }
+static bool dr_fid_eq(const struct hash_node *restrict const node, const void *restrict const key) {
+  const struct dr_fid *restrict const f = container_of_const(node, const struct dr_fid, hash);
+  return f->id == *(const uint32_t *)key;
+}
+
+// Clients may hold many fids, so they are hashed rather than scanned on every request
+WARN_UNUSED_RESULT static struct dr_fid *dr_fid_get(const struct hash_table *restrict const fids, const uint32_t fid) {
+  struct hash_node *restrict const node = hash_find(fids, hash_uint32(fid), dr_fid_eq, &fid);
+  if (node == NULL) {
+    return NULL;
   }
-  return NULL;
+  return hash_entry(node, struct dr_fid, hash);
 }
 
-WARN_UNUSED_RESULT static struct dr_fid *dr_fid_init(struct list_head *restrict const fids, struct dr_user *restrict const user, struct dr_file *restrict const file, const uint32_t id) {
+WARN_UNUSED_RESULT static struct dr_fid *dr_fid_init(struct hash_table *restrict const fids, struct dr_user *restrict const user, struct dr_file *restrict const file, const uint32_t id) {
   struct dr_fid *restrict const f = (struct dr_fid *)malloc(sizeof(*f));
   if (dr_unlikely(f == NULL)) {
     return NULL;
@@ -153,21 +423,55 @@ WARN_UNUSED_RESULT static struct dr_fid *dr_fid_init(struct list_head *restrict
     .id = id,
     .open = false,
   };
-  list_add(&f->fids, fids);
+  if (dr_unlikely(!hash_insert(fids, &f->hash, hash_uint32(id)))) {
+    free(f);
+    return NULL;
+  }
+  dr_vfs_ref(file);
+  ++dr_stats_self->fids_created;
   return f;
 }
 
-static void dr_fid_destroy(struct dr_fid *restrict const f) {
-  list_del(&f->fids);
+static void dr_fid_destroy(struct hash_table *restrict const fids, struct dr_fid *restrict const f) {
+  hash_remove(fids, &f->hash);
+  ++dr_stats_self->fids_destroyed;
+  struct dr_file *restrict const file = f->open ? f->u.fd->file : f->u.file;
   if (f->open) {
     dr_vfs_close(f->u.fd);
   }
+  dr_vfs_unref(file);
   free(f);
 }
 
 #define DR_9P_BUF_SIZE (1<<13)
 
-static bool dr_handle_request(struct list_head *restrict const fids, const uint8_t *restrict const tbuf, const uint32_t tsize, uint8_t *restrict const rbuf, const uint32_t rsize, uint32_t *restrict const rpos) {
+struct dr_session {
+  struct hash_table fids;
+  // Fid to read ahead on once the current reply is sent
+  uint32_t prefetch;
+  bool dotl;
+};
+
+static void dr_session_reset(struct dr_session *restrict const s) {
+  uint32_t i = 0;
+  struct hash_node *restrict node;
+  while ((node = hash_next_remaining(&s->fids, &i)) != NULL) {
+    dr_fid_destroy(&s->fids, hash_entry(node, struct dr_fid, hash));
+  }
+  s->prefetch = DR_NOFID;
+  s->dotl = false;
+}
+
+static void dr_encode_error(const struct dr_session *restrict const s, uint8_t *restrict const rbuf, const uint32_t rsize, uint32_t *restrict const rpos, const uint16_t tag, const struct dr_error *restrict const err) {
+  if (s->dotl) {
+    dr_9p_encode_Rlerror_err(rbuf, rsize, rpos, tag, err);
+  } else {
+    dr_9p_encode_Rerror_err(rbuf, rsize, rpos, tag, err);
+  }
+}
+
+// tbuf is one of the frames accepted by dr_9p_decode_frames
+static bool dr_handle_request(struct dr_session *restrict const s, const uint8_t *restrict const tbuf, const uint32_t tsize, uint8_t *restrict const rbuf, const uint32_t rsize, uint32_t *restrict const rpos) {
   uint32_t tpos;
   uint8_t type;
   uint16_t tag;
@@ -179,22 +483,33 @@ static bool dr_handle_request(struct list_head *restrict const fids, const uint8
   case DR_TVERSION: {
     uint32_t msize;
     struct dr_str version;
-    if (dr_unlikely(!dr_9p_decode_Tversion(&msize, &version, tbuf, tsize, &tpos))) {
-      dr_log("dr_9p_decode_Tversion failed");
-      return false;
-    }
-    if (debug) {
-      printf("Tversion %" PRIu16 " %" PRIu32 " '%.*s'\n", tag, msize, version.len, version.buf);
-    }
+    dr_9p_decode_valid_Tversion(&msize, &version, tbuf, tsize, &tpos);
+    dr_logf(DR_LOG_DEBUG, "Tversion %" PRIu16 " %" PRIu32 " '%.*s'", tag, msize, version.len, version.buf);
     if (msize > DR_9P_BUF_SIZE) {
       msize = DR_9P_BUF_SIZE;
     }
+    // Tversion aborts all outstanding I/O and clunks all fids
+    dr_session_reset(s);
     // DR Set and use msize instead of sizeof(rbuf)
-    char version_9p2000[] = {'9','P','2','0','0','0'};
-    const struct dr_str rversion = {
-      .len = sizeof(version_9p2000),
-      .buf = version_9p2000,
+    static char version_9p2000_l[] = {'9','P','2','0','0','0','.','L'};
+    static char version_9p2000[] = {'9','P','2','0','0','0'};
+    static char version_unknown[] = {'u','n','k','n','o','w','n'};
+    struct dr_str rversion = {
+      .len = sizeof(version_unknown),
+      .buf = version_unknown,
     };
+    if (version.len >= sizeof(version_9p2000_l) && memcmp(version.buf, version_9p2000_l, sizeof(version_9p2000_l)) == 0) {
+      s->dotl = true;
+      rversion = (struct dr_str) {
+	.len = sizeof(version_9p2000_l),
+	.buf = version_9p2000_l,
+      };
+    } else if (version.len >= sizeof(version_9p2000) && memcmp(version.buf, version_9p2000, sizeof(version_9p2000)) == 0) {
+      rversion = (struct dr_str) {
+	.len = sizeof(version_9p2000),
+	.buf = version_9p2000,
+      };
+    }
     if (dr_unlikely(!dr_9p_encode_Rversion(rbuf, rsize, rpos, tag, msize, &rversion))) {
       dr_log("dr_9p_encode_Rversion failed");
       return false;
@@ -205,12 +520,21 @@ static bool dr_handle_request(struct list_head *restrict const fids, const uint8
     uint32_t afid;
     struct dr_str uname;
     struct dr_str aname;
-    if (dr_unlikely(!dr_9p_decode_Tauth(&afid, &uname, &aname, tbuf, tsize, &tpos))) {
+    uint32_t n_uname = DR_NONUNAME;
+    // Like Tattach, only the checked decoders can tell which layout was sent
+    if (s->dotl) {
+      if (dr_unlikely(!dr_9p_decode_Tauth_dotl(&afid, &uname, &aname, &n_uname, tbuf, tsize, &tpos))) {
+	dr_log("dr_9p_decode_Tauth_dotl failed");
+	return false;
+      }
+    } else if (dr_unlikely(!dr_9p_decode_Tauth(&afid, &uname, &aname, tbuf, tsize, &tpos))) {
       dr_log("dr_9p_decode_Tauth failed");
       return false;
     }
-    if (debug) {
-      printf("Tauth %" PRIu16 " %" PRIu32 " '%.*s' '%.*s'\n", tag, afid, uname.len, uname.buf, aname.len, aname.buf);
+    dr_logf(DR_LOG_DEBUG, "Tauth %" PRIu16 " %" PRIu32 " '%.*s' '%.*s' %" PRIu32, tag, afid, uname.len, uname.buf, aname.len, aname.buf, n_uname);
+    if (s->dotl) {
+      dr_9p_encode_Rlerror(rbuf, rsize, rpos, tag, EOPNOTSUPP);
+      return true;
     }
     struct dr_str ename = {
       .len = 0,
@@ -224,22 +548,27 @@ static bool dr_handle_request(struct list_head *restrict const fids, const uint8
     uint32_t afid;
     struct dr_str uname;
     struct dr_str aname;
-    if (dr_unlikely(!dr_9p_decode_Tattach(&fid, &afid, &uname, &aname, tbuf, tsize, &tpos))) {
+    uint32_t n_uname = DR_NONUNAME;
+    // Frames were checked against both layouts, so only these decoders can tell whether it is the negotiated one
+    if (s->dotl) {
+      if (dr_unlikely(!dr_9p_decode_Tattach_dotl(&fid, &afid, &uname, &aname, &n_uname, tbuf, tsize, &tpos))) {
+	dr_log("dr_9p_decode_Tattach_dotl failed");
+	return false;
+      }
+    } else if (dr_unlikely(!dr_9p_decode_Tattach(&fid, &afid, &uname, &aname, tbuf, tsize, &tpos))) {
       dr_log("dr_9p_decode_Tattach failed");
       return false;
     }
-    if (debug) {
-      printf("Tattach %" PRIu16 " %" PRIu32 " %" PRIu32 " '%.*s' '%.*s'\n", tag, fid, afid, uname.len, uname.buf, aname.len, aname.buf);
-    }
+    dr_logf(DR_LOG_DEBUG, "Tattach %" PRIu16 " %" PRIu32 " %" PRIu32 " '%.*s' '%.*s' %" PRIu32, tag, fid, afid, uname.len, uname.buf, aname.len, aname.buf, n_uname);
     if (dr_unlikely(afid != DR_NOFID)) {
       dr_log("Afid is invalid");
       return false;
     }
-    if (dr_unlikely(dr_fid_get(fids, fid) != NULL)) {
+    if (dr_unlikely(dr_fid_get(&s->fids, fid) != NULL)) {
       dr_log("Fid already in use");
       return false;
     }
-    const struct dr_fid *restrict const f = dr_fid_init(fids, dr_str_eq(&uname, &dr_user.name) ? &dr_user : &dr_nobody, &dr_root.file, fid);
+    const struct dr_fid *restrict const f = dr_fid_init(&s->fids, dr_str_eq(&uname, &dr_user.name) ? &dr_user : &dr_nobody, &dr_root.file, fid);
     if (dr_unlikely(f == NULL)) {
       dr_log("dr_fid_init failed");
       return false;
@@ -258,20 +587,18 @@ static bool dr_handle_request(struct list_head *restrict const fids, const uint8
       dr_log("dr_9p_decode_Twalk_iterator failed");
       return false;
     }
-    if (debug) {
-      printf("Twalk %" PRIu16 " %" PRIu32 " %" PRIu32 " %" PRIu16, tag, fid, newfid, nwname);
-    }
+    dr_logf(DR_LOG_DEBUG, "Twalk %" PRIu16 " %" PRIu32 " %" PRIu32 " %" PRIu16, tag, fid, newfid, nwname);
     uint16_t nwqid;
     if (dr_unlikely(!dr_9p_encode_Rwalk_iterator(rbuf, rsize, rpos, tag, &nwqid))) {
       dr_log("dr_9p_encode_Rwalk_iterator failed");
       return false;
     }
-    struct dr_fid *restrict const fidp = dr_fid_get(fids, fid);
+    struct dr_fid *restrict const fidp = dr_fid_get(&s->fids, fid);
     if (dr_unlikely(fidp == NULL)) {
       dr_log("Unable to find fid");
       return false;
     }
-    if (dr_unlikely(newfid != fid && dr_fid_get(fids, newfid) != NULL)) {
+    if (dr_unlikely(newfid != fid && dr_fid_get(&s->fids, newfid) != NULL)) {
       dr_log("Newfid already in use");
       return false;
     }
@@ -282,9 +609,7 @@ static bool dr_handle_request(struct list_head *restrict const fids, const uint8
 	dr_log("dr_9p_decode_Twalk_advance failed");
 	return false;
       }
-      if (debug) {
-	printf(" '%.*s'", wname.len, wname.buf);
-      }
+      dr_logf(DR_LOG_DEBUG, "Twalk %" PRIu16 " '%.*s'", tag, wname.len, wname.buf);
       {
 	const struct dr_result_file r = dr_vfs_walk(fidp->user, f, &wname);
 	DR_IF_RESULT_ERR(r, err) {
@@ -292,7 +617,7 @@ static bool dr_handle_request(struct list_head *restrict const fids, const uint8
 	  if (i > 0) {
 	    break;
 	  }
-	  dr_9p_encode_Rerror_err(rbuf, rsize, rpos, tag, err);
+	  dr_encode_error(s, rbuf, rsize, rpos, tag, err);
 	  return true;
 	} DR_ELIF_RESULT_OK(struct dr_file *restrict, r, value) {
 	  f = value;
@@ -303,13 +628,12 @@ static bool dr_handle_request(struct list_head *restrict const fids, const uint8
 	return false;
       }
     }
-    if (debug) {
-      printf("\n");
-    }
     if (nwname == nwqid) {
       if (fid == newfid) {
+	dr_vfs_ref(f);
+	dr_vfs_unref(fidp->u.file);
 	fidp->u.file = f;
-      } else if (dr_unlikely(dr_fid_init(fids, fidp->user, f, newfid) == NULL)) {
+      } else if (dr_unlikely(dr_fid_init(&s->fids, fidp->user, f, newfid) == NULL)) {
 	dr_log("dr_fid_init failed");
 	return false;
       }
@@ -327,14 +651,9 @@ static bool dr_handle_request(struct list_head *restrict const fids, const uint8
   case DR_TOPEN: {
     uint32_t fid;
     uint8_t mode;
-    if (dr_unlikely(!dr_9p_decode_Topen(&fid, &mode, tbuf, tsize, &tpos))) {
-      dr_log("dr_9p_decode_Topen failed");
-      return false;
-    }
-    if (debug) {
-      printf("Topen %" PRIu16 " %" PRIu32 " %" PRIu8 "\n", tag, fid, mode);
-    }
-    struct dr_fid *restrict const fidp = dr_fid_get(fids, fid);
+    dr_9p_decode_valid_Topen(&fid, &mode, tbuf, tsize, &tpos);
+    dr_logf(DR_LOG_DEBUG, "Topen %" PRIu16 " %" PRIu32 " %" PRIu8, tag, fid, mode);
+    struct dr_fid *restrict const fidp = dr_fid_get(&s->fids, fid);
     if (dr_unlikely(fidp == NULL)) {
       dr_log("Unable to find fid");
       return false;
@@ -348,7 +667,7 @@ static bool dr_handle_request(struct list_head *restrict const fids, const uint8
       const struct dr_result_fd r = dr_vfs_open(fidp->user, fidp->u.file, mode);
       DR_IF_RESULT_ERR(r, err) {
 	dr_log_error("dr_vfs_open failed", err);
-	dr_9p_encode_Rerror_err(rbuf, rsize, rpos, tag, err);
+	dr_encode_error(s, rbuf, rsize, rpos, tag, err);
 	return true;
       } DR_ELIF_RESULT_OK(struct dr_fd *restrict, r, value) {
 	fd = value;
@@ -367,32 +686,46 @@ static bool dr_handle_request(struct list_head *restrict const fids, const uint8
     struct dr_str name;
     uint32_t perm;
     uint8_t mode;
-    if (dr_unlikely(!dr_9p_decode_Tcreate(&fid, &name, &perm, &mode, tbuf, tsize, &tpos))) {
-      dr_log("dr_9p_decode_Tcreate failed");
+    dr_9p_decode_valid_Tcreate(&fid, &name, &perm, &mode, tbuf, tsize, &tpos);
+    dr_logf(DR_LOG_DEBUG, "Tcreate %" PRIu16 " %" PRIu32 " '%.*s' %" PRIu32 " %" PRIu8, tag, fid, name.len, name.buf, perm, mode);
+    struct dr_fid *restrict const fidp = dr_fid_get(&s->fids, fid);
+    if (dr_unlikely(fidp == NULL)) {
+      dr_log("Unable to find fid");
       return false;
     }
-    if (debug) {
-      printf("Tcreate %" PRIu16 " %" PRIu32 " '%.*s' %" PRIu32 " %" PRIu8 "\n", tag, fid, name.len, name.buf, perm, mode);
+    if (dr_unlikely(fidp->open)) {
+      dr_log("Fid is open");
+      return false;
+    }
+    struct dr_fd *restrict fd;
+    {
+      const struct dr_result_fd r = dr_vfs_create(fidp->user, fidp->u.file, &name, perm, mode);
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_vfs_create failed", err);
+	dr_encode_error(s, rbuf, rsize, rpos, tag, err);
+	return true;
+      } DR_ELIF_RESULT_OK(struct dr_fd *restrict, r, value) {
+	fd = value;
+      } DR_FI_RESULT;
+    }
+    // The fid now represents the new file
+    dr_vfs_ref(fd->file);
+    dr_vfs_unref(fidp->u.file);
+    fidp->open = true;
+    fidp->u.fd = fd;
+    if (dr_unlikely(!dr_9p_encode_Rcreate(rbuf, rsize, rpos, tag, fd->file, 0))) {
+      dr_log("dr_9p_encode_Rcreate failed");
+      return false;
     }
-    const struct dr_error err = {
-      .domain = DR_ERR_ISO_C,
-      .num = EACCES,
-    };
-    dr_9p_encode_Rerror_err(rbuf, rsize, rpos, tag, &err);
     return true;
   }
   case DR_TREAD: {
     uint32_t fid;
     uint64_t offset;
     uint32_t count;
-    if (dr_unlikely(!dr_9p_decode_Tread(&fid, &offset, &count, tbuf, tsize, &tpos))) {
-      dr_log("dr_9p_decode_Tread failed");
-      return false;
-    }
-    if (debug) {
-      printf("Tread %" PRIu16 " %" PRIu32 " %" PRIu64 " %" PRIu32 "\n", tag, fid, offset, count);
-    }
-    struct dr_fid *restrict const fidp = dr_fid_get(fids, fid);
+    dr_9p_decode_valid_Tread(&fid, &offset, &count, tbuf, tsize, &tpos);
+    dr_logf(DR_LOG_DEBUG, "Tread %" PRIu16 " %" PRIu32 " %" PRIu64 " %" PRIu32, tag, fid, offset, count);
+    struct dr_fid *restrict const fidp = dr_fid_get(&s->fids, fid);
     if (dr_unlikely(fidp == NULL)) {
       dr_log("Unable to find fid");
       return false;
@@ -414,7 +747,7 @@ static bool dr_handle_request(struct list_head *restrict const fids, const uint8
       const struct dr_result_uint32 r = dr_vfs_read(fidp->u.fd, offset, count, rbuf + *rpos);
       DR_IF_RESULT_ERR(r, err) {
 	dr_log_error("dr_vfs_read failed", err);
-	dr_9p_encode_Rerror_err(rbuf, rsize, rpos, tag, err);
+	dr_encode_error(s, rbuf, rsize, rpos, tag, err);
 	return true;
       } DR_ELIF_RESULT_OK(uint32_t, r, value) {
 	bytes_read = value;
@@ -425,6 +758,7 @@ static bool dr_handle_request(struct list_head *restrict const fids, const uint8
       dr_log("dr_9p_decode_Rread_finish failed");
       return false;
     }
+    s->prefetch = fid;
     return true;
   }
   case DR_TWRITE: {
@@ -436,10 +770,8 @@ static bool dr_handle_request(struct list_head *restrict const fids, const uint8
       dr_log("dr_9p_decode_Twrite failed");
       return false;
     }
-    if (debug) {
-      printf("Twrite %" PRIu16 " %" PRIu32 " %" PRIu64 " %" PRIu32 "\n", tag, fid, offset, count);
-    }
-    struct dr_fid *restrict const fidp = dr_fid_get(fids, fid);
+    dr_logf(DR_LOG_DEBUG, "Twrite %" PRIu16 " %" PRIu32 " %" PRIu64 " %" PRIu32, tag, fid, offset, count);
+    struct dr_fid *restrict const fidp = dr_fid_get(&s->fids, fid);
     if (dr_unlikely(fidp == NULL)) {
       dr_log("Unable to find fid");
       return false;
@@ -453,7 +785,7 @@ static bool dr_handle_request(struct list_head *restrict const fids, const uint8
       const struct dr_result_uint32 r = dr_vfs_write(fidp->u.fd, offset, count, data);
       DR_IF_RESULT_ERR(r, err) {
 	dr_log_error("dr_vfs_write failed", err);
-	dr_9p_encode_Rerror_err(rbuf, rsize, rpos, tag, err);
+	dr_encode_error(s, rbuf, rsize, rpos, tag, err);
 	return true;
       } DR_ELIF_RESULT_OK(uint32_t, r, value) {
 	bytes_written = value;
@@ -467,19 +799,24 @@ static bool dr_handle_request(struct list_head *restrict const fids, const uint8
   }
   case DR_TCLUNK: {
     uint32_t fid;
-    if (dr_unlikely(!dr_9p_decode_Tclunk(&fid, tbuf, tsize, &tpos))) {
-      dr_log("dr_9p_decode_Tclunk failed");
-      return false;
-    }
-    if (debug) {
-      printf("Tclunk %" PRIu16 " %" PRIu32 "\n", tag, fid);
-    }
-    struct dr_fid *restrict const f = dr_fid_get(fids, fid);
+    dr_9p_decode_valid_Tclunk(&fid, tbuf, tsize, &tpos);
+    dr_logf(DR_LOG_DEBUG, "Tclunk %" PRIu16 " %" PRIu32, tag, fid);
+    struct dr_fid *restrict const f = dr_fid_get(&s->fids, fid);
     if (dr_unlikely(f == NULL)) {
       dr_log("dr_fid_get failed");
       return false;
     }
-    dr_fid_destroy(f);
+    if (f->open) {
+      // The fid is clunked even if the buffered writes fail
+      const struct dr_result_void r = dr_vfs_flush(f->u.fd);
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_vfs_flush failed", err);
+	dr_fid_destroy(&s->fids, f);
+	dr_encode_error(s, rbuf, rsize, rpos, tag, err);
+	return true;
+      } DR_FI_RESULT;
+    }
+    dr_fid_destroy(&s->fids, f);
     if (dr_unlikely(!dr_9p_encode_Rclunk(rbuf, rsize, rpos, tag))) {
       dr_log("dr_9p_encode_Rclunk failed");
       return false;
@@ -488,36 +825,32 @@ static bool dr_handle_request(struct list_head *restrict const fids, const uint8
   }
   case DR_TREMOVE: {
     uint32_t fid;
-    if (dr_unlikely(!dr_9p_decode_Tremove(&fid, tbuf, tsize, &tpos))) {
-      dr_log("dr_9p_decode_Tremove failed");
-      return false;
-    }
-    if (debug) {
-      printf("Tremove %" PRIu16 " %" PRIu32 "\n", tag, fid);
-    }
-    struct dr_fid *restrict const f = dr_fid_get(fids, fid);
+    dr_9p_decode_valid_Tremove(&fid, tbuf, tsize, &tpos);
+    dr_logf(DR_LOG_DEBUG, "Tremove %" PRIu16 " %" PRIu32, tag, fid);
+    struct dr_fid *restrict const f = dr_fid_get(&s->fids, fid);
     if (dr_unlikely(f == NULL)) {
       dr_log("dr_fid_get failed");
       return false;
     }
-    dr_fid_destroy(f);
-    const struct dr_error err = {
-      .domain = DR_ERR_ISO_C,
-      .num = EACCES,
-    };
-    dr_9p_encode_Rerror_err(rbuf, rsize, rpos, tag, &err);
+    const struct dr_result_void r = dr_vfs_remove(f->user, f->open ? f->u.fd->file : f->u.file);
+    // The fid is clunked even if the remove fails
+    dr_fid_destroy(&s->fids, f);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_vfs_remove failed", err);
+      dr_encode_error(s, rbuf, rsize, rpos, tag, err);
+      return true;
+    } DR_FI_RESULT;
+    if (dr_unlikely(!dr_9p_encode_Rremove(rbuf, rsize, rpos, tag))) {
+      dr_log("dr_9p_encode_Rremove failed");
+      return false;
+    }
     return true;
   }
   case DR_TSTAT: {
     uint32_t fid;
-    if (dr_unlikely(!dr_9p_decode_Tstat(&fid, tbuf, tsize, &tpos))) {
-      dr_log("dr_9p_decode_Tstat failed");
-      return false;
-    }
-    if (debug) {
-      printf("Tstat %" PRIu16 " %" PRIu32 "\n", tag, fid);
-    }
-    struct dr_fid *restrict const fidp = dr_fid_get(fids, fid);
+    dr_9p_decode_valid_Tstat(&fid, tbuf, tsize, &tpos);
+    dr_logf(DR_LOG_DEBUG, "Tstat %" PRIu16 " %" PRIu32, tag, fid);
+    struct dr_fid *restrict const fidp = dr_fid_get(&s->fids, fid);
     if (dr_unlikely(fidp == NULL)) {
       dr_log("dr_fid_get failed");
       return false;
@@ -535,23 +868,320 @@ static bool dr_handle_request(struct list_head *restrict const fids, const uint8
       dr_log("dr_9p_decode_Twstat failed");
       return false;
     }
-    if (debug) {
-      printf("Twstat %" PRIu16 " %" PRIu32 " %" PRIu16 " %" PRIu32 " %" PRIu8 " %" PRIu32 " %" PRIu64 " %" PRIu32 " %" PRIu32 " %" PRIu32 " %" PRIu64 " '%.*s' '%.*s' '%.*s' '%.*s'\n", tag, fid, stat.type, stat.dev, stat.qid.type, stat.qid.vers, stat.qid.path, stat.mode, stat.atime, stat.mtime, stat.length, stat.name.len, stat.name.buf, stat.uid.len, stat.uid.buf, stat.gid.len, stat.gid.buf, stat.muid.len, stat.muid.buf);
-    }
+    dr_logf(DR_LOG_DEBUG, "Twstat %" PRIu16 " %" PRIu32 " %" PRIu16 " %" PRIu32 " %" PRIu8 " %" PRIu32 " %" PRIu64 " %" PRIu32 " %" PRIu32 " %" PRIu32 " %" PRIu64 " '%.*s' '%.*s' '%.*s' '%.*s'", tag, fid, stat.type, stat.dev, stat.qid.type, stat.qid.vers, stat.qid.path, stat.mode, stat.atime, stat.mtime, stat.length, stat.name.len, stat.name.buf, stat.uid.len, stat.uid.buf, stat.gid.len, stat.gid.buf, stat.muid.len, stat.muid.buf);
     const struct dr_error err = {
       .domain = DR_ERR_ISO_C,
       .num = EACCES,
     };
-    dr_9p_encode_Rerror_err(rbuf, rsize, rpos, tag, &err);
+    dr_encode_error(s, rbuf, rsize, rpos, tag, &err);
+    return true;
+  }
+  case DR_TSTATFS: {
+    if (dr_unlikely(!s->dotl)) {
+      goto unrecognized;
+    }
+    uint32_t fid;
+    dr_9p_decode_valid_Tstatfs(&fid, tbuf, tsize, &tpos);
+    dr_logf(DR_LOG_DEBUG, "Tstatfs %" PRIu16 " %" PRIu32, tag, fid);
+    if (dr_unlikely(dr_fid_get(&s->fids, fid) == NULL)) {
+      dr_log("dr_fid_get failed");
+      return false;
+    }
+    // Only the scratch tree uses any space
+    const struct dr_9p_statfs statfs = {
+      .blocks = dr_scratch.cap/DR_TMPFS_PAGE_SIZE,
+      .bfree = (dr_scratch.cap - dr_scratch.used)/DR_TMPFS_PAGE_SIZE,
+      .bavail = (dr_scratch.cap - dr_scratch.used)/DR_TMPFS_PAGE_SIZE,
+      .files = dr_scratch.nodes,
+      .type = 0x01021997, // V9FS_MAGIC
+      .bsize = DR_TMPFS_PAGE_SIZE,
+      .namelen = UINT16_MAX,
+    };
+    if (dr_unlikely(!dr_9p_encode_Rstatfs(rbuf, rsize, rpos, tag, &statfs))) {
+      dr_log("dr_9p_encode_Rstatfs failed");
+      return false;
+    }
+    return true;
+  }
+  case DR_TLOPEN: {
+    if (dr_unlikely(!s->dotl)) {
+      goto unrecognized;
+    }
+    uint32_t fid;
+    uint32_t flags;
+    dr_9p_decode_valid_Tlopen(&fid, &flags, tbuf, tsize, &tpos);
+    dr_logf(DR_LOG_DEBUG, "Tlopen %" PRIu16 " %" PRIu32 " %" PRIu32, tag, fid, flags);
+    struct dr_fid *restrict const fidp = dr_fid_get(&s->fids, fid);
+    if (dr_unlikely(fidp == NULL)) {
+      dr_log("Unable to find fid");
+      return false;
+    }
+    if (dr_unlikely(fidp->open)) {
+      dr_log("Fid is open");
+      return false;
+    }
+    // O_RDONLY, O_WRONLY and O_RDWR have the same values as OREAD, OWRITE and ORDWR
+    const uint8_t mode = (flags & DR_L_O_ACCMODE) | ((flags & DR_L_O_TRUNC) != 0 ? DR_OTRUNC : 0);
+    struct dr_fd *restrict fd;
+    {
+      const struct dr_result_fd r = dr_vfs_open(fidp->user, fidp->u.file, mode);
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_vfs_open failed", err);
+	dr_encode_error(s, rbuf, rsize, rpos, tag, err);
+	return true;
+      } DR_ELIF_RESULT_OK(struct dr_fd *restrict, r, value) {
+	fd = value;
+      } DR_FI_RESULT;
+    }
+    fidp->open = true;
+    fidp->u.fd = fd;
+    if (dr_unlikely(!dr_9p_encode_Rlopen(rbuf, rsize, rpos, tag, fd->file, 0))) {
+      dr_log("dr_9p_encode_Rlopen failed");
+      return false;
+    }
+    return true;
+  }
+  case DR_TLCREATE: {
+    if (dr_unlikely(!s->dotl)) {
+      goto unrecognized;
+    }
+    uint32_t fid;
+    struct dr_str name;
+    uint32_t flags;
+    uint32_t mode;
+    uint32_t gid;
+    dr_9p_decode_valid_Tlcreate(&fid, &name, &flags, &mode, &gid, tbuf, tsize, &tpos);
+    dr_logf(DR_LOG_DEBUG, "Tlcreate %" PRIu16 " %" PRIu32 " '%.*s' %" PRIu32 " %" PRIu32 " %" PRIu32, tag, fid, name.len, name.buf, flags, mode, gid);
+    struct dr_fid *restrict const fidp = dr_fid_get(&s->fids, fid);
+    if (dr_unlikely(fidp == NULL)) {
+      dr_log("Unable to find fid");
+      return false;
+    }
+    if (dr_unlikely(fidp->open)) {
+      dr_log("Fid is open");
+      return false;
+    }
+    // DR Groups have no numeric ids so gid is ignored
+    struct dr_fd *restrict fd;
+    {
+      const struct dr_result_fd r = dr_vfs_create(fidp->user, fidp->u.file, &name, mode & 0777, flags & DR_L_O_ACCMODE);
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_vfs_create failed", err);
+	dr_encode_error(s, rbuf, rsize, rpos, tag, err);
+	return true;
+      } DR_ELIF_RESULT_OK(struct dr_fd *restrict, r, value) {
+	fd = value;
+      } DR_FI_RESULT;
+    }
+    // The fid now represents the new file
+    dr_vfs_ref(fd->file);
+    dr_vfs_unref(fidp->u.file);
+    fidp->open = true;
+    fidp->u.fd = fd;
+    if (dr_unlikely(!dr_9p_encode_Rlcreate(rbuf, rsize, rpos, tag, fd->file, 0))) {
+      dr_log("dr_9p_encode_Rlcreate failed");
+      return false;
+    }
+    return true;
+  }
+  case DR_TMKDIR: {
+    if (dr_unlikely(!s->dotl)) {
+      goto unrecognized;
+    }
+    uint32_t dfid;
+    struct dr_str name;
+    uint32_t mode;
+    uint32_t gid;
+    dr_9p_decode_valid_Tmkdir(&dfid, &name, &mode, &gid, tbuf, tsize, &tpos);
+    dr_logf(DR_LOG_DEBUG, "Tmkdir %" PRIu16 " %" PRIu32 " '%.*s' %" PRIu32 " %" PRIu32, tag, dfid, name.len, name.buf, mode, gid);
+    struct dr_fid *restrict const fidp = dr_fid_get(&s->fids, dfid);
+    if (dr_unlikely(fidp == NULL)) {
+      dr_log("Unable to find fid");
+      return false;
+    }
+    if (dr_unlikely(fidp->open)) {
+      dr_log("Fid is open");
+      return false;
+    }
+    struct dr_fd *restrict fd;
+    {
+      const struct dr_result_fd r = dr_vfs_create(fidp->user, fidp->u.file, &name, DR_DIR | (mode & 0777), DR_OREAD);
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_vfs_create failed", err);
+	dr_encode_error(s, rbuf, rsize, rpos, tag, err);
+	return true;
+      } DR_ELIF_RESULT_OK(struct dr_fd *restrict, r, value) {
+	fd = value;
+      } DR_FI_RESULT;
+    }
+    // The directory entry keeps the new directory alive
+    struct dr_file *restrict const f = fd->file;
+    dr_vfs_close(fd);
+    if (dr_unlikely(!dr_9p_encode_Rmkdir(rbuf, rsize, rpos, tag, f))) {
+      dr_log("dr_9p_encode_Rmkdir failed");
+      return false;
+    }
+    return true;
+  }
+  case DR_TGETATTR: {
+    if (dr_unlikely(!s->dotl)) {
+      goto unrecognized;
+    }
+    uint32_t fid;
+    uint64_t request_mask;
+    dr_9p_decode_valid_Tgetattr(&fid, &request_mask, tbuf, tsize, &tpos);
+    dr_logf(DR_LOG_DEBUG, "Tgetattr %" PRIu16 " %" PRIu32 " %" PRIx64, tag, fid, request_mask);
+    struct dr_fid *restrict const fidp = dr_fid_get(&s->fids, fid);
+    if (dr_unlikely(fidp == NULL)) {
+      dr_log("dr_fid_get failed");
+      return false;
+    }
+    if (dr_unlikely(!dr_9p_encode_Rgetattr(rbuf, rsize, rpos, tag, DR_GETATTR_BASIC, fidp->open ? fidp->u.fd->file : fidp->u.file))) {
+      dr_log("dr_9p_encode_Rgetattr failed");
+      return false;
+    }
+    return true;
+  }
+  case DR_TXATTRWALK: {
+    if (dr_unlikely(!s->dotl)) {
+      goto unrecognized;
+    }
+    uint32_t fid;
+    uint32_t newfid;
+    struct dr_str name;
+    dr_9p_decode_valid_Txattrwalk(&fid, &newfid, &name, tbuf, tsize, &tpos);
+    dr_logf(DR_LOG_DEBUG, "Txattrwalk %" PRIu16 " %" PRIu32 " %" PRIu32 " '%.*s'", tag, fid, newfid, name.len, name.buf);
+    // No extended attributes are supported
+    dr_9p_encode_Rlerror(rbuf, rsize, rpos, tag, EOPNOTSUPP);
+    return true;
+  }
+  case DR_TREADDIR: {
+    if (dr_unlikely(!s->dotl)) {
+      goto unrecognized;
+    }
+    uint32_t fid;
+    uint64_t offset;
+    uint32_t count;
+    dr_9p_decode_valid_Treaddir(&fid, &offset, &count, tbuf, tsize, &tpos);
+    dr_logf(DR_LOG_DEBUG, "Treaddir %" PRIu16 " %" PRIu32 " %" PRIu64 " %" PRIu32, tag, fid, offset, count);
+    struct dr_fid *restrict const fidp = dr_fid_get(&s->fids, fid);
+    if (dr_unlikely(fidp == NULL)) {
+      dr_log("Unable to find fid");
+      return false;
+    }
+    if (dr_unlikely(!fidp->open)) {
+      dr_log("Fid is not open");
+      return false;
+    }
+    if (dr_unlikely(!dr_9p_encode_Rreaddir_iterator(rbuf, rsize, rpos, tag))) {
+      dr_log("dr_9p_encode_Rreaddir_iterator failed");
+      return false;
+    }
+    if (count > rsize - *rpos) {
+      count = rsize - *rpos;
+    }
+    uint32_t bytes_read;
+    {
+      const struct dr_result_uint32 r = dr_vfs_readdir(fidp->u.fd, offset, count, rbuf + *rpos);
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_vfs_readdir failed", err);
+	dr_encode_error(s, rbuf, rsize, rpos, tag, err);
+	return true;
+      } DR_ELIF_RESULT_OK(uint32_t, r, value) {
+	bytes_read = value;
+      } DR_FI_RESULT;
+    }
+    *rpos += bytes_read;
+    if (dr_unlikely(!dr_9p_encode_Rreaddir_finish(rbuf, rsize, rpos, bytes_read))) {
+      dr_log("dr_9p_encode_Rreaddir_finish failed");
+      return false;
+    }
+    return true;
+  }
+  case DR_TFSYNC: {
+    if (dr_unlikely(!s->dotl)) {
+      goto unrecognized;
+    }
+    uint32_t fid;
+    uint32_t datasync;
+    if (dr_unlikely(!dr_9p_decode_Tfsync(&fid, &datasync, tbuf, tsize, &tpos))) {
+      dr_log("dr_9p_decode_Tfsync failed");
+      return false;
+    }
+    dr_logf(DR_LOG_DEBUG, "Tfsync %" PRIu16 " %" PRIu32 " %" PRIu32, tag, fid, datasync);
+    struct dr_fid *restrict const fidp = dr_fid_get(&s->fids, fid);
+    if (dr_unlikely(fidp == NULL)) {
+      dr_log("dr_fid_get failed");
+      return false;
+    }
+    if (fidp->open) {
+      const struct dr_result_void r = dr_vfs_flush(fidp->u.fd);
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_vfs_flush failed", err);
+	dr_encode_error(s, rbuf, rsize, rpos, tag, err);
+	return true;
+      } DR_FI_RESULT;
+    }
+    if (dr_unlikely(!dr_9p_encode_Rfsync(rbuf, rsize, rpos, tag))) {
+      dr_log("dr_9p_encode_Rfsync failed");
+      return false;
+    }
+    return true;
+  }
+  case DR_TLOCK: {
+    if (dr_unlikely(!s->dotl)) {
+      goto unrecognized;
+    }
+    uint32_t fid;
+    struct dr_9p_flock flock;
+    if (dr_unlikely(!dr_9p_decode_Tlock(&fid, &flock, tbuf, tsize, &tpos))) {
+      dr_log("dr_9p_decode_Tlock failed");
+      return false;
+    }
+    dr_logf(DR_LOG_DEBUG, "Tlock %" PRIu16 " %" PRIu32 " %" PRIu8 " %" PRIu32 " %" PRIu64 " %" PRIu64 " %" PRIu32 " '%.*s'", tag, fid, flock.type, flock.flags, flock.start, flock.length, flock.proc_id, flock.client_id.len, flock.client_id.buf);
+    if (dr_unlikely(dr_fid_get(&s->fids, fid) == NULL)) {
+      dr_log("dr_fid_get failed");
+      return false;
+    }
+    // DR Locks are not tracked, every request is granted
+    if (dr_unlikely(!dr_9p_encode_Rlock(rbuf, rsize, rpos, tag, DR_LOCK_SUCCESS))) {
+      dr_log("dr_9p_encode_Rlock failed");
+      return false;
+    }
+    return true;
+  }
+  case DR_TGETLOCK: {
+    if (dr_unlikely(!s->dotl)) {
+      goto unrecognized;
+    }
+    uint32_t fid;
+    struct dr_9p_flock flock;
+    if (dr_unlikely(!dr_9p_decode_Tgetlock(&fid, &flock, tbuf, tsize, &tpos))) {
+      dr_log("dr_9p_decode_Tgetlock failed");
+      return false;
+    }
+    dr_logf(DR_LOG_DEBUG, "Tgetlock %" PRIu16 " %" PRIu32 " %" PRIu8 " %" PRIu64 " %" PRIu64 " %" PRIu32 " '%.*s'", tag, fid, flock.type, flock.start, flock.length, flock.proc_id, flock.client_id.len, flock.client_id.buf);
+    if (dr_unlikely(dr_fid_get(&s->fids, fid) == NULL)) {
+      dr_log("dr_fid_get failed");
+      return false;
+    }
+    // Nothing is ever locked
+    flock.type = DR_LOCK_TYPE_UNLCK;
+    if (dr_unlikely(!dr_9p_encode_Rgetlock(rbuf, rsize, rpos, tag, &flock))) {
+      dr_log("dr_9p_encode_Rgetlock failed");
+      return false;
+    }
     return true;
   }
   default: {
+  unrecognized:
     dr_log("Unrecognized message");
+    // Linux falls back to older requests, like Tremove for Tunlinkat, only on EOPNOTSUPP
     const struct dr_error err = {
       .domain = DR_ERR_ISO_C,
-      .num = ENOSYS,
+      .num = s->dotl ? EOPNOTSUPP : ENOSYS,
     };
-    dr_9p_encode_Rerror_err(rbuf, rsize, rpos, tag, &err);
+    dr_encode_error(s, rbuf, rsize, rpos, tag, &err);
     return true;
   }
   }
@@ -563,12 +1193,14 @@ struct client {
   struct list_head clients;
   struct dr_task task;
   struct dr_equeue_client c;
-  struct list_head fids;
+  struct dr_session session;
+  uint32_t id;
 };
 
 static struct list_head clients;
 static struct dr_equeue equeue;
 static struct dr_equeue_server server;
+static struct dr_pool pool;
 
 static void client_func(void *restrict const arg);
 
@@ -578,7 +1210,9 @@ static WARN_UNUSED_RESULT struct dr_result_void client_init(dr_handle_t fd) {
     return DR_RESULT_ERRNO_VOID();
   }
   *c = (struct client) {
-    .fids = LIST_HEAD_INIT(c->fids),
+    .session.fids = HASH_TABLE_INIT,
+    .session.prefetch = DR_NOFID,
+    .id = (uint32_t)dr_stats_self->connections_accepted,
   };
   dr_equeue_client_init(&c->c, fd);
   {
@@ -590,19 +1224,15 @@ static WARN_UNUSED_RESULT struct dr_result_void client_init(dr_handle_t fd) {
     } DR_FI_RESULT;
   }
   list_add_tail(&c->clients, &clients);
+  ++dr_stats_self->connections_accepted;
   return DR_RESULT_OK_VOID();
 }
 
 static void client_destroy(struct client *restrict const c) {
   dr_log("Closing client");
   list_del(&c->clients);
-  {
-    struct dr_fid *restrict f;
-    struct dr_fid *restrict n;
-    list_for_each_entry_safe(f, n, &c->fids, struct dr_fid, fids) {
-      dr_fid_destroy(f);
-    }
-  }
+  dr_session_reset(&c->session);
+  hash_destroy(&c->session.fids);
   dr_task_destroy(&c->task);
   dr_equeue_client_destroy(&c->c);
   free(c);
@@ -610,11 +1240,13 @@ static void client_destroy(struct client *restrict const c) {
 
 static void client_func(void *restrict const arg) {
   struct client *restrict const c = (struct client *)arg;
+  // Clients may pipeline requests, so a read can return several messages or part of one
+  uint8_t tbuf[DR_9P_BUF_SIZE];
+  uint32_t len = 0;
   while (true) {
-    uint8_t tbuf[DR_9P_BUF_SIZE];
     size_t bytes;
     {
-      const struct dr_result_size r = dr_equeue_read(&equeue, &c->c, tbuf, sizeof(tbuf));
+      const struct dr_result_size r = dr_equeue_read(&equeue, &c->c, tbuf + len, sizeof(tbuf) - len);
       DR_IF_RESULT_ERR(r, err) {
 	dr_log_error("dr_equeue_read failed", err);
 	break;
@@ -626,34 +1258,79 @@ static void client_func(void *restrict const arg) {
       dr_log("Closing client");
       break;
     }
-    if (bytes < sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint16_t)) {
-      dr_log("Short read");
-      break;
-    }
-    const uint32_t tsize = dr_decode_uint32(tbuf);
-    if (bytes != tsize) {
-      dr_log("Short read");
-      break;
-    }
-    uint8_t rbuf[DR_9P_BUF_SIZE];
-    uint32_t rpos;
-    if (!dr_handle_request(&c->fids, tbuf, tsize, rbuf, sizeof(rbuf), &rpos)) {
-      break;
-    }
-    {
-      const struct dr_result_size r = dr_equeue_write(&equeue, &c->c, rbuf, rpos);
-      DR_IF_RESULT_ERR(r, err) {
-	dr_log_error("dr_equeue_write failed", err);
+    dr_stats_self->bytes_in += bytes;
+    len += bytes;
+    // Frame and validate everything buffered before handling any of it
+    uint32_t pos = 0;
+    bool failed = false;
+    while (true) {
+      struct dr_9p_frame frames[64];
+      uint32_t used;
+      const uint32_t count = dr_9p_decode_frames(frames, sizeof(frames)/sizeof(frames[0]), tbuf + pos, len - pos, sizeof(tbuf), &used);
+      if (count == FAIL_UINT32) {
+	dr_log("Invalid message");
+	failed = true;
 	break;
-      } DR_ELIF_RESULT_OK(size_t, r, value) {
-	bytes = value;
-      } DR_FI_RESULT;
+      }
+      for (uint32_t i = 0; i < count; ++i) {
+	const uint8_t *restrict const msg = tbuf + pos + frames[i].pos;
+	const uint32_t tsize = frames[i].size;
+	uint8_t rbuf[DR_9P_BUF_SIZE];
+	uint32_t rpos;
+	const int64_t start = dr_ticks_ns(dr_ticks());
+	const bool handled = dr_handle_request(&c->session, msg, tsize, rbuf, sizeof(rbuf), &rpos);
+	const int64_t end = dr_ticks_ns(dr_ticks());
+	dr_stats_message(dr_decode_uint8(msg + sizeof(uint32_t)), end - start);
+	if (dr_stats_self->trace.header != NULL) {
+	  dr_stats_trace(c->id, msg, tsize, start, end);
+	}
+	if (!handled) {
+	  failed = true;
+	  break;
+	}
+	{
+	  const struct dr_result_size r = dr_equeue_write(&equeue, &c->c, rbuf, rpos);
+	  DR_IF_RESULT_ERR(r, err) {
+	    dr_log_error("dr_equeue_write failed", err);
+	    failed = true;
+	  } DR_ELIF_RESULT_OK(size_t, r, value) {
+	    bytes = value;
+	  } DR_FI_RESULT;
+	}
+	if (failed) {
+	  break;
+	}
+	dr_stats_self->bytes_out += bytes;
+	if (bytes != rpos) {
+	  dr_log("Short write");
+	  failed = true;
+	  break;
+	}
+	if (c->session.prefetch != DR_NOFID) {
+	  struct dr_fid *restrict const f = dr_fid_get(&c->session.fids, c->session.prefetch);
+	  c->session.prefetch = DR_NOFID;
+	  if (f != NULL && f->open) {
+	    dr_vfs_prefetch(f->u.fd);
+	  }
+	}
+      }
+      if (failed) {
+	break;
+      }
+      pos += used;
+      if (count < sizeof(frames)/sizeof(frames[0])) {
+	break;
+      }
     }
-    if (bytes != rpos) {
-      dr_log("Short write");
+    if (failed) {
       break;
     }
+    len -= pos;
+    memmove(tbuf, tbuf + pos, len);
   }
+  // Release the fids now so they are not counted as live while the client waits to be destroyed
+  dr_session_reset(&c->session);
+  ++dr_stats_self->connections_closed;
 }
 
 static void server_func(void *restrict const arg) {
@@ -718,6 +1395,9 @@ WARN_UNUSED_RESULT static int print_usage(void) {
 	 "Options:\n"
 	 "  -p, --port     TCP/IP port name to connect to\n"
 	 "  -d, --debug    Print received messages\n"
+	 "  -T, --trace    File to write a binary trace of every request to\n"
+	 "  -m, --memory   Bytes available to /scratch (default 64MiB)\n"
+	 "  -t, --threads  Threads for blocking file operations (default 4)\n"
 	 "  -v, --version  Print version information\n"
 	 "  -h, --help     Print this help\n");
   return -1;
@@ -726,17 +1406,23 @@ WARN_UNUSED_RESULT static int print_usage(void) {
 int main(int argc, char *argv[]) {
   int result = -1;
   char *restrict port = 0;
+  const char *restrict trace = 0;
+  uint64_t memory = 64<<20;
+  unsigned long threads = 4;
   {
     static struct dr_option longopts[] = {
       {"port", 1, 0, 'p'},
       {"debug", 0, 0, 'd'},
+      {"trace", 1, 0, 'T'},
+      {"memory", 1, 0, 'm'},
+      {"threads", 1, 0, 't'},
       {"version", 0, 0, 'v'},
       {"help", 0, 0, 'h'},
       {0, 0, 0, 0},
     };
     dr_optind = 0;
     while (true) {
-      int opt = dr_getopt_long(argc, argv, "+p:dvh", longopts, NULL);
+      int opt = dr_getopt_long(argc, argv, "+p:dT:m:t:vh", longopts, NULL);
       if (opt == -1) {
 	break;
       }
@@ -745,8 +1431,27 @@ int main(int argc, char *argv[]) {
 	port = dr_optarg;
 	break;
       case 'd':
-	debug = true;
+	dr_log_level = DR_LOG_DEBUG;
+	break;
+      case 'T':
+	trace = dr_optarg;
+	break;
+      case 'm': {
+	char *end;
+	memory = strtoull(dr_optarg, &end, 10);
+	if (*dr_optarg == '\0' || *end != '\0') {
+	  return print_usage();
+	}
+	break;
+      }
+      case 't': {
+	char *end;
+	threads = strtoul(dr_optarg, &end, 10);
+	if (*dr_optarg == '\0' || *end != '\0' || threads == 0 || threads > 256) {
+	  return print_usage();
+	}
 	break;
+      }
       case 'v':
 	return print_version();
       default:
@@ -759,6 +1464,26 @@ int main(int argc, char *argv[]) {
     return print_usage();
   }
   INIT_LIST_HEAD(&clients);
+  INIT_LIST_HEAD(&dr_stats_threads);
+  list_add(&dr_stats_main.stats, &dr_stats_threads);
+  {
+    const struct dr_str name = {
+      .len = sizeof(dr_scratch_name),
+      .buf = dr_scratch_name,
+    };
+    dr_tmpfs_init(&dr_scratch, memory, &dr_root.file, &name, &dr_user, &dr_group, 0777);
+  }
+  // Clients must not stall behind a slow stdout, /stats/log counts what was lost
+  dr_log_drop(true);
+  // Before the first request is timed
+  dr_ticks_calibrate();
+  if (trace != NULL) {
+    const struct dr_result_void r = dr_trace_open(&dr_stats_main.trace, trace, DR_TRACE_RECORDS);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_trace_open failed", err);
+      goto fail;
+    } DR_FI_RESULT;
+  }
   {
     const struct dr_result_void r = dr_socket_startup();
     DR_IF_RESULT_ERR(r, err) {
@@ -773,12 +1498,29 @@ int main(int argc, char *argv[]) {
       goto fail;
     } DR_FI_RESULT;
   }
+  {
+    const struct dr_result_void r = dr_pool_init(&pool, &equeue, threads);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_pool_init failed", err);
+      goto fail_equeue_destroy;
+    } DR_FI_RESULT;
+  }
+  struct dr_task pool_task;
+  {
+    const struct dr_result_void r = dr_task_create(&pool_task, STACK_SIZE, dr_pool_task, &pool);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_task_create failed", err);
+      goto fail_pool_destroy;
+    } DR_FI_RESULT;
+  }
+  dr_vfs_offload(&pool);
+  dr_resolve_offload(&pool);
   struct dr_task server_task;
   {
     const struct dr_result_void r = dr_task_create(&server_task, STACK_SIZE, server_func, port);
     DR_IF_RESULT_ERR(r, err) {
       dr_log_error("dr_task_create failed", err);
-      goto fail_equeue_destroy;
+      goto fail_pool_task_destroy;
     } DR_FI_RESULT;
   }
   // Switch to allow server_func to run for the first time
@@ -795,13 +1537,14 @@ int main(int argc, char *argv[]) {
 	count = value;
       } DR_FI_RESULT;
     }
-    if (count == 0) {
-      continue;
-    }
+    ++dr_stats_self->wakeups;
+    dr_stats_self->events += count;
     for (unsigned int i = 0; i < count; ++i) {
       void *restrict const key = dr_event_key(events, i);
       if (key == &server) {
 	dr_task_runnable(&server_task);
+      } else if (key == &pool) {
+	dr_task_runnable(&pool_task);
       } else {
 	struct client *restrict const c = container_of(key, struct client, c);
 	dr_task_runnable(&c->task);
@@ -810,6 +1553,10 @@ int main(int argc, char *argv[]) {
     dr_schedule(true);
   }
  done:
+  // Running jobs use the stacks of the tasks that submitted them, so wait for them first
+  dr_vfs_offload(NULL);
+  dr_resolve_offload(NULL);
+  dr_pool_destroy(&pool);
   {
     struct client *restrict c;
     struct client *restrict n;
@@ -818,8 +1565,18 @@ int main(int argc, char *argv[]) {
     }
   }
   dr_task_destroy(&server_task);
+  dr_task_destroy(&pool_task);
+  goto fail_equeue_destroy;
+ fail_pool_task_destroy:
+  dr_vfs_offload(NULL);
+  dr_resolve_offload(NULL);
+  dr_task_destroy(&pool_task);
+ fail_pool_destroy:
+  dr_pool_destroy(&pool);
  fail_equeue_destroy:
   dr_equeue_destroy(&equeue);
  fail:
+  dr_trace_close(&dr_stats_main.trace);
+  dr_tmpfs_destroy(&dr_scratch);
   return result;
 }
@@ -0,0 +1,143 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// Copyright (c) 2018 Drew Richardson <drewrichardson@gmail.com>
+
+#include "dr.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void print_type(const uint8_t type) {
+  const char *restrict const name = dr_9p_name(type);
+  if (name != NULL) {
+    printf("%s", name);
+  } else {
+    printf("%" PRIu8, type);
+  }
+}
+
+static void print_text(const struct dr_trace_record *restrict const record) {
+  printf("%" PRIi64 ".%09" PRIi64 " %10" PRIi64 " %6" PRIu32 " ", record->start/DR_NS_PER_S, record->start%DR_NS_PER_S, record->end - record->start, record->conn);
+  print_type(record->type);
+  printf(" tag %" PRIu16, record->tag);
+  if (record->fid != DR_NOFID) {
+    printf(" fid %" PRIu32, record->fid);
+  }
+  if (record->type == DR_TREAD || record->type == DR_TWRITE || record->type == DR_TREADDIR) {
+    printf(" offset %" PRIu64 " count %" PRIu32, record->offset, record->count);
+  }
+  printf("\n");
+}
+
+// Complete events in the Trace Event Format read by chrome://tracing and Perfetto, one thread per connection
+static void print_json(const struct dr_trace_record *restrict const record, const bool first) {
+  const int64_t duration = record->end - record->start;
+  printf("%s{\"name\":\"", first ? "" : ",\n");
+  print_type(record->type);
+  printf("\",\"ph\":\"X\",\"pid\":0,\"tid\":%" PRIu32 ",\"ts\":%" PRIi64 ".%03" PRIi64 ",\"dur\":%" PRIi64 ".%03" PRIi64 ",\"args\":{\"tag\":%" PRIu16, record->conn, record->start/1000, record->start%1000, duration/1000, duration%1000, record->tag);
+  if (record->fid != DR_NOFID) {
+    printf(",\"fid\":%" PRIu32, record->fid);
+  }
+  if (record->type == DR_TREAD || record->type == DR_TWRITE || record->type == DR_TREADDIR) {
+    printf(",\"offset\":%" PRIu64 ",\"count\":%" PRIu32, record->offset, record->count);
+  }
+  printf("}}");
+}
+
+WARN_UNUSED_RESULT static int print_records(FILE *restrict const file, const char *restrict const path, const bool json) {
+  struct dr_trace_header header;
+  if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, DR_TRACE_MAGIC, sizeof(header.magic)) != 0 || header.record_size != sizeof(struct dr_trace_record) || header.capacity == 0 || (header.capacity & (header.capacity - 1)) != 0) {
+    printf("%s is not a trace\n", path);
+    return -1;
+  }
+  struct dr_trace_record *restrict const records = (struct dr_trace_record *)malloc((size_t)header.capacity*sizeof(*records));
+  if (records == NULL) {
+    printf("malloc failed\n");
+    return -1;
+  }
+  if (fread(records, sizeof(*records), header.capacity, file) != header.capacity) {
+    printf("%s is truncated\n", path);
+    free(records);
+    return -1;
+  }
+  // Once the ring has wrapped only the last capacity records remain
+  const uint64_t first = header.head > header.capacity ? header.head - header.capacity : 0;
+  if (json) {
+    printf("{\"traceEvents\":[\n");
+  }
+  for (uint64_t i = first; i < header.head; ++i) {
+    const struct dr_trace_record *restrict const record = &records[i & (header.capacity - 1)];
+    if (json) {
+      print_json(record, i == first);
+    } else {
+      print_text(record);
+    }
+  }
+  if (json) {
+    printf("\n]}\n");
+  }
+  free(records);
+  return 0;
+}
+
+WARN_UNUSED_RESULT static int print_trace(const char *restrict const path, const bool json) {
+  FILE *restrict const file = fopen(path, "rb");
+  if (file == NULL) {
+    printf("Unable to open %s\n", path);
+    return -1;
+  }
+  const int result = print_records(file, path, json);
+  fclose(file);
+  return result;
+}
+
+WARN_UNUSED_RESULT static int print_version(void) {
+  printf("9p_trace %u.%u.%u\n", DR_VERSION_MAJOR, DR_VERSION_MINOR, DR_VERSION_PATCH);
+  return 0;
+}
+
+WARN_UNUSED_RESULT static int print_usage(void) {
+  printf("Usage: 9p_trace [OPTIONS]... FILE\n"
+	 "\n"
+	 "Prints a trace written by 9p_server -T, oldest request first\n"
+	 "\n"
+	 "Options:\n"
+	 "  -j, --json     Print Chrome trace JSON instead of text\n"
+	 "  -v, --version  Print version information\n"
+	 "  -h, --help     Print this help\n");
+  return -1;
+}
+
+int main(int argc, char *argv[]) {
+  bool json = false;
+  {
+    static struct dr_option longopts[] = {
+      {"json", 0, 0, 'j'},
+      {"version", 0, 0, 'v'},
+      {"help", 0, 0, 'h'},
+      {0, 0, 0, 0},
+    };
+    dr_optind = 0;
+    while (true) {
+      int opt = dr_getopt_long(argc, argv, "+jvh", longopts, NULL);
+      if (opt == -1) {
+	break;
+      }
+      switch (opt) {
+      case 'j':
+	json = true;
+	break;
+      case 'v':
+	return print_version();
+      default:
+      case 'h':
+	return print_usage();
+      }
+    }
+  }
+  if (dr_optind != argc - 1) {
+    return print_usage();
+  }
+  return print_trace(argv[dr_optind], json);
+}
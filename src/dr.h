@@ -15,6 +15,7 @@
 #include "dr_types_common.h"
 #include "dr_types.h"
 #include "dr_compiler.h"
+#include "dr_9p_schema.h"
 
 extern char *restrict dr_optarg;
 extern int dr_optind, dr_opterr, dr_optopt, dr_optreset;
@@ -103,11 +104,34 @@ int dr_getopt_long(int argc, char **argv, const char *optstring, const struct dr
 #define DR_IF_RESULT_OK_VOID(R) \
   if (dr_likely(!(R).private_is_err)) {
 
-#define dr_log(msg) dr_log_impl(__func__, __FILE__, __LINE__, msg)
+// Log records are buffered until dr_log_flush, a full buffer is written out at once unless dr_log_drop(true) makes it drop and count records instead. Call dr_log_flush before writing to stdout directly or blocking outside of dr_equeue_dequeue, and only log from the thread running the scheduler
+void dr_log_flush(void);
+void dr_log_drop(const bool drop);
+WARN_UNUSED_RESULT uint64_t dr_log_dropped(void);
+
+#define DR_LOG_DEBUG 0
+#define DR_LOG_INFO  1
+#define DR_LOG_ERROR 2
+
+// Calls below DR_LOG_MIN_LEVEL are compiled out. make/build.mk sets it from LOG_MIN_LEVEL, for example make LOG_MIN_LEVEL=DR_LOG_INFO
+#if !defined(DR_LOG_MIN_LEVEL)
+#define DR_LOG_MIN_LEVEL DR_LOG_DEBUG
+#endif
+
+// Records below dr_log_level are skipped at runtime, it defaults to DR_LOG_INFO
+extern int dr_log_level;
+
+#define dr_log_enabled(level) ((level) >= DR_LOG_MIN_LEVEL && dr_unlikely((level) >= dr_log_level))
+
+#define dr_logf(level, ...) (dr_log_enabled(level) ? dr_logf_impl(__func__, __FILE__, __LINE__, __VA_ARGS__) : (void)(0))
+//__attribute__((noinline,cold))
+void dr_logf_impl(const char *restrict const func, const char *restrict const file, const int line, const char *restrict const format, ...);
+
+#define dr_log(msg) (dr_log_enabled(DR_LOG_INFO) ? dr_log_impl(__func__, __FILE__, __LINE__, msg) : (void)(0))
 //__attribute__((noinline,cold))
 void dr_log_impl(const char *restrict const func, const char *restrict const file, const int line, const char *restrict const msg);
 
-#define dr_log_error(msg, error) dr_log_error_impl(__func__, __FILE__, __LINE__, msg, error)
+#define dr_log_error(msg, error) (dr_log_enabled(DR_LOG_ERROR) ? dr_log_error_impl(__func__, __FILE__, __LINE__, msg, error) : (void)(0))
 //__attribute__((noinline,cold))
 void dr_log_error_impl(const char *restrict const func, const char *restrict const file, const int line, const char *restrict const msg, const struct dr_error *restrict const error);
 
@@ -125,10 +149,21 @@ WARN_UNUSED_RESULT bool dr_str_eq(const struct dr_str *restrict const a, const s
 // 2^63/1000000000 = 9223372036 -> Sep 21 00:12:44 UTC 1677 - Apr 11 23:47:16 UTC 2262
 WARN_UNUSED_RESULT struct dr_result_int64 dr_system_time_ns(void);
 WARN_UNUSED_RESULT struct dr_result_void dr_system_sleep_ns(const int64_t time);
+// Not affected by changes to the system time, for timeouts and intervals
+WARN_UNUSED_RESULT int64_t dr_monotonic_ns(void);
+// dr_monotonic_ns as of the last dr_equeue_dequeue return, for timeouts that can be as stale as the current wakeup
+WARN_UNUSED_RESULT int64_t dr_now_ns(void);
+void dr_now_update(void);
+// Cheaper than dr_monotonic_ns for timing code, dr_ticks_ns converts ticks to dr_monotonic_ns time
+WARN_UNUSED_RESULT uint64_t dr_ticks(void);
+// Spins for 10ms to time the TSC, call once at startup before the first dr_ticks. Until then ticks are dr_monotonic_ns
+void dr_ticks_calibrate(void);
+WARN_UNUSED_RESULT int64_t dr_ticks_ns(const uint64_t ticks);
 
 WARN_UNUSED_RESULT struct dr_result_size dr_read(dr_handle_t fd, void *restrict const buf, size_t count);
 WARN_UNUSED_RESULT struct dr_result_size dr_write(dr_handle_t fd, const void *restrict const buf, size_t count);
 void dr_close(dr_handle_t fd);
+WARN_UNUSED_RESULT struct dr_result_void dr_set_nonblock(dr_handle_t fd);
 
 #if defined(_WIN32)
 
@@ -139,8 +174,54 @@ WARN_UNUSED_RESULT struct dr_result_size dr_write_ol(dr_handle_t fd, const void
 
 #endif
 
-#define DR_QUEUE_READABLE(c) ((c)->write_pos >= (c)->read_pos ? (c)->write_pos - (c)->read_pos : sizeof((c)->buf) - (c)->read_pos)
-#define DR_QUEUE_WRITABLE(c) ((c)->write_pos < (c)->read_pos ? (c)->read_pos - 1 - (c)->write_pos : (c)->read_pos == 0 ? sizeof((c)->buf) - 1 - (c)->write_pos : sizeof((c)->buf) - (c)->write_pos)
+// May transfer less than the total length, on Windows only the first iovec is used
+WARN_UNUSED_RESULT struct dr_result_size dr_readv(dr_handle_t fd, const struct dr_iovec *restrict const iov, const unsigned int count);
+WARN_UNUSED_RESULT struct dr_result_size dr_writev(dr_handle_t fd, const struct dr_iovec *restrict const iov, const unsigned int count);
+
+// capacity must be a power of two, and for a mirrored ring also a multiple of the page size. dr_ring_init_mirror fails with ENOSYS where it is not supported
+WARN_UNUSED_RESULT struct dr_result_void dr_ring_init(struct dr_ring *restrict const ring, const uint32_t capacity);
+WARN_UNUSED_RESULT struct dr_result_void dr_ring_init_mirror(struct dr_ring *restrict const ring, const uint32_t capacity);
+void dr_ring_destroy(struct dr_ring *restrict const ring);
+// Copy in or out as much of count as fits or is buffered and return how much
+WARN_UNUSED_RESULT uint32_t dr_ring_put(struct dr_ring *restrict const ring, const void *restrict const buf, const uint32_t count);
+WARN_UNUSED_RESULT uint32_t dr_ring_get(struct dr_ring *restrict const ring, void *restrict const buf, const uint32_t count);
+
+WARN_UNUSED_RESULT static inline uint32_t dr_ring_readable(const struct dr_ring *restrict const ring) {
+  return ring->tail - ring->head;
+}
+
+WARN_UNUSED_RESULT static inline uint32_t dr_ring_writable(const struct dr_ring *restrict const ring) {
+  return ring->mask + 1 - (ring->tail - ring->head);
+}
+
+// Describes len bytes starting at index in the two entries of iov and returns how many are used
+WARN_UNUSED_RESULT static inline unsigned int dr_ring_iov(const struct dr_ring *restrict const ring, const uint32_t index, const uint32_t len, struct dr_iovec *restrict const iov) {
+  const uint32_t pos = index & ring->mask;
+  const uint32_t first = ring->mirror || len <= ring->mask + 1 - pos ? len : ring->mask + 1 - pos;
+  iov[0].base = ring->buf + pos;
+  iov[0].len = first;
+  iov[1].base = ring->buf;
+  iov[1].len = len - first;
+  return len == first ? 1 : 2;
+}
+
+// The buffered bytes, release them with dr_ring_consume
+WARN_UNUSED_RESULT static inline unsigned int dr_ring_read_iov(const struct dr_ring *restrict const ring, struct dr_iovec *restrict const iov) {
+  return dr_ring_iov(ring, ring->head, dr_ring_readable(ring), iov);
+}
+
+// The free space, commit what was written with dr_ring_produce
+WARN_UNUSED_RESULT static inline unsigned int dr_ring_write_iov(const struct dr_ring *restrict const ring, struct dr_iovec *restrict const iov) {
+  return dr_ring_iov(ring, ring->tail, dr_ring_writable(ring), iov);
+}
+
+static inline void dr_ring_consume(struct dr_ring *restrict const ring, const uint32_t count) {
+  ring->head += count;
+}
+
+static inline void dr_ring_produce(struct dr_ring *restrict const ring, const uint32_t count) {
+  ring->tail += count;
+}
 
 WARN_UNUSED_RESULT struct dr_result_void dr_console_startup(void);
 extern dr_handle_t dr_stdin;
@@ -162,6 +243,22 @@ WARN_UNUSED_RESULT struct dr_result_void dr_connect(dr_handle_t sockfd, const st
 WARN_UNUSED_RESULT struct dr_result_handle dr_sock_connect(const char *restrict const hostname, const char *restrict const port, unsigned int flags);
 WARN_UNUSED_RESULT struct dr_result_void dr_listen(dr_handle_t sockfd, int backlog);
 
+struct addrinfo;
+
+#define DR_RESOLVE_TTL_NS (30*DR_NS_PER_S)
+
+// Resolves hostname and port for stream sockets as getaddrinfo does, with passive set when binding. Answers are cached, for DR_RESOLVE_TTL_NS by default as measured by dr_monotonic_ns so callers outside the event loop see them expire, and a task asking for a name already being resolved waits for that lookup
+WARN_UNUSED_RESULT struct dr_result_resolved dr_resolve(const char *restrict const hostname, const char *restrict const port, const bool passive);
+// The addresses stay valid until the result is released
+WARN_UNUSED_RESULT const struct addrinfo *dr_resolved_addrs(const struct dr_resolved *restrict const resolved);
+void dr_resolve_release(struct dr_resolved *restrict const resolved);
+// Lookups run on pool rather than blocking every task, so dr_resolve must then be called from a task. A NULL pool runs them inline
+void dr_resolve_offload(struct dr_pool *restrict const pool);
+// Sets how long later answers are cached, 0 turns caching off
+void dr_resolve_cache_ttl(const int64_t ttl_ns);
+// Drops every cached answer, for instance after the network changed
+void dr_resolve_flush(void);
+
 WARN_UNUSED_RESULT struct dr_result_handle dr_pipe_bind(const char *restrict const name, unsigned int flags);
 WARN_UNUSED_RESULT struct dr_result_handle dr_pipe_connect(const char *restrict const name, unsigned int flags);
 
@@ -188,26 +285,89 @@ void dr_equeue_client_init(struct dr_equeue_client *restrict const c, dr_handle_
 void dr_equeue_client_destroy(struct dr_equeue_client *restrict const c);
 
 WARN_UNUSED_RESULT struct dr_result_handle dr_equeue_accept(struct dr_equeue *restrict const e, struct dr_equeue_server *restrict const s);
+// Connects to the first of hostname's addresses to answer without blocking other tasks, starting another attempt whenever one fails or has not finished within 250ms and alternating between IPv6 and IPv4. hostname is looked up with dr_resolve, which blocks every task on getaddrinfo unless dr_resolve_offload has set a pool. Returns a non-blocking socket for dr_equeue_client_init
+WARN_UNUSED_RESULT struct dr_result_handle dr_equeue_connect(struct dr_equeue *restrict const e, const char *restrict const hostname, const char *restrict const port);
 WARN_UNUSED_RESULT struct dr_result_size dr_equeue_read(struct dr_equeue *restrict const e, struct dr_equeue_client *restrict const c, void *restrict const buf, const size_t count);
 WARN_UNUSED_RESULT struct dr_result_size dr_equeue_write(struct dr_equeue *restrict const e, struct dr_equeue_client *restrict const c, const void *restrict const buf, const size_t count);
+WARN_UNUSED_RESULT struct dr_result_size dr_equeue_readv(struct dr_equeue *restrict const e, struct dr_equeue_client *restrict const c, const struct dr_iovec *restrict const iov, const unsigned int count);
+WARN_UNUSED_RESULT struct dr_result_size dr_equeue_writev(struct dr_equeue *restrict const e, struct dr_equeue_client *restrict const c, const struct dr_iovec *restrict const iov, const unsigned int count);
+// Fill the free space or drain the buffered bytes of ring, both halves in one call
+WARN_UNUSED_RESULT struct dr_result_size dr_equeue_read_ring(struct dr_equeue *restrict const e, struct dr_equeue_client *restrict const c, struct dr_ring *restrict const ring);
+WARN_UNUSED_RESULT struct dr_result_size dr_equeue_write_ring(struct dr_equeue *restrict const e, struct dr_equeue_client *restrict const c, struct dr_ring *restrict const ring);
 WARN_UNUSED_RESULT struct dr_result_void dr_equeue_dispatch(struct dr_equeue *restrict const e);
 
 WARN_UNUSED_RESULT struct dr_result_void dr_task_create(struct dr_task *restrict const task, const size_t stack_size, const dr_task_start_t func, void *restrict const arg);
 WARN_UNUSED_RESULT struct dr_task *dr_task_self(void);
 void dr_task_destroy(struct dr_task *restrict const task);
 void dr_task_runnable(struct dr_task *restrict const task);
+WARN_UNUSED_RESULT unsigned int dr_task_runnable_count(void);
 NORETURN void dr_task_exit(void *restrict const arg, void (*cleanup)(void *restrict const));
 void dr_schedule(const bool sleep);
 
+#define DR_NEVER INT64_MAX
+
+// Makes the calling task runnable once dr_now_ns reaches deadline unless cancelled first. dr_equeue_dequeue waits no longer than the earliest timer and fires the due ones
+void dr_timer_start(struct dr_timer *restrict const timer, const int64_t deadline);
+void dr_timer_cancel(struct dr_timer *restrict const timer);
+// Nanoseconds until the earliest timer is due, 0 if one already is or -1 if there are none
+WARN_UNUSED_RESULT int64_t dr_timer_timeout_ns(void);
+void dr_timer_run(void);
+void dr_sleep_until(const int64_t deadline);
+
 void dr_wait_init(struct dr_wait *restrict const wait);
 void dr_wait_destroy(struct dr_wait *restrict const wait);
 void dr_wait_notify(struct dr_wait *restrict const wait);
+void dr_wait_notify_all(struct dr_wait *restrict const wait);
 void dr_wait_wait(struct dr_wait *restrict const wait);
+// Returns false if deadline passed before a notify
+WARN_UNUSED_RESULT bool dr_wait_wait_until(struct dr_wait *restrict const wait, const int64_t deadline);
 
 WARN_UNUSED_RESULT struct dr_result_void dr_sem_init(struct dr_sem *restrict const sem, unsigned int value);
 void dr_sem_destroy(struct dr_sem *restrict const sem);
 WARN_UNUSED_RESULT struct dr_result_void dr_sem_post(struct dr_sem *restrict const sem);
+WARN_UNUSED_RESULT struct dr_result_void dr_sem_post_count(struct dr_sem *restrict const sem, const unsigned int count);
 WARN_UNUSED_RESULT struct dr_result_void dr_sem_wait(struct dr_sem *restrict const sem);
+// Fails with ETIMEDOUT if deadline passes first
+WARN_UNUSED_RESULT struct dr_result_void dr_sem_timedwait(struct dr_sem *restrict const sem, const int64_t deadline);
+
+// lock is a dr_sem with a value of 1 used as a mutex, it is released while waiting and held again on return
+void dr_cond_init(struct dr_cond *restrict const cond);
+void dr_cond_destroy(struct dr_cond *restrict const cond);
+void dr_cond_signal(struct dr_cond *restrict const cond);
+void dr_cond_broadcast(struct dr_cond *restrict const cond);
+WARN_UNUSED_RESULT struct dr_result_void dr_cond_wait(struct dr_cond *restrict const cond, struct dr_sem *restrict const lock);
+WARN_UNUSED_RESULT struct dr_result_void dr_cond_timedwait(struct dr_cond *restrict const cond, struct dr_sem *restrict const lock, const int64_t deadline);
+
+// capacity must be a power of two. Sends fail with EPIPE once closed, receives fail with EPIPE once closed and drained, and the try variants fail with EAGAIN instead of waiting
+WARN_UNUSED_RESULT struct dr_result_void dr_chan_init(struct dr_chan *restrict const chan, const uint32_t size, const uint32_t capacity);
+void dr_chan_destroy(struct dr_chan *restrict const chan);
+void dr_chan_close(struct dr_chan *restrict const chan);
+WARN_UNUSED_RESULT struct dr_result_void dr_chan_send(struct dr_chan *restrict const chan, const void *restrict const elem);
+WARN_UNUSED_RESULT struct dr_result_void dr_chan_try_send(struct dr_chan *restrict const chan, const void *restrict const elem);
+WARN_UNUSED_RESULT struct dr_result_void dr_chan_recv(struct dr_chan *restrict const chan, void *restrict const elem);
+WARN_UNUSED_RESULT struct dr_result_void dr_chan_try_recv(struct dr_chan *restrict const chan, void *restrict const elem);
+// Waits until at least one element fits or is available, then moves as many of count as possible and returns how many
+WARN_UNUSED_RESULT struct dr_result_uint dr_chan_send_batch(struct dr_chan *restrict const chan, const void *restrict const elems, const unsigned int count);
+WARN_UNUSED_RESULT struct dr_result_uint dr_chan_recv_batch(struct dr_chan *restrict const chan, void *restrict const elems, const unsigned int count);
+
+// thread_count OS threads run dr_pool_run jobs, completions are delivered by dr_pool_task with the pool as the event key
+WARN_UNUSED_RESULT struct dr_result_void dr_pool_init(struct dr_pool *restrict const pool, struct dr_equeue *restrict const e, const unsigned int thread_count);
+void dr_pool_destroy(struct dr_pool *restrict const pool);
+void dr_pool_run(struct dr_pool *restrict const pool, struct dr_pool_job *restrict const job);
+// Queues job without waiting, dr_pool_finish must then be called from a task before job is reused or freed
+void dr_pool_start(struct dr_pool *restrict const pool, struct dr_pool_job *restrict const job);
+void dr_pool_finish(struct dr_pool_job *restrict const job);
+void dr_pool_task(void *restrict const arg);
+
+void dr_hist_init(struct dr_hist *restrict const hist);
+void dr_hist_record(struct dr_hist *restrict const hist, const uint64_t value);
+void dr_hist_merge(struct dr_hist *restrict const dst, const struct dr_hist *restrict const src);
+WARN_UNUSED_RESULT uint64_t dr_hist_percentile(const struct dr_hist *restrict const hist, const uint32_t permille);
+
+// Maps a ring of capacity records, which must be a power of two, from path. Records reach the file even if the process dies without dr_trace_close
+WARN_UNUSED_RESULT struct dr_result_void dr_trace_open(struct dr_trace *restrict const trace, const char *restrict const path, const uint32_t capacity);
+void dr_trace_close(struct dr_trace *restrict const trace);
+void dr_trace_write(struct dr_trace *restrict const trace, const struct dr_trace_record *restrict const record);
 
 // mode
 #define DR_DIR    0x80000000
@@ -244,11 +404,37 @@ WARN_UNUSED_RESULT struct dr_result_void dr_sem_wait(struct dr_sem *restrict con
 
 WARN_UNUSED_RESULT struct dr_result_file dr_vfs_walk(const struct dr_user *restrict const user, const struct dr_file *restrict const file, const struct dr_str *restrict const name);
 WARN_UNUSED_RESULT struct dr_result_fd dr_vfs_open(const struct dr_user *restrict const user, struct dr_file *restrict const file, const uint8_t mode);
-WARN_UNUSED_RESULT struct dr_result_uint32 dr_vfs_read(const struct dr_fd *restrict const fd, const uint64_t offset, const uint32_t count, void *restrict const buf);
-WARN_UNUSED_RESULT struct dr_result_uint32 dr_vfs_write(const struct dr_fd *restrict const fd, const uint64_t offset, const uint32_t count, const void *restrict const buf);
+WARN_UNUSED_RESULT struct dr_result_uint32 dr_vfs_read(struct dr_fd *restrict const fd, const uint64_t offset, const uint32_t count, void *restrict const buf);
+WARN_UNUSED_RESULT struct dr_result_uint32 dr_vfs_write(struct dr_fd *restrict const fd, const uint64_t offset, const uint32_t count, const void *restrict const buf);
+WARN_UNUSED_RESULT struct dr_result_uint32 dr_vfs_readdir(const struct dr_fd *restrict const fd, const uint64_t offset, const uint32_t count, void *restrict const buf);
 void dr_vfs_close(struct dr_fd *restrict const fd);
+WARN_UNUSED_RESULT struct dr_result_fd dr_vfs_create(struct dr_user *restrict const user, struct dr_file *restrict const dir, const struct dr_str *restrict const name, const uint32_t perm, const uint8_t mode);
+WARN_UNUSED_RESULT struct dr_result_void dr_vfs_remove(const struct dr_user *restrict const user, struct dr_file *restrict const file);
+WARN_UNUSED_RESULT bool dr_vfs_can_write(const struct dr_user *restrict const user, const struct dr_file *restrict const file);
+void dr_vfs_ref(struct dr_file *restrict const file);
+void dr_vfs_unref(struct dr_file *restrict const file);
+
+#define DR_VFS_READAHEAD   (1U<<0)
+#define DR_VFS_WRITEBEHIND (1U<<1)
+// Reads and writes may block and are run on the pool set with dr_vfs_offload
+#define DR_VFS_BLOCKING    (1U<<2)
+#define DR_VFS_CACHE_SIZE  (1U<<16)
+#define DR_VFS_CACHE_LIMIT (256*DR_VFS_CACHE_SIZE)
+
+// Writes out buffered data, or reports a write behind that failed since the last write or flush
+WARN_UNUSED_RESULT struct dr_result_void dr_vfs_flush(struct dr_fd *restrict const fd);
+// Starts filling the read ahead window on the pool for DR_VFS_BLOCKING backends and returns without waiting for it
+void dr_vfs_prefetch(struct dr_fd *restrict const fd);
+void dr_vfs_offload(struct dr_pool *restrict const pool);
+
+#define DR_TMPFS_PAGE_SIZE 4096
+
+void dr_tmpfs_init(struct dr_tmpfs *restrict const fs, const uint64_t cap, struct dr_file *restrict const parent, const struct dr_str *restrict const name, struct dr_user *restrict const user, struct dr_group *restrict const group, const uint32_t mode);
+void dr_tmpfs_destroy(struct dr_tmpfs *restrict const fs);
 
 extern struct dr_file_vtbl dr_dir_vtbl;
+WARN_UNUSED_RESULT uint32_t dr_dir_read_entries(uint8_t *restrict const buf, const uint32_t count, const uint64_t offset, struct dr_file *restrict const *restrict const entries, const uint32_t entry_count);
+WARN_UNUSED_RESULT uint32_t dr_dir_readdir_entries(uint8_t *restrict const buf, const uint32_t count, const uint64_t offset, struct dr_file *restrict const *restrict const entries, const uint32_t entry_count);
 
 #define DR_TVERSION 100
 #define DR_RVERSION 101
@@ -278,79 +464,173 @@ extern struct dr_file_vtbl dr_dir_vtbl;
 #define DR_TWSTAT   126
 #define DR_RWSTAT   127
 
+// 9P2000.L
+#define DR_TLERROR     6
+#define DR_RLERROR     7
+#define DR_TSTATFS     8
+#define DR_RSTATFS     9
+#define DR_TLOPEN     12
+#define DR_RLOPEN     13
+#define DR_TLCREATE   14
+#define DR_RLCREATE   15
+#define DR_TGETATTR   24
+#define DR_RGETATTR   25
+#define DR_TXATTRWALK 30
+#define DR_RXATTRWALK 31
+#define DR_TREADDIR   40
+#define DR_RREADDIR   41
+#define DR_TFSYNC     50
+#define DR_RFSYNC     51
+#define DR_TLOCK      52
+#define DR_RLOCK      53
+#define DR_TGETLOCK   54
+#define DR_RGETLOCK   55
+#define DR_TMKDIR     72
+#define DR_RMKDIR     73
+
+#define DR_NOTAG ((uint16_t)~0)
 #define DR_NOFID ((uint32_t)~0)
+#define DR_NONUNAME ((uint32_t)~0)
+
+// Linux open flags as sent in Tlopen and Tlcreate
+#define DR_L_O_ACCMODE 00000003
+#define DR_L_O_TRUNC   00001000
+
+// Linux mode bits as sent in Rgetattr
+#define DR_L_S_IFDIR 0040000
+#define DR_L_S_IFREG 0100000
+
+// Linux dirent types as sent in Rreaddir
+#define DR_L_DT_DIR 4
+#define DR_L_DT_REG 8
+
+#define DR_GETATTR_BASIC 0x000007ff
+
+#define DR_LOCK_TYPE_RDLCK 0
+#define DR_LOCK_TYPE_WRLCK 1
+#define DR_LOCK_TYPE_UNLCK 2
+
+#define DR_LOCK_SUCCESS 0
+
+// 9p integers are little endian and unaligned, so use a single load or store where the compiler can do one and a byte loop otherwise
+
+#if defined(HAS_BUILTIN_MEMCPY) && (defined(IS_LITTLE_ENDIAN) || (defined(IS_BIG_ENDIAN) && defined(HAS_BUILTIN_BSWAP)))
+
+#if defined(IS_LITTLE_ENDIAN)
+#define dr_le16(val) (val)
+#define dr_le32(val) (val)
+#define dr_le64(val) (val)
+#else
+#define dr_le16(val) __builtin_bswap16(val)
+#define dr_le32(val) __builtin_bswap32(val)
+#define dr_le64(val) __builtin_bswap64(val)
+#endif
+
+#define DR_DECODE_UINTN(bits) \
+  WARN_UNUSED_RESULT static inline uint##bits##_t dr_decode_uint##bits(const uint8_t *restrict const buf) { \
+    uint##bits##_t val; \
+    __builtin_memcpy(&val, buf, sizeof(val)); \
+    return dr_le##bits(val); \
+  }
+
+#define DR_ENCODE_UINTN(bits) \
+  static inline void dr_encode_uint##bits(uint8_t *restrict const buf, const uint##bits##_t val) { \
+    const uint##bits##_t le = dr_le##bits(val); \
+    __builtin_memcpy(buf, &le, sizeof(le)); \
+  }
+
+#else
+
+#define DR_DECODE_UINTN(bits) \
+  WARN_UNUSED_RESULT static inline uint##bits##_t dr_decode_uint##bits(const uint8_t *restrict const buf) { \
+    uint##bits##_t val = 0; \
+    for (size_t i = 0; i < sizeof(val); ++i) { \
+      val |= ((uint##bits##_t)buf[i]) << 8 * i; \
+    } \
+    return val; \
+  }
+
+#define DR_ENCODE_UINTN(bits) \
+  static inline void dr_encode_uint##bits(uint8_t *restrict const buf, const uint##bits##_t val) { \
+    for (size_t i = 0; i < sizeof(val); ++i) { \
+      buf[i] = (val >> 8 * i) & 0xff; \
+    } \
+  }
+
+#endif
+
+WARN_UNUSED_RESULT static inline uint8_t dr_decode_uint8(const uint8_t *restrict const buf) {
+  return buf[0];
+}
+
+DR_DECODE_UINTN(16)
+DR_DECODE_UINTN(32)
+DR_DECODE_UINTN(64)
 
-WARN_UNUSED_RESULT uint8_t dr_decode_uint8(const uint8_t *restrict const buf);
-WARN_UNUSED_RESULT uint16_t dr_decode_uint16(const uint8_t *restrict const buf);
-WARN_UNUSED_RESULT uint32_t dr_decode_uint32(const uint8_t *restrict const buf);
-WARN_UNUSED_RESULT uint64_t dr_decode_uint64(const uint8_t *restrict const buf);
+static inline void dr_encode_uint8(uint8_t *restrict const buf, const uint8_t val) {
+  buf[0] = val;
+}
 
-void dr_encode_uint8(uint8_t *restrict const buf, const uint8_t val);
-void dr_encode_uint16(uint8_t *restrict const buf, const uint16_t val);
-void dr_encode_uint32(uint8_t *restrict const buf, const uint32_t val);
-void dr_encode_uint64(uint8_t *restrict const buf, const uint64_t val);
+DR_ENCODE_UINTN(16)
+DR_ENCODE_UINTN(32)
+DR_ENCODE_UINTN(64)
 
 #define FAIL_UINT32 ((uint32_t)~0)
 WARN_UNUSED_RESULT uint32_t dr_9p_decode_stat(struct dr_9p_stat *restrict const stat, const uint8_t *restrict const buf, const uint32_t size);
 WARN_UNUSED_RESULT bool dr_9p_decode_header(uint8_t *restrict const type, uint16_t *restrict const tag, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos);
-WARN_UNUSED_RESULT bool dr_9p_decode_Tversion(uint32_t *restrict const msize, struct dr_str *restrict const version, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos);
-WARN_UNUSED_RESULT bool dr_9p_decode_Rversion(uint32_t *restrict const msize, struct dr_str *restrict const version, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos);
-WARN_UNUSED_RESULT bool dr_9p_decode_Tauth(uint32_t *restrict const afid, struct dr_str *restrict const uname, struct dr_str *restrict const aname, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos);
-WARN_UNUSED_RESULT bool dr_9p_decode_Rerror(struct dr_str *restrict const ename, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos);
-WARN_UNUSED_RESULT bool dr_9p_decode_Tattach(uint32_t *restrict const fid, uint32_t *restrict const afid, struct dr_str *restrict const uname, struct dr_str *restrict const aname, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos);
-WARN_UNUSED_RESULT bool dr_9p_decode_Rattach(struct dr_9p_qid *restrict const qid, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos);
+// Splits the whole messages at the start of buf into frames and checks them all before any is handled. Stops at a partial message or when frames is full, sets used to the bytes covered and returns the frame count, or FAIL_UINT32 if a message is malformed
+WARN_UNUSED_RESULT uint32_t dr_9p_decode_frames(struct dr_9p_frame *restrict const frames, const uint32_t max_frames, const uint8_t *restrict const buf, const uint32_t len, const uint32_t max_size, uint32_t *restrict const used);
+// The messages in dr_9p_schema.h. dr_9p_decode_valid_* may only be given a message that dr_9p_decode_frames accepted and that has a single layout for its type, which rules out Tauth, Tauth_dotl, Tattach and Tattach_dotl
+DR_9P_MESSAGES(DR_9P_DECLARE)
 WARN_UNUSED_RESULT bool dr_9p_decode_Twalk_iterator(uint32_t *restrict const fid, uint32_t *restrict const newfid, uint16_t *restrict const nwname, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos);
 WARN_UNUSED_RESULT bool dr_9p_decode_Twalk_advance(struct dr_str *restrict const wname, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos);
 WARN_UNUSED_RESULT bool dr_9p_decode_Twalk_finish(const uint32_t size, const uint32_t pos);
 WARN_UNUSED_RESULT bool dr_9p_decode_Rwalk_iterator(uint16_t *restrict const nwqid, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos);
 WARN_UNUSED_RESULT bool dr_9p_decode_Rwalk_advance(struct dr_9p_qid *restrict const qid, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos);
 WARN_UNUSED_RESULT bool dr_9p_decode_Rwalk_finish(const uint32_t size, const uint32_t pos);
-WARN_UNUSED_RESULT bool dr_9p_decode_Topen(uint32_t *restrict const fid, uint8_t *restrict const mode, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos);
-WARN_UNUSED_RESULT bool dr_9p_decode_Ropen(struct dr_9p_qid *restrict const qid, uint32_t *restrict const iounit, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos);
-WARN_UNUSED_RESULT bool dr_9p_decode_Tcreate(uint32_t *restrict const fid, struct dr_str *restrict const name, uint32_t *restrict const perm, uint8_t *restrict const mode, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos);
-WARN_UNUSED_RESULT bool dr_9p_decode_Rcreate(struct dr_9p_qid *restrict const qid, uint32_t *restrict const iounit, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos);
-WARN_UNUSED_RESULT bool dr_9p_decode_Tread(uint32_t *restrict const fid, uint64_t *restrict const offset, uint32_t *restrict const count, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos);
 WARN_UNUSED_RESULT bool dr_9p_decode_Rread(uint32_t *restrict const count, const void *restrict *restrict const data, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos);
 WARN_UNUSED_RESULT bool dr_9p_decode_Twrite(uint32_t *restrict const fid, uint64_t *restrict const offset, uint32_t *restrict const count, const void *restrict *restrict const data, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos);
-WARN_UNUSED_RESULT bool dr_9p_decode_Rwrite(uint32_t *restrict const count, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos);
-WARN_UNUSED_RESULT bool dr_9p_decode_Tclunk(uint32_t *restrict const fid, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos);
 WARN_UNUSED_RESULT bool dr_9p_decode_Rclunk(const uint32_t size, uint32_t *restrict const pos);
-WARN_UNUSED_RESULT bool dr_9p_decode_Tremove(uint32_t *restrict const fid, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos);
 WARN_UNUSED_RESULT bool dr_9p_decode_Rremove(const uint32_t size, uint32_t *restrict const pos);
-WARN_UNUSED_RESULT bool dr_9p_decode_Tstat(uint32_t *restrict const fid, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos);
 WARN_UNUSED_RESULT bool dr_9p_decode_Rstat(struct dr_9p_stat *restrict const stat, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos);
 WARN_UNUSED_RESULT bool dr_9p_decode_Twstat(uint32_t *restrict const fid, struct dr_9p_stat *restrict const stat, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos);
 WARN_UNUSED_RESULT bool dr_9p_decode_Rwstat(const uint32_t size, uint32_t *restrict const pos);
+WARN_UNUSED_RESULT bool dr_9p_decode_Tfsync(uint32_t *restrict const fid, uint32_t *restrict const datasync, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos);
+WARN_UNUSED_RESULT bool dr_9p_decode_Tlock(uint32_t *restrict const fid, struct dr_9p_flock *restrict const flock, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos);
+WARN_UNUSED_RESULT bool dr_9p_decode_Tgetlock(uint32_t *restrict const fid, struct dr_9p_flock *restrict const flock, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos);
+// Returns the name of a request type or NULL if it is unknown
+WARN_UNUSED_RESULT const char *dr_9p_name(const uint8_t type);
+// Describes a message for debugging, truncating to fit out
+size_t dr_9p_format(char *restrict const out, const size_t out_size, const uint8_t *restrict const buf, const uint32_t size);
 
-WARN_UNUSED_RESULT bool dr_9p_encode_Tversion(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const uint32_t msize, const struct dr_str *restrict const version);
-WARN_UNUSED_RESULT bool dr_9p_encode_Rversion(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const uint32_t msize, const struct dr_str *restrict const version);
 void dr_9p_encode_Rerror(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const struct dr_str *restrict const ename);
 void dr_9p_encode_Rerror_err(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const struct dr_error *restrict const error);
-WARN_UNUSED_RESULT bool dr_9p_encode_Tattach(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const uint32_t fid, const uint32_t afid, const struct dr_str *restrict const uname, const struct dr_str *restrict const aname);
-WARN_UNUSED_RESULT bool dr_9p_encode_Rattach(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const struct dr_file *restrict const f);
 WARN_UNUSED_RESULT bool dr_9p_encode_Twalk_iterator(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const uint32_t fid, const uint32_t newfid, uint16_t *restrict const nwname);
 WARN_UNUSED_RESULT bool dr_9p_encode_Twalk_add(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, uint16_t *restrict const nwname, const struct dr_str *restrict const name);
 WARN_UNUSED_RESULT bool dr_9p_encode_Twalk_finish(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t nwname);
 WARN_UNUSED_RESULT bool dr_9p_encode_Rwalk_iterator(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, uint16_t *restrict const nwqid);
 WARN_UNUSED_RESULT bool dr_9p_encode_Rwalk_add(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, uint16_t *restrict const nwqid, const struct dr_file *restrict const f);
 WARN_UNUSED_RESULT bool dr_9p_encode_Rwalk_finish(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t nwqid);
-WARN_UNUSED_RESULT bool dr_9p_encode_Topen(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const uint32_t fid, const uint8_t mode);
-WARN_UNUSED_RESULT bool dr_9p_encode_Ropen(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const struct dr_file *restrict const f, const uint32_t iounit);
-WARN_UNUSED_RESULT bool dr_9p_encode_Tcreate(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const uint32_t fid, const struct dr_str *restrict const name, const uint32_t perm, const uint8_t mode);
-WARN_UNUSED_RESULT bool dr_9p_encode_Rcreate(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const struct dr_file *restrict const f, const uint32_t iounit);
-WARN_UNUSED_RESULT bool dr_9p_encode_Tread(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const uint32_t fid, const uint64_t offset, const uint32_t count);
 WARN_UNUSED_RESULT bool dr_9p_encode_Rread_iterator(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag);
 WARN_UNUSED_RESULT bool dr_9p_encode_Rread_finish(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint32_t count);
 WARN_UNUSED_RESULT bool dr_9p_encode_Twrite_iterator(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const uint32_t fid, const uint64_t offset);
 WARN_UNUSED_RESULT bool dr_9p_encode_Twrite_finish(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint32_t count);
-WARN_UNUSED_RESULT bool dr_9p_encode_Rwrite(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const uint32_t count);
-WARN_UNUSED_RESULT bool dr_9p_encode_Tclunk(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const uint32_t fid);
-WARN_UNUSED_RESULT bool dr_9p_encode_Rclunk(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag);
-WARN_UNUSED_RESULT bool dr_9p_encode_Tremove(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const uint32_t fid);
-WARN_UNUSED_RESULT bool dr_9p_encode_Rremove(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag);
-WARN_UNUSED_RESULT bool dr_9p_encode_Tstat(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const uint32_t fid);
 WARN_UNUSED_RESULT bool dr_9p_encode_Rstat(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const struct dr_file *restrict const f);
 WARN_UNUSED_RESULT bool dr_9p_encode_Twstat(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const uint32_t fid, const struct dr_9p_stat *restrict const stat);
-WARN_UNUSED_RESULT bool dr_9p_encode_Rwstat(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag);
+void dr_9p_encode_Rlerror(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const uint32_t ecode);
+void dr_9p_encode_Rlerror_err(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const struct dr_error *restrict const error);
+WARN_UNUSED_RESULT bool dr_9p_encode_Rstatfs(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const struct dr_9p_statfs *restrict const statfs);
+WARN_UNUSED_RESULT bool dr_9p_encode_Rgetattr(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const uint64_t valid, const struct dr_file *restrict const f);
+WARN_UNUSED_RESULT uint32_t dr_9p_encode_dirent(uint8_t *restrict const buf, const uint32_t size, const struct dr_file *restrict const f, const uint64_t offset);
+WARN_UNUSED_RESULT bool dr_9p_encode_Rreaddir_iterator(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag);
+WARN_UNUSED_RESULT bool dr_9p_encode_Rreaddir_finish(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint32_t count);
+WARN_UNUSED_RESULT bool dr_9p_encode_Rgetlock(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const struct dr_9p_flock *restrict const flock);
+
+// Calls from many tasks share one connection and are matched by tag, dr_9p_client_task reads the responses and the client owns fd
+WARN_UNUSED_RESULT struct dr_result_void dr_9p_client_init(struct dr_9p_client *restrict const client, struct dr_equeue *restrict const e, dr_handle_t fd, const uint32_t msize);
+void dr_9p_client_destroy(struct dr_9p_client *restrict const client);
+void dr_9p_client_task(void *restrict const arg);
+void dr_9p_client_ready(struct dr_9p_client *restrict const client, struct dr_event *restrict const events, int i);
+WARN_UNUSED_RESULT struct dr_result_uint32 dr_9p_client_call(struct dr_9p_client *restrict const client, uint8_t *restrict const buf, const uint32_t tsize, const uint32_t size);
 
 #endif // DR_H
@@ -0,0 +1,233 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// Copyright (c) 2018 Drew Richardson <drewrichardson@gmail.com>
+
+#include "dr.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dr_types_impl.h"
+
+/*
+ * Each call takes a tag, writes its request and sleeps until the reader task
+ * copies the response with the same tag into the caller's buffer. Requests are
+ * written whole under write_lock so they are never interleaved on the wire.
+ */
+
+struct dr_9p_client_call {
+  struct dr_task *restrict task;
+  uint8_t *restrict buf;
+  uint32_t size;
+  struct dr_result_uint32 result;
+  bool done;
+};
+
+static void dr_9p_client_finish(struct dr_9p_client_impl *restrict const c, const unsigned int slot, const struct dr_result_uint32 result) {
+  struct dr_9p_client_call *restrict const call = c->calls[slot];
+  c->calls[slot] = NULL;
+  call->result = result;
+  call->done = true;
+  dr_task_runnable(call->task);
+}
+
+static void dr_9p_client_fail(struct dr_9p_client_impl *restrict const c) {
+  c->failed = true;
+  for (unsigned int slot = 0; slot <= DR_9P_CLIENT_TAGS; ++slot) {
+    if (c->calls[slot] != NULL) {
+      dr_9p_client_finish(c, slot, DR_RESULT_ERRNUM(uint32, DR_ERR_ISO_C, EPIPE));
+    }
+  }
+}
+
+struct dr_result_void dr_9p_client_init(struct dr_9p_client *restrict const arg0, struct dr_equeue *restrict const e, dr_handle_t fd, const uint32_t msize) {
+  dr_assert(sizeof(struct dr_9p_client) == sizeof(struct dr_9p_client_impl));
+  struct dr_9p_client_impl *restrict const c = (struct dr_9p_client_impl *)arg0;
+  if (dr_unlikely(msize < sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint16_t))) {
+    return DR_RESULT_ERRNUM_VOID(DR_ERR_ISO_C, EINVAL);
+  }
+  *c = (struct dr_9p_client_impl) {
+    .e = e,
+    .free_count = DR_9P_CLIENT_TAGS,
+    .size = msize,
+  };
+  c->buf = (uint8_t *)malloc(msize);
+  if (dr_unlikely(c->buf == NULL)) {
+    return DR_RESULT_ERRNO_VOID();
+  }
+  for (unsigned int i = 0; i < DR_9P_CLIENT_TAGS; ++i) {
+    c->free_tags[i] = DR_9P_CLIENT_TAGS - 1 - i;
+  }
+  {
+    const struct dr_result_void r = dr_sem_init(&c->tags, DR_9P_CLIENT_TAGS);
+    DR_IF_RESULT_ERR(r, err) {
+      free(c->buf);
+      return DR_RESULT_ERROR_VOID(err);
+    } DR_FI_RESULT;
+  }
+  {
+    const struct dr_result_void r = dr_sem_init(&c->write_lock, 1);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_sem_destroy(&c->tags);
+      free(c->buf);
+      return DR_RESULT_ERROR_VOID(err);
+    } DR_FI_RESULT;
+  }
+  dr_equeue_client_init((struct dr_equeue_client *)&c->c, fd);
+  return DR_RESULT_OK_VOID();
+}
+
+void dr_9p_client_destroy(struct dr_9p_client *restrict const arg0) {
+  struct dr_9p_client_impl *restrict const c = (struct dr_9p_client_impl *)arg0;
+  dr_equeue_client_destroy((struct dr_equeue_client *)&c->c);
+  dr_sem_destroy(&c->write_lock);
+  dr_sem_destroy(&c->tags);
+  free(c->buf);
+}
+
+WARN_UNUSED_RESULT static bool dr_9p_client_complete(struct dr_9p_client_impl *restrict const c, const uint8_t *restrict const buf, const uint32_t size) {
+  const uint16_t tag = dr_decode_uint16(buf + sizeof(uint32_t) + sizeof(uint8_t));
+  const unsigned int slot = tag == DR_NOTAG ? DR_9P_CLIENT_TAGS : tag;
+  if (dr_unlikely(slot > DR_9P_CLIENT_TAGS || c->calls[slot] == NULL)) {
+    dr_log("Unexpected tag");
+    return false;
+  }
+  if (dr_unlikely(size > c->calls[slot]->size)) {
+    dr_9p_client_finish(c, slot, DR_RESULT_ERRNUM(uint32, DR_ERR_ISO_C, EMSGSIZE));
+    return true;
+  }
+  memcpy(c->calls[slot]->buf, buf, size);
+  dr_9p_client_finish(c, slot, DR_RESULT_OK(uint32, size));
+  return true;
+}
+
+void dr_9p_client_task(void *restrict const arg) {
+  struct dr_9p_client_impl *restrict const c = (struct dr_9p_client_impl *)arg;
+  c->reader = dr_task_self();
+  while (true) {
+    size_t bytes;
+    {
+      const struct dr_result_size r = dr_equeue_read(c->e, (struct dr_equeue_client *)&c->c, c->buf + c->len, c->size - c->len);
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_equeue_read failed", err);
+	break;
+      } DR_ELIF_RESULT_OK(size_t, r, value) {
+	bytes = value;
+      } DR_FI_RESULT;
+    }
+    if (bytes == 0) {
+      break;
+    }
+    c->len += bytes;
+    uint32_t pos = 0;
+    while (c->len - pos >= sizeof(uint32_t)) {
+      const uint32_t rsize = dr_decode_uint32(c->buf + pos);
+      if (dr_unlikely(rsize < sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint16_t) || rsize > c->size)) {
+	dr_log("Invalid message size");
+	goto fail;
+      }
+      if (c->len - pos < rsize) {
+	break;
+      }
+      if (dr_unlikely(!dr_9p_client_complete(c, c->buf + pos, rsize))) {
+	goto fail;
+      }
+      pos += rsize;
+    }
+    c->len -= pos;
+    memmove(c->buf, c->buf + pos, c->len);
+  }
+ fail:
+  c->reader = NULL;
+  dr_9p_client_fail(c);
+}
+
+void dr_9p_client_ready(struct dr_9p_client *restrict const arg0, struct dr_event *restrict const events, int i) {
+  struct dr_9p_client_impl *restrict const c = (struct dr_9p_client_impl *)arg0;
+  if (dr_event_is_read(events, i) && c->reader != NULL) {
+    dr_task_runnable(c->reader);
+  }
+  if (dr_event_is_write(events, i) && c->writer != NULL) {
+    dr_task_runnable(c->writer);
+  }
+}
+
+WARN_UNUSED_RESULT static struct dr_result_void dr_9p_client_write(struct dr_9p_client_impl *restrict const c, const uint8_t *restrict const buf, const uint32_t size) {
+  {
+    const struct dr_result_void r = dr_sem_wait(&c->write_lock);
+    DR_IF_RESULT_ERR(r, err) {
+      return DR_RESULT_ERROR_VOID(err);
+    } DR_FI_RESULT;
+  }
+  c->writer = dr_task_self();
+  struct dr_result_void result = DR_RESULT_OK_VOID();
+  if (dr_unlikely(c->failed)) {
+    result = DR_RESULT_ERRNUM_VOID(DR_ERR_ISO_C, EPIPE);
+    goto done;
+  }
+  for (uint32_t pos = 0; pos < size;) {
+    const struct dr_result_size r = dr_equeue_write(c->e, (struct dr_equeue_client *)&c->c, buf + pos, size - pos);
+    DR_IF_RESULT_ERR(r, err) {
+      result = DR_RESULT_ERROR_VOID(err);
+      goto done;
+    } DR_ELIF_RESULT_OK(size_t, r, value) {
+      pos += value;
+    } DR_FI_RESULT;
+  }
+ done:
+  c->writer = NULL;
+  {
+    const struct dr_result_void r = dr_sem_post(&c->write_lock);
+    (void)r;
+  }
+  return result;
+}
+
+struct dr_result_uint32 dr_9p_client_call(struct dr_9p_client *restrict const arg0, uint8_t *restrict const buf, const uint32_t tsize, const uint32_t size) {
+  struct dr_9p_client_impl *restrict const c = (struct dr_9p_client_impl *)arg0;
+  if (dr_unlikely(tsize < sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint16_t) || tsize > c->size)) {
+    return DR_RESULT_ERRNUM(uint32, DR_ERR_ISO_C, EINVAL);
+  }
+  if (dr_unlikely(c->failed)) {
+    return DR_RESULT_ERRNUM(uint32, DR_ERR_ISO_C, EPIPE);
+  }
+  unsigned int slot;
+  if (dr_decode_uint16(buf + sizeof(uint32_t) + sizeof(uint8_t)) == DR_NOTAG) {
+    slot = DR_9P_CLIENT_TAGS;
+    if (dr_unlikely(c->calls[slot] != NULL)) {
+      return DR_RESULT_ERRNUM(uint32, DR_ERR_ISO_C, EBUSY);
+    }
+  } else {
+    const struct dr_result_void r = dr_sem_wait(&c->tags);
+    DR_IF_RESULT_ERR(r, err) {
+      return DR_RESULT_ERROR(uint32, err);
+    } DR_FI_RESULT;
+    slot = c->free_tags[--c->free_count];
+    dr_encode_uint16(buf + sizeof(uint32_t) + sizeof(uint8_t), slot);
+  }
+  struct dr_9p_client_call call = {
+    .task = dr_task_self(),
+    .buf = buf,
+    .size = size,
+  };
+  c->calls[slot] = &call;
+  {
+    const struct dr_result_void r = dr_9p_client_write(c, buf, tsize);
+    DR_IF_RESULT_ERR(r, err) {
+      // A partial request leaves the stream unusable
+      if (c->calls[slot] == &call) {
+	dr_9p_client_finish(c, slot, DR_RESULT_ERROR(uint32, err));
+      }
+      dr_9p_client_fail(c);
+    } DR_FI_RESULT;
+  }
+  while (!call.done) {
+    dr_schedule(true);
+  }
+  if (slot != DR_9P_CLIENT_TAGS) {
+    c->free_tags[c->free_count++] = slot;
+    const struct dr_result_void r = dr_sem_post(&c->tags);
+    (void)r;
+  }
+  return call.result;
+}
@@ -3,40 +3,13 @@
 
 #include "dr.h"
 
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+
 static const uint32_t header_size = sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint16_t);
 static const uint32_t qid_size = sizeof(uint8_t) + sizeof(uint32_t) + sizeof(uint64_t);
 
-#define dr_decode_uintn(type, result, buf) \
-  do { \
-    for (size_t i = 0; i < sizeof(result); ++i) { \
-      (result) |= ((type)(buf)[i]) << 8 * i; \
-    } \
-  } while (false)
-
-uint8_t dr_decode_uint8(const uint8_t *restrict const buf) {
-  uint8_t result = 0;
-  dr_decode_uintn(uint8_t, result, buf);
-  return result;
-}
-
-uint16_t dr_decode_uint16(const uint8_t *restrict const buf) {
-  uint16_t result = 0;
-  dr_decode_uintn(uint16_t, result, buf);
-  return result;
-}
-
-uint32_t dr_decode_uint32(const uint8_t *restrict const buf) {
-  uint32_t result = 0;
-  dr_decode_uintn(uint32_t, result, buf);
-  return result;
-}
-
-uint64_t dr_decode_uint64(const uint8_t *restrict const buf) {
-  uint64_t result = 0;
-  dr_decode_uintn(uint64_t, result, buf);
-  return result;
-}
-
 // Move into a function so that the warning only happens once :(
 static void dr_9p_set_str(struct dr_str *restrict const str, const uint16_t len, const uint8_t *restrict const buf) {
   str->len = len;
@@ -50,55 +23,54 @@ static void dr_9p_decode_qid(struct dr_9p_qid *restrict const qid, const uint8_t
   qid->path = dr_decode_uint64(buf + sizeof(uint8_t) + sizeof(uint32_t));
 }
 
+// Takes the next string, avail is the number of string bytes left in the message
+WARN_UNUSED_RESULT static bool dr_9p_decode_str(struct dr_str *restrict const str, const uint8_t *restrict *restrict const cur, uint32_t *restrict const avail) {
+  const uint16_t len = dr_decode_uint16(*cur);
+  if (dr_unlikely(len > *avail)) {
+    return false;
+  }
+  *avail -= len;
+  dr_9p_set_str(str, len, *cur + sizeof(uint16_t));
+  *cur += sizeof(uint16_t) + len;
+  return true;
+}
+
+// size[2] type[2] dev[4] qid[13] mode[4] atime[4] mtime[4] length[8] name[s] uid[s] gid[s] muid[s]
+
 uint32_t dr_9p_decode_stat(struct dr_9p_stat *restrict const stat, const uint8_t *restrict const buf, const uint32_t size) {
+  const uint32_t fixed_size = sizeof(uint16_t) + sizeof(uint16_t) + sizeof(uint32_t) + qid_size + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint64_t) + 4*sizeof(uint16_t);
   if (dr_unlikely(size < sizeof(uint16_t))) {
     return FAIL_UINT32;
   }
-  const uint16_t stat_size = dr_decode_uint16(buf);
-  if (dr_unlikely((size < sizeof(uint16_t) + stat_size) ||
-		  (size < sizeof(uint16_t) + sizeof(uint16_t) + sizeof(uint32_t) + qid_size + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint16_t)))) {
+  const uint32_t stat_size = sizeof(uint16_t) + dr_decode_uint16(buf);
+  if (dr_unlikely(size < stat_size || stat_size < fixed_size)) {
     return FAIL_UINT32;
   }
-  const uint16_t name_len = dr_decode_uint16(buf + sizeof(uint16_t) + sizeof(uint16_t) + sizeof(uint32_t) + qid_size + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint64_t));
-  if (dr_unlikely(size < sizeof(uint16_t) + sizeof(uint16_t) + sizeof(uint32_t) + qid_size + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint16_t) + name_len + sizeof(uint16_t))) {
+  // Everything past the fixed fields belongs to the four strings
+  uint32_t avail = stat_size - fixed_size;
+  const uint8_t *restrict cur = buf + sizeof(uint16_t);
+  stat->type = dr_decode_uint16(cur);
+  cur += sizeof(uint16_t);
+  stat->dev = dr_decode_uint32(cur);
+  cur += sizeof(uint32_t);
+  dr_9p_decode_qid(&stat->qid, cur);
+  cur += qid_size;
+  stat->mode = dr_decode_uint32(cur);
+  cur += sizeof(uint32_t);
+  stat->atime = dr_decode_uint32(cur);
+  cur += sizeof(uint32_t);
+  stat->mtime = dr_decode_uint32(cur);
+  cur += sizeof(uint32_t);
+  stat->length = dr_decode_uint64(cur);
+  cur += sizeof(uint64_t);
+  if (dr_unlikely(!dr_9p_decode_str(&stat->name, &cur, &avail) ||
+		  !dr_9p_decode_str(&stat->uid, &cur, &avail) ||
+		  !dr_9p_decode_str(&stat->gid, &cur, &avail) ||
+		  !dr_9p_decode_str(&stat->muid, &cur, &avail) ||
+		  avail != 0)) {
     return FAIL_UINT32;
   }
-  const uint16_t uid_len = dr_decode_uint16(buf + sizeof(uint16_t) + sizeof(uint16_t) + sizeof(uint32_t) + qid_size + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint16_t) + name_len);
-  if (dr_unlikely(size < sizeof(uint16_t) + sizeof(uint16_t) + sizeof(uint32_t) + qid_size + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint16_t) + name_len + sizeof(uint16_t) + uid_len + sizeof(uint16_t))) {
-    return FAIL_UINT32;
-  }
-  const uint16_t gid_len = dr_decode_uint16(buf + sizeof(uint16_t) + sizeof(uint16_t) + sizeof(uint32_t) + qid_size + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint16_t) + name_len + sizeof(uint16_t) + uid_len);
-  if (dr_unlikely(size < sizeof(uint16_t) + sizeof(uint16_t) + sizeof(uint32_t) + qid_size + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint16_t) + name_len + sizeof(uint16_t) + uid_len + sizeof(uint16_t) + gid_len + sizeof(uint16_t))) {
-    return FAIL_UINT32;
-  }
-  const uint16_t muid_len = dr_decode_uint16(buf + sizeof(uint16_t) + sizeof(uint16_t) + sizeof(uint32_t) + qid_size + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint16_t) + name_len + sizeof(uint16_t) + uid_len + sizeof(uint16_t) + gid_len);
-  if (dr_unlikely(size < sizeof(uint16_t) + sizeof(uint16_t) + sizeof(uint32_t) + qid_size + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint16_t) + name_len + sizeof(uint16_t) + uid_len + sizeof(uint16_t) + gid_len + sizeof(uint16_t) + muid_len)) {
-    return FAIL_UINT32;
-  }
-  uint32_t spos = sizeof(uint16_t);
-  stat->type = dr_decode_uint16(buf + spos);
-  spos += sizeof(uint16_t);
-  stat->dev = dr_decode_uint32(buf + spos);
-  spos += sizeof(uint32_t);
-  dr_9p_decode_qid(&stat->qid, buf + spos);
-  spos += qid_size;
-  stat->mode = dr_decode_uint32(buf + spos);
-  spos += sizeof(uint32_t);
-  stat->atime = dr_decode_uint32(buf + spos);
-  spos += sizeof(uint32_t);
-  stat->mtime = dr_decode_uint32(buf + spos);
-  spos += sizeof(uint32_t);
-  stat->length = dr_decode_uint64(buf + spos);
-  spos += sizeof(uint64_t) + sizeof(uint16_t);
-  dr_9p_set_str(&stat->name, name_len, buf + spos);
-  spos += name_len + sizeof(uint16_t);
-  dr_9p_set_str(&stat->uid, uid_len, buf + spos);
-  spos += uid_len + sizeof(uint16_t);
-  dr_9p_set_str(&stat->gid, gid_len, buf + spos);
-  spos += gid_len + sizeof(uint16_t);
-  dr_9p_set_str(&stat->muid, muid_len, buf + spos);
-  spos += muid_len;
-  return spos;
+  return stat_size;
 }
 
 bool dr_9p_decode_header(uint8_t *restrict const type, uint16_t *restrict const tag, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos) {
@@ -111,101 +83,152 @@ bool dr_9p_decode_header(uint8_t *restrict const type, uint16_t *restrict const
   return true;
 }
 
-// size[4] Tversion tag[2] msize[4] version[s]
+// Decoders for the messages in dr_9p_schema.h. The fixed fields are checked once and each string is charged against the bytes left over
 
-bool dr_9p_decode_Tversion(uint32_t *restrict const msize, struct dr_str *restrict const version, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos) {
-  if (dr_unlikely(size < header_size + sizeof(uint32_t) + sizeof(uint16_t))) {
-    return false;
-  }
-  const uint16_t version_len = dr_decode_uint16(buf + header_size + sizeof(uint32_t));
-  if (dr_unlikely(size != header_size + sizeof(uint32_t) + sizeof(uint16_t) + version_len)) {
-    return false;
-  }
-  *msize = dr_decode_uint32(buf + header_size);
-  dr_9p_set_str(version, version_len, buf + header_size + sizeof(uint32_t) + sizeof(uint16_t));
-  *pos = header_size + sizeof(uint32_t) + sizeof(uint16_t) + version_len;
-  return true;
-}
+#define DR_9P_FIXED_SIZE(KIND, FIELD) + DR_9P_SIZE_##KIND
 
-// size[4] Rversion tag[2] msize[4] version[s]
+#define DR_9P_DECODE_U8(FIELD) *FIELD = dr_decode_uint8(cur); cur += sizeof(uint8_t);
+#define DR_9P_DECODE_U16(FIELD) *FIELD = dr_decode_uint16(cur); cur += sizeof(uint16_t);
+#define DR_9P_DECODE_U32(FIELD) *FIELD = dr_decode_uint32(cur); cur += sizeof(uint32_t);
+#define DR_9P_DECODE_U64(FIELD) *FIELD = dr_decode_uint64(cur); cur += sizeof(uint64_t);
+#define DR_9P_DECODE_STR(FIELD) if (dr_unlikely(!dr_9p_decode_str(FIELD, &cur, &avail))) { return false; }
+#define DR_9P_DECODE_QID(FIELD) dr_9p_decode_qid(FIELD, cur); cur += qid_size;
+#define DR_9P_DECODE_FIELD(KIND, FIELD) DR_9P_DECODE_##KIND(FIELD)
 
-bool dr_9p_decode_Rversion(uint32_t *restrict const msize, struct dr_str *restrict const version, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos) {
-  return dr_9p_decode_Tversion(msize, version, buf, size, pos);
-}
+#define DR_9P_DECODER(NAME) \
+  DR_9P_DECODE_PROTO(NAME) { \
+    const uint32_t fixed_size = header_size DR_9P_FIELDS_##NAME(DR_9P_FIXED_SIZE); \
+    if (dr_unlikely(size < fixed_size)) { \
+      return false; \
+    } \
+    uint32_t avail = size - fixed_size; \
+    const uint8_t *restrict cur = buf + header_size; \
+    DR_9P_FIELDS_##NAME(DR_9P_DECODE_FIELD) \
+    if (dr_unlikely(avail != 0)) { \
+      return false; \
+    } \
+    *pos = size; \
+    return true; \
+  }
 
-// size[4] Tauth tag[2] afid[4] uname[s] aname[s]
-// size[4] Rauth tag[2] aqid[13]
+#define DR_9P_DECODER_BOTH(NAME) DR_9P_DECODER(NAME)
+#define DR_9P_DECODER_DEC(NAME) DR_9P_DECODER(NAME)
+#define DR_9P_DECODER_ENC(NAME)
+#define DR_9P_DEFINE_DECODER(DIR, NAME, TYPE) DR_9P_DECODER_##DIR(NAME)
 
-bool dr_9p_decode_Tauth(uint32_t *restrict const afid, struct dr_str *restrict const uname, struct dr_str *restrict const aname, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos) {
-  if (dr_unlikely(size < header_size + sizeof(uint32_t) + sizeof(uint16_t))) {
-    return false;
-  }
-  const uint16_t uname_len = dr_decode_uint16(buf + header_size + sizeof(uint32_t));
-  if (dr_unlikely(size < header_size + sizeof(uint32_t) + sizeof(uint16_t) + uname_len + sizeof(uint16_t))) {
-    return false;
-  }
-  const uint16_t aname_len = dr_decode_uint16(buf + header_size + sizeof(uint32_t) + sizeof(uint16_t) + uname_len);
-  if (dr_unlikely(size != header_size + sizeof(uint32_t) + sizeof(uint16_t) + uname_len + sizeof(uint16_t) + aname_len)) {
-    return false;
-  }
-  *afid = dr_decode_uint32(buf + header_size);
-  dr_9p_set_str(uname, uname_len, buf + header_size + sizeof(uint32_t) + sizeof(uint16_t));
-  dr_9p_set_str(aname, aname_len, buf + header_size + sizeof(uint32_t) + sizeof(uint16_t) + uname_len + sizeof(uint16_t));
-  *pos = header_size + sizeof(uint32_t) + sizeof(uint16_t) + uname_len + sizeof(uint16_t) + aname_len;
-  return true;
-}
+DR_9P_MESSAGES(DR_9P_DEFINE_DECODER)
 
-// size[4] Rerror tag[2] ename[s]
+// The same decoders without the checks, for messages dr_9p_decode_frames has already checked
 
-bool dr_9p_decode_Rerror(struct dr_str *restrict const ename, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos) {
-  if (dr_unlikely(size < header_size + sizeof(uint16_t))) {
-    return false;
-  }
-  const uint16_t ename_len = dr_decode_uint16(buf + header_size);
-  if (dr_unlikely(size != header_size + sizeof(uint16_t) + ename_len)) {
-    return false;
+#define DR_9P_DECODE_VALID_STR(FIELD) dr_9p_set_str(FIELD, dr_decode_uint16(cur), cur + sizeof(uint16_t)); cur += sizeof(uint16_t) + (FIELD)->len;
+#define DR_9P_DECODE_VALID_FIELD(KIND, FIELD) DR_9P_DECODE_VALID_##KIND(FIELD)
+#define DR_9P_DECODE_VALID_U8 DR_9P_DECODE_U8
+#define DR_9P_DECODE_VALID_U16 DR_9P_DECODE_U16
+#define DR_9P_DECODE_VALID_U32 DR_9P_DECODE_U32
+#define DR_9P_DECODE_VALID_U64 DR_9P_DECODE_U64
+#define DR_9P_DECODE_VALID_QID DR_9P_DECODE_QID
+
+#define DR_9P_VALID_DECODER(NAME) \
+  DR_9P_DECODE_VALID_PROTO(NAME) { \
+    const uint8_t *restrict cur = buf + header_size; \
+    DR_9P_FIELDS_##NAME(DR_9P_DECODE_VALID_FIELD) \
+    (void)cur; \
+    *pos = size; \
   }
-  dr_9p_set_str(ename, ename_len, buf + header_size + sizeof(uint16_t));
-  *pos = header_size + sizeof(uint16_t) + ename_len;
-  return true;
-}
 
-// size[4] Tflush tag[2] oldtag[2]
-// size[4] Rflush tag[2]
+#define DR_9P_VALID_DECODER_BOTH(NAME) DR_9P_VALID_DECODER(NAME)
+#define DR_9P_VALID_DECODER_DEC(NAME) DR_9P_VALID_DECODER(NAME)
+#define DR_9P_VALID_DECODER_ENC(NAME)
+#define DR_9P_DEFINE_VALID_DECODER(DIR, NAME, TYPE) DR_9P_VALID_DECODER_##DIR(NAME)
 
-// size[4] Tattach tag[2] fid[4] afid[4] uname[s] aname[s]
+DR_9P_MESSAGES(DR_9P_DEFINE_VALID_DECODER)
 
-bool dr_9p_decode_Tattach(uint32_t *restrict const fid, uint32_t *restrict const afid, struct dr_str *restrict const uname, struct dr_str *restrict const aname, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos) {
-  if (dr_unlikely(size < header_size + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint16_t))) {
-    return false;
-  }
-  const uint16_t uname_len = dr_decode_uint16(buf + header_size + sizeof(uint32_t) + sizeof(uint32_t));
-  if (dr_unlikely(size < header_size + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint16_t) + uname_len + sizeof(uint16_t))) {
-    return false;
+// Layout checks for dr_9p_decode_frames, which accept a message that matches any schema entry of its type
+
+#define DR_9P_CHECK_U8 cur += sizeof(uint8_t);
+#define DR_9P_CHECK_U16 cur += sizeof(uint16_t);
+#define DR_9P_CHECK_U32 cur += sizeof(uint32_t);
+#define DR_9P_CHECK_U64 cur += sizeof(uint64_t);
+#define DR_9P_CHECK_STR { \
+    const uint16_t len = dr_decode_uint16(cur); \
+    if (len > avail) { \
+      return false; \
+    } \
+    avail -= len; \
+    cur += sizeof(uint16_t) + len; \
   }
-  const uint16_t aname_len = dr_decode_uint16(buf + header_size + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint16_t) + uname_len);
-  if (dr_unlikely(size != header_size + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint16_t) + uname_len + sizeof(uint16_t) + aname_len)) {
-    return false;
+#define DR_9P_CHECK_QID cur += qid_size;
+#define DR_9P_CHECK_FIELD(KIND, FIELD) DR_9P_CHECK_##KIND
+
+#define DR_9P_CHECKER(DIR, NAME, TYPE) \
+  WARN_UNUSED_RESULT static bool dr_9p_check_##NAME(const uint8_t *restrict const buf, const uint32_t size) { \
+    const uint32_t fixed_size = header_size DR_9P_FIELDS_##NAME(DR_9P_FIXED_SIZE); \
+    if (size < fixed_size) { \
+      return false; \
+    } \
+    uint32_t avail = size - fixed_size; \
+    const uint8_t *restrict cur = buf + header_size; \
+    DR_9P_FIELDS_##NAME(DR_9P_CHECK_FIELD) \
+    (void)cur; \
+    return avail == 0; \
   }
-  *fid = dr_decode_uint32(buf + header_size);
-  *afid = dr_decode_uint32(buf + header_size + sizeof(uint32_t));
-  dr_9p_set_str(uname, uname_len, buf + header_size + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint16_t));
-  dr_9p_set_str(aname, aname_len, buf + header_size + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint16_t) + uname_len + sizeof(uint16_t));
-  *pos = header_size + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint16_t) + uname_len + sizeof(uint16_t) + aname_len;
-  return true;
-}
 
-// size[4] Rattach tag[2] qid[13]
+DR_9P_MESSAGES(DR_9P_CHECKER)
 
-bool dr_9p_decode_Rattach(struct dr_9p_qid *restrict const qid, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos) {
-  if (dr_unlikely(size != header_size + qid_size)) {
-    return false;
+#define DR_9P_CHECK_TYPE(DIR, NAME, TYPE) \
+  if (type == TYPE) { \
+    if (dr_9p_check_##NAME(buf, size)) { \
+      return true; \
+    } \
+    known = true; \
+  }
+
+// Messages outside the schema are left to their handlers, which answer unknown types with an error
+WARN_UNUSED_RESULT static bool dr_9p_check_frame(const uint8_t *restrict const buf, const uint32_t size) {
+  const uint8_t type = dr_decode_uint8(buf + sizeof(uint32_t));
+  bool known = false;
+  DR_9P_MESSAGES(DR_9P_CHECK_TYPE)
+  return !known;
+}
+
+uint32_t dr_9p_decode_frames(struct dr_9p_frame *restrict const frames, const uint32_t max_frames, const uint8_t *restrict const buf, const uint32_t len, const uint32_t max_size, uint32_t *restrict const used) {
+  // Each size prefix gives the next position, so this walk is serial and only records the frames
+  uint32_t count = 0;
+  uint32_t pos = 0;
+  while (count < max_frames && len - pos >= sizeof(uint32_t)) {
+    const uint32_t size = dr_decode_uint32(buf + pos);
+    if (len - pos < size) {
+      // A message that can never fit would otherwise wait forever
+      if (dr_unlikely(size > max_size)) {
+	return FAIL_UINT32;
+      }
+      break;
+    }
+    frames[count].pos = pos;
+    frames[count].size = size;
+    ++count;
+    pos += size;
+  }
+  // Branch free over the whole batch so it can be vectorized
+  bool bad = false;
+  for (uint32_t i = 0; i < count; ++i) {
+    bad |= frames[i].size - header_size > max_size - header_size;
+  }
+  if (dr_unlikely(bad)) {
+    return FAIL_UINT32;
   }
-  dr_9p_decode_qid(qid, buf + header_size);
-  *pos = header_size + qid_size;
-  return true;
+  for (uint32_t i = 0; i < count; ++i) {
+    if (dr_unlikely(!dr_9p_check_frame(buf + frames[i].pos, frames[i].size))) {
+      return FAIL_UINT32;
+    }
+  }
+  *used = pos;
+  return count;
 }
 
+// size[4] Tflush tag[2] oldtag[2]
+// size[4] Rflush tag[2]
+
 // size[4] Twalk tag[2] fid[4] newfid[4] nwname[2] nwname*(wname[s])
 
 bool dr_9p_decode_Twalk_iterator(uint32_t *restrict const fid, uint32_t *restrict const newfid, uint16_t *restrict const nwname, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos) {
@@ -266,72 +289,9 @@ bool dr_9p_decode_Rwalk_finish(const uint32_t size, const uint32_t pos) {
   return pos == size;
 }
 
-// size[4] Topen tag[2] fid[4] mode[1]
-
-bool dr_9p_decode_Topen(uint32_t *restrict const fid, uint8_t *restrict const mode, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos) {
-  if (dr_unlikely(size != header_size + sizeof(uint32_t) + sizeof(uint8_t))) {
-    return false;
-  }
-  *fid = dr_decode_uint32(buf + header_size);
-  *mode = dr_decode_uint8(buf + header_size + sizeof(uint32_t));
-  *pos = header_size + sizeof(uint32_t) + sizeof(uint8_t);
-  return true;
-}
-
-// The iounit field returned by open(9P), if non-zero, reports the maximum size that is guaranteed to be transferred atomically.
-
-// size[4] Ropen tag[2] qid[13] iounit[4]
-
-bool dr_9p_decode_Ropen(struct dr_9p_qid *restrict const qid, uint32_t *restrict const iounit, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos) {
-  if (dr_unlikely(size != header_size + qid_size + sizeof(uint32_t))) {
-    return false;
-  }
-  dr_9p_decode_qid(qid, buf + header_size);
-  *iounit = dr_decode_uint32(buf + header_size + qid_size);
-  *pos = header_size + qid_size + sizeof(uint32_t);
-  return true;
-}
-
 // size[4] Topenfd tag[2] fid[4] mode[1]
 // size[4] Ropenfd tag[2] qid[13] iounit[4] unixfd[4]
 
-// size[4] Tcreate tag[2] fid[4] name[s] perm[4] mode[1]
-
-bool dr_9p_decode_Tcreate(uint32_t *restrict const fid, struct dr_str *restrict const name, uint32_t *restrict const perm, uint8_t *restrict const mode, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos) {
-  if (dr_unlikely(size < header_size + sizeof(uint32_t) + sizeof(uint16_t))) {
-    return false;
-  }
-  const uint16_t name_len = dr_decode_uint16(buf + header_size + sizeof(uint32_t));
-  if (dr_unlikely(size != header_size + sizeof(uint32_t) + sizeof(uint16_t) + name_len + sizeof(uint32_t) + sizeof(uint8_t))) {
-    return false;
-  }
-  *fid = dr_decode_uint32(buf + header_size);
-  dr_9p_set_str(name, name_len, buf + header_size + sizeof(uint32_t) + sizeof(uint16_t));
-  *perm = dr_decode_uint32(buf + header_size + sizeof(uint32_t) + sizeof(uint16_t) + name_len);
-  *mode = dr_decode_uint8(buf + header_size + sizeof(uint32_t) + sizeof(uint16_t) + name_len + sizeof(uint32_t));
-  *pos = header_size + sizeof(uint32_t) + sizeof(uint16_t) + name_len + sizeof(uint32_t) + sizeof(uint8_t);
-  return true;
-}
-
-// size[4] Rcreate tag[2] qid[13] iounit[4]
-
-bool dr_9p_decode_Rcreate(struct dr_9p_qid *restrict const qid, uint32_t *restrict const iounit, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos) {
-  return dr_9p_decode_Ropen(qid, iounit, buf, size, pos);
-}
-
-// size[4] Tread tag[2] fid[4] offset[8] count[4]
-
-bool dr_9p_decode_Tread(uint32_t *restrict const fid, uint64_t *restrict const offset, uint32_t *restrict const count, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos) {
-  if (dr_unlikely(size != header_size + sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint32_t))) {
-    return false;
-  }
-  *fid = dr_decode_uint32(buf + header_size);
-  *offset = dr_decode_uint64(buf + header_size + sizeof(uint32_t));
-  *count = dr_decode_uint32(buf + header_size + sizeof(uint32_t) + sizeof(uint64_t));
-  *pos = header_size + sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint32_t);
-  return true;
-}
-
 // size[4] Rread tag[2] count[4] data[count]
 
 bool dr_9p_decode_Rread(uint32_t *restrict const count, const void *restrict *restrict const data, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos) {
@@ -366,23 +326,6 @@ bool dr_9p_decode_Twrite(uint32_t *restrict const fid, uint64_t *restrict const
   return true;
 }
 
-// size[4] Rwrite tag[2] count[4]
-
-bool dr_9p_decode_Rwrite(uint32_t *restrict const count, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos) {
-  if (dr_unlikely(size != header_size + sizeof(uint32_t))) {
-    return false;
-  }
-  *count = dr_decode_uint32(buf + header_size);
-  *pos = header_size + sizeof(uint32_t);
-  return true;
-}
-
-// size[4] Tclunk tag[2] fid[4]
-
-bool dr_9p_decode_Tclunk(uint32_t *restrict const fid, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos) {
-  return dr_9p_decode_Rwrite(fid, buf, size, pos);
-}
-
 // size[4] Rclunk tag[2]
 
 bool dr_9p_decode_Rclunk(const uint32_t size, uint32_t *restrict const pos) {
@@ -393,24 +336,12 @@ bool dr_9p_decode_Rclunk(const uint32_t size, uint32_t *restrict const pos) {
   return true;
 }
 
-// size[4] Tremove tag[2] fid[4]
-
-bool dr_9p_decode_Tremove(uint32_t *restrict const fid, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos) {
-  return dr_9p_decode_Rwrite(fid, buf, size, pos);
-}
-
 // size[4] Rremove tag[2]
 
 bool dr_9p_decode_Rremove(const uint32_t size, uint32_t *restrict const pos) {
   return dr_9p_decode_Rclunk(size, pos);
 }
 
-// size[4] Tstat tag[2] fid[4]
-
-bool dr_9p_decode_Tstat(uint32_t *restrict const fid, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos) {
-  return dr_9p_decode_Rwrite(fid, buf, size, pos);
-}
-
 // size[4] Rstat tag[2] stat[n]
 
 bool dr_9p_decode_Rstat(struct dr_9p_stat *restrict const stat, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos) {
@@ -459,3 +390,147 @@ bool dr_9p_decode_Twstat(uint32_t *restrict const fid, struct dr_9p_stat *restri
 bool dr_9p_decode_Rwstat(const uint32_t size, uint32_t *restrict const pos) {
   return dr_9p_decode_Rclunk(size, pos);
 }
+
+// 9P2000.L
+
+// size[4] Tfsync tag[2] fid[4] datasync[4]
+
+bool dr_9p_decode_Tfsync(uint32_t *restrict const fid, uint32_t *restrict const datasync, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos) {
+  // Older kernels omit datasync
+  if (size == header_size + sizeof(uint32_t)) {
+    *datasync = 0;
+    return dr_9p_decode_Rwrite(fid, buf, size, pos);
+  }
+  if (dr_unlikely(size != header_size + sizeof(uint32_t) + sizeof(uint32_t))) {
+    return false;
+  }
+  *fid = dr_decode_uint32(buf + header_size);
+  *datasync = dr_decode_uint32(buf + header_size + sizeof(uint32_t));
+  *pos = header_size + sizeof(uint32_t) + sizeof(uint32_t);
+  return true;
+}
+
+// size[4] Tlock tag[2] fid[4] type[1] flags[4] start[8] length[8] proc_id[4] client_id[s]
+
+bool dr_9p_decode_Tlock(uint32_t *restrict const fid, struct dr_9p_flock *restrict const flock, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos) {
+  if (dr_unlikely(size < header_size + sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint64_t) + sizeof(uint32_t) + sizeof(uint16_t))) {
+    return false;
+  }
+  const uint16_t client_id_len = dr_decode_uint16(buf + header_size + sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint64_t) + sizeof(uint32_t));
+  if (dr_unlikely(size != header_size + sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint64_t) + sizeof(uint32_t) + sizeof(uint16_t) + client_id_len)) {
+    return false;
+  }
+  *fid = dr_decode_uint32(buf + header_size);
+  flock->type = dr_decode_uint8(buf + header_size + sizeof(uint32_t));
+  flock->flags = dr_decode_uint32(buf + header_size + sizeof(uint32_t) + sizeof(uint8_t));
+  flock->start = dr_decode_uint64(buf + header_size + sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint32_t));
+  flock->length = dr_decode_uint64(buf + header_size + sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint32_t) + sizeof(uint64_t));
+  flock->proc_id = dr_decode_uint32(buf + header_size + sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint64_t));
+  dr_9p_set_str(&flock->client_id, client_id_len, buf + header_size + sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint64_t) + sizeof(uint32_t) + sizeof(uint16_t));
+  *pos = header_size + sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint64_t) + sizeof(uint32_t) + sizeof(uint16_t) + client_id_len;
+  return true;
+}
+
+// size[4] Tgetlock tag[2] fid[4] type[1] start[8] length[8] proc_id[4] client_id[s]
+
+bool dr_9p_decode_Tgetlock(uint32_t *restrict const fid, struct dr_9p_flock *restrict const flock, const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos) {
+  if (dr_unlikely(size < header_size + sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint64_t) + sizeof(uint64_t) + sizeof(uint32_t) + sizeof(uint16_t))) {
+    return false;
+  }
+  const uint16_t client_id_len = dr_decode_uint16(buf + header_size + sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint64_t) + sizeof(uint64_t) + sizeof(uint32_t));
+  if (dr_unlikely(size != header_size + sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint64_t) + sizeof(uint64_t) + sizeof(uint32_t) + sizeof(uint16_t) + client_id_len)) {
+    return false;
+  }
+  *fid = dr_decode_uint32(buf + header_size);
+  flock->type = dr_decode_uint8(buf + header_size + sizeof(uint32_t));
+  flock->flags = 0;
+  flock->start = dr_decode_uint64(buf + header_size + sizeof(uint32_t) + sizeof(uint8_t));
+  flock->length = dr_decode_uint64(buf + header_size + sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint64_t));
+  flock->proc_id = dr_decode_uint32(buf + header_size + sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint64_t) + sizeof(uint64_t));
+  dr_9p_set_str(&flock->client_id, client_id_len, buf + header_size + sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint64_t) + sizeof(uint64_t) + sizeof(uint32_t) + sizeof(uint16_t));
+  *pos = header_size + sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint64_t) + sizeof(uint64_t) + sizeof(uint32_t) + sizeof(uint16_t) + client_id_len;
+  return true;
+}
+
+static void dr_9p_append(char *restrict const out, const size_t out_size, size_t *restrict const len, const char *restrict const format, ...) {
+  va_list ap;
+  va_start(ap, format);
+  const int written = vsnprintf(out + *len, out_size - *len, format, ap);
+  va_end(ap);
+  if (written > 0) {
+    *len += (size_t)written < out_size - *len ? (size_t)written : out_size - *len - 1;
+  }
+}
+
+static const char *const dr_9p_names[256] = {
+  [DR_TVERSION] = "Tversion",
+  [DR_TAUTH] = "Tauth",
+  [DR_TATTACH] = "Tattach",
+  [DR_TWALK] = "Twalk",
+  [DR_TOPEN] = "Topen",
+  [DR_TCREATE] = "Tcreate",
+  [DR_TREAD] = "Tread",
+  [DR_TWRITE] = "Twrite",
+  [DR_TCLUNK] = "Tclunk",
+  [DR_TREMOVE] = "Tremove",
+  [DR_TSTAT] = "Tstat",
+  [DR_TWSTAT] = "Twstat",
+  [DR_TSTATFS] = "Tstatfs",
+  [DR_TLOPEN] = "Tlopen",
+  [DR_TGETATTR] = "Tgetattr",
+  [DR_TXATTRWALK] = "Txattrwalk",
+  [DR_TREADDIR] = "Treaddir",
+  [DR_TFSYNC] = "Tfsync",
+  [DR_TLOCK] = "Tlock",
+  [DR_TGETLOCK] = "Tgetlock",
+};
+
+const char *dr_9p_name(const uint8_t type) {
+  return dr_9p_names[type];
+}
+
+#define DR_9P_LOCAL(KIND, FIELD) DR_9P_TYPE_##KIND FIELD;
+#define DR_9P_ADDRESS(KIND, FIELD) &FIELD,
+
+#define DR_9P_FORMAT_U8(FIELD) dr_9p_append(out, out_size, &len, " " #FIELD " %" PRIu8, FIELD);
+#define DR_9P_FORMAT_U16(FIELD) dr_9p_append(out, out_size, &len, " " #FIELD " %" PRIu16, FIELD);
+#define DR_9P_FORMAT_U32(FIELD) dr_9p_append(out, out_size, &len, " " #FIELD " %" PRIu32, FIELD);
+#define DR_9P_FORMAT_U64(FIELD) dr_9p_append(out, out_size, &len, " " #FIELD " %" PRIu64, FIELD);
+#define DR_9P_FORMAT_STR(FIELD) dr_9p_append(out, out_size, &len, " " #FIELD " '%.*s'", (int)FIELD.len, FIELD.buf);
+#define DR_9P_FORMAT_QID(FIELD) dr_9p_append(out, out_size, &len, " " #FIELD " (%" PRIu8 " %" PRIu32 " %" PRIx64 ")", FIELD.type, FIELD.vers, FIELD.path);
+#define DR_9P_FORMAT_FIELD(KIND, FIELD) DR_9P_FORMAT_##KIND(FIELD)
+
+#define DR_9P_FORMAT_DECODED(NAME, TYPE) \
+  if (type == TYPE) { \
+    DR_9P_FIELDS_##NAME(DR_9P_LOCAL) \
+    if (dr_9p_decode_##NAME(DR_9P_FIELDS_##NAME(DR_9P_ADDRESS) buf, size, &pos)) { \
+      dr_9p_append(out, out_size, &len, #NAME " %" PRIu16, tag); \
+      DR_9P_FIELDS_##NAME(DR_9P_FORMAT_FIELD) \
+      return len; \
+    } \
+  }
+
+#define DR_9P_FORMAT_BOTH(NAME, TYPE) DR_9P_FORMAT_DECODED(NAME, TYPE)
+#define DR_9P_FORMAT_DEC(NAME, TYPE) DR_9P_FORMAT_DECODED(NAME, TYPE)
+#define DR_9P_FORMAT_ENC(NAME, TYPE) \
+  if (type == TYPE && size == header_size) { \
+    dr_9p_append(out, out_size, &len, #NAME " %" PRIu16, tag); \
+    return len; \
+  }
+#define DR_9P_FORMAT(DIR, NAME, TYPE) DR_9P_FORMAT_##DIR(NAME, TYPE)
+
+size_t dr_9p_format(char *restrict const out, const size_t out_size, const uint8_t *restrict const buf, const uint32_t size) {
+  dr_assert(out_size > 0);
+  out[0] = '\0';
+  size_t len = 0;
+  uint8_t type;
+  uint16_t tag;
+  uint32_t pos;
+  if (dr_unlikely(!dr_9p_decode_header(&type, &tag, buf, size, &pos))) {
+    dr_9p_append(out, out_size, &len, "short message %" PRIu32, size);
+    return len;
+  }
+  DR_9P_MESSAGES(DR_9P_FORMAT)
+  dr_9p_append(out, out_size, &len, "type %" PRIu8 " %" PRIu16 " size %" PRIu32, type, tag, size);
+  return len;
+}
@@ -3,42 +3,26 @@
 
 #include "dr.h"
 
+#include <errno.h>
+#include <stdlib.h>
 #include <string.h>
 
 static const uint32_t header_size = sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint16_t);
 static const uint32_t qid_size = sizeof(uint8_t) + sizeof(uint32_t) + sizeof(uint64_t);
 
-#define dr_encode_uintn(buf, val) \
-  do { \
-    for (size_t i = 0; i < sizeof(val); ++i) { \
-      (buf)[i] = ((val) >> 8 * i) & 0xff; \
-    } \
-  } while (false)
-
-void dr_encode_uint8(uint8_t *restrict const buf, const uint8_t val) {
-  dr_encode_uintn(buf, val);
-}
-
-void dr_encode_uint16(uint8_t *restrict const buf, const uint16_t val) {
-  dr_encode_uintn(buf, val);
-}
-
-void dr_encode_uint32(uint8_t *restrict const buf, const uint32_t val) {
-  dr_encode_uintn(buf, val);
-}
-
-void dr_encode_uint64(uint8_t *restrict const buf, const uint64_t val) {
-  dr_encode_uintn(buf, val);
-}
-
 static void dr_9p_encode_qid(uint8_t *restrict const buf, const struct dr_file *restrict const f) {
   dr_encode_uint8(buf, f->mode >> 24);
   dr_encode_uint32(buf + sizeof(uint8_t), f->vers);
   dr_encode_uint64(buf + sizeof(uint8_t) + sizeof(uint32_t), (uintptr_t)f); // DR xor file
 }
 
+// Excludes the leading size[2]
+WARN_UNUSED_RESULT static uint32_t dr_9p_stat_size(const struct dr_file *restrict const f) {
+  return sizeof(uint16_t) + sizeof(uint32_t) + qid_size + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint16_t) + f->name.len + sizeof(uint16_t) + f->uid->name.len + sizeof(uint16_t) + f->gid->name.len + sizeof(uint16_t) + f->muid->name.len;
+}
+
 WARN_UNUSED_RESULT static uint32_t dr_9p_encode_stat(uint8_t *restrict const buf, const uint32_t size, const struct dr_file *restrict const f) {
-  const uint32_t ssize = sizeof(uint16_t) + sizeof(uint32_t) + qid_size + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint16_t) + f->name.len + sizeof(uint16_t) + f->uid->name.len + sizeof(uint16_t) + f->gid->name.len + sizeof(uint16_t) + f->muid->name.len;
+  const uint32_t ssize = dr_9p_stat_size(f);
   uint32_t spos = 0;
   if (dr_unlikely(size < spos + sizeof(uint16_t) + ssize)) {
     return FAIL_UINT32;
@@ -89,29 +73,52 @@ static bool dr_9p_encode_finish(uint8_t *restrict const buf, const uint32_t size
   return true;
 }
 
-// size[4] Tversion tag[2] msize[4] version[s]
-
-WARN_UNUSED_RESULT static bool dr_9p_encode_uint32_str(const uint8_t type, uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const uint32_t arg0, const struct dr_str *restrict const arg1) {
-  const uint16_t arg1_len = arg1->len;
-  if (dr_unlikely(size < header_size + sizeof(uint32_t) + sizeof(uint16_t) + arg1_len)) {
-    return false;
+static void dr_9p_encode_str(uint8_t *restrict *restrict const cur, const struct dr_str *restrict const str) {
+  const uint16_t len = str->len;
+  dr_encode_uint16(*cur, len);
+  memcpy(*cur + sizeof(uint16_t), str->buf, len);
+  *cur += sizeof(uint16_t) + len;
+}
+
+// Encoders for the messages in dr_9p_schema.h. The size is summed from the table before anything is written
+
+#define DR_9P_ENCODE_SIZE_U8(FIELD) sizeof(uint8_t)
+#define DR_9P_ENCODE_SIZE_U16(FIELD) sizeof(uint16_t)
+#define DR_9P_ENCODE_SIZE_U32(FIELD) sizeof(uint32_t)
+#define DR_9P_ENCODE_SIZE_U64(FIELD) sizeof(uint64_t)
+#define DR_9P_ENCODE_SIZE_STR(FIELD) sizeof(uint16_t) + FIELD->len
+#define DR_9P_ENCODE_SIZE_QID(FIELD) qid_size
+#define DR_9P_ENCODE_SIZE(KIND, FIELD) + DR_9P_ENCODE_SIZE_##KIND(FIELD)
+
+#define DR_9P_ENCODE_U8(FIELD) dr_encode_uint8(cur, FIELD); cur += sizeof(uint8_t);
+#define DR_9P_ENCODE_U16(FIELD) dr_encode_uint16(cur, FIELD); cur += sizeof(uint16_t);
+#define DR_9P_ENCODE_U32(FIELD) dr_encode_uint32(cur, FIELD); cur += sizeof(uint32_t);
+#define DR_9P_ENCODE_U64(FIELD) dr_encode_uint64(cur, FIELD); cur += sizeof(uint64_t);
+#define DR_9P_ENCODE_STR(FIELD) dr_9p_encode_str(&cur, FIELD);
+#define DR_9P_ENCODE_QID(FIELD) dr_9p_encode_qid(cur, FIELD); cur += qid_size;
+#define DR_9P_ENCODE_FIELD(KIND, FIELD) DR_9P_ENCODE_##KIND(FIELD)
+
+#define DR_9P_ENCODER(NAME, TYPE) \
+  DR_9P_ENCODE_PROTO(NAME) { \
+    const uint32_t msg_size = header_size DR_9P_FIELDS_##NAME(DR_9P_ENCODE_SIZE); \
+    if (dr_unlikely(size < msg_size)) { \
+      return false; \
+    } \
+    dr_9p_encode_header(buf, TYPE, tag); \
+    uint8_t *restrict cur = buf + header_size; \
+    DR_9P_FIELDS_##NAME(DR_9P_ENCODE_FIELD) \
+    (void)cur; \
+    return dr_9p_encode_finish(buf, msg_size, pos); \
   }
-  dr_9p_encode_header(buf, type, tag);
-  dr_encode_uint32(buf + header_size, arg0);
-  dr_encode_uint16(buf + header_size + sizeof(uint32_t), arg1_len);
-  memcpy(buf + header_size + sizeof(uint32_t) + sizeof(uint16_t), arg1->buf, arg1_len);
-  return dr_9p_encode_finish(buf, header_size + sizeof(uint32_t) + sizeof(uint16_t) + arg1_len, pos);
-}
 
-bool dr_9p_encode_Tversion(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const uint32_t msize, const struct dr_str *restrict const version) {
-  return dr_9p_encode_uint32_str(DR_TVERSION, buf, size, pos, tag, msize, version);
-}
+#define DR_9P_ENCODER_BOTH(NAME, TYPE) DR_9P_ENCODER(NAME, TYPE)
+#define DR_9P_ENCODER_DEC(NAME, TYPE)
+#define DR_9P_ENCODER_ENC(NAME, TYPE) DR_9P_ENCODER(NAME, TYPE)
+#define DR_9P_DEFINE_ENCODER(DIR, NAME, TYPE) DR_9P_ENCODER_##DIR(NAME, TYPE)
 
-// size[4] Rversion tag[2] msize[4] version[s]
+DR_9P_MESSAGES(DR_9P_DEFINE_ENCODER)
 
-bool dr_9p_encode_Rversion(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const uint32_t msize, const struct dr_str *restrict const version) {
-  return dr_9p_encode_uint32_str(DR_RVERSION, buf, size, pos, tag, msize, version);
-}
+// size[4] Tversion tag[2] msize[4] version[s]
 
 // size[4] Tauth tag[2] afid[4] uname[s] aname[s]
 // size[4] Rauth tag[2] aqid[13]
@@ -146,35 +153,6 @@ void dr_9p_encode_Rerror_err(uint8_t *restrict const buf, const uint32_t size, u
 // size[4] Tflush tag[2] oldtag[2]
 // size[4] Rflush tag[2]
 
-// size[4] Tattach tag[2] fid[4] afid[4] uname[s] aname[s]
-
-bool dr_9p_encode_Tattach(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const uint32_t fid, const uint32_t afid, const struct dr_str *restrict const uname, const struct dr_str *restrict const aname) {
-  const uint16_t uname_len = uname->len;
-  const uint16_t aname_len = aname->len;
-  if (dr_unlikely(size < header_size + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint16_t) + uname_len + sizeof(uint16_t) + aname_len)) {
-    return false;
-  }
-  dr_9p_encode_header(buf, DR_TATTACH, tag);
-  dr_encode_uint32(buf + header_size, fid);
-  dr_encode_uint32(buf + header_size + sizeof(uint32_t), afid);
-  dr_encode_uint16(buf + header_size + sizeof(uint32_t) + sizeof(uint32_t), uname_len);
-  memcpy(buf + header_size + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint16_t), uname->buf, uname_len);
-  dr_encode_uint16(buf + header_size + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint16_t) + uname_len, aname_len);
-  memcpy(buf + header_size + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint16_t) + uname_len + sizeof(uint16_t), aname->buf, aname_len);
-  return dr_9p_encode_finish(buf, header_size + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint16_t) + uname_len + sizeof(uint16_t) + aname_len, pos);
-}
-
-// size[4] Rattach tag[2] qid[13]
-
-bool dr_9p_encode_Rattach(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const struct dr_file *restrict const f) {
-  if (dr_unlikely(size < header_size + qid_size)) {
-    return false;
-  }
-  dr_9p_encode_header(buf, DR_RATTACH, tag);
-  dr_9p_encode_qid(buf + header_size, f);
-  return dr_9p_encode_finish(buf, header_size + qid_size, pos);
-}
-
 // size[4] Twalk tag[2] fid[4] newfid[4] nwname[2] nwname*(wname[s])
 
 bool dr_9p_encode_Twalk_iterator(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const uint32_t fid, const uint32_t newfid, uint16_t *restrict const nwname) {
@@ -243,74 +221,9 @@ bool dr_9p_encode_Rwalk_finish(uint8_t *restrict const buf, const uint32_t size,
   return dr_9p_encode_finish(buf, p, pos);
 }
 
-// size[4] Topen tag[2] fid[4] mode[1]
-
-bool dr_9p_encode_Topen(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const uint32_t fid, const uint8_t mode) {
-  if (dr_unlikely(size < header_size + sizeof(uint32_t) + sizeof(uint8_t))) {
-    return false;
-  }
-  dr_9p_encode_header(buf, DR_TOPEN, tag);
-  dr_encode_uint32(buf + header_size, fid);
-  dr_encode_uint8(buf + header_size + sizeof(uint32_t), mode);
-  return dr_9p_encode_finish(buf, header_size + sizeof(uint32_t) + sizeof(uint8_t), pos);
-}
-
-// The iounit field returned by open(9P), if non-zero, reports the maximum size that is guaranteed to be transferred atomically.
-
-WARN_UNUSED_RESULT static bool dr_9p_encode_qid_uint32(const uint8_t type, uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const struct dr_file *restrict const arg0, const uint32_t arg1) {
-  if (dr_unlikely(size < header_size + qid_size + sizeof(uint32_t))) {
-    return false;
-  }
-  dr_9p_encode_header(buf, type, tag);
-  dr_9p_encode_qid(buf + header_size, arg0);
-  dr_encode_uint32(buf + header_size + qid_size, arg1);
-  return dr_9p_encode_finish(buf, header_size + qid_size + sizeof(uint32_t), pos);
-}
-
-// size[4] Ropen tag[2] qid[13] iounit[4]
-
-bool dr_9p_encode_Ropen(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const struct dr_file *restrict const f, const uint32_t iounit) {
-  return dr_9p_encode_qid_uint32(DR_ROPEN, buf, size, pos, tag, f, iounit);
-}
-
 // size[4] Topenfd tag[2] fid[4] mode[1]
 // size[4] Ropenfd tag[2] qid[13] iounit[4] unixfd[4]
 
-// size[4] Tcreate tag[2] fid[4] name[s] perm[4] mode[1]
-
-bool dr_9p_encode_Tcreate(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const uint32_t fid, const struct dr_str *restrict const name, const uint32_t perm, const uint8_t mode) {
-  const uint16_t name_len = name->len;
-  if (dr_unlikely(size < header_size + sizeof(uint32_t) + sizeof(uint16_t) + name_len + sizeof(uint32_t) + sizeof(uint8_t))) {
-    return false;
-  }
-  dr_9p_encode_header(buf, DR_TCREATE, tag);
-  dr_encode_uint32(buf + header_size, fid);
-  dr_encode_uint16(buf + header_size + sizeof(uint32_t), name_len);
-  memcpy(buf + header_size + sizeof(uint32_t) + sizeof(uint16_t), name->buf, name_len);
-  dr_encode_uint32(buf + header_size + sizeof(uint32_t) + sizeof(uint16_t) + name_len, perm);
-  dr_encode_uint8(buf + header_size + sizeof(uint32_t) + sizeof(uint16_t) + name_len + sizeof(uint32_t), mode);
-  return dr_9p_encode_finish(buf, header_size + sizeof(uint32_t) + sizeof(uint16_t) + name_len + sizeof(uint32_t) + sizeof(uint8_t), pos);
-}
-
-// size[4] Rcreate tag[2] qid[13] iounit[4]
-
-bool dr_9p_encode_Rcreate(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const struct dr_file *restrict const f, const uint32_t iounit) {
-  return dr_9p_encode_qid_uint32(DR_RCREATE, buf, size, pos, tag, f, iounit);
-}
-
-// size[4] Tread tag[2] fid[4] offset[8] count[4]
-
-bool dr_9p_encode_Tread(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const uint32_t fid, const uint64_t offset, const uint32_t count) {
-  if (dr_unlikely(size < header_size + sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint32_t))) {
-    return false;
-  }
-  dr_9p_encode_header(buf, DR_TREAD, tag);
-  dr_encode_uint32(buf + header_size, fid);
-  dr_encode_uint64(buf + header_size + sizeof(uint32_t), offset);
-  dr_encode_uint32(buf + header_size + sizeof(uint32_t) + sizeof(uint64_t), count);
-  return dr_9p_encode_finish(buf, header_size + sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint32_t), pos);
-}
-
 // size[4] Rread tag[2] count[4] data[count]
 
 bool dr_9p_encode_Rread_iterator(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag) {
@@ -353,57 +266,8 @@ bool dr_9p_encode_Twrite_finish(uint8_t *restrict const buf, const uint32_t size
 
 // size[4] Rwrite tag[2] count[4]
 
-WARN_UNUSED_RESULT static bool dr_9p_encode_uint32(const uint8_t type, uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const uint32_t arg0) {
-  if (dr_unlikely(size < header_size + sizeof(uint32_t))) {
-    return false;
-  }
-  dr_9p_encode_header(buf, type, tag);
-  dr_encode_uint32(buf + header_size, arg0);
-  return dr_9p_encode_finish(buf, header_size + sizeof(uint32_t), pos);
-}
-
-bool dr_9p_encode_Rwrite(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const uint32_t count) {
-  return dr_9p_encode_uint32(DR_RWRITE, buf, size, pos, tag, count);
-}
-
-// size[4] Tclunk tag[2] fid[4]
-
-bool dr_9p_encode_Tclunk(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const uint32_t fid) {
-  return dr_9p_encode_uint32(DR_TCLUNK, buf, size, pos, tag, fid);
-}
-
 // size[4] Rclunk tag[2]
 
-WARN_UNUSED_RESULT static bool dr_9p_encode_null(const uint8_t type, uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag) {
-  if (dr_unlikely(size < header_size)) {
-    return false;
-  }
-  dr_9p_encode_header(buf, type, tag);
-  return dr_9p_encode_finish(buf, header_size, pos);
-}
-
-bool dr_9p_encode_Rclunk(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag) {
-  return dr_9p_encode_null(DR_RCLUNK, buf, size, pos, tag);
-}
-
-// size[4] Tremove tag[2] fid[4]
-
-bool dr_9p_encode_Tremove(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const uint32_t fid) {
-  return dr_9p_encode_uint32(DR_TREMOVE, buf, size, pos, tag, fid);
-}
-
-// size[4] Rremove tag[2]
-
-bool dr_9p_encode_Rremove(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag) {
-  return dr_9p_encode_null(DR_RREMOVE, buf, size, pos, tag);
-}
-
-// size[4] Tstat tag[2] fid[4]
-
-bool dr_9p_encode_Tstat(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const uint32_t fid) {
-  return dr_9p_encode_uint32(DR_TSTAT, buf, size, pos, tag, fid);
-}
-
 // size[4] Rstat tag[2] stat[n]
 
 bool dr_9p_encode_Rstat(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const struct dr_file *restrict const f) {
@@ -471,33 +335,233 @@ bool dr_9p_encode_Twstat(uint8_t *restrict const buf, const uint32_t size, uint3
   return dr_9p_encode_finish(buf, spos, pos);
 }
 
-// size[4] Rwstat tag[2]
+// 9P2000.L
 
-bool dr_9p_encode_Rwstat(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag) {
-  return dr_9p_encode_null(DR_RWSTAT, buf, size, pos, tag);
+// size[4] Rlerror tag[2] ecode[4]
+
+void dr_9p_encode_Rlerror(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const uint32_t ecode) {
+  dr_assert(size >= header_size + sizeof(uint32_t));
+  dr_9p_encode_header(buf, DR_RLERROR, tag);
+  dr_encode_uint32(buf + header_size, ecode);
+  dr_9p_encode_finish(buf, header_size + sizeof(uint32_t), pos);
+}
+
+void dr_9p_encode_Rlerror_err(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const struct dr_error *restrict const error) {
+  // DR Assumes the local errno values match Linux
+  dr_9p_encode_Rlerror(buf, size, pos, tag, error->domain == DR_ERR_ISO_C ? (uint32_t)error->num : EIO);
 }
 
-WARN_UNUSED_RESULT static struct dr_result_uint32 dr_dir_read(const struct dr_fd *restrict const fd, const uint64_t offset, const uint32_t count, void *restrict const b) {
-  uint8_t *restrict const buf = (uint8_t *)b;
-  if (offset != 0) {
-    // DR Fix later
-    return DR_RESULT_OK(uint32, 0);
+// size[4] Rstatfs tag[2] type[4] bsize[4] blocks[8] bfree[8] bavail[8] files[8] ffree[8] fsid[8] namelen[4]
+
+bool dr_9p_encode_Rstatfs(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const struct dr_9p_statfs *restrict const statfs) {
+  if (dr_unlikely(size < header_size + sizeof(uint32_t) + sizeof(uint32_t) + 6*sizeof(uint64_t) + sizeof(uint32_t))) {
+    return false;
+  }
+  dr_9p_encode_header(buf, DR_RSTATFS, tag);
+  uint32_t spos = header_size;
+  dr_encode_uint32(buf + spos, statfs->type);
+  spos += sizeof(uint32_t);
+  dr_encode_uint32(buf + spos, statfs->bsize);
+  spos += sizeof(uint32_t);
+  dr_encode_uint64(buf + spos, statfs->blocks);
+  spos += sizeof(uint64_t);
+  dr_encode_uint64(buf + spos, statfs->bfree);
+  spos += sizeof(uint64_t);
+  dr_encode_uint64(buf + spos, statfs->bavail);
+  spos += sizeof(uint64_t);
+  dr_encode_uint64(buf + spos, statfs->files);
+  spos += sizeof(uint64_t);
+  dr_encode_uint64(buf + spos, statfs->ffree);
+  spos += sizeof(uint64_t);
+  dr_encode_uint64(buf + spos, statfs->fsid);
+  spos += sizeof(uint64_t);
+  dr_encode_uint32(buf + spos, statfs->namelen);
+  spos += sizeof(uint32_t);
+  return dr_9p_encode_finish(buf, spos, pos);
+}
+
+// size[4] Rgetattr tag[2] valid[8] qid[13] mode[4] uid[4] gid[4] nlink[8] rdev[8] size[8] blksize[8] blocks[8] atime_sec[8] atime_nsec[8] mtime_sec[8] mtime_nsec[8] ctime_sec[8] ctime_nsec[8] btime_sec[8] btime_nsec[8] gen[8] data_version[8]
+
+#define DR_9P_BLKSIZE 4096
+
+bool dr_9p_encode_Rgetattr(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const uint64_t valid, const struct dr_file *restrict const f) {
+  if (dr_unlikely(size < header_size + sizeof(uint64_t) + qid_size + 3*sizeof(uint32_t) + 15*sizeof(uint64_t))) {
+    return false;
+  }
+  dr_9p_encode_header(buf, DR_RGETATTR, tag);
+  uint32_t spos = header_size;
+  dr_encode_uint64(buf + spos, valid);
+  spos += sizeof(uint64_t);
+  dr_9p_encode_qid(buf + spos, f);
+  spos += qid_size;
+  dr_encode_uint32(buf + spos, ((f->mode & DR_DIR) != 0 ? DR_L_S_IFDIR : DR_L_S_IFREG) | (f->mode & 0777));
+  spos += sizeof(uint32_t);
+  // DR Users and groups have no numeric ids
+  dr_encode_uint32(buf + spos, 0);
+  spos += sizeof(uint32_t);
+  dr_encode_uint32(buf + spos, 0);
+  spos += sizeof(uint32_t);
+  dr_encode_uint64(buf + spos, 1);
+  spos += sizeof(uint64_t);
+  dr_encode_uint64(buf + spos, 0);
+  spos += sizeof(uint64_t);
+  dr_encode_uint64(buf + spos, f->length);
+  spos += sizeof(uint64_t);
+  dr_encode_uint64(buf + spos, DR_9P_BLKSIZE);
+  spos += sizeof(uint64_t);
+  dr_encode_uint64(buf + spos, (f->length + 511)/512);
+  spos += sizeof(uint64_t);
+  dr_encode_uint64(buf + spos, f->atime/DR_NS_PER_S);
+  spos += sizeof(uint64_t);
+  dr_encode_uint64(buf + spos, f->atime%DR_NS_PER_S);
+  spos += sizeof(uint64_t);
+  dr_encode_uint64(buf + spos, f->mtime/DR_NS_PER_S);
+  spos += sizeof(uint64_t);
+  dr_encode_uint64(buf + spos, f->mtime%DR_NS_PER_S);
+  spos += sizeof(uint64_t);
+  // ctime
+  dr_encode_uint64(buf + spos, f->mtime/DR_NS_PER_S);
+  spos += sizeof(uint64_t);
+  dr_encode_uint64(buf + spos, f->mtime%DR_NS_PER_S);
+  spos += sizeof(uint64_t);
+  // btime, gen
+  dr_encode_uint64(buf + spos, 0);
+  spos += sizeof(uint64_t);
+  dr_encode_uint64(buf + spos, 0);
+  spos += sizeof(uint64_t);
+  dr_encode_uint64(buf + spos, 0);
+  spos += sizeof(uint64_t);
+  dr_encode_uint64(buf + spos, f->vers);
+  spos += sizeof(uint64_t);
+  return dr_9p_encode_finish(buf, spos, pos);
+}
+
+// size[4] Rreaddir tag[2] count[4] data[count]
+// qid[13] offset[8] type[1] name[s]
+
+uint32_t dr_9p_encode_dirent(uint8_t *restrict const buf, const uint32_t size, const struct dr_file *restrict const f, const uint64_t offset) {
+  const uint32_t dsize = qid_size + sizeof(uint64_t) + sizeof(uint8_t) + sizeof(uint16_t) + f->name.len;
+  if (dr_unlikely(size < dsize)) {
+    return FAIL_UINT32;
+  }
+  dr_9p_encode_qid(buf, f);
+  dr_encode_uint64(buf + qid_size, offset);
+  dr_encode_uint8(buf + qid_size + sizeof(uint64_t), (f->mode & DR_DIR) != 0 ? DR_L_DT_DIR : DR_L_DT_REG);
+  dr_encode_uint16(buf + qid_size + sizeof(uint64_t) + sizeof(uint8_t), f->name.len);
+  memcpy(buf + qid_size + sizeof(uint64_t) + sizeof(uint8_t) + sizeof(uint16_t), f->name.buf, f->name.len);
+  return dsize;
+}
+
+bool dr_9p_encode_Rreaddir_iterator(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag) {
+  if (dr_unlikely(size < header_size + sizeof(uint32_t))) {
+    return false;
+  }
+  dr_9p_encode_header(buf, DR_RREADDIR, tag);
+  *pos = header_size + sizeof(uint32_t);
+  return true;
+}
+
+bool dr_9p_encode_Rreaddir_finish(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint32_t count) {
+  return dr_9p_encode_Rread_finish(buf, size, pos, count);
+}
+
+// size[4] Rgetlock tag[2] type[1] start[8] length[8] proc_id[4] client_id[s]
+
+bool dr_9p_encode_Rgetlock(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag, const struct dr_9p_flock *restrict const flock) {
+  const uint16_t client_id_len = flock->client_id.len;
+  if (dr_unlikely(size < header_size + sizeof(uint8_t) + sizeof(uint64_t) + sizeof(uint64_t) + sizeof(uint32_t) + sizeof(uint16_t) + client_id_len)) {
+    return false;
+  }
+  dr_9p_encode_header(buf, DR_RGETLOCK, tag);
+  dr_encode_uint8(buf + header_size, flock->type);
+  dr_encode_uint64(buf + header_size + sizeof(uint8_t), flock->start);
+  dr_encode_uint64(buf + header_size + sizeof(uint8_t) + sizeof(uint64_t), flock->length);
+  dr_encode_uint32(buf + header_size + sizeof(uint8_t) + sizeof(uint64_t) + sizeof(uint64_t), flock->proc_id);
+  dr_encode_uint16(buf + header_size + sizeof(uint8_t) + sizeof(uint64_t) + sizeof(uint64_t) + sizeof(uint32_t), client_id_len);
+  memcpy(buf + header_size + sizeof(uint8_t) + sizeof(uint64_t) + sizeof(uint64_t) + sizeof(uint32_t) + sizeof(uint16_t), flock->client_id.buf, client_id_len);
+  return dr_9p_encode_finish(buf, header_size + sizeof(uint8_t) + sizeof(uint64_t) + sizeof(uint64_t) + sizeof(uint32_t) + sizeof(uint16_t) + client_id_len, pos);
+}
+
+// Returns the encoded stat of f, which is only encoded again after f changes, or NULL if it can not be allocated
+WARN_UNUSED_RESULT static const uint8_t *dr_file_stat(struct dr_file *restrict const f) {
+  if (dr_likely(f->stat != NULL && f->stat_vers == f->vers)) {
+    return f->stat;
+  }
+  const uint32_t size = sizeof(uint16_t) + dr_9p_stat_size(f);
+  uint8_t *restrict const stat = (uint8_t *)realloc(f->stat, size);
+  if (dr_unlikely(stat == NULL)) {
+    return NULL;
+  }
+  const uint32_t written = dr_9p_encode_stat(stat, size, f);
+  dr_assert(written == size);
+  f->stat = stat;
+  f->stat_vers = f->vers;
+  f->stat_size = size;
+  return stat;
+}
+
+// Directory reads must resume at an offset returned by a previous read
+uint32_t dr_dir_read_entries(uint8_t *restrict const buf, const uint32_t count, const uint64_t offset, struct dr_file *restrict const *restrict const entries, const uint32_t entry_count) {
+  uint64_t skipped = 0;
+  uint_fast32_t i = 0;
+  for (; i < entry_count && skipped < offset; ++i) {
+    skipped += sizeof(uint16_t) + dr_9p_stat_size(entries[i]);
+  }
+  if (dr_unlikely(skipped != offset)) {
+    return 0;
+  }
+  uint32_t pos = 0;
+  for (; i < entry_count; ++i) {
+    struct dr_file *restrict const f = entries[i];
+    const uint8_t *restrict const stat = dr_file_stat(f);
+    uint32_t written;
+    if (dr_likely(stat != NULL)) {
+      written = f->stat_size;
+      if (dr_unlikely(written > count - pos)) {
+	written = FAIL_UINT32;
+      } else {
+	memcpy(buf + pos, stat, written);
+      }
+    } else {
+      written = dr_9p_encode_stat(buf + pos, count - pos, f);
+    }
+    if (dr_unlikely(written == FAIL_UINT32)) {
+      // Buffer is too small
+      break;
+    }
+    pos += written;
+  }
+  return pos;
+}
+
+// The offset of each dirent is the index of the following entry
+uint32_t dr_dir_readdir_entries(uint8_t *restrict const buf, const uint32_t count, const uint64_t offset, struct dr_file *restrict const *restrict const entries, const uint32_t entry_count) {
+  if (offset >= entry_count) {
+    return 0;
   }
-  const struct dr_dir *restrict const dir = container_of_const(fd->file, const struct dr_dir, file);
   uint32_t pos = 0;
-  // DR Specific to this dr_dir impl
-  for (uint_fast32_t i = 0; i < dir->entry_count; ++i) {
-    const struct dr_file *restrict const f = dir->entries[i];
-    const uint32_t written = dr_9p_encode_stat(buf + pos, count - pos, f);
+  for (uint_fast32_t i = offset; i < entry_count; ++i) {
+    const uint32_t written = dr_9p_encode_dirent(buf + pos, count - pos, entries[i], i + 1);
     if (dr_unlikely(written == FAIL_UINT32)) {
       // Buffer is too small
       break;
     }
     pos += written;
   }
-  return DR_RESULT_OK(uint32, pos);
+  return pos;
+}
+
+WARN_UNUSED_RESULT static struct dr_result_uint32 dr_dir_read(const struct dr_fd *restrict const fd, const uint64_t offset, const uint32_t count, void *restrict const buf) {
+  const struct dr_dir *restrict const dir = container_of_const(fd->file, const struct dr_dir, file);
+  return DR_RESULT_OK(uint32, dr_dir_read_entries((uint8_t *)buf, count, offset, dir->entries, dir->entry_count));
+}
+
+WARN_UNUSED_RESULT static struct dr_result_uint32 dr_dir_readdir(const struct dr_fd *restrict const fd, const uint64_t offset, const uint32_t count, void *restrict const buf) {
+  const struct dr_dir *restrict const dir = container_of_const(fd->file, const struct dr_dir, file);
+  return DR_RESULT_OK(uint32, dr_dir_readdir_entries((uint8_t *)buf, count, offset, dir->entries, dir->entry_count));
 }
 
 struct dr_file_vtbl dr_dir_vtbl = {
   .read = dr_dir_read,
+  .readdir = dr_dir_readdir,
 };
@@ -0,0 +1,130 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// Copyright (c) 2018 Drew Richardson <drewrichardson@gmail.com>
+
+#if !defined(DR_9P_SCHEMA_H)
+#define DR_9P_SCHEMA_H
+
+/*
+ * Layouts of the 9p messages that are a flat list of integers, strings and
+ * qids. DR_9P_FIELDS_<name>(F) lists the fields after size[4] type[1] tag[2]
+ * as F(kind, field) and DR_9P_MESSAGES(M) lists the messages as
+ * M(dir, name, type). dir is BOTH, or DEC or ENC when the other direction is
+ * written by hand because it does not fit the common signature.
+ * dr_9p_decode.c and dr_9p_encode.c expand the table into the dr_9p_decode_*,
+ * dr_9p_encode_* and dr_9p_format code, so adding a message is one fields
+ * macro and one row. dr_9p_decode_valid_* skip the checks and are only for
+ * messages that dr_9p_decode_frames has accepted. QID fields decode into a
+ * struct dr_9p_qid and are encoded from the struct dr_file they describe.
+ */
+
+#define DR_9P_FIELDS_Tversion(F) F(U32, msize) F(STR, version)
+#define DR_9P_FIELDS_Rversion(F) F(U32, msize) F(STR, version)
+#define DR_9P_FIELDS_Tauth(F) F(U32, afid) F(STR, uname) F(STR, aname)
+#define DR_9P_FIELDS_Rerror(F) F(STR, ename)
+#define DR_9P_FIELDS_Tattach(F) F(U32, fid) F(U32, afid) F(STR, uname) F(STR, aname)
+#define DR_9P_FIELDS_Rattach(F) F(QID, qid)
+#define DR_9P_FIELDS_Topen(F) F(U32, fid) F(U8, mode)
+// The iounit field returned by open(9P), if non-zero, reports the maximum size that is guaranteed to be transferred atomically.
+#define DR_9P_FIELDS_Ropen(F) F(QID, qid) F(U32, iounit)
+#define DR_9P_FIELDS_Tcreate(F) F(U32, fid) F(STR, name) F(U32, perm) F(U8, mode)
+#define DR_9P_FIELDS_Rcreate(F) F(QID, qid) F(U32, iounit)
+#define DR_9P_FIELDS_Tread(F) F(U32, fid) F(U64, offset) F(U32, count)
+#define DR_9P_FIELDS_Rwrite(F) F(U32, count)
+#define DR_9P_FIELDS_Tclunk(F) F(U32, fid)
+#define DR_9P_FIELDS_Rclunk(F)
+#define DR_9P_FIELDS_Tremove(F) F(U32, fid)
+#define DR_9P_FIELDS_Rremove(F)
+#define DR_9P_FIELDS_Tstat(F) F(U32, fid)
+#define DR_9P_FIELDS_Rwstat(F)
+
+// 9P2000.L
+
+#define DR_9P_FIELDS_Rlerror(F) F(U32, ecode)
+#define DR_9P_FIELDS_Tstatfs(F) F(U32, fid)
+#define DR_9P_FIELDS_Tauth_dotl(F) F(U32, afid) F(STR, uname) F(STR, aname) F(U32, n_uname)
+#define DR_9P_FIELDS_Tattach_dotl(F) F(U32, fid) F(U32, afid) F(STR, uname) F(STR, aname) F(U32, n_uname)
+#define DR_9P_FIELDS_Tlopen(F) F(U32, fid) F(U32, flags)
+#define DR_9P_FIELDS_Rlopen(F) F(QID, qid) F(U32, iounit)
+#define DR_9P_FIELDS_Tlcreate(F) F(U32, fid) F(STR, name) F(U32, flags) F(U32, mode) F(U32, gid)
+#define DR_9P_FIELDS_Rlcreate(F) F(QID, qid) F(U32, iounit)
+#define DR_9P_FIELDS_Tgetattr(F) F(U32, fid) F(U64, request_mask)
+#define DR_9P_FIELDS_Txattrwalk(F) F(U32, fid) F(U32, newfid) F(STR, name)
+#define DR_9P_FIELDS_Rxattrwalk(F) F(U64, xattr_size)
+#define DR_9P_FIELDS_Treaddir(F) F(U32, fid) F(U64, offset) F(U32, count)
+#define DR_9P_FIELDS_Rfsync(F)
+#define DR_9P_FIELDS_Rlock(F) F(U8, status)
+#define DR_9P_FIELDS_Tmkdir(F) F(U32, dfid) F(STR, name) F(U32, mode) F(U32, gid)
+#define DR_9P_FIELDS_Rmkdir(F) F(QID, qid)
+
+// Messages sharing a type are tried in order by dr_9p_format
+#define DR_9P_MESSAGES(M) \
+  M(BOTH, Tversion, DR_TVERSION) \
+  M(BOTH, Rversion, DR_RVERSION) \
+  M(BOTH, Tauth, DR_TAUTH) \
+  M(DEC, Rerror, DR_RERROR) \
+  M(BOTH, Tattach, DR_TATTACH) \
+  M(BOTH, Rattach, DR_RATTACH) \
+  M(BOTH, Topen, DR_TOPEN) \
+  M(BOTH, Ropen, DR_ROPEN) \
+  M(BOTH, Tcreate, DR_TCREATE) \
+  M(BOTH, Rcreate, DR_RCREATE) \
+  M(BOTH, Tread, DR_TREAD) \
+  M(BOTH, Rwrite, DR_RWRITE) \
+  M(BOTH, Tclunk, DR_TCLUNK) \
+  M(ENC, Rclunk, DR_RCLUNK) \
+  M(BOTH, Tremove, DR_TREMOVE) \
+  M(ENC, Rremove, DR_RREMOVE) \
+  M(BOTH, Tstat, DR_TSTAT) \
+  M(ENC, Rwstat, DR_RWSTAT) \
+  M(DEC, Rlerror, DR_RLERROR) \
+  M(BOTH, Tstatfs, DR_TSTATFS) \
+  M(BOTH, Tauth_dotl, DR_TAUTH) \
+  M(BOTH, Tattach_dotl, DR_TATTACH) \
+  M(BOTH, Tlopen, DR_TLOPEN) \
+  M(BOTH, Rlopen, DR_RLOPEN) \
+  M(BOTH, Tlcreate, DR_TLCREATE) \
+  M(BOTH, Rlcreate, DR_RLCREATE) \
+  M(BOTH, Tgetattr, DR_TGETATTR) \
+  M(BOTH, Txattrwalk, DR_TXATTRWALK) \
+  M(BOTH, Rxattrwalk, DR_RXATTRWALK) \
+  M(BOTH, Treaddir, DR_TREADDIR) \
+  M(ENC, Rfsync, DR_RFSYNC) \
+  M(BOTH, Rlock, DR_RLOCK) \
+  M(BOTH, Tmkdir, DR_TMKDIR) \
+  M(BOTH, Rmkdir, DR_RMKDIR)
+
+#define DR_9P_TYPE_U8 uint8_t
+#define DR_9P_TYPE_U16 uint16_t
+#define DR_9P_TYPE_U32 uint32_t
+#define DR_9P_TYPE_U64 uint64_t
+#define DR_9P_TYPE_STR struct dr_str
+#define DR_9P_TYPE_QID struct dr_9p_qid
+
+#define DR_9P_ARG_U8 const uint8_t
+#define DR_9P_ARG_U16 const uint16_t
+#define DR_9P_ARG_U32 const uint32_t
+#define DR_9P_ARG_U64 const uint64_t
+#define DR_9P_ARG_STR const struct dr_str *restrict const
+#define DR_9P_ARG_QID const struct dr_file *restrict const
+
+// Strings count only their length here
+#define DR_9P_SIZE_U8 sizeof(uint8_t)
+#define DR_9P_SIZE_U16 sizeof(uint16_t)
+#define DR_9P_SIZE_U32 sizeof(uint32_t)
+#define DR_9P_SIZE_U64 sizeof(uint64_t)
+#define DR_9P_SIZE_STR sizeof(uint16_t)
+#define DR_9P_SIZE_QID (sizeof(uint8_t) + sizeof(uint32_t) + sizeof(uint64_t))
+
+#define DR_9P_DECODE_PARAM(KIND, FIELD) DR_9P_TYPE_##KIND *restrict const FIELD,
+#define DR_9P_ENCODE_PARAM(KIND, FIELD) , DR_9P_ARG_##KIND FIELD
+
+#define DR_9P_DECODE_PROTO(NAME) bool dr_9p_decode_##NAME(DR_9P_FIELDS_##NAME(DR_9P_DECODE_PARAM) const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos)
+#define DR_9P_DECODE_VALID_PROTO(NAME) void dr_9p_decode_valid_##NAME(DR_9P_FIELDS_##NAME(DR_9P_DECODE_PARAM) const uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos)
+#define DR_9P_ENCODE_PROTO(NAME) bool dr_9p_encode_##NAME(uint8_t *restrict const buf, const uint32_t size, uint32_t *restrict const pos, const uint16_t tag DR_9P_FIELDS_##NAME(DR_9P_ENCODE_PARAM))
+
+#define DR_9P_DECLARE_BOTH(NAME) WARN_UNUSED_RESULT DR_9P_DECODE_PROTO(NAME); DR_9P_DECODE_VALID_PROTO(NAME); WARN_UNUSED_RESULT DR_9P_ENCODE_PROTO(NAME);
+#define DR_9P_DECLARE_DEC(NAME) WARN_UNUSED_RESULT DR_9P_DECODE_PROTO(NAME); DR_9P_DECODE_VALID_PROTO(NAME);
+#define DR_9P_DECLARE_ENC(NAME) WARN_UNUSED_RESULT DR_9P_ENCODE_PROTO(NAME);
+#define DR_9P_DECLARE(DIR, NAME, TYPE) DR_9P_DECLARE_##DIR(NAME)
+
+#endif // DR_9P_SCHEMA_H
@@ -0,0 +1,140 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// Copyright (c) 2018 Drew Richardson <drewrichardson@gmail.com>
+
+#include "dr.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Like dr_sem a channel belongs to the tasks of one scheduler thread, so the
+ * ring needs no atomics. Each side only wakes one waiter of the other side,
+ * and a woken task that leaves room or elements behind wakes the next one.
+ */
+
+struct dr_result_void dr_chan_init(struct dr_chan *restrict const chan, const uint32_t size, const uint32_t capacity) {
+  if (size == 0 || capacity == 0 || (capacity & (capacity - 1)) != 0 || capacity > UINT32_MAX/2) {
+    return DR_RESULT_ERRNUM_VOID(DR_ERR_ISO_C, EINVAL);
+  }
+  uint8_t *restrict const buf = (uint8_t *)malloc((size_t)size*capacity);
+  if (dr_unlikely(buf == NULL)) {
+    return DR_RESULT_ERRNO_VOID();
+  }
+  *chan = (struct dr_chan) {
+    .buf = buf,
+    .size = size,
+    .mask = capacity - 1,
+  };
+  dr_wait_init(&chan->send_wait);
+  dr_wait_init(&chan->recv_wait);
+  return DR_RESULT_OK_VOID();
+}
+
+void dr_chan_destroy(struct dr_chan *restrict const chan) {
+  dr_wait_destroy(&chan->recv_wait);
+  dr_wait_destroy(&chan->send_wait);
+  free(chan->buf);
+  chan->buf = NULL;
+}
+
+void dr_chan_close(struct dr_chan *restrict const chan) {
+  chan->closed = true;
+  dr_wait_notify_all(&chan->send_wait);
+  dr_wait_notify_all(&chan->recv_wait);
+}
+
+static bool dr_chan_full(const struct dr_chan *restrict const chan) {
+  return chan->tail - chan->head > chan->mask;
+}
+
+static bool dr_chan_empty(const struct dr_chan *restrict const chan) {
+  return chan->tail == chan->head;
+}
+
+static uint32_t dr_chan_put(struct dr_chan *restrict const chan, const void *restrict const elems, const unsigned int count) {
+  const uint32_t space = chan->mask + 1 - (chan->tail - chan->head);
+  const uint32_t n = count < space ? count : space;
+  const uint32_t pos = chan->tail & chan->mask;
+  // The elements may wrap around the end of the ring
+  const uint32_t first = n < chan->mask + 1 - pos ? n : chan->mask + 1 - pos;
+  memcpy(chan->buf + (size_t)pos*chan->size, elems, (size_t)first*chan->size);
+  memcpy(chan->buf, (const uint8_t *)elems + (size_t)first*chan->size, (size_t)(n - first)*chan->size);
+  chan->tail += n;
+  dr_wait_notify(&chan->recv_wait);
+  if (!dr_chan_full(chan)) {
+    dr_wait_notify(&chan->send_wait);
+  }
+  return n;
+}
+
+static uint32_t dr_chan_get(struct dr_chan *restrict const chan, void *restrict const elems, const unsigned int count) {
+  const uint32_t avail = chan->tail - chan->head;
+  const uint32_t n = count < avail ? count : avail;
+  const uint32_t pos = chan->head & chan->mask;
+  const uint32_t first = n < chan->mask + 1 - pos ? n : chan->mask + 1 - pos;
+  memcpy(elems, chan->buf + (size_t)pos*chan->size, (size_t)first*chan->size);
+  memcpy((uint8_t *)elems + (size_t)first*chan->size, chan->buf, (size_t)(n - first)*chan->size);
+  chan->head += n;
+  dr_wait_notify(&chan->send_wait);
+  if (!dr_chan_empty(chan)) {
+    dr_wait_notify(&chan->recv_wait);
+  }
+  return n;
+}
+
+struct dr_result_void dr_chan_send(struct dr_chan *restrict const chan, const void *restrict const elem) {
+  const struct dr_result_uint r = dr_chan_send_batch(chan, elem, 1);
+  DR_IF_RESULT_ERR(r, err) {
+    return DR_RESULT_ERROR_VOID(err);
+  } DR_FI_RESULT;
+  return DR_RESULT_OK_VOID();
+}
+
+struct dr_result_void dr_chan_try_send(struct dr_chan *restrict const chan, const void *restrict const elem) {
+  if (dr_unlikely(chan->closed)) {
+    return DR_RESULT_ERRNUM_VOID(DR_ERR_ISO_C, EPIPE);
+  }
+  if (dr_chan_full(chan)) {
+    return DR_RESULT_ERRNUM_VOID(DR_ERR_ISO_C, EAGAIN);
+  }
+  (void)dr_chan_put(chan, elem, 1);
+  return DR_RESULT_OK_VOID();
+}
+
+struct dr_result_void dr_chan_recv(struct dr_chan *restrict const chan, void *restrict const elem) {
+  const struct dr_result_uint r = dr_chan_recv_batch(chan, elem, 1);
+  DR_IF_RESULT_ERR(r, err) {
+    return DR_RESULT_ERROR_VOID(err);
+  } DR_FI_RESULT;
+  return DR_RESULT_OK_VOID();
+}
+
+struct dr_result_void dr_chan_try_recv(struct dr_chan *restrict const chan, void *restrict const elem) {
+  if (dr_chan_empty(chan)) {
+    return DR_RESULT_ERRNUM_VOID(DR_ERR_ISO_C, chan->closed ? EPIPE : EAGAIN);
+  }
+  (void)dr_chan_get(chan, elem, 1);
+  return DR_RESULT_OK_VOID();
+}
+
+struct dr_result_uint dr_chan_send_batch(struct dr_chan *restrict const chan, const void *restrict const elems, const unsigned int count) {
+  while (!chan->closed && dr_chan_full(chan)) {
+    dr_wait_wait(&chan->send_wait);
+  }
+  if (dr_unlikely(chan->closed)) {
+    return DR_RESULT_ERRNUM(uint, DR_ERR_ISO_C, EPIPE);
+  }
+  return DR_RESULT_OK(uint, dr_chan_put(chan, elems, count));
+}
+
+struct dr_result_uint dr_chan_recv_batch(struct dr_chan *restrict const chan, void *restrict const elems, const unsigned int count) {
+  while (!chan->closed && dr_chan_empty(chan)) {
+    dr_wait_wait(&chan->recv_wait);
+  }
+  // Elements sent before the close are still delivered
+  if (dr_unlikely(dr_chan_empty(chan))) {
+    return DR_RESULT_ERRNUM(uint, DR_ERR_ISO_C, EPIPE);
+  }
+  return DR_RESULT_OK(uint, dr_chan_get(chan, elems, count));
+}
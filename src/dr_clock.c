@@ -20,6 +20,16 @@ struct dr_result_void dr_system_sleep_ns(const int64_t time) {
   return DR_RESULT_OK_VOID();
 }
 
+int64_t dr_monotonic_ns(void) {
+  static LARGE_INTEGER frequency;
+  if (dr_unlikely(frequency.QuadPart == 0)) {
+    QueryPerformanceFrequency(&frequency);
+  }
+  LARGE_INTEGER counter;
+  QueryPerformanceCounter(&counter);
+  return counter.QuadPart/frequency.QuadPart*DR_NS_PER_S + counter.QuadPart%frequency.QuadPart*DR_NS_PER_S/frequency.QuadPart;
+}
+
 #else
 
 #include <errno.h>
@@ -44,4 +54,135 @@ struct dr_result_void dr_system_sleep_ns(const int64_t time) {
   return DR_RESULT_OK_VOID();
 }
 
+// CLOCK_MONOTONIC always exists and res is valid, so this cannot fail
+int64_t dr_monotonic_ns(void) {
+  struct timespec res;
+  clock_gettime(CLOCK_MONOTONIC, &res);
+  return DR_NS_PER_S*(int64_t)res.tv_sec + res.tv_nsec;
+}
+
+#endif
+
+static int64_t dr_now;
+
+int64_t dr_now_ns(void) {
+  if (dr_unlikely(dr_now == 0)) {
+    dr_now = dr_monotonic_ns();
+  }
+  return dr_now;
+}
+
+void dr_now_update(void) {
+  dr_now = dr_monotonic_ns();
+}
+
+/*
+ * The TSC is only used when cpuid reports it invariant, meaning it ticks at a
+ * constant rate in every power state and is synchronized across cores.
+ * Otherwise ticks are dr_monotonic_ns nanoseconds.
+ */
+
+#if defined(__x86_64__) && !defined(_MSC_VER)
+
+#define DR_HAS_TSC
+
+WARN_UNUSED_RESULT static uint64_t dr_rdtsc(void) {
+  uint32_t lo;
+  uint32_t hi;
+  __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+  return (uint64_t)hi << 32 | lo;
+}
+
+WARN_UNUSED_RESULT static bool dr_tsc_invariant(void) {
+  uint32_t a;
+  uint32_t b;
+  uint32_t c;
+  uint32_t d;
+  __asm__ __volatile__("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(0x80000000U), "c"(0));
+  if (a < 0x80000007U) {
+    return false;
+  }
+  __asm__ __volatile__("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(0x80000007U), "c"(0));
+  return (d & (1U<<8)) != 0;
+}
+
+#elif defined(_M_X64)
+
+#include <intrin.h>
+
+#define DR_HAS_TSC
+
+WARN_UNUSED_RESULT static uint64_t dr_rdtsc(void) {
+  return __rdtsc();
+}
+
+WARN_UNUSED_RESULT static bool dr_tsc_invariant(void) {
+  int regs[4];
+  __cpuid(regs, 0x80000000);
+  if ((unsigned int)regs[0] < 0x80000007U) {
+    return false;
+  }
+  __cpuid(regs, 0x80000007);
+  return (regs[3] & (1<<8)) != 0;
+}
+
+#endif
+
+#if defined(DR_HAS_TSC)
+
+#define DR_TSC_CALIBRATE_NS (10*DR_NS_PER_MS)
+
+static bool dr_tsc;
+static uint64_t dr_tsc_base;
+static int64_t dr_tsc_base_ns;
+static double dr_tsc_ns_per_tick;
+
+// Spins for DR_TSC_CALIBRATE_NS to find the TSC rate
+void dr_ticks_calibrate(void) {
+  if (dr_tsc || !dr_tsc_invariant()) {
+    return;
+  }
+  const int64_t start_ns = dr_monotonic_ns();
+  const uint64_t start = dr_rdtsc();
+  int64_t end_ns;
+  do {
+    end_ns = dr_monotonic_ns();
+  } while (end_ns - start_ns < DR_TSC_CALIBRATE_NS);
+  const uint64_t end = dr_rdtsc();
+  if (dr_unlikely(end <= start)) {
+    return;
+  }
+  dr_tsc_ns_per_tick = (double)(end_ns - start_ns)/(double)(end - start);
+  dr_tsc_base = end;
+  dr_tsc_base_ns = end_ns;
+  dr_tsc = true;
+}
+
+uint64_t dr_ticks(void) {
+  if (dr_likely(dr_tsc)) {
+    return dr_rdtsc();
+  }
+  return (uint64_t)dr_monotonic_ns();
+}
+
+int64_t dr_ticks_ns(const uint64_t ticks) {
+  if (dr_likely(dr_tsc)) {
+    return dr_tsc_base_ns + (int64_t)((double)(int64_t)(ticks - dr_tsc_base)*dr_tsc_ns_per_tick);
+  }
+  return (int64_t)ticks;
+}
+
+#else
+
+void dr_ticks_calibrate(void) {
+}
+
+uint64_t dr_ticks(void) {
+  return (uint64_t)dr_monotonic_ns();
+}
+
+int64_t dr_ticks_ns(const uint64_t ticks) {
+  return (int64_t)ticks;
+}
+
 #endif
@@ -4,6 +4,7 @@
 #include "dr.h"
 
 #include <errno.h>
+#include <limits.h>
 
 #if defined(__linux__)
 
@@ -39,8 +40,48 @@
 
 #endif
 
+#if !defined(_WIN32)
+
+#include <netdb.h>
+#include <sys/socket.h>
+
+#endif
+
 #include "dr_types_impl.h"
 
+#if defined(__linux__) || defined(_WIN32)
+// Waits for the earliest timer in whole milliseconds, rounded up so it is due on wakeup
+WARN_UNUSED_RESULT static int64_t dr_equeue_timeout_ms(void) {
+  const int64_t timeout = dr_timer_timeout_ns();
+  return timeout < 0 ? -1 : (timeout + DR_NS_PER_MS - 1)/DR_NS_PER_MS;
+}
+#endif
+
+static void dr_equeue_woken(void) {
+  // Timeouts compare against the time of this wakeup rather than reading the clock each time
+  dr_now_update();
+  dr_timer_run();
+}
+
+#if defined(__linux__) || defined(HAS_KEVENT) || defined(__sun)
+// Wakes the tasks waiting on handles directly and returns how many of the events are left for the caller
+WARN_UNUSED_RESULT static unsigned int dr_equeue_wake_tasks(struct dr_event *restrict const events, const unsigned int count) {
+  unsigned int kept = 0;
+  for (unsigned int i = 0; i < count; ++i) {
+    const struct dr_equeue_handle *restrict const h = (const struct dr_equeue_handle *)dr_event_key(events, i);
+    if (h->task != NULL) {
+      dr_task_runnable(h->task);
+      continue;
+    }
+    if (kept != i) {
+      ((dr_event_impl_t *)events)[kept] = ((dr_event_impl_t *)events)[i];
+    }
+    ++kept;
+  }
+  return kept;
+}
+#endif
+
 /*
  * epoll
  * - linux
@@ -132,6 +173,8 @@ bool dr_event_is_write(struct dr_event *restrict const events, int i) {
 
 struct dr_result_uint dr_equeue_dequeue(struct dr_equeue *restrict const arg0, struct dr_event *restrict const events, size_t bytes) {
   struct dr_equeue_impl *restrict const e = (struct dr_equeue_impl *)arg0;
+  // Write out what was logged since the last wait, before this one may block
+  dr_log_flush();
   {
     struct dr_equeue_handle *restrict h;
     struct dr_equeue_handle *restrict n;
@@ -159,15 +202,18 @@ struct dr_result_uint dr_equeue_dequeue(struct dr_equeue *restrict const arg0, s
     }
   }
   dr_assert(sizeof(struct epoll_event) == sizeof(struct dr_event));
-  const int count = epoll_wait(e->fd, (struct epoll_event *)events, bytes/sizeof(struct epoll_event), -1);
+  const int64_t timeout = dr_equeue_timeout_ms();
+  const int count = epoll_wait(e->fd, (struct epoll_event *)events, bytes/sizeof(struct epoll_event), timeout > INT_MAX ? INT_MAX : (int)timeout);
   if (dr_unlikely(count < 0)) {
     const int errnum = errno;
     if (errnum == EINTR) {
+      dr_equeue_woken();
       return DR_RESULT_OK(uint, 0);
     }
     return DR_RESULT_ERRNUM(uint, DR_ERR_ISO_C, errnum);
   }
-  return DR_RESULT_OK(uint, count);
+  dr_equeue_woken();
+  return DR_RESULT_OK(uint, dr_equeue_wake_tasks(events, count));
 }
 
 #elif defined(HAS_KEVENT)
@@ -209,6 +255,7 @@ bool dr_event_is_write(struct dr_event *restrict const events, int i) {
 
 struct dr_result_uint dr_equeue_dequeue(struct dr_equeue *restrict const arg0, struct dr_event *restrict const events, size_t bytes) {
   struct dr_equeue_impl *restrict const e = (struct dr_equeue_impl *)arg0;
+  dr_log_flush();
   // DR only call kevent once, or at least less often, and on freebsd, netbsd, openbsd, and macOS, the same kevent arrays can be the same
   {
     struct dr_equeue_handle *restrict h;
@@ -236,11 +283,17 @@ struct dr_result_uint dr_equeue_dequeue(struct dr_equeue *restrict const arg0, s
     }
   }
   dr_assert(sizeof(struct kevent) == sizeof(struct dr_event));
-  const int count = kevent(e->fd, NULL, 0, (struct kevent *)events, bytes/sizeof(struct kevent), NULL);
+  const int64_t timeout = dr_timer_timeout_ns();
+  const struct timespec ts = {
+    .tv_sec = timeout/DR_NS_PER_S,
+    .tv_nsec = timeout%DR_NS_PER_S,
+  };
+  const int count = kevent(e->fd, NULL, 0, (struct kevent *)events, bytes/sizeof(struct kevent), timeout < 0 ? NULL : &ts);
   if (dr_unlikely(count < 0)) {
     return DR_RESULT_ERRNO(uint);
   }
-  return DR_RESULT_OK(uint, count);
+  dr_equeue_woken();
+  return DR_RESULT_OK(uint, dr_equeue_wake_tasks(events, count));
 }
 
 #endif
@@ -263,6 +316,38 @@ static void dr_event_unsubscribe(struct dr_equeue_impl *restrict const e, struct
   }
 }
 
+// Stops watching the handle right away rather than at the next dr_equeue_dequeue, so its fd can be handed to another handle
+WARN_UNUSED_RESULT static struct dr_result_void dr_event_forget(struct dr_equeue_impl *restrict const e, struct dr_equeue_handle *restrict const c) {
+  if (c->changed_clients.next != NULL) {
+    list_del(&c->changed_clients);
+  }
+  if (c->actual_events != 0) {
+#if defined(__linux__)
+    if (dr_unlikely(epoll_ctl(e->fd, EPOLL_CTL_DEL, c->fd, NULL) != 0)) {
+      return DR_RESULT_ERRNO_VOID();
+    }
+#else
+    // Filters are values rather than flags, so each one is deleted separately
+    struct kevent kev[2];
+    int count = 0;
+    if ((c->actual_events & DR_EVENT_IN) != 0) {
+      EV_SET(&kev[count], c->fd, EVFILT_READ, EV_DELETE, 0, 0, c);
+      ++count;
+    }
+    if ((c->actual_events & DR_EVENT_OUT) != 0) {
+      EV_SET(&kev[count], c->fd, EVFILT_WRITE, EV_DELETE, 0, 0, c);
+      ++count;
+    }
+    if (dr_unlikely(kevent(e->fd, kev, count, NULL, 0, NULL) != 0)) {
+      return DR_RESULT_ERRNO_VOID();
+    }
+#endif
+  }
+  c->actual_events = 0;
+  c->events = 0;
+  return DR_RESULT_OK_VOID();
+}
+
 #elif defined(__sun)
 
 WARN_UNUSED_RESULT static struct dr_result_handle dr_event_open(unsigned int flags) {
@@ -313,8 +398,22 @@ static void dr_event_unsubscribe(struct dr_equeue_impl *restrict const e, struct
   (void)f;
 }
 
+// Stops watching the handle right away rather than at the next dr_equeue_dequeue, so its fd can be handed to another handle
+WARN_UNUSED_RESULT static struct dr_result_void dr_event_forget(struct dr_equeue_impl *restrict const e, struct dr_equeue_handle *restrict const c) {
+  if (c->changed_clients.next != NULL) {
+    list_del(&c->changed_clients);
+  }
+  // Associations are dropped once they fire, so there may be nothing left to dissociate
+  if (dr_unlikely(port_dissociate(e->fd, PORT_SOURCE_FD, c->fd) != 0 && errno != ENOENT)) {
+    return DR_RESULT_ERRNO_VOID();
+  }
+  c->events = 0;
+  return DR_RESULT_OK_VOID();
+}
+
 struct dr_result_uint dr_equeue_dequeue(struct dr_equeue *restrict const arg0, struct dr_event *restrict const events, size_t bytes) {
   struct dr_equeue_impl *restrict const e = (struct dr_equeue_impl *)arg0;
+  dr_log_flush();
   {
     struct dr_equeue_handle *restrict h;
     struct dr_equeue_handle *restrict n;
@@ -338,10 +437,20 @@ struct dr_result_uint dr_equeue_dequeue(struct dr_equeue *restrict const arg0, s
   }
   uint_t count = 1;
   dr_assert(sizeof(port_event_t) == sizeof(struct dr_event));
-  if (dr_unlikely(port_getn(e->fd, (port_event_t *)events, bytes/sizeof(port_event_t), &count, NULL) != 0)) {
+  const int64_t timeout = dr_timer_timeout_ns();
+  timespec_t ts = {
+    .tv_sec = timeout/DR_NS_PER_S,
+    .tv_nsec = timeout%DR_NS_PER_S,
+  };
+  if (dr_unlikely(port_getn(e->fd, (port_event_t *)events, bytes/sizeof(port_event_t), &count, timeout < 0 ? NULL : &ts) != 0)) {
+    if (errno == ETIME) {
+      dr_equeue_woken();
+      return DR_RESULT_OK(uint, 0);
+    }
     return DR_RESULT_ERRNO(uint);
   }
-  return DR_RESULT_OK(uint, count);
+  dr_equeue_woken();
+  return DR_RESULT_OK(uint, dr_equeue_wake_tasks(events, count));
 }
 
 #endif
@@ -403,6 +512,44 @@ struct dr_result_size dr_equeue_write(struct dr_equeue *restrict const arg0, str
   return dr_write(c->h.fd, buf, count);
 }
 
+struct dr_result_size dr_equeue_readv(struct dr_equeue *restrict const arg0, struct dr_equeue_client *restrict const arg1, const struct dr_iovec *restrict const iov, const unsigned int count) {
+  struct dr_equeue_impl *restrict const e = (struct dr_equeue_impl *)arg0;
+  struct dr_equeue_client_impl *restrict const c = (struct dr_equeue_client_impl *)arg1;
+  {
+    const struct dr_result_size r = dr_readv(c->h.fd, iov, count);
+    DR_IF_RESULT_OK(size_t, r, value) {
+      return DR_RESULT_OK(size, value);
+    } DR_ELIF_RESULT_ERR(r, err) {
+      if (dr_unlikely(err->num != EAGAIN)) {
+	return DR_RESULT_ERROR(size, err);
+      }
+    } DR_FI_RESULT;
+  }
+  dr_event_subscribe(e, &c->h, DR_EVENT_IN);
+  dr_schedule(true);
+  dr_event_unsubscribe(e, &c->h, DR_EVENT_IN);
+  return dr_readv(c->h.fd, iov, count);
+}
+
+struct dr_result_size dr_equeue_writev(struct dr_equeue *restrict const arg0, struct dr_equeue_client *restrict const arg1, const struct dr_iovec *restrict const iov, const unsigned int count) {
+  struct dr_equeue_impl *restrict const e = (struct dr_equeue_impl *)arg0;
+  struct dr_equeue_client_impl *restrict const c = (struct dr_equeue_client_impl *)arg1;
+  {
+    const struct dr_result_size r = dr_writev(c->h.fd, iov, count);
+    DR_IF_RESULT_OK(size_t, r, value) {
+      return DR_RESULT_OK(size, value);
+    } DR_ELIF_RESULT_ERR(r, err) {
+      if (dr_unlikely(err->num != EAGAIN)) {
+	return DR_RESULT_ERROR(size, err);
+      }
+    } DR_FI_RESULT;
+  }
+  dr_event_subscribe(e, &c->h, DR_EVENT_OUT);
+  dr_schedule(true);
+  dr_event_unsubscribe(e, &c->h, DR_EVENT_OUT);
+  return dr_writev(c->h.fd, iov, count);
+}
+
 struct dr_result_void dr_equeue_init(struct dr_equeue *restrict const arg0) {
   dr_assert(sizeof(struct dr_equeue) == sizeof(struct dr_equeue_impl));
   dr_assert(sizeof(struct dr_equeue_server) == sizeof(struct dr_equeue_server_impl));
@@ -457,6 +604,175 @@ void dr_equeue_client_destroy(struct dr_equeue_client *restrict const arg0) {
   dr_equeue_handle_destroy(&c->h);
 }
 
+#define DR_CONNECT_ADDRS 16
+#define DR_CONNECT_ATTEMPTS 4
+// The connection attempt delay recommended by RFC 8305
+#define DR_CONNECT_DELAY_NS (250*DR_NS_PER_MS)
+
+// Returns 0 once fd is connected, EINPROGRESS while it is still connecting or why it failed
+WARN_UNUSED_RESULT static int dr_connect_status(const dr_handle_t fd) {
+  int errnum = 0;
+  socklen_t len = sizeof(errnum);
+  if (dr_unlikely(getsockopt(fd, SOL_SOCKET, SO_ERROR, &errnum, &len) != 0)) {
+    return errno;
+  }
+  if (errnum != 0) {
+    return errnum;
+  }
+  struct sockaddr_storage addr;
+  socklen_t addrlen = sizeof(addr);
+  if (getpeername(fd, (struct sockaddr *)&addr, &addrlen) != 0) {
+    return errno == ENOTCONN ? EINPROGRESS : errno;
+  }
+  return 0;
+}
+
+struct dr_result_handle dr_equeue_connect(struct dr_equeue *restrict const arg0, const char *restrict const hostname, const char *restrict const port) {
+  struct dr_equeue_impl *restrict const e = (struct dr_equeue_impl *)arg0;
+  struct dr_resolved *restrict resolved;
+  {
+    const struct dr_result_resolved r = dr_resolve(hostname, port, false);
+    DR_IF_RESULT_ERR(r, err) {
+      return DR_RESULT_ERROR(handle, err);
+    } DR_ELIF_RESULT_OK(struct dr_resolved *restrict, r, value) {
+      resolved = value;
+    } DR_FI_RESULT;
+  }
+  const struct addrinfo *restrict const res = dr_resolved_addrs(resolved);
+
+  // Alternate between the family getaddrinfo prefers and the rest so a family that is unreachable only costs one delay
+  const struct addrinfo *addrs[DR_CONNECT_ADDRS];
+  unsigned int addr_count = 0;
+  {
+    const struct addrinfo *preferred = res;
+    const struct addrinfo *other = res;
+    bool take_preferred = true;
+    while (addr_count < DR_CONNECT_ADDRS) {
+      while (preferred != NULL && preferred->ai_family != res->ai_family) {
+	preferred = preferred->ai_next;
+      }
+      while (other != NULL && other->ai_family == res->ai_family) {
+	other = other->ai_next;
+      }
+      if (preferred != NULL && (take_preferred || other == NULL)) {
+	addrs[addr_count++] = preferred;
+	preferred = preferred->ai_next;
+      } else if (other != NULL) {
+	addrs[addr_count++] = other;
+	other = other->ai_next;
+      } else {
+	break;
+      }
+      take_preferred = !take_preferred;
+    }
+  }
+
+  // Attempts stay in place while the equeue watches them, a free slot has fd -1
+  struct dr_equeue_handle attempts[DR_CONNECT_ATTEMPTS];
+  for (unsigned int i = 0; i < DR_CONNECT_ATTEMPTS; ++i) {
+    attempts[i] = dr_equeue_handle_init(-1);
+  }
+  unsigned int pending = 0;
+  unsigned int next = 0;
+  dr_handle_t result = -1;
+  struct dr_error last_error = {
+    .line = 0,
+  };
+  struct dr_timer timer = {
+    .pending = false,
+  };
+  while (result < 0) {
+    // Start the next attempt once the last one failed or had its head start
+    if (next < addr_count && pending < DR_CONNECT_ATTEMPTS && !timer.pending) {
+      const struct addrinfo *restrict const ai = addrs[next++];
+      dr_handle_t fd;
+      {
+	const struct dr_result_handle r = dr_socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol, DR_NONBLOCK | DR_CLOEXEC);
+	DR_IF_RESULT_ERR(r, err) {
+	  last_error = *err;
+	  continue;
+	} DR_ELIF_RESULT_OK(dr_handle_t, r, value) {
+	  fd = value;
+	} DR_FI_RESULT;
+      }
+      {
+	const struct dr_result_void r = dr_connect(fd, ai->ai_addr, ai->ai_addrlen);
+	DR_IF_RESULT_ERR(r, err) {
+	  if (err->num != EINPROGRESS) {
+	    last_error = *err;
+	    dr_close(fd);
+	    continue;
+	  }
+	} DR_ELIF_RESULT_OK_VOID(r) {
+	  result = fd;
+	  break;
+	} DR_FI_RESULT;
+      }
+      unsigned int i = 0;
+      while (attempts[i].fd >= 0) {
+	++i;
+      }
+      attempts[i] = dr_equeue_handle_init(fd);
+      attempts[i].task = dr_task_self();
+      dr_event_subscribe(e, &attempts[i], DR_EVENT_OUT);
+      ++pending;
+      if (next < addr_count) {
+	dr_timer_start(&timer, dr_now_ns() + DR_CONNECT_DELAY_NS);
+      }
+      continue;
+    }
+    if (pending == 0) {
+      break;
+    }
+    dr_schedule(true);
+    for (unsigned int i = 0; i < DR_CONNECT_ATTEMPTS && result < 0; ++i) {
+      if (attempts[i].fd < 0) {
+	continue;
+      }
+      const int status = dr_connect_status(attempts[i].fd);
+      if (status == 0) {
+	result = attempts[i].fd;
+      } else if (status != EINPROGRESS) {
+	last_error = (struct dr_error) {
+	  .func = __func__,
+	  .file = __FILE__,
+	  .line = __LINE__,
+	  .domain = DR_ERR_ISO_C,
+	  .num = status,
+	};
+	dr_equeue_handle_destroy(&attempts[i]);
+	attempts[i].fd = -1;
+	--pending;
+	// Go straight to the next address
+	dr_timer_cancel(&timer);
+      }
+    }
+  }
+  dr_timer_cancel(&timer);
+
+  // Attempts that lost are closed and the winner is handed back unwatched
+  for (unsigned int i = 0; i < DR_CONNECT_ATTEMPTS; ++i) {
+    if (attempts[i].fd < 0) {
+      continue;
+    }
+    if (attempts[i].fd != result) {
+      dr_equeue_handle_destroy(&attempts[i]);
+      continue;
+    }
+    const struct dr_result_void r = dr_event_forget(e, &attempts[i]);
+    DR_IF_RESULT_ERR(r, err) {
+      last_error = *err;
+      dr_close(result);
+      result = -1;
+    } DR_FI_RESULT;
+  }
+  dr_resolve_release(resolved);
+  if (dr_unlikely(result < 0)) {
+    return DR_RESULT_ERROR(handle, &last_error);
+  }
+  return DR_RESULT_OK(handle, result);
+}
+
 #elif defined(_WIN32)
 
 WARN_UNUSED_RESULT static struct dr_result_void dr_event_associate(dr_handle_t efd, dr_handle_t fd, void *restrict const key) {
@@ -575,6 +891,23 @@ struct dr_result_size dr_equeue_write(struct dr_equeue *restrict const arg0, str
   return DR_RESULT_OK(size, c->wol.InternalHigh);
 }
 
+// Overlapped reads and writes take one buffer, a short transfer is allowed anyway
+struct dr_result_size dr_equeue_readv(struct dr_equeue *restrict const e, struct dr_equeue_client *restrict const c, const struct dr_iovec *restrict const iov, const unsigned int count) {
+  dr_assert(count > 0);
+  return dr_equeue_read(e, c, iov[0].base, iov[0].len);
+}
+
+struct dr_result_size dr_equeue_writev(struct dr_equeue *restrict const e, struct dr_equeue_client *restrict const c, const struct dr_iovec *restrict const iov, const unsigned int count) {
+  dr_assert(count > 0);
+  return dr_equeue_write(e, c, iov[0].base, iov[0].len);
+}
+
+struct dr_result_handle dr_equeue_connect(struct dr_equeue *restrict const e, const char *restrict const hostname, const char *restrict const port) {
+  (void)e;
+  // DR Use ConnectEx, this blocks until connected
+  return dr_sock_connect(hostname, port, DR_CLOEXEC | DR_NONBLOCK);
+}
+
 bool dr_event_is_read(struct dr_event *restrict const events, int i) {
   OVERLAPPED_ENTRY *restrict const e = ((OVERLAPPED_ENTRY *)events) +i;
   return (char *)e->lpOverlapped - (char *)e->lpCompletionKey == offsetof(struct dr_equeue_client_impl, rol);
@@ -602,6 +935,7 @@ struct dr_result_void dr_equeue_init(struct dr_equeue *restrict const arg0) {
 
 struct dr_result_uint dr_equeue_dequeue(struct dr_equeue *restrict const arg0, struct dr_event *restrict const events, size_t bytes) {
   struct dr_equeue_impl *restrict const e = (struct dr_equeue_impl *)arg0;
+  dr_log_flush();
   DWORD count;
   dr_assert(sizeof(OVERLAPPED_ENTRY) == sizeof(struct dr_event));
 #if 0 // DR ...
@@ -611,11 +945,18 @@ struct dr_result_uint dr_equeue_dequeue(struct dr_equeue *restrict const arg0, s
     return DR_RESULT_ERRNUM(uint, DR_ERR_WIN, ERROR_INVALID_HANDLE);
   }
   count = 1;
-  if (dr_unlikely(GetQueuedCompletionStatus((HANDLE)e->fd, &((OVERLAPPED_ENTRY *)events)[0].dwNumberOfBytesTransferred, &((OVERLAPPED_ENTRY *)events)[0].lpCompletionKey, &((OVERLAPPED_ENTRY *)events)[0].lpOverlapped, INFINITE) == 0))
+  const int64_t timeout = dr_equeue_timeout_ms();
+  if (dr_unlikely(GetQueuedCompletionStatus((HANDLE)e->fd, &((OVERLAPPED_ENTRY *)events)[0].dwNumberOfBytesTransferred, &((OVERLAPPED_ENTRY *)events)[0].lpCompletionKey, &((OVERLAPPED_ENTRY *)events)[0].lpOverlapped, timeout < 0 ? INFINITE : timeout >= INFINITE ? INFINITE - 1 : (DWORD)timeout) == 0))
 #endif
   {
-    return DR_RESULT_GETLASTERROR(uint);
+    const DWORD errnum = GetLastError();
+    if (errnum == WAIT_TIMEOUT && ((OVERLAPPED_ENTRY *)events)[0].lpOverlapped == NULL) {
+      dr_equeue_woken();
+      return DR_RESULT_OK(uint, 0);
+    }
+    return DR_RESULT_ERRNUM(uint, DR_ERR_WIN, errnum);
   }
+  dr_equeue_woken();
   return DR_RESULT_OK(uint, count);
 }
 
@@ -650,3 +991,26 @@ void dr_equeue_destroy(struct dr_equeue *restrict const arg0) {
   struct dr_equeue_impl *restrict const e = (struct dr_equeue_impl *)arg0;
   dr_close(e->fd);
 }
+
+struct dr_result_size dr_equeue_read_ring(struct dr_equeue *restrict const e, struct dr_equeue_client *restrict const c, struct dr_ring *restrict const ring) {
+  // A read into no space would look like end of file
+  dr_assert(dr_ring_writable(ring) > 0);
+  struct dr_iovec iov[2];
+  const unsigned int count = dr_ring_write_iov(ring, iov);
+  const struct dr_result_size r = dr_equeue_readv(e, c, iov, count);
+  DR_IF_RESULT_OK(size_t, r, value) {
+    dr_ring_produce(ring, (uint32_t)value);
+  } DR_FI_RESULT;
+  return r;
+}
+
+struct dr_result_size dr_equeue_write_ring(struct dr_equeue *restrict const e, struct dr_equeue_client *restrict const c, struct dr_ring *restrict const ring) {
+  dr_assert(dr_ring_readable(ring) > 0);
+  struct dr_iovec iov[2];
+  const unsigned int count = dr_ring_read_iov(ring, iov);
+  const struct dr_result_size r = dr_equeue_writev(e, c, iov, count);
+  DR_IF_RESULT_OK(size_t, r, value) {
+    dr_ring_consume(ring, (uint32_t)value);
+  } DR_FI_RESULT;
+  return r;
+}
@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// Copyright (c) 2018 Drew Richardson <drewrichardson@gmail.com>
+
+#include "dr.h"
+
+#include <string.h>
+
+#define DR_HIST_SUB_COUNT (1U<<DR_HIST_SUB_BITS)
+#define DR_HIST_SUB_MASK (DR_HIST_SUB_COUNT - 1)
+
+WARN_UNUSED_RESULT static unsigned int dr_msb64(const uint64_t value) {
+#if defined(HAS_BUILTIN_CLZLL)
+  return 63 - __builtin_clzll(value);
+#else
+  unsigned int msb = 0;
+  for (uint64_t v = value; v >>= 1; ++msb) {
+  }
+  return msb;
+#endif
+}
+
+WARN_UNUSED_RESULT static uint_fast32_t dr_hist_index(const uint64_t value) {
+  if (value < DR_HIST_SUB_COUNT) {
+    return value;
+  }
+  const unsigned int shift = dr_msb64(value) - DR_HIST_SUB_BITS;
+  return ((shift + 1) << DR_HIST_SUB_BITS) + ((value >> shift) & DR_HIST_SUB_MASK);
+}
+
+WARN_UNUSED_RESULT static uint64_t dr_hist_upper(const uint_fast32_t index) {
+  if (index < DR_HIST_SUB_COUNT) {
+    return index;
+  }
+  const unsigned int shift = (index >> DR_HIST_SUB_BITS) - 1;
+  const uint64_t lower = (uint64_t)(DR_HIST_SUB_COUNT | (index & DR_HIST_SUB_MASK)) << shift;
+  return lower + (((uint64_t)1 << shift) - 1);
+}
+
+void dr_hist_init(struct dr_hist *restrict const hist) {
+  memset(hist, 0, sizeof(*hist));
+}
+
+void dr_hist_record(struct dr_hist *restrict const hist, const uint64_t value) {
+  ++hist->buckets[dr_hist_index(value)];
+  ++hist->count;
+  if (value > hist->max) {
+    hist->max = value;
+  }
+}
+
+void dr_hist_merge(struct dr_hist *restrict const dst, const struct dr_hist *restrict const src) {
+  for (uint_fast32_t i = 0; i < DR_HIST_BUCKETS; ++i) {
+    dst->buckets[i] += src->buckets[i];
+  }
+  dst->count += src->count;
+  if (src->max > dst->max) {
+    dst->max = src->max;
+  }
+}
+
+// Returns the upper bound of the bucket holding the requested rank, clamped to the largest recorded value
+uint64_t dr_hist_percentile(const struct dr_hist *restrict const hist, const uint32_t permille) {
+  if (hist->count == 0) {
+    return 0;
+  }
+  const uint64_t rank = permille >= 1000 ? hist->count : (hist->count*permille + 999)/1000;
+  uint64_t seen = 0;
+  for (uint_fast32_t i = 0; i < DR_HIST_BUCKETS; ++i) {
+    seen += hist->buckets[i];
+    if (seen >= rank && seen != 0) {
+      const uint64_t upper = dr_hist_upper(i);
+      return upper < hist->max ? upper : hist->max;
+    }
+  }
+  return hist->max;
+}
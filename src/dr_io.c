@@ -37,13 +37,32 @@ struct dr_result_size dr_write(dr_handle_t fd, const void *restrict const buf, s
   return dr_write_ol(fd, buf, count, NULL);
 }
 
+struct dr_result_size dr_readv(dr_handle_t fd, const struct dr_iovec *restrict const iov, const unsigned int count) {
+  dr_assert(count > 0);
+  return dr_read(fd, iov[0].base, iov[0].len);
+}
+
+struct dr_result_size dr_writev(dr_handle_t fd, const struct dr_iovec *restrict const iov, const unsigned int count) {
+  dr_assert(count > 0);
+  return dr_write(fd, iov[0].base, iov[0].len);
+}
+
 void dr_close(dr_handle_t fd) {
   CloseHandle((HANDLE)fd);
 }
 
+struct dr_result_void dr_set_nonblock(dr_handle_t fd) {
+  (void)fd;
+  // Overlapped IO is used instead
+  return DR_RESULT_OK_VOID();
+}
+
 #else
 
 #include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 struct dr_result_size dr_read(dr_handle_t fd, void *restrict const buf, size_t count) {
@@ -62,8 +81,37 @@ struct dr_result_size dr_write(dr_handle_t fd, const void *restrict const buf, s
   return DR_RESULT_OK(size, result);
 }
 
+// struct dr_iovec is laid out like struct iovec so it is passed through as is, the array size goes negative and fails the build if not
+typedef char dr_iovec_check[(sizeof(struct dr_iovec) == sizeof(struct iovec) &&
+			     offsetof(struct dr_iovec, base) == offsetof(struct iovec, iov_base) &&
+			     offsetof(struct dr_iovec, len) == offsetof(struct iovec, iov_len)) ? 1 : -1];
+
+struct dr_result_size dr_readv(dr_handle_t fd, const struct dr_iovec *restrict const iov, const unsigned int count) {
+  const ssize_t result = readv(fd, (const struct iovec *)iov, count);
+  if (dr_unlikely(result < 0)) {
+    return DR_RESULT_ERRNO(size);
+  }
+  return DR_RESULT_OK(size, result);
+}
+
+struct dr_result_size dr_writev(dr_handle_t fd, const struct dr_iovec *restrict const iov, const unsigned int count) {
+  const ssize_t result = writev(fd, (const struct iovec *)iov, count);
+  if (dr_unlikely(result < 0)) {
+    return DR_RESULT_ERRNO(size);
+  }
+  return DR_RESULT_OK(size, result);
+}
+
 void dr_close(dr_handle_t fd) {
   close(fd);
 }
 
+struct dr_result_void dr_set_nonblock(dr_handle_t fd) {
+  const int fl = fcntl(fd, F_GETFL);
+  if (dr_unlikely(fl < 0 || fcntl(fd, F_SETFL, fl | O_NONBLOCK) != 0)) {
+    return DR_RESULT_ERRNO_VOID();
+  }
+  return DR_RESULT_OK_VOID();
+}
+
 #endif
@@ -9,41 +9,150 @@
 #include <windows.h>
 #else
 #include <netdb.h>
+#include <pthread.h>
 #endif
 
 #include <inttypes.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-static void dr_log_prolog(const char *restrict const func, const char *restrict const file, const int line) {
-  int width = 0;
-  {
-    const struct dr_result_int64 r = dr_system_time_ns();
-    DR_IF_RESULT_OK(int64_t, r, value) {
-      width += printf("%" PRIi64 ".%09" PRIi64 " ", value/DR_NS_PER_S, value%DR_NS_PER_S);
-    } DR_FI_RESULT;
+/*
+ * Records are formatted into a buffer and written with a single fwrite by
+ * dr_log_flush, which dr_equeue_dequeue calls before it waits, so logging
+ * does not block every task on a terminal or pipe write. Records are
+ * appended only by the thread running the scheduler, so no locking is needed,
+ * and dr_log_commit asserts that pool threads do not log.
+ */
+
+#define DR_LOG_BUF_SIZE (1<<16)
+#define DR_LOG_RECORD_SIZE (1<<9)
+
+static char dr_log_buf[DR_LOG_BUF_SIZE];
+static uint32_t dr_log_len;
+static bool dr_log_dropping;
+int dr_log_level = DR_LOG_INFO;
+static uint64_t dr_log_drops;
+static uint64_t dr_log_reported;
+
+#if defined(_WIN32)
+typedef DWORD dr_log_thread_t;
+#define dr_log_self() GetCurrentThreadId()
+#define dr_log_thread_eq(a, b) ((a) == (b))
+#else
+typedef pthread_t dr_log_thread_t;
+#define dr_log_self() pthread_self()
+#define dr_log_thread_eq(a, b) pthread_equal(a, b)
+#endif
+
+// The first thread to log owns the buffer
+static dr_log_thread_t dr_log_owner;
+
+void dr_log_flush(void) {
+  const bool dropped = dr_log_drops != dr_log_reported;
+  if (dr_likely(dr_log_len == 0 && !dropped)) {
+    return;
+  }
+  fwrite(dr_log_buf, 1, dr_log_len, stdout);
+  dr_log_len = 0;
+  if (dr_unlikely(dropped)) {
+    printf("%" PRIu64 " log records dropped\n", dr_log_drops - dr_log_reported);
+    dr_log_reported = dr_log_drops;
+  }
+  fflush(stdout);
+}
+
+void dr_log_drop(const bool drop) {
+  dr_log_dropping = drop;
+}
+
+uint64_t dr_log_dropped(void) {
+  return dr_log_drops;
+}
+
+static void dr_log_commit(const char *restrict const record, const uint32_t len) {
+  static bool registered;
+  if (dr_unlikely(!registered)) {
+    registered = true;
+    dr_log_owner = dr_log_self();
+    atexit(dr_log_flush);
   }
-  width += printf("%s(%s:%i)", func, file, line);
+  dr_assert(dr_log_thread_eq(dr_log_owner, dr_log_self()));
+  if (dr_unlikely(len > sizeof(dr_log_buf) - dr_log_len)) {
+    if (dr_log_dropping) {
+      ++dr_log_drops;
+      return;
+    }
+    dr_log_flush();
+  }
+  memcpy(dr_log_buf + dr_log_len, record, len);
+  dr_log_len += len;
+}
+
+// Appends to a record of DR_LOG_RECORD_SIZE bytes, truncating it when full
+static void dr_log_vappend(char *restrict const record, uint32_t *restrict const len, const char *restrict const format, va_list ap) {
+  const int written = vsnprintf(record + *len, DR_LOG_RECORD_SIZE - *len, format, ap);
+  if (dr_likely(written > 0)) {
+    *len = (uint32_t)written < DR_LOG_RECORD_SIZE - *len ? *len + written : DR_LOG_RECORD_SIZE - 1;
+  }
+}
+
+static void dr_log_append(char *restrict const record, uint32_t *restrict const len, const char *restrict const format, ...) {
+  va_list ap;
+  va_start(ap, format);
+  dr_log_vappend(record, len, format, ap);
+  va_end(ap);
+}
+
+WARN_UNUSED_RESULT static uint32_t dr_log_prolog(char *restrict const record, const char *restrict const func, const char *restrict const file, const int line) {
+  uint32_t len = 0;
+  // The time of the current wakeup is close enough and saves a clock read per record
+  const int64_t now = dr_now_ns();
+  dr_log_append(record, &len, "%" PRIi64 ".%09" PRIi64 " ", now/DR_NS_PER_S, now%DR_NS_PER_S);
+  dr_log_append(record, &len, "%s(%s:%i)", func, file, line);
+  const int width = len;
   static int max_width;
   if (dr_unlikely(width > max_width)) {
     max_width = width;
   }
-  printf("%*s : ", max_width - width, "");
+  dr_log_append(record, &len, "%*s : ", max_width - width, "");
+  return len;
 }
 
-static void dr_log_epilog(void) {
-  fflush(stdout);
+// Truncated records still end the line
+static void dr_log_end_record(char *restrict const record, const uint32_t len) {
+  if (dr_unlikely(len == DR_LOG_RECORD_SIZE - 1)) {
+    record[len - 1] = '\n';
+  }
+}
+
+static void dr_log_commit_record(char *restrict const record, const uint32_t len) {
+  dr_log_end_record(record, len);
+  dr_log_commit(record, len);
 }
 
 void dr_log_impl(const char *restrict const func, const char *restrict const file, const int line, const char *restrict const msg) {
-  dr_log_prolog(func, file, line);
-  printf("%s\n", msg);
-  dr_log_epilog();
+  char record[DR_LOG_RECORD_SIZE];
+  uint32_t len = dr_log_prolog(record, func, file, line);
+  dr_log_append(record, &len, "%s\n", msg);
+  dr_log_commit_record(record, len);
+}
+
+void dr_logf_impl(const char *restrict const func, const char *restrict const file, const int line, const char *restrict const format, ...) {
+  char record[DR_LOG_RECORD_SIZE];
+  uint32_t len = dr_log_prolog(record, func, file, line);
+  va_list ap;
+  va_start(ap, format);
+  dr_log_vappend(record, &len, format, ap);
+  va_end(ap);
+  dr_log_append(record, &len, "\n");
+  dr_log_commit_record(record, len);
 }
 
 void dr_log_error_impl(const char *restrict const func, const char *restrict const file, const int line, const char *restrict const msg, const struct dr_error *restrict const error) {
-  dr_log_prolog(func, file, line);
+  char record[DR_LOG_RECORD_SIZE];
+  uint32_t len = dr_log_prolog(record, func, file, line);
   char buf[1<<6];
   const char *restrict bufp;
   bool newline = true;
@@ -69,8 +178,8 @@ void dr_log_error_impl(const char *restrict const func, const char *restrict con
     bufp = buf;
     break;
   }
-  printf("at %s(%s:%i): %s: %s%s", error->func, error->file, error->line, msg, bufp, newline ? "\n" : "");
-  dr_log_epilog();
+  dr_log_append(record, &len, "at %s(%s:%i): %s: %s%s", error->func, error->file, error->line, msg, bufp, newline ? "\n" : "");
+  dr_log_commit_record(record, len);
 }
 
 // This ommits func/file/line, but is convienent where it's being used. If that's not desireable, multiple versions could be created
@@ -102,8 +211,13 @@ int dr_log_format(char *restrict const buf, size_t size, const struct dr_error *
 }
 
 void dr_assert_fail(const char *restrict const func, const char *restrict const file, const int line, const char *restrict const cond) {
-  dr_log_prolog(func, file, line);
-  printf("`%s` failed\n", cond);
-  dr_log_epilog();
+  char record[DR_LOG_RECORD_SIZE];
+  uint32_t len = dr_log_prolog(record, func, file, line);
+  dr_log_append(record, &len, "`%s` failed\n", cond);
+  dr_log_end_record(record, len);
+  // Written directly, as the failure may be the owner check in dr_log_commit
+  dr_log_flush();
+  fwrite(record, 1, len, stdout);
+  fflush(stdout);
   abort();
 }
@@ -0,0 +1,341 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// Copyright (c) 2018 Drew Richardson <drewrichardson@gmail.com>
+
+#include "dr.h"
+
+#include <errno.h>
+#include <stdlib.h>
+
+#if defined(_WIN32)
+
+#include <windows.h>
+
+#elif defined(__linux__)
+
+#include <sys/eventfd.h>
+
+#else
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#endif
+
+#include "dr_types_impl.h"
+#include "list.h"
+
+/*
+ * Blocking calls are run on a fixed set of OS threads. The submitting task
+ * sleeps until the pool task, woken through the equeue, marks it runnable.
+ * dr_pool_start lets it carry on and only sleep once it calls dr_pool_finish.
+ * Only the pending and done lists are shared between threads.
+ */
+
+#if defined(_WIN32)
+
+static void dr_pool_lock(struct dr_pool_impl *restrict const p) {
+  EnterCriticalSection(&p->lock);
+}
+
+static void dr_pool_unlock(struct dr_pool_impl *restrict const p) {
+  LeaveCriticalSection(&p->lock);
+}
+
+static void dr_pool_signal(struct dr_pool_impl *restrict const p) {
+  WakeConditionVariable(&p->cond);
+}
+
+static void dr_pool_cond_wait(struct dr_pool_impl *restrict const p) {
+  SleepConditionVariableCS(&p->cond, &p->lock, INFINITE);
+}
+
+static void dr_pool_wake(struct dr_pool_impl *restrict const p) {
+  // Failure leaves woken set and stalls completions, but only happens if the port is closed
+  PostQueuedCompletionStatus((HANDLE)p->efd, 0, (ULONG_PTR)p, NULL);
+}
+
+WARN_UNUSED_RESULT static struct dr_result_void dr_pool_wait(struct dr_pool_impl *restrict const p) {
+  (void)p;
+  dr_schedule(true);
+  return DR_RESULT_OK_VOID();
+}
+
+#else
+
+static void dr_pool_lock(struct dr_pool_impl *restrict const p) {
+  pthread_mutex_lock(&p->lock);
+}
+
+static void dr_pool_unlock(struct dr_pool_impl *restrict const p) {
+  pthread_mutex_unlock(&p->lock);
+}
+
+static void dr_pool_signal(struct dr_pool_impl *restrict const p) {
+  pthread_cond_signal(&p->cond);
+}
+
+static void dr_pool_cond_wait(struct dr_pool_impl *restrict const p) {
+  pthread_cond_wait(&p->cond, &p->lock);
+}
+
+static void dr_pool_wake(struct dr_pool_impl *restrict const p) {
+  const uint64_t value = 1;
+  // EAGAIN means the handle is already readable
+  const struct dr_result_size r = dr_write(p->wfd, &value, sizeof(value));
+  (void)r;
+}
+
+WARN_UNUSED_RESULT static struct dr_result_void dr_pool_wait(struct dr_pool_impl *restrict const p) {
+  uint8_t buf[64];
+  const struct dr_result_size r = dr_equeue_read(p->e, (struct dr_equeue_client *)&p->c, buf, sizeof(buf));
+  DR_IF_RESULT_ERR(r, err) {
+    return DR_RESULT_ERROR_VOID(err);
+  } DR_FI_RESULT;
+  return DR_RESULT_OK_VOID();
+}
+
+#endif
+
+static void dr_pool_thread_do(struct dr_pool_impl *restrict const p) {
+  dr_pool_lock(p);
+  while (true) {
+    while (list_empty(&p->pending) && !p->stopping) {
+      dr_pool_cond_wait(p);
+    }
+    if (list_empty(&p->pending)) {
+      break;
+    }
+    struct dr_pool_job *restrict const job = list_first_entry(&p->pending, struct dr_pool_job, jobs);
+    list_del(&job->jobs);
+    dr_pool_unlock(p);
+    job->func(job);
+    dr_pool_lock(p);
+    list_add_tail(&job->jobs, &p->done);
+    if (!p->woken) {
+      p->woken = true;
+      dr_pool_wake(p);
+    }
+  }
+  dr_pool_unlock(p);
+}
+
+#if defined(_WIN32)
+
+static DWORD WINAPI dr_pool_thread(LPVOID arg) {
+  dr_pool_thread_do((struct dr_pool_impl *)arg);
+  return 0;
+}
+
+WARN_UNUSED_RESULT static struct dr_result_void dr_pool_impl_init(struct dr_pool_impl *restrict const p, struct dr_equeue *restrict const e) {
+  p->efd = ((struct dr_equeue_impl *)e)->fd;
+  InitializeCriticalSection(&p->lock);
+  InitializeConditionVariable(&p->cond);
+  return DR_RESULT_OK_VOID();
+}
+
+static void dr_pool_impl_destroy(struct dr_pool_impl *restrict const p) {
+  DeleteCriticalSection(&p->lock);
+}
+
+WARN_UNUSED_RESULT static struct dr_result_void dr_pool_thread_start(struct dr_pool_impl *restrict const p, const unsigned int i) {
+  p->threads[i] = CreateThread(NULL, 0, dr_pool_thread, p, 0, NULL);
+  if (dr_unlikely(p->threads[i] == NULL)) {
+    return DR_RESULT_GETLASTERROR_VOID();
+  }
+  return DR_RESULT_OK_VOID();
+}
+
+static void dr_pool_thread_join(struct dr_pool_impl *restrict const p, const unsigned int i) {
+  WaitForSingleObject(p->threads[i], INFINITE);
+  CloseHandle(p->threads[i]);
+}
+
+#else
+
+static void *dr_pool_thread(void *arg) {
+  dr_pool_thread_do((struct dr_pool_impl *)arg);
+  return NULL;
+}
+
+WARN_UNUSED_RESULT static struct dr_result_handle dr_pool_wake_open(dr_handle_t *restrict const wfd) {
+#if defined(__linux__)
+  const int fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (dr_unlikely(fd < 0)) {
+    return DR_RESULT_ERRNO(handle);
+  }
+  *wfd = fd;
+  return DR_RESULT_OK(handle, fd);
+#else
+  int fds[2];
+  if (dr_unlikely(pipe(fds) != 0)) {
+    return DR_RESULT_ERRNO(handle);
+  }
+  for (int i = 0; i < 2; ++i) {
+    const int df = fcntl(fds[i], F_GETFD); // DR Merge duplicate fcntl code?
+    const int fl = fcntl(fds[i], F_GETFL);
+    if (dr_unlikely(df < 0 || fcntl(fds[i], F_SETFD, df | FD_CLOEXEC) != 0 ||
+		    fl < 0 || fcntl(fds[i], F_SETFL, fl | O_NONBLOCK) != 0)) {
+      const int errnum = errno;
+      dr_close(fds[0]);
+      dr_close(fds[1]);
+      return DR_RESULT_ERRNUM(handle, DR_ERR_ISO_C, errnum);
+    }
+  }
+  *wfd = fds[1];
+  return DR_RESULT_OK(handle, fds[0]);
+#endif
+}
+
+WARN_UNUSED_RESULT static struct dr_result_void dr_pool_impl_init(struct dr_pool_impl *restrict const p, struct dr_equeue *restrict const e) {
+  dr_handle_t rfd;
+  {
+    const struct dr_result_handle r = dr_pool_wake_open(&p->wfd);
+    DR_IF_RESULT_ERR(r, err) {
+      return DR_RESULT_ERROR_VOID(err);
+    } DR_ELIF_RESULT_OK(dr_handle_t, r, value) {
+      rfd = value;
+    } DR_FI_RESULT;
+  }
+  dr_equeue_client_init((struct dr_equeue_client *)&p->c, rfd);
+  p->e = e;
+  pthread_mutex_init(&p->lock, NULL);
+  pthread_cond_init(&p->cond, NULL);
+  return DR_RESULT_OK_VOID();
+}
+
+static void dr_pool_impl_destroy(struct dr_pool_impl *restrict const p) {
+  pthread_cond_destroy(&p->cond);
+  pthread_mutex_destroy(&p->lock);
+  if (p->wfd != p->c.h.fd) {
+    dr_close(p->wfd);
+  }
+  dr_equeue_client_destroy((struct dr_equeue_client *)&p->c);
+}
+
+WARN_UNUSED_RESULT static struct dr_result_void dr_pool_thread_start(struct dr_pool_impl *restrict const p, const unsigned int i) {
+  const int errnum = pthread_create(&p->threads[i], NULL, dr_pool_thread, p);
+  if (dr_unlikely(errnum != 0)) {
+    return DR_RESULT_ERRNUM_VOID(DR_ERR_ISO_C, errnum);
+  }
+  return DR_RESULT_OK_VOID();
+}
+
+static void dr_pool_thread_join(struct dr_pool_impl *restrict const p, const unsigned int i) {
+  pthread_join(p->threads[i], NULL);
+}
+
+#endif
+
+static void dr_pool_stop(struct dr_pool_impl *restrict const p) {
+  dr_pool_lock(p);
+  p->stopping = true;
+  dr_pool_unlock(p);
+#if defined(_WIN32)
+  WakeAllConditionVariable(&p->cond);
+#else
+  pthread_cond_broadcast(&p->cond);
+#endif
+  for (unsigned int i = 0; i < p->thread_count; ++i) {
+    dr_pool_thread_join(p, i);
+  }
+}
+
+struct dr_result_void dr_pool_init(struct dr_pool *restrict const arg0, struct dr_equeue *restrict const e, const unsigned int thread_count) {
+  dr_assert(sizeof(struct dr_pool) == sizeof(struct dr_pool_impl));
+  struct dr_pool_impl *restrict const p = (struct dr_pool_impl *)arg0;
+  if (dr_unlikely(thread_count == 0)) {
+    return DR_RESULT_ERRNUM_VOID(DR_ERR_ISO_C, EINVAL);
+  }
+  *p = (struct dr_pool_impl) {
+    .pending = LIST_HEAD_INIT(p->pending),
+    .done = LIST_HEAD_INIT(p->done),
+  };
+  p->threads = calloc(thread_count, sizeof(*p->threads));
+  if (dr_unlikely(p->threads == NULL)) {
+    return DR_RESULT_ERRNO_VOID();
+  }
+  {
+    const struct dr_result_void r = dr_pool_impl_init(p, e);
+    DR_IF_RESULT_ERR(r, err) {
+      free(p->threads);
+      return DR_RESULT_ERROR_VOID(err);
+    } DR_FI_RESULT;
+  }
+  for (unsigned int i = 0; i < thread_count; ++i) {
+    const struct dr_result_void r = dr_pool_thread_start(p, i);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_pool_stop(p);
+      dr_pool_impl_destroy(p);
+      free(p->threads);
+      return DR_RESULT_ERROR_VOID(err);
+    } DR_FI_RESULT;
+    ++p->thread_count;
+  }
+  return DR_RESULT_OK_VOID();
+}
+
+void dr_pool_destroy(struct dr_pool *restrict const arg0) {
+  struct dr_pool_impl *restrict const p = (struct dr_pool_impl *)arg0;
+  dr_pool_stop(p);
+  // The pool task no longer runs, so dr_pool_finish on a job started earlier must not wait for it
+  struct dr_pool_job *restrict job;
+  struct dr_pool_job *restrict n;
+  list_for_each_entry_safe(job, n, &p->done, struct dr_pool_job, jobs) {
+    list_del(&job->jobs);
+    job->done = true;
+  }
+  dr_pool_impl_destroy(p);
+  free(p->threads);
+}
+
+void dr_pool_start(struct dr_pool *restrict const arg0, struct dr_pool_job *restrict const job) {
+  struct dr_pool_impl *restrict const p = (struct dr_pool_impl *)arg0;
+  job->task = NULL;
+  job->done = false;
+  dr_pool_lock(p);
+  list_add_tail(&job->jobs, &p->pending);
+  dr_pool_unlock(p);
+  dr_pool_signal(p);
+}
+
+void dr_pool_finish(struct dr_pool_job *restrict const job) {
+  // done and task are only touched on the scheduler thread
+  job->task = dr_task_self();
+  while (!job->done) {
+    dr_schedule(true);
+  }
+  job->task = NULL;
+}
+
+void dr_pool_run(struct dr_pool *restrict const pool, struct dr_pool_job *restrict const job) {
+  dr_pool_start(pool, job);
+  dr_pool_finish(job);
+}
+
+void dr_pool_task(void *restrict const arg) {
+  struct dr_pool_impl *restrict const p = (struct dr_pool_impl *)arg;
+  while (true) {
+    {
+      const struct dr_result_void r = dr_pool_wait(p);
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_pool_wait failed", err);
+	break;
+      } DR_FI_RESULT;
+    }
+    struct list_head done = LIST_HEAD_INIT(done);
+    dr_pool_lock(p);
+    list_splice_tail_init(&p->done, &done);
+    p->woken = false;
+    dr_pool_unlock(p);
+    struct dr_pool_job *restrict job;
+    struct dr_pool_job *restrict n;
+    list_for_each_entry_safe(job, n, &done, struct dr_pool_job, jobs) {
+      list_del(&job->jobs);
+      job->done = true;
+      // A job nobody is waiting on yet is picked up by dr_pool_finish
+      if (job->task != NULL) {
+	dr_task_runnable(job->task);
+      }
+    }
+  }
+}
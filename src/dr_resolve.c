@@ -0,0 +1,259 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// Copyright (c) 2018 Drew Richardson <drewrichardson@gmail.com>
+
+#include "dr.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+
+#include <winsock2.h>
+
+#include <windows.h>
+#include <ws2tcpip.h>
+
+#else
+
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#endif
+
+#include "hash.h"
+#include "list.h"
+
+/*
+ * getaddrinfo answers are cached by hostname, port and whether they are for
+ * binding, so connecting to the same peer again costs a hash probe. The
+ * system resolver does not report DNS TTLs, so every answer is kept for the
+ * configured time. Cached entries are kept in expiry order, which is the
+ * order they were resolved unless the TTL has since been lowered.
+ * Tasks asking for a name that is still being resolved wait for that lookup
+ * rather than starting another.
+ */
+
+struct dr_resolved {
+  struct hash_node hash;
+  // Resolved entries still cached, soonest to expire first
+  struct list_head entries;
+  struct dr_wait wait;
+  struct addrinfo *restrict res;
+  const char *restrict hostname;
+  const char *restrict port;
+  int64_t expires;
+  unsigned int refs;
+  int errnum;
+  bool passive;
+  bool resolving;
+  bool cached;
+  char strs[];
+};
+
+struct dr_resolve_key {
+  const char *restrict hostname;
+  const char *restrict port;
+  bool passive;
+};
+
+struct dr_resolve_call {
+  struct dr_pool_job job;
+  struct dr_resolved *restrict entry;
+};
+
+static struct hash_table dr_resolve_cache = HASH_TABLE_INIT;
+static struct list_head dr_resolve_entries = LIST_HEAD_INIT(dr_resolve_entries);
+static int64_t dr_resolve_ttl = DR_RESOLVE_TTL_NS;
+static struct dr_pool *restrict dr_resolve_pool;
+
+void dr_resolve_offload(struct dr_pool *restrict const pool) {
+  dr_resolve_pool = pool;
+}
+
+void dr_resolve_cache_ttl(const int64_t ttl_ns) {
+  dr_resolve_ttl = ttl_ns;
+}
+
+// FNV-1a, a NULL string hashes differently from an empty one
+static uint32_t dr_resolve_hash_str(uint32_t hash, const char *restrict const str) {
+  if (str == NULL) {
+    return (hash ^ 0xff)*UINT32_C(16777619);
+  }
+  for (const char *restrict pos = str;; ++pos) {
+    hash = (hash ^ (uint8_t)*pos)*UINT32_C(16777619);
+    if (*pos == '\0') {
+      return hash;
+    }
+  }
+}
+
+WARN_UNUSED_RESULT static uint32_t dr_resolve_hash(const struct dr_resolve_key *restrict const key) {
+  uint32_t hash = UINT32_C(2166136261) ^ (key->passive ? 1 : 0);
+  hash = dr_resolve_hash_str(hash, key->hostname);
+  return dr_resolve_hash_str(hash, key->port);
+}
+
+WARN_UNUSED_RESULT static bool dr_resolve_str_eq(const char *restrict const a, const char *restrict const b) {
+  return a == NULL || b == NULL ? a == b : strcmp(a, b) == 0;
+}
+
+static bool dr_resolve_eq(const struct hash_node *restrict const node, const void *restrict const arg) {
+  const struct dr_resolved *restrict const entry = container_of_const(node, const struct dr_resolved, hash);
+  const struct dr_resolve_key *restrict const key = (const struct dr_resolve_key *)arg;
+  return entry->passive == key->passive && dr_resolve_str_eq(entry->hostname, key->hostname) && dr_resolve_str_eq(entry->port, key->port);
+}
+
+const struct addrinfo *dr_resolved_addrs(const struct dr_resolved *restrict const resolved) {
+  return resolved->res;
+}
+
+void dr_resolve_release(struct dr_resolved *restrict const resolved) {
+  if (--resolved->refs > 0) {
+    return;
+  }
+  if (resolved->res != NULL) {
+    freeaddrinfo(resolved->res);
+  }
+  dr_wait_destroy(&resolved->wait);
+  free(resolved);
+}
+
+static void dr_resolve_uncache(struct dr_resolved *restrict const entry) {
+  hash_remove(&dr_resolve_cache, &entry->hash);
+  if (entry->entries.next != NULL) {
+    list_del(&entry->entries);
+  }
+  entry->cached = false;
+  dr_resolve_release(entry);
+}
+
+void dr_resolve_flush(void) {
+  while (!list_empty(&dr_resolve_entries)) {
+    dr_resolve_uncache(list_first_entry(&dr_resolve_entries, struct dr_resolved, entries));
+  }
+}
+
+static void dr_resolve_expire(const int64_t now) {
+  while (!list_empty(&dr_resolve_entries)) {
+    struct dr_resolved *restrict const entry = list_first_entry(&dr_resolve_entries, struct dr_resolved, entries);
+    if (entry->expires > now) {
+      break;
+    }
+    dr_resolve_uncache(entry);
+  }
+}
+
+// Scans from the newest entry, which usually expires no later than this one
+static void dr_resolve_queue(struct dr_resolved *restrict const entry) {
+  struct dr_resolved *restrict pos;
+  list_for_each_entry_reverse(pos, &dr_resolve_entries, struct dr_resolved, entries) {
+    if (pos->expires <= entry->expires) {
+      list_add(&entry->entries, &pos->entries);
+      return;
+    }
+  }
+  list_add(&entry->entries, &dr_resolve_entries);
+}
+
+WARN_UNUSED_RESULT static struct dr_resolved *dr_resolved_new(const struct dr_resolve_key *restrict const key) {
+  const size_t hostname_size = key->hostname == NULL ? 0 : strlen(key->hostname) + 1;
+  const size_t port_size = key->port == NULL ? 0 : strlen(key->port) + 1;
+  struct dr_resolved *restrict const entry = (struct dr_resolved *)malloc(sizeof(*entry) + hostname_size + port_size);
+  if (dr_unlikely(entry == NULL)) {
+    return NULL;
+  }
+  *entry = (struct dr_resolved) {
+    .res = NULL,
+    .hostname = NULL,
+    .port = NULL,
+    .refs = 1,
+    .errnum = 0,
+    .passive = key->passive,
+    .resolving = true,
+    .cached = false,
+  };
+  dr_wait_init(&entry->wait);
+  if (key->hostname != NULL) {
+    memcpy(entry->strs, key->hostname, hostname_size);
+    entry->hostname = entry->strs;
+  }
+  if (key->port != NULL) {
+    memcpy(entry->strs + hostname_size, key->port, port_size);
+    entry->port = entry->strs + hostname_size;
+  }
+  return entry;
+}
+
+static void dr_resolve_lookup(struct dr_resolved *restrict const entry) {
+  const struct addrinfo hints = {
+    .ai_family = AF_UNSPEC,
+    .ai_socktype = SOCK_STREAM,
+    .ai_protocol = 0,
+    .ai_flags = entry->passive ? AI_PASSIVE : 0,
+  };
+  struct addrinfo *res;
+  entry->errnum = getaddrinfo(entry->hostname, entry->port, &hints, &res);
+  entry->res = entry->errnum == 0 ? res : NULL;
+}
+
+static void dr_resolve_call_lookup(struct dr_pool_job *restrict const job) {
+  struct dr_resolve_call *restrict const call = container_of(job, struct dr_resolve_call, job);
+  dr_resolve_lookup(call->entry);
+}
+
+struct dr_result_resolved dr_resolve(const char *restrict const hostname, const char *restrict const port, const bool passive) {
+  dr_resolve_expire(dr_monotonic_ns());
+  const struct dr_resolve_key key = {
+    .hostname = hostname,
+    .port = port,
+    .passive = passive,
+  };
+  const uint32_t hash = dr_resolve_hash(&key);
+  struct dr_resolved *restrict entry;
+  struct hash_node *restrict const node = hash_find(&dr_resolve_cache, hash, dr_resolve_eq, &key);
+  if (node != NULL) {
+    entry = hash_entry(node, struct dr_resolved, hash);
+    ++entry->refs;
+    while (entry->resolving) {
+      dr_wait_wait(&entry->wait);
+    }
+  } else {
+    entry = dr_resolved_new(&key);
+    if (dr_unlikely(entry == NULL)) {
+      return DR_RESULT_ERRNUM(resolved, DR_ERR_ISO_C, ENOMEM);
+    }
+    // Uncached lookups still work, they are just not shared
+    if (dr_resolve_ttl > 0 && hash_insert(&dr_resolve_cache, &entry->hash, hash)) {
+      entry->cached = true;
+      ++entry->refs;
+    }
+    if (dr_resolve_pool == NULL) {
+      dr_resolve_lookup(entry);
+    } else {
+      struct dr_resolve_call call = {
+	.job.func = dr_resolve_call_lookup,
+	.entry = entry,
+      };
+      dr_pool_run(dr_resolve_pool, &call.job);
+    }
+    entry->resolving = false;
+    if (entry->cached) {
+      if (entry->errnum == 0) {
+	entry->expires = dr_monotonic_ns() + dr_resolve_ttl;
+	dr_resolve_queue(entry);
+      } else {
+	// Failures are not cached, the next caller tries again
+	dr_resolve_uncache(entry);
+      }
+    }
+    dr_wait_notify_all(&entry->wait);
+  }
+  if (dr_unlikely(entry->errnum != 0)) {
+    const int errnum = entry->errnum;
+    dr_resolve_release(entry);
+    return DR_RESULT_ERRNUM(resolved, DR_ERR_GAI, errnum);
+  }
+  return DR_RESULT_OK(resolved, entry);
+}
@@ -0,0 +1,139 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// Copyright (c) 2018 Drew Richardson <drewrichardson@gmail.com>
+
+#include "dr.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(HAS_MEMFD_CREATE)
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Maps one memfd of capacity bytes twice into a reserved range of twice the size
+WARN_UNUSED_RESULT static struct dr_result_voidp dr_ring_map_mirror(const uint32_t capacity) {
+  if (capacity % (uint32_t)sysconf(_SC_PAGESIZE) != 0) {
+    return DR_RESULT_ERRNUM(voidp, DR_ERR_ISO_C, EINVAL);
+  }
+  const int fd = memfd_create("dr_ring", MFD_CLOEXEC);
+  if (dr_unlikely(fd < 0)) {
+    return DR_RESULT_ERRNO(voidp);
+  }
+  if (dr_unlikely(ftruncate(fd, capacity) != 0)) {
+    const int errnum = errno;
+    close(fd);
+    return DR_RESULT_ERRNUM(voidp, DR_ERR_ISO_C, errnum);
+  }
+  uint8_t *restrict const map = (uint8_t *)mmap(NULL, 2*(size_t)capacity, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (dr_unlikely(map == MAP_FAILED)) {
+    const int errnum = errno;
+    close(fd);
+    return DR_RESULT_ERRNUM(voidp, DR_ERR_ISO_C, errnum);
+  }
+  if (dr_unlikely(mmap(map, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+		  mmap(map + capacity, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)) {
+    const int errnum = errno;
+    munmap(map, 2*(size_t)capacity);
+    close(fd);
+    return DR_RESULT_ERRNUM(voidp, DR_ERR_ISO_C, errnum);
+  }
+  // The mappings keep the memory alive
+  close(fd);
+  return DR_RESULT_OK(voidp, map);
+}
+
+static void dr_ring_unmap_mirror(void *restrict const map, const uint32_t capacity) {
+  munmap(map, 2*(size_t)capacity);
+}
+
+#else
+
+WARN_UNUSED_RESULT static struct dr_result_voidp dr_ring_map_mirror(const uint32_t capacity) {
+  (void)capacity;
+  return DR_RESULT_ERRNUM(voidp, DR_ERR_ISO_C, ENOSYS);
+}
+
+static void dr_ring_unmap_mirror(void *restrict const map, const uint32_t capacity) {
+  (void)map;
+  (void)capacity;
+}
+
+#endif
+
+static bool dr_ring_capacity_valid(const uint32_t capacity) {
+  return capacity > 0 && (capacity & (capacity - 1)) == 0;
+}
+
+struct dr_result_void dr_ring_init(struct dr_ring *restrict const ring, const uint32_t capacity) {
+  if (!dr_ring_capacity_valid(capacity)) {
+    return DR_RESULT_ERRNUM_VOID(DR_ERR_ISO_C, EINVAL);
+  }
+  uint8_t *restrict const buf = (uint8_t *)malloc(capacity);
+  if (dr_unlikely(buf == NULL)) {
+    return DR_RESULT_ERRNO_VOID();
+  }
+  *ring = (struct dr_ring) {
+    .buf = buf,
+    .mask = capacity - 1,
+    .mirror = false,
+  };
+  return DR_RESULT_OK_VOID();
+}
+
+struct dr_result_void dr_ring_init_mirror(struct dr_ring *restrict const ring, const uint32_t capacity) {
+  if (!dr_ring_capacity_valid(capacity)) {
+    return DR_RESULT_ERRNUM_VOID(DR_ERR_ISO_C, EINVAL);
+  }
+  uint8_t *restrict buf;
+  {
+    const struct dr_result_voidp r = dr_ring_map_mirror(capacity);
+    DR_IF_RESULT_ERR(r, err) {
+      return DR_RESULT_ERROR_VOID(err);
+    } DR_ELIF_RESULT_OK(void *restrict, r, value) {
+      buf = (uint8_t *)value;
+    } DR_FI_RESULT;
+  }
+  *ring = (struct dr_ring) {
+    .buf = buf,
+    .mask = capacity - 1,
+    .mirror = true,
+  };
+  return DR_RESULT_OK_VOID();
+}
+
+void dr_ring_destroy(struct dr_ring *restrict const ring) {
+  if (ring->mirror) {
+    dr_ring_unmap_mirror(ring->buf, ring->mask + 1);
+  } else {
+    free(ring->buf);
+  }
+  ring->buf = NULL;
+}
+
+uint32_t dr_ring_put(struct dr_ring *restrict const ring, const void *restrict const buf, const uint32_t count) {
+  const uint32_t writable = dr_ring_writable(ring);
+  struct dr_iovec iov[2];
+  const unsigned int n = dr_ring_iov(ring, ring->tail, count < writable ? count : writable, iov);
+  memcpy(iov[0].base, buf, iov[0].len);
+  if (n > 1) {
+    memcpy(iov[1].base, (const uint8_t *)buf + iov[0].len, iov[1].len);
+  }
+  const uint32_t len = (uint32_t)(iov[0].len + iov[1].len);
+  dr_ring_produce(ring, len);
+  return len;
+}
+
+uint32_t dr_ring_get(struct dr_ring *restrict const ring, void *restrict const buf, const uint32_t count) {
+  const uint32_t readable = dr_ring_readable(ring);
+  struct dr_iovec iov[2];
+  const unsigned int n = dr_ring_iov(ring, ring->head, count < readable ? count : readable, iov);
+  memcpy(buf, iov[0].base, iov[0].len);
+  if (n > 1) {
+    memcpy((uint8_t *)buf + iov[0].len, iov[1].base, iov[1].len);
+  }
+  const uint32_t len = (uint32_t)(iov[0].len + iov[1].len);
+  dr_ring_consume(ring, len);
+  return len;
+}
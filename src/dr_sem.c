@@ -8,6 +8,7 @@
 struct dr_waiter {
   struct list_head waiters;
   struct dr_task *restrict task;
+  bool notified;
 };
 
 void dr_wait_init(struct dr_wait *restrict const wait) {
@@ -25,15 +26,45 @@ void dr_wait_notify(struct dr_wait *restrict const wait) {
   if (!list_empty(&wait->waiters)) {
     struct dr_waiter *restrict const waiter = list_first_entry(&wait->waiters, struct dr_waiter, waiters);
     list_del(&waiter->waiters);
+    waiter->notified = true;
     dr_task_runnable(waiter->task);
   }
 }
 
-void dr_wait_wait(struct dr_wait *restrict const wait) {
-  struct dr_waiter waiter;
+void dr_wait_notify_all(struct dr_wait *restrict const wait) {
+  while (!list_empty(&wait->waiters)) {
+    dr_wait_notify(wait);
+  }
+}
+
+bool dr_wait_wait_until(struct dr_wait *restrict const wait, const int64_t deadline) {
+  struct dr_waiter waiter = {
+    .task = dr_task_self(),
+    .notified = false,
+  };
   list_add_tail(&waiter.waiters, &wait->waiters);
-  waiter.task = dr_task_self();
-  dr_schedule(true);
+  struct dr_timer timer = {
+    .pending = false,
+  };
+  if (deadline != DR_NEVER) {
+    dr_timer_start(&timer, deadline);
+  }
+  // The task may also be made runnable by events meant for it, so only stop once notified or timed out
+  do {
+    dr_schedule(true);
+  } while (!waiter.notified && (timer.pending || deadline == DR_NEVER));
+  if (waiter.notified) {
+    dr_timer_cancel(&timer);
+    return true;
+  }
+  list_del(&waiter.waiters);
+  return false;
+}
+
+void dr_wait_wait(struct dr_wait *restrict const wait) {
+  // Events for the task can also make it runnable, and returning then would leave the waiter queued
+  const bool notified = dr_wait_wait_until(wait, DR_NEVER);
+  dr_assert(notified);
 }
 
 static const unsigned int dr_sem_value_max = 0x7fffffff;
@@ -62,6 +93,18 @@ struct dr_result_void dr_sem_post(struct dr_sem *restrict const sem) {
   return DR_RESULT_OK_VOID();
 }
 
+// Wakes at most count waiters rather than posting count times
+struct dr_result_void dr_sem_post_count(struct dr_sem *restrict const sem, const unsigned int count) {
+  if (count > dr_sem_value_max - sem->value) {
+    return DR_RESULT_ERRNUM_VOID(DR_ERR_ISO_C, EOVERFLOW);
+  }
+  sem->value += count;
+  for (unsigned int i = 0; i < count && !list_empty(&sem->wait.waiters); ++i) {
+    dr_wait_notify(&sem->wait);
+  }
+  return DR_RESULT_OK_VOID();
+}
+
 struct dr_result_void dr_sem_wait(struct dr_sem *restrict const sem) {
   while (sem->value <= 0) {
     dr_wait_wait(&sem->wait);
@@ -69,3 +112,53 @@ struct dr_result_void dr_sem_wait(struct dr_sem *restrict const sem) {
   --sem->value;
   return DR_RESULT_OK_VOID();
 }
+
+struct dr_result_void dr_sem_timedwait(struct dr_sem *restrict const sem, const int64_t deadline) {
+  while (sem->value <= 0) {
+    if (!dr_wait_wait_until(&sem->wait, deadline)) {
+      return DR_RESULT_ERRNUM_VOID(DR_ERR_ISO_C, ETIMEDOUT);
+    }
+  }
+  --sem->value;
+  return DR_RESULT_OK_VOID();
+}
+
+void dr_cond_init(struct dr_cond *restrict const cond) {
+  dr_wait_init(&cond->wait);
+}
+
+void dr_cond_destroy(struct dr_cond *restrict const cond) {
+  dr_wait_destroy(&cond->wait);
+}
+
+void dr_cond_signal(struct dr_cond *restrict const cond) {
+  dr_wait_notify(&cond->wait);
+}
+
+void dr_cond_broadcast(struct dr_cond *restrict const cond) {
+  dr_wait_notify_all(&cond->wait);
+}
+
+struct dr_result_void dr_cond_wait(struct dr_cond *restrict const cond, struct dr_sem *restrict const lock) {
+  return dr_cond_timedwait(cond, lock, DR_NEVER);
+}
+
+struct dr_result_void dr_cond_timedwait(struct dr_cond *restrict const cond, struct dr_sem *restrict const lock, const int64_t deadline) {
+  {
+    const struct dr_result_void r = dr_sem_post(lock);
+    DR_IF_RESULT_ERR(r, err) {
+      return DR_RESULT_ERROR_VOID(err);
+    } DR_FI_RESULT;
+  }
+  const bool notified = dr_wait_wait_until(&cond->wait, deadline);
+  {
+    const struct dr_result_void r = dr_sem_wait(lock);
+    DR_IF_RESULT_ERR(r, err) {
+      return DR_RESULT_ERROR_VOID(err);
+    } DR_FI_RESULT;
+  }
+  if (!notified) {
+    return DR_RESULT_ERRNUM_VOID(DR_ERR_ISO_C, ETIMEDOUT);
+  }
+  return DR_RESULT_OK_VOID();
+}
@@ -199,26 +199,22 @@ struct dr_result_void dr_listen(dr_handle_t sockfd, int backlog) {
 }
 
 struct dr_result_handle dr_sock_connect(const char *restrict const hostname, const char *restrict const port, unsigned int flags) {
-  struct addrinfo hints = {
-    .ai_family = AF_UNSPEC,
-    .ai_socktype = SOCK_STREAM,
-    .ai_protocol = 0,
-    .ai_flags = 0,
-  };
-  struct addrinfo *res;
+  struct dr_resolved *restrict resolved;
   {
-    const int errnum = getaddrinfo(hostname, port, &hints, &res);
-    if (dr_unlikely(errnum != 0)) {
-      return DR_RESULT_ERRNUM(handle, DR_ERR_GAI, errnum);
-    }
+    const struct dr_result_resolved r = dr_resolve(hostname, port, false);
+    DR_IF_RESULT_ERR(r, err) {
+      return DR_RESULT_ERROR(handle, err);
+    } DR_ELIF_RESULT_OK(struct dr_resolved *restrict, r, value) {
+      resolved = value;
+    } DR_FI_RESULT;
   }
 
   dr_handle_t fd;
   struct dr_error last_error = {
     .line = 0,
   };
-  struct addrinfo *restrict ai;
-  for (ai = res; ai != NULL; ai = ai->ai_next) {
+  const struct addrinfo *restrict ai;
+  for (ai = dr_resolved_addrs(resolved); ai != NULL; ai = ai->ai_next) {
     {
       const struct dr_result_handle r = dr_socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol, flags);
       DR_IF_RESULT_ERR(r, err) {
@@ -239,7 +235,7 @@ struct dr_result_handle dr_sock_connect(const char *restrict const hostname, con
     dr_close(fd);
   }
 
-  freeaddrinfo(res);
+  dr_resolve_release(resolved);
   if (dr_unlikely(ai == NULL)) {
     return DR_RESULT_ERROR(handle, &last_error);
   }
@@ -247,26 +243,22 @@ struct dr_result_handle dr_sock_connect(const char *restrict const hostname, con
 }
 
 struct dr_result_handle dr_sock_bind(const char *restrict const hostname, const char *restrict const port, unsigned int flags) {
-  const struct addrinfo hints = {
-    .ai_family = AF_UNSPEC,
-    .ai_socktype = SOCK_STREAM,
-    .ai_protocol = 0,
-    .ai_flags = AI_PASSIVE,
-  };
-  struct addrinfo *res;
+  struct dr_resolved *restrict resolved;
   {
-    const int errnum = getaddrinfo(hostname, port, &hints, &res);
-    if (dr_unlikely(errnum != 0)) {
-      return DR_RESULT_ERRNUM(handle, DR_ERR_GAI, errnum);
-    }
+    const struct dr_result_resolved r = dr_resolve(hostname, port, true);
+    DR_IF_RESULT_ERR(r, err) {
+      return DR_RESULT_ERROR(handle, err);
+    } DR_ELIF_RESULT_OK(struct dr_resolved *restrict, r, value) {
+      resolved = value;
+    } DR_FI_RESULT;
   }
 
   dr_handle_t fd;
   struct dr_error last_error = {
     .line = 0,
   };
-  struct addrinfo *restrict ai;
-  for (ai = res; ai != NULL; ai = ai->ai_next) {
+  const struct addrinfo *restrict ai;
+  for (ai = dr_resolved_addrs(resolved); ai != NULL; ai = ai->ai_next) {
     {
       const struct dr_result_handle r = dr_socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol, flags);
       DR_IF_RESULT_ERR(r, err) {
@@ -287,7 +279,7 @@ struct dr_result_handle dr_sock_bind(const char *restrict const hostname, const
     dr_close(fd);
   }
 
-  freeaddrinfo(res);
+  dr_resolve_release(resolved);
   if (dr_unlikely(ai == NULL)) {
     return DR_RESULT_ERROR(handle, &last_error);
   }
@@ -147,6 +147,8 @@ struct dr_task_start_args {
 static struct dr_task dr_task_parent;
 static struct list_head dr_runnable;
 static struct list_head dr_sleeping;
+// Pending timers ordered by deadline, the root caches the earliest
+static struct rb_root dr_timers = RB_ROOT_INIT;
 
 extern void dr_task_switch(struct dr_task *restrict const cur, struct dr_task *restrict const next);
 NORETURN
@@ -315,6 +317,19 @@ void dr_task_runnable(struct dr_task *restrict const task) {
   }
 }
 
+// Tasks waiting to run, not counting the caller
+unsigned int dr_task_runnable_count(void) {
+  if (dr_unlikely(dr_runnable.next == NULL)) {
+    return 0;
+  }
+  unsigned int count = 0;
+  const struct list_head *restrict pos;
+  list_for_each(pos, &dr_runnable) {
+    ++count;
+  }
+  return count > 0 ? count - 1 : 0;
+}
+
 void dr_schedule(const bool sleep) {
   struct dr_task *restrict const prev = dr_task_self();
   list_move_tail(&prev->tasks, sleep ? &dr_sleeping : &dr_runnable);
@@ -325,3 +340,58 @@ void dr_schedule(const bool sleep) {
   struct dr_task *restrict const next = dr_get_next_runnable();
   dr_task_switch(prev, next);
 }
+
+static bool dr_timer_less(const struct rb_node *restrict const a, const struct rb_node *restrict const b) {
+  const struct dr_timer *restrict const ta = container_of_const(a, const struct dr_timer, node);
+  const struct dr_timer *restrict const tb = container_of_const(b, const struct dr_timer, node);
+  return ta->deadline < tb->deadline;
+}
+
+void dr_timer_start(struct dr_timer *restrict const timer, const int64_t deadline) {
+  dr_timer_cancel(timer);
+  timer->task = dr_task_self();
+  timer->deadline = deadline;
+  timer->pending = true;
+  rb_insert(&dr_timers, &timer->node, dr_timer_less);
+}
+
+void dr_timer_cancel(struct dr_timer *restrict const timer) {
+  if (timer->pending) {
+    rb_erase(&dr_timers, &timer->node);
+    timer->pending = false;
+  }
+}
+
+int64_t dr_timer_timeout_ns(void) {
+  const struct rb_node *restrict const node = rb_first(&dr_timers);
+  if (node == NULL) {
+    return -1;
+  }
+  const struct dr_timer *restrict const first = container_of_const(node, const struct dr_timer, node);
+  const int64_t timeout = first->deadline - dr_monotonic_ns();
+  return timeout > 0 ? timeout : 0;
+}
+
+void dr_timer_run(void) {
+  const int64_t now = dr_now_ns();
+  struct rb_node *restrict node;
+  while ((node = rb_first(&dr_timers)) != NULL) {
+    struct dr_timer *restrict const timer = rb_entry(node, struct dr_timer, node);
+    if (timer->deadline > now) {
+      break;
+    }
+    rb_erase(&dr_timers, node);
+    timer->pending = false;
+    dr_task_runnable(timer->task);
+  }
+}
+
+void dr_sleep_until(const int64_t deadline) {
+  struct dr_timer timer = {
+    .pending = false,
+  };
+  dr_timer_start(&timer, deadline);
+  while (timer.pending) {
+    dr_schedule(true);
+  }
+}
@@ -0,0 +1,386 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// Copyright (c) 2018 Drew Richardson <drewrichardson@gmail.com>
+
+#include "dr.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "list.h"
+
+static struct dr_file_vtbl dr_tmpfs_file_vtbl;
+static struct dr_file_vtbl dr_tmpfs_dir_vtbl;
+
+WARN_UNUSED_RESULT static uint32_t dr_tmpfs_hash(const struct dr_str *restrict const name) {
+  // FNV-1a
+  uint32_t hash = 2166136261U;
+  for (uint_fast32_t i = 0; i < name->len; ++i) {
+    hash = (hash ^ (uint8_t)name->buf[i])*16777619U;
+  }
+  return hash;
+}
+
+WARN_UNUSED_RESULT static uint64_t dr_tmpfs_now(void) {
+  const struct dr_result_int64 r = dr_system_time_ns();
+  DR_IF_RESULT_OK(int64_t, r, value) {
+    return value;
+  } DR_FI_RESULT;
+  return 0;
+}
+
+WARN_UNUSED_RESULT static bool dr_tmpfs_charge(struct dr_tmpfs *restrict const fs, const uint64_t bytes) {
+  if (dr_unlikely(bytes > fs->cap - fs->used)) {
+    return false;
+  }
+  fs->used += bytes;
+  return true;
+}
+
+static void dr_tmpfs_modified(struct dr_tmpfs_node *restrict const node) {
+  ++node->file.vers;
+  node->file.mtime = dr_tmpfs_now();
+}
+
+WARN_UNUSED_RESULT static bool dr_tmpfs_is_dir(const struct dr_tmpfs_node *restrict const node) {
+  return (node->file.mode & DR_DIR) != 0;
+}
+
+static void dr_tmpfs_truncate_pages(struct dr_tmpfs_node *restrict const node, const uint64_t length) {
+  const uint64_t keep = (length + DR_TMPFS_PAGE_SIZE - 1)/DR_TMPFS_PAGE_SIZE;
+  for (uint_fast32_t i = keep; i < node->u.f.page_count; ++i) {
+    if (node->u.f.pages[i] != NULL) {
+      free(node->u.f.pages[i]);
+      node->fs->used -= DR_TMPFS_PAGE_SIZE;
+    }
+  }
+  if (keep < node->u.f.page_count) {
+    node->u.f.page_count = keep;
+  }
+  // Later extensions must read back as zeros
+  const uint32_t tail = length % DR_TMPFS_PAGE_SIZE;
+  if (tail != 0 && keep <= node->u.f.page_count && node->u.f.pages[keep - 1] != NULL) {
+    memset(node->u.f.pages[keep - 1] + tail, 0, DR_TMPFS_PAGE_SIZE - tail);
+  }
+}
+
+static void dr_tmpfs_free(struct dr_tmpfs_node *restrict const node) {
+  struct dr_tmpfs *restrict const fs = node->fs;
+  if (dr_tmpfs_is_dir(node)) {
+    free(node->u.d.entries);
+    free(node->u.d.hashes);
+  } else {
+    dr_tmpfs_truncate_pages(node, 0);
+    free(node->u.f.pages);
+    fs->used -= (uint64_t)node->u.f.page_cap*sizeof(*node->u.f.pages);
+  }
+  free(node->file.stat);
+  --fs->nodes;
+  if (node != &fs->root) {
+    fs->used -= sizeof(*node) + node->file.name.len;
+    free(node);
+  }
+}
+
+static void dr_tmpfs_release(struct dr_file *restrict const file) {
+  struct dr_tmpfs_node *restrict const node = container_of(file, struct dr_tmpfs_node, file);
+  struct dr_file *restrict const parent = node->parent;
+  dr_tmpfs_free(node);
+  dr_vfs_unref(parent);
+}
+
+WARN_UNUSED_RESULT static struct dr_result_uint32 dr_tmpfs_read(const struct dr_fd *restrict const fd, const uint64_t offset, const uint32_t count, void *restrict const b) {
+  uint8_t *restrict const buf = (uint8_t *)b;
+  const struct dr_tmpfs_node *restrict const node = container_of_const(fd->file, const struct dr_tmpfs_node, file);
+  const uint64_t length = node->file.length;
+  if (offset >= length) {
+    return DR_RESULT_OK(uint32, 0);
+  }
+  const uint32_t bytes = length - offset < count ? length - offset : count;
+  for (uint32_t pos = 0; pos < bytes;) {
+    const uint64_t page = (offset + pos)/DR_TMPFS_PAGE_SIZE;
+    const uint32_t in = (offset + pos) % DR_TMPFS_PAGE_SIZE;
+    const uint32_t chunk = DR_TMPFS_PAGE_SIZE - in < bytes - pos ? DR_TMPFS_PAGE_SIZE - in : bytes - pos;
+    if (page < node->u.f.page_count && node->u.f.pages[page] != NULL) {
+      memcpy(buf + pos, node->u.f.pages[page] + in, chunk);
+    } else {
+      memset(buf + pos, 0, chunk);
+    }
+    pos += chunk;
+  }
+  return DR_RESULT_OK(uint32, bytes);
+}
+
+// The page array is charged to the cap like the pages, so a write far past the end cannot allocate a huge array of holes
+WARN_UNUSED_RESULT static int dr_tmpfs_reserve_pages(struct dr_tmpfs_node *restrict const node, const uint64_t page_count) {
+  if (page_count <= node->u.f.page_cap) {
+    return 0;
+  }
+  if (dr_unlikely(page_count > UINT32_MAX/2)) {
+    return EFBIG;
+  }
+  struct dr_tmpfs *restrict const fs = node->fs;
+  // Doubling keeps appends amortized O(1)
+  uint32_t cap = node->u.f.page_cap == 0 ? 4 : node->u.f.page_cap;
+  while (cap < page_count) {
+    cap *= 2;
+  }
+  if (!dr_tmpfs_charge(fs, (uint64_t)(cap - node->u.f.page_cap)*sizeof(*node->u.f.pages))) {
+    // Near the cap only take what is needed
+    cap = page_count;
+    if (dr_unlikely(!dr_tmpfs_charge(fs, (uint64_t)(cap - node->u.f.page_cap)*sizeof(*node->u.f.pages)))) {
+      return ENOSPC;
+    }
+  }
+  uint8_t **const pages = (uint8_t **)realloc(node->u.f.pages, cap*sizeof(*pages));
+  if (dr_unlikely(pages == NULL)) {
+    fs->used -= (uint64_t)(cap - node->u.f.page_cap)*sizeof(*pages);
+    return ENOMEM;
+  }
+  node->u.f.pages = pages;
+  node->u.f.page_cap = cap;
+  return 0;
+}
+
+WARN_UNUSED_RESULT static struct dr_result_uint32 dr_tmpfs_write(const struct dr_fd *restrict const fd, const uint64_t off, const uint32_t count, const void *restrict const b) {
+  const uint8_t *restrict const buf = (const uint8_t *)b;
+  struct dr_tmpfs_node *restrict const node = container_of(fd->file, struct dr_tmpfs_node, file);
+  struct dr_tmpfs *restrict const fs = node->fs;
+  const uint64_t offset = (node->file.mode & DR_APPEND) != 0 ? node->file.length : off;
+  if (dr_unlikely(offset + count < offset)) {
+    return DR_RESULT_ERRNUM(uint32, DR_ERR_ISO_C, EFBIG);
+  }
+  {
+    const int errnum = dr_tmpfs_reserve_pages(node, (offset + count + DR_TMPFS_PAGE_SIZE - 1)/DR_TMPFS_PAGE_SIZE);
+    if (dr_unlikely(errnum != 0)) {
+      return DR_RESULT_ERRNUM(uint32, DR_ERR_ISO_C, errnum);
+    }
+  }
+  uint32_t pos = 0;
+  while (pos < count) {
+    const uint64_t page = (offset + pos)/DR_TMPFS_PAGE_SIZE;
+    const uint32_t in = (offset + pos) % DR_TMPFS_PAGE_SIZE;
+    const uint32_t chunk = DR_TMPFS_PAGE_SIZE - in < count - pos ? DR_TMPFS_PAGE_SIZE - in : count - pos;
+    while (node->u.f.page_count <= page) {
+      node->u.f.pages[node->u.f.page_count++] = NULL;
+    }
+    uint8_t *restrict p = node->u.f.pages[page];
+    if (p == NULL) {
+      if (dr_unlikely(!dr_tmpfs_charge(fs, DR_TMPFS_PAGE_SIZE))) {
+	break;
+      }
+      p = (uint8_t *)malloc(DR_TMPFS_PAGE_SIZE);
+      if (dr_unlikely(p == NULL)) {
+	fs->used -= DR_TMPFS_PAGE_SIZE;
+	break;
+      }
+      memset(p, 0, in);
+      memset(p + in + chunk, 0, DR_TMPFS_PAGE_SIZE - in - chunk);
+      node->u.f.pages[page] = p;
+    }
+    memcpy(p + in, buf + pos, chunk);
+    pos += chunk;
+  }
+  if (dr_unlikely(pos == 0 && count != 0)) {
+    return DR_RESULT_ERRNUM(uint32, DR_ERR_ISO_C, ENOSPC);
+  }
+  if (offset + pos > node->file.length) {
+    node->file.length = offset + pos;
+  }
+  dr_tmpfs_modified(node);
+  return DR_RESULT_OK(uint32, pos);
+}
+
+WARN_UNUSED_RESULT static struct dr_result_void dr_tmpfs_truncate(struct dr_file *restrict const file, const uint64_t length) {
+  struct dr_tmpfs_node *restrict const node = container_of(file, struct dr_tmpfs_node, file);
+  if (length < node->file.length) {
+    dr_tmpfs_truncate_pages(node, length);
+  }
+  node->file.length = length;
+  dr_tmpfs_modified(node);
+  return DR_RESULT_OK_VOID();
+}
+
+WARN_UNUSED_RESULT static struct dr_result_uint32 dr_tmpfs_dir_read(const struct dr_fd *restrict const fd, const uint64_t offset, const uint32_t count, void *restrict const buf) {
+  const struct dr_tmpfs_node *restrict const node = container_of_const(fd->file, const struct dr_tmpfs_node, file);
+  return DR_RESULT_OK(uint32, dr_dir_read_entries((uint8_t *)buf, count, offset, node->u.d.entries, node->u.d.entry_count));
+}
+
+WARN_UNUSED_RESULT static struct dr_result_uint32 dr_tmpfs_dir_readdir(const struct dr_fd *restrict const fd, const uint64_t offset, const uint32_t count, void *restrict const buf) {
+  const struct dr_tmpfs_node *restrict const node = container_of_const(fd->file, const struct dr_tmpfs_node, file);
+  return DR_RESULT_OK(uint32, dr_dir_readdir_entries((uint8_t *)buf, count, offset, node->u.d.entries, node->u.d.entry_count));
+}
+
+WARN_UNUSED_RESULT static uint32_t dr_tmpfs_lookup(const struct dr_tmpfs_node *restrict const dir, const struct dr_str *restrict const name) {
+  const uint32_t hash = dr_tmpfs_hash(name);
+  for (uint_fast32_t i = 0; i < dir->u.d.entry_count; ++i) {
+    if (dir->u.d.hashes[i] == hash && dr_str_eq(&dir->u.d.entries[i]->name, name)) {
+      return i;
+    }
+  }
+  return FAIL_UINT32;
+}
+
+WARN_UNUSED_RESULT static struct dr_result_file dr_tmpfs_walk(const struct dr_file *restrict const file, const struct dr_str *restrict const name) {
+  const struct dr_tmpfs_node *restrict const dir = container_of_const(file, const struct dr_tmpfs_node, file);
+  if (name->len == 2 && name->buf[0] == '.' && name->buf[1] == '.') {
+    return DR_RESULT_OK(file, dir->parent);
+  }
+  const uint32_t i = dr_tmpfs_lookup(dir, name);
+  if (i == FAIL_UINT32) {
+    return DR_RESULT_ERRNUM(file, DR_ERR_ISO_C, ENOENT);
+  }
+  return DR_RESULT_OK(file, dir->u.d.entries[i]);
+}
+
+WARN_UNUSED_RESULT static struct dr_result_file dr_tmpfs_create(struct dr_file *restrict const file, struct dr_user *restrict const user, const struct dr_str *restrict const name, const uint32_t perm) {
+  struct dr_tmpfs_node *restrict const dir = container_of(file, struct dr_tmpfs_node, file);
+  struct dr_tmpfs *restrict const fs = dir->fs;
+  if (dr_unlikely(dir->removed)) {
+    return DR_RESULT_ERRNUM(file, DR_ERR_ISO_C, ENOENT);
+  }
+  if (dr_unlikely(dr_tmpfs_lookup(dir, name) != FAIL_UINT32)) {
+    return DR_RESULT_ERRNUM(file, DR_ERR_ISO_C, EEXIST);
+  }
+  if (dir->u.d.entry_count == dir->u.d.entry_cap) {
+    const uint32_t cap = dir->u.d.entry_cap == 0 ? 8 : 2*dir->u.d.entry_cap;
+    struct dr_file **const entries = (struct dr_file **)realloc(dir->u.d.entries, cap*sizeof(*entries));
+    if (dr_unlikely(entries == NULL)) {
+      return DR_RESULT_ERRNO(file);
+    }
+    dir->u.d.entries = entries;
+    uint32_t *const hashes = (uint32_t *)realloc(dir->u.d.hashes, cap*sizeof(*hashes));
+    if (dr_unlikely(hashes == NULL)) {
+      return DR_RESULT_ERRNO(file);
+    }
+    dir->u.d.hashes = hashes;
+    dir->u.d.entry_cap = cap;
+  }
+  if (dr_unlikely(!dr_tmpfs_charge(fs, sizeof(struct dr_tmpfs_node) + name->len))) {
+    return DR_RESULT_ERRNUM(file, DR_ERR_ISO_C, ENOSPC);
+  }
+  struct dr_tmpfs_node *restrict const node = (struct dr_tmpfs_node *)malloc(sizeof(*node) + name->len);
+  if (dr_unlikely(node == NULL)) {
+    fs->used -= sizeof(*node) + name->len;
+    return DR_RESULT_ERRNO(file);
+  }
+  const bool is_dir = (perm & DR_DIR) != 0;
+  const uint32_t mode = is_dir ? perm & (~0777U | (dir->file.mode & 0777)) : perm & (~0666U | (dir->file.mode & 0666));
+  const uint64_t now = dr_tmpfs_now();
+  char *restrict const name_buf = (char *)(node + 1);
+  memcpy(name_buf, name->buf, name->len);
+  *node = (struct dr_tmpfs_node) {
+    .file = {
+      .vers = 0,
+      .mode = mode & (DR_DIR | DR_APPEND | DR_EXCL | DR_TMP | 0777),
+      .atime = now,
+      .mtime = now,
+      .length = 0,
+      .name.len = name->len,
+      .name.buf = name_buf,
+      .uid = user,
+      .gid = dir->file.gid,
+      .muid = user,
+      .vtbl = is_dir ? &dr_tmpfs_dir_vtbl : &dr_tmpfs_file_vtbl,
+      // Held by the directory entry
+      .refs = 1,
+    },
+    .fs = fs,
+    .parent = &dir->file,
+  };
+  dr_vfs_ref(&dir->file);
+  ++fs->nodes;
+  dir->u.d.entries[dir->u.d.entry_count] = &node->file;
+  dir->u.d.hashes[dir->u.d.entry_count] = dr_tmpfs_hash(name);
+  ++dir->u.d.entry_count;
+  dr_tmpfs_modified(dir);
+  return DR_RESULT_OK(file, &node->file);
+}
+
+WARN_UNUSED_RESULT static struct dr_result_void dr_tmpfs_remove(const struct dr_user *restrict const user, struct dr_file *restrict const file) {
+  struct dr_tmpfs_node *restrict const node = container_of(file, struct dr_tmpfs_node, file);
+  if (dr_unlikely(node == &node->fs->root)) {
+    return DR_RESULT_ERRNUM_VOID(DR_ERR_ISO_C, EBUSY);
+  }
+  struct dr_tmpfs_node *restrict const dir = container_of(node->parent, struct dr_tmpfs_node, file);
+  if (dr_unlikely(!dr_vfs_can_write(user, &dir->file))) {
+    return DR_RESULT_ERRNUM_VOID(DR_ERR_ISO_C, EACCES);
+  }
+  if (dr_unlikely(dr_tmpfs_is_dir(node) && node->u.d.entry_count != 0)) {
+    return DR_RESULT_ERRNUM_VOID(DR_ERR_ISO_C, ENOTEMPTY);
+  }
+  const uint32_t i = dr_tmpfs_lookup(dir, &node->file.name);
+  if (dr_unlikely(i == FAIL_UINT32 || dir->u.d.entries[i] != file)) {
+    // Already removed
+    return DR_RESULT_ERRNUM_VOID(DR_ERR_ISO_C, ENOENT);
+  }
+  // Keep the order stable so Treaddir offsets held by other readers stay valid
+  const uint32_t after = dir->u.d.entry_count - i - 1;
+  memmove(dir->u.d.entries + i, dir->u.d.entries + i + 1, after*sizeof(*dir->u.d.entries));
+  memmove(dir->u.d.hashes + i, dir->u.d.hashes + i + 1, after*sizeof(*dir->u.d.hashes));
+  --dir->u.d.entry_count;
+  dr_tmpfs_modified(dir);
+  node->removed = true;
+  dr_vfs_unref(file);
+  return DR_RESULT_OK_VOID();
+}
+
+static struct dr_file_vtbl dr_tmpfs_file_vtbl = {
+  .read = dr_tmpfs_read,
+  .write = dr_tmpfs_write,
+  .remove = dr_tmpfs_remove,
+  .truncate = dr_tmpfs_truncate,
+  .release = dr_tmpfs_release,
+};
+
+static struct dr_file_vtbl dr_tmpfs_dir_vtbl = {
+  .read = dr_tmpfs_dir_read,
+  .readdir = dr_tmpfs_dir_readdir,
+  .walk = dr_tmpfs_walk,
+  .create = dr_tmpfs_create,
+  .remove = dr_tmpfs_remove,
+  .release = dr_tmpfs_release,
+};
+
+void dr_tmpfs_init(struct dr_tmpfs *restrict const fs, const uint64_t cap, struct dr_file *restrict const parent, const struct dr_str *restrict const name, struct dr_user *restrict const user, struct dr_group *restrict const group, const uint32_t mode) {
+  const uint64_t now = dr_tmpfs_now();
+  *fs = (struct dr_tmpfs) {
+    .root = {
+      .file = {
+	.vers = 0,
+	.mode = DR_DIR | (mode & 0777),
+	.atime = now,
+	.mtime = now,
+	.length = 0,
+	.name = *name,
+	.uid = user,
+	.gid = group,
+	.muid = user,
+	.vtbl = &dr_tmpfs_dir_vtbl,
+	// Held by fs
+	.refs = 1,
+      },
+      .fs = fs,
+      .parent = parent,
+    },
+    .used = 0,
+    .cap = cap,
+    .nodes = 1,
+  };
+  dr_vfs_ref(parent);
+}
+
+static void dr_tmpfs_free_tree(struct dr_tmpfs_node *restrict const node) {
+  if (dr_tmpfs_is_dir(node)) {
+    for (uint_fast32_t i = 0; i < node->u.d.entry_count; ++i) {
+      dr_tmpfs_free_tree(container_of(node->u.d.entries[i], struct dr_tmpfs_node, file));
+    }
+  }
+  dr_tmpfs_free(node);
+}
+
+// Frees everything regardless of references, so nothing may refer to fs afterwards
+void dr_tmpfs_destroy(struct dr_tmpfs *restrict const fs) {
+  dr_tmpfs_free_tree(&fs->root);
+  dr_vfs_unref(fs->root.parent);
+}
@@ -0,0 +1,115 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// Copyright (c) 2018 Drew Richardson <drewrichardson@gmail.com>
+
+#include "dr.h"
+
+#include <string.h>
+
+/*
+ * The file is mapped shared so dr_trace_write is only a store into memory and
+ * the kernel writes the pages back. A trace belongs to one thread, threads
+ * that handle requests each open their own file.
+ */
+
+#if defined(_WIN32)
+
+#include <windows.h>
+
+WARN_UNUSED_RESULT static struct dr_result_voidp dr_trace_map(const char *restrict const path, const size_t size) {
+  const HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (dr_unlikely(file == INVALID_HANDLE_VALUE)) {
+    return DR_RESULT_GETLASTERROR(voidp);
+  }
+  const HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)size, NULL);
+  if (dr_unlikely(mapping == NULL)) {
+    const DWORD errnum = GetLastError();
+    CloseHandle(file);
+    return DR_RESULT_ERRNUM(voidp, DR_ERR_WIN, errnum);
+  }
+  void *restrict const map = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size);
+  const DWORD errnum = GetLastError();
+  // The view keeps the mapping and file open
+  CloseHandle(mapping);
+  CloseHandle(file);
+  if (dr_unlikely(map == NULL)) {
+    return DR_RESULT_ERRNUM(voidp, DR_ERR_WIN, errnum);
+  }
+  return DR_RESULT_OK(voidp, map);
+}
+
+static void dr_trace_unmap(void *restrict const map, const size_t size) {
+  (void)size;
+  UnmapViewOfFile(map);
+}
+
+#else
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+WARN_UNUSED_RESULT static struct dr_result_voidp dr_trace_map(const char *restrict const path, const size_t size) {
+  const int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (dr_unlikely(fd < 0)) {
+    return DR_RESULT_ERRNO(voidp);
+  }
+  if (dr_unlikely(ftruncate(fd, size) != 0)) {
+    const int errnum = errno;
+    close(fd);
+    return DR_RESULT_ERRNUM(voidp, DR_ERR_ISO_C, errnum);
+  }
+  void *restrict const map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  const int errnum = errno;
+  close(fd);
+  if (dr_unlikely(map == MAP_FAILED)) {
+    return DR_RESULT_ERRNUM(voidp, DR_ERR_ISO_C, errnum);
+  }
+  return DR_RESULT_OK(voidp, map);
+}
+
+static void dr_trace_unmap(void *restrict const map, const size_t size) {
+  munmap(map, size);
+}
+
+#endif
+
+struct dr_result_void dr_trace_open(struct dr_trace *restrict const trace, const char *restrict const path, const uint32_t capacity) {
+  dr_assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+  const size_t size = sizeof(struct dr_trace_header) + (size_t)capacity*sizeof(struct dr_trace_record);
+  void *restrict map;
+  {
+    const struct dr_result_voidp r = dr_trace_map(path, size);
+    DR_IF_RESULT_ERR(r, err) {
+      return DR_RESULT_ERROR_VOID(err);
+    } DR_ELIF_RESULT_OK(void *restrict, r, value) {
+      map = value;
+    } DR_FI_RESULT;
+  }
+  struct dr_trace_header *restrict const header = (struct dr_trace_header *)map;
+  memcpy(header->magic, DR_TRACE_MAGIC, sizeof(header->magic));
+  header->record_size = sizeof(struct dr_trace_record);
+  header->capacity = capacity;
+  header->head = 0;
+  *trace = (struct dr_trace) {
+    .header = header,
+    .records = (struct dr_trace_record *)(header + 1),
+    .size = size,
+    .mask = capacity - 1,
+  };
+  return DR_RESULT_OK_VOID();
+}
+
+void dr_trace_close(struct dr_trace *restrict const trace) {
+  if (trace->header != NULL) {
+    dr_trace_unmap(trace->header, trace->size);
+    trace->header = NULL;
+    trace->records = NULL;
+  }
+}
+
+void dr_trace_write(struct dr_trace *restrict const trace, const struct dr_trace_record *restrict const record) {
+  struct dr_trace_header *restrict const header = trace->header;
+  trace->records[header->head & trace->mask] = *record;
+  ++header->head;
+}
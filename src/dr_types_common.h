@@ -9,6 +9,7 @@
 #include <stdint.h>
 
 #include "list.h"
+#include "rbtree.h"
 
 #include "dr_version.h"
 #include "dr_compiler.h"
@@ -65,6 +66,22 @@ struct dr_task {
 
 typedef void (*dr_task_start_t)(void *restrict const);
 
+// Wakes task at deadline in dr_monotonic_ns time
+struct dr_timer {
+  struct rb_node node;
+  struct dr_task *restrict task;
+  int64_t deadline;
+  bool pending;
+};
+
+struct dr_pool_job {
+  struct list_head jobs;
+  // Runs on a pool thread
+  void (*func)(struct dr_pool_job *restrict const);
+  struct dr_task *restrict task;
+  bool done;
+};
+
 struct dr_wait {
   struct list_head waiters;
 };
@@ -74,6 +91,36 @@ struct dr_sem {
   unsigned int value;
 };
 
+struct dr_cond {
+  struct dr_wait wait;
+};
+
+// Fixed capacity ring of size byte elements, head and tail run freely and are masked on access
+struct dr_chan {
+  struct dr_wait send_wait;
+  struct dr_wait recv_wait;
+  uint8_t *restrict buf;
+  uint32_t size;
+  uint32_t mask;
+  uint32_t head;
+  uint32_t tail;
+  bool closed;
+};
+
+struct dr_iovec {
+  void *restrict base;
+  size_t len;
+};
+
+// Byte ring whose head and tail run freely and are masked on access. A mirrored ring maps its buffer twice back to back, so every region is contiguous
+struct dr_ring {
+  uint8_t *restrict buf;
+  uint32_t mask;
+  uint32_t head;
+  uint32_t tail;
+  bool mirror;
+};
+
 struct dr_str {
   char *restrict buf;
   uint16_t len;
@@ -102,6 +149,11 @@ struct dr_file {
   struct dr_group *restrict gid;
   struct dr_user *restrict muid;
   struct dr_file_vtbl *restrict vtbl;
+  uint32_t refs;
+  // Encoded stat for directory reads, valid while stat_vers is vers so anything changing the stat must bump vers
+  uint8_t *restrict stat;
+  uint32_t stat_vers;
+  uint32_t stat_size;
 };
 
 struct dr_dir {
@@ -111,14 +163,80 @@ struct dr_dir {
   struct dr_file *restrict entries[];
 };
 
+struct dr_fd_cache {
+  // A read ahead on the pool owns offset, len and buf until it is finished
+  struct dr_pool_job fetch;
+  const struct dr_fd *restrict fd;
+  uint64_t offset;
+  uint32_t len;
+  uint32_t vers;
+  // A failed write behind, reported by the next write or flush
+  struct dr_error error;
+  bool failed;
+  bool dirty;
+  bool prefetch;
+  bool fetching;
+  uint8_t buf[];
+};
+
 struct dr_fd {
   struct dr_file *restrict file;
   int mode;
+  // End of the last read or write, used to detect sequential access
+  uint64_t next;
+  struct dr_fd_cache *restrict cache;
 };
 
 struct dr_file_vtbl {
   struct dr_result_uint32 (*read)(const struct dr_fd *restrict const, const uint64_t, const uint32_t, void *restrict const);
   struct dr_result_uint32 (*write)(const struct dr_fd *restrict const, const uint64_t, const uint32_t, const void *restrict const);
+  struct dr_result_uint32 (*readdir)(const struct dr_fd *restrict const, const uint64_t, const uint32_t, void *restrict const);
+  // Optional, files without them use the fixed dr_dir layout and cannot be created, removed or truncated
+  struct dr_result_file (*walk)(const struct dr_file *restrict const, const struct dr_str *restrict const);
+  struct dr_result_file (*create)(struct dr_file *restrict const, struct dr_user *restrict const, const struct dr_str *restrict const, const uint32_t);
+  struct dr_result_void (*remove)(const struct dr_user *restrict const, struct dr_file *restrict const);
+  struct dr_result_void (*truncate)(struct dr_file *restrict const, const uint64_t);
+  void (*release)(struct dr_file *restrict const);
+  // DR_VFS_READAHEAD, DR_VFS_WRITEBEHIND and DR_VFS_BLOCKING for backends where each read or write is expensive
+  uint32_t flags;
+};
+
+struct dr_tmpfs;
+
+struct dr_tmpfs_node {
+  struct dr_file file;
+  struct dr_tmpfs *restrict fs;
+  struct dr_file *restrict parent;
+  // Set once unlinked, a removed directory must not gain entries that would hold a reference back to it
+  bool removed;
+  union {
+    // Regular files are an array of page sized extents, a NULL extent is a hole
+    struct {
+      uint8_t **pages;
+      uint32_t page_count;
+      uint32_t page_cap;
+    } f;
+    // Directories keep entry pointers and name hashes in parallel arrays so lookups scan the hashes
+    struct {
+      struct dr_file **entries;
+      uint32_t *hashes;
+      uint32_t entry_count;
+      uint32_t entry_cap;
+    } d;
+  } u;
+};
+
+struct dr_tmpfs {
+  struct dr_tmpfs_node root;
+  uint64_t used;
+  uint64_t cap;
+  uint64_t nodes;
+};
+
+// A whole message within a receive buffer
+struct dr_9p_frame {
+  uint32_t pos;
+  uint32_t size;
 };
 
 struct dr_9p_qid {
@@ -141,6 +259,66 @@ struct dr_9p_stat {
   uint16_t type;
 };
 
+struct dr_9p_statfs {
+  uint64_t blocks;
+  uint64_t bfree;
+  uint64_t bavail;
+  uint64_t files;
+  uint64_t ffree;
+  uint64_t fsid;
+  uint32_t type;
+  uint32_t bsize;
+  uint32_t namelen;
+};
+
+struct dr_9p_flock {
+  uint64_t start;
+  uint64_t length;
+  struct dr_str client_id;
+  uint32_t flags;
+  uint32_t proc_id;
+  uint8_t type;
+};
+
+// Log-linear buckets, values below 2^DR_HIST_SUB_BITS are exact and larger values are within 1/2^DR_HIST_SUB_BITS
+#define DR_HIST_SUB_BITS 3
+#define DR_HIST_BUCKETS ((64 - DR_HIST_SUB_BITS + 1) << DR_HIST_SUB_BITS)
+
+struct dr_hist {
+  uint64_t count;
+  uint64_t max;
+  uint64_t buckets[DR_HIST_BUCKETS];
+};
+
+// A trace file is a struct dr_trace_header followed by capacity records in native byte order, record head%capacity is written next
+#define DR_TRACE_MAGIC "dr9ptrc1"
+
+struct dr_trace_header {
+  char magic[8];
+  uint32_t record_size;
+  uint32_t capacity;
+  uint64_t head;
+};
+
+struct dr_trace_record {
+  int64_t start;
+  int64_t end;
+  uint64_t offset;
+  uint32_t conn;
+  uint32_t fid;
+  uint32_t count;
+  uint16_t tag;
+  uint8_t type;
+  uint8_t reserved;
+};
+
+struct dr_trace {
+  struct dr_trace_header *restrict header;
+  struct dr_trace_record *restrict records;
+  size_t size;
+  uint32_t mask;
+};
+
 DR_RESULT_DECL(dr_handle_t, handle);
 DR_RESULT_DECL(size_t, size);
 DR_RESULT_DECL(uint32_t, uint32);
@@ -149,5 +327,7 @@ DR_RESULT_DECL(unsigned int, uint);
 DR_RESULT_DECL(void *restrict, voidp);
 DR_RESULT_DECL(struct dr_file *restrict, file);
 DR_RESULT_DECL(struct dr_fd *restrict, fd);
+struct dr_resolved;
+DR_RESULT_DECL(struct dr_resolved *restrict, resolved);
 
 #endif // DR_TYPES_COMMON_H
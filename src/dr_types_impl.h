@@ -33,6 +33,8 @@ typedef struct kevent dr_event_impl_t;
 
 struct dr_equeue_handle {
   struct list_head changed_clients;
+  // Set while dr_equeue_connect waits on the handle, dr_equeue_dequeue then wakes the task instead of returning the event
+  struct dr_task *restrict task;
   dr_handle_t fd;
   unsigned int actual_events;
   unsigned int events;
@@ -46,6 +48,8 @@ typedef port_event_t dr_event_impl_t;
 
 struct dr_equeue_handle {
   struct list_head changed_clients;
+  // Set while dr_equeue_connect waits on the handle, dr_equeue_dequeue then wakes the task instead of returning the event
+  struct dr_task *restrict task;
   dr_handle_t fd;
   unsigned int events;
 };
@@ -65,6 +69,23 @@ struct dr_equeue_client_impl {
   struct dr_equeue_handle h;
 };
 
+#include <pthread.h>
+
+struct dr_pool_impl {
+  // The read side of the wake handle, first so the event key is the pool
+  struct dr_equeue_client_impl c;
+  struct dr_equeue *restrict e;
+  dr_handle_t wfd;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  struct list_head pending;
+  struct list_head done;
+  pthread_t *restrict threads;
+  unsigned int thread_count;
+  bool stopping;
+  bool woken;
+};
+
 #elif defined(_WIN32)
 
 #include <winsock2.h>
@@ -92,6 +113,41 @@ struct dr_equeue_client_impl {
   bool subscribed;
 };
 
+struct dr_pool_impl {
+  // Completions are posted to the equeue's port with the pool as the key
+  dr_handle_t efd;
+  CRITICAL_SECTION lock;
+  CONDITION_VARIABLE cond;
+  struct list_head pending;
+  struct list_head done;
+  HANDLE *restrict threads;
+  unsigned int thread_count;
+  bool stopping;
+  bool woken;
+};
+
 #endif
 
+#define DR_9P_CLIENT_TAGS 64
+
+struct dr_9p_client_call;
+
+struct dr_9p_client_impl {
+  // First so the event key is the client
+  struct dr_equeue_client_impl c;
+  struct dr_equeue *restrict e;
+  struct dr_task *restrict reader;
+  struct dr_task *restrict writer;
+  // The last slot is used by Tversion, which is sent with NOTAG
+  struct dr_9p_client_call *restrict calls[DR_9P_CLIENT_TAGS + 1];
+  uint16_t free_tags[DR_9P_CLIENT_TAGS];
+  unsigned int free_count;
+  struct dr_sem tags;
+  struct dr_sem write_lock;
+  uint8_t *restrict buf;
+  uint32_t size;
+  uint32_t len;
+  bool failed;
+};
+
 #endif // DR_TYPES_IMPL_H
@@ -5,6 +5,7 @@
 
 #include <errno.h>
 #include <stdlib.h>
+#include <string.h>
 
 WARN_UNUSED_RESULT static bool dr_is_user_member_of_group(const struct dr_user *restrict const user, const struct dr_group *restrict const group) {
   for (uint_fast32_t i = 0; i < user->group_count; ++i) {
@@ -45,11 +46,13 @@ struct dr_result_file dr_vfs_walk(const struct dr_user *restrict const user, con
   if (dr_unlikely(!dr_is_dir(file))) {
     return DR_RESULT_ERRNUM(file, DR_ERR_ISO_C, ENOTDIR);
   }
-  const struct dr_dir *restrict const dir = container_of_const(file, const struct dr_dir, file);
   if (dr_unlikely(!dr_user_has_perm_exec(user, file))) {
     return DR_RESULT_ERRNUM(file, DR_ERR_ISO_C, EACCES);
   }
-  // DR add to vtbl to allow different impls
+  if (file->vtbl->walk != NULL) {
+    return file->vtbl->walk(file, name);
+  }
+  const struct dr_dir *restrict const dir = container_of_const(file, const struct dr_dir, file);
   for (uint_fast32_t i = 0; i < dir->entry_count; ++i) {
     if (dr_str_eq(&dir->entries[i]->name, name)) {
       return DR_RESULT_OK(file, dir->entries[i]);
@@ -61,12 +64,24 @@ struct dr_result_file dr_vfs_walk(const struct dr_user *restrict const user, con
   return DR_RESULT_ERRNUM(file, DR_ERR_ISO_C, ENOENT);
 }
 
+WARN_UNUSED_RESULT static struct dr_result_fd dr_vfs_fd(struct dr_file *restrict const file, const bool reading, const bool writing) {
+  struct dr_fd *restrict const fd = (struct dr_fd *)malloc(sizeof(*fd));
+  if (dr_unlikely(fd == NULL)) {
+    return DR_RESULT_ERRNO(fd);
+  }
+  *fd = (struct dr_fd) {
+    .file = file,
+    .mode = (reading ? DR_AREAD : 0) | (writing ? DR_AWRITE : 0),
+  };
+  return DR_RESULT_OK(fd, fd);
+}
+
 struct dr_result_fd dr_vfs_open(const struct dr_user *restrict const user, struct dr_file *restrict const file, const uint8_t mode) {
   if (dr_unlikely(dr_is_dir(file) && mode != DR_OREAD)) {
     return DR_RESULT_ERRNUM(fd, DR_ERR_ISO_C, EISDIR);
   }
   const uint8_t masked_mode = mode & 0xf;
-  // DR Ignoring OTRUNC and ORCLOSE
+  // DR Ignoring ORCLOSE
   const bool reading = masked_mode == DR_OREAD || masked_mode == DR_ORDWR;
   const bool writing = masked_mode == DR_OWRITE || masked_mode == DR_ORDWR;
   if (dr_unlikely((reading && !dr_user_has_perm_read(user, file)) ||
@@ -74,37 +89,346 @@ struct dr_result_fd dr_vfs_open(const struct dr_user *restrict const user, struc
 		  (masked_mode == DR_OEXEC && !dr_user_has_perm_exec(user, file)))) {
     return DR_RESULT_ERRNUM(fd, DR_ERR_ISO_C, EACCES);
   }
-  struct dr_fd *restrict const fd = (struct dr_fd *)malloc(sizeof(*fd));
-  if (dr_unlikely(fd == NULL)) {
-    return DR_RESULT_ERRNO(fd);
+  if ((mode & DR_OTRUNC) != 0 && writing && file->vtbl->truncate != NULL) {
+    const struct dr_result_void r = file->vtbl->truncate(file, 0);
+    DR_IF_RESULT_ERR(r, err) {
+      return DR_RESULT_ERROR(fd, err);
+    } DR_FI_RESULT;
   }
-  *fd = (struct dr_fd) {
-    .file = file,
-    .mode = (reading ? DR_AREAD : 0) | (writing ? DR_AWRITE : 0),
+  return dr_vfs_fd(file, reading, writing);
+}
+
+struct dr_result_fd dr_vfs_create(struct dr_user *restrict const user, struct dr_file *restrict const dir, const struct dr_str *restrict const name, const uint32_t perm, const uint8_t mode) {
+  if (dr_unlikely(!dr_is_dir(dir))) {
+    return DR_RESULT_ERRNUM(fd, DR_ERR_ISO_C, ENOTDIR);
+  }
+  if (dr_unlikely(!dr_user_has_perm_write(user, dir))) {
+    return DR_RESULT_ERRNUM(fd, DR_ERR_ISO_C, EACCES);
+  }
+  if (dr_unlikely(dir->vtbl->create == NULL)) {
+    // Read only tree
+    return DR_RESULT_ERRNUM(fd, DR_ERR_ISO_C, EACCES);
+  }
+  if (dr_unlikely(name->len == 0 ||
+		  (name->len == 1 && name->buf[0] == '.') ||
+		  (name->len == 2 && name->buf[0] == '.' && name->buf[1] == '.') ||
+		  memchr(name->buf, '/', name->len) != NULL)) {
+    return DR_RESULT_ERRNUM(fd, DR_ERR_ISO_C, EINVAL);
+  }
+  const uint8_t masked_mode = mode & 0xf;
+  const bool reading = masked_mode == DR_OREAD || masked_mode == DR_ORDWR;
+  const bool writing = masked_mode == DR_OWRITE || masked_mode == DR_ORDWR;
+  if (dr_unlikely((perm & DR_DIR) != 0 && masked_mode != DR_OREAD)) {
+    return DR_RESULT_ERRNUM(fd, DR_ERR_ISO_C, EISDIR);
+  }
+  struct dr_file *restrict file;
+  {
+    const struct dr_result_file r = dir->vtbl->create(dir, user, name, perm);
+    DR_IF_RESULT_ERR(r, err) {
+      return DR_RESULT_ERROR(fd, err);
+    } DR_ELIF_RESULT_OK(struct dr_file *restrict, r, value) {
+      file = value;
+    } DR_FI_RESULT;
+  }
+  // The new file is opened with mode regardless of perm
+  return dr_vfs_fd(file, reading, writing);
+}
+
+struct dr_result_void dr_vfs_remove(const struct dr_user *restrict const user, struct dr_file *restrict const file) {
+  if (dr_unlikely(file->vtbl->remove == NULL)) {
+    // Read only tree
+    return DR_RESULT_ERRNUM_VOID(DR_ERR_ISO_C, EACCES);
+  }
+  return file->vtbl->remove(user, file);
+}
+
+bool dr_vfs_can_write(const struct dr_user *restrict const user, const struct dr_file *restrict const file) {
+  return dr_user_has_perm_write(user, file);
+}
+
+void dr_vfs_ref(struct dr_file *restrict const file) {
+  ++file->refs;
+}
+
+void dr_vfs_unref(struct dr_file *restrict const file) {
+  if (--file->refs == 0 && file->vtbl->release != NULL) {
+    file->vtbl->release(file);
+  }
+}
+
+static uint64_t dr_vfs_cache_used;
+static struct dr_pool *restrict dr_vfs_pool;
+
+struct dr_vfs_call {
+  struct dr_pool_job job;
+  const struct dr_fd *restrict fd;
+  uint64_t offset;
+  uint32_t count;
+  void *restrict buf;
+  const void *restrict cbuf;
+  struct dr_result_uint32 result;
+};
+
+static void dr_vfs_call_read(struct dr_pool_job *restrict const job) {
+  struct dr_vfs_call *restrict const call = container_of(job, struct dr_vfs_call, job);
+  call->result = call->fd->file->vtbl->read(call->fd, call->offset, call->count, call->buf);
+}
+
+static void dr_vfs_call_write(struct dr_pool_job *restrict const job) {
+  struct dr_vfs_call *restrict const call = container_of(job, struct dr_vfs_call, job);
+  call->result = call->fd->file->vtbl->write(call->fd, call->offset, call->count, call->cbuf);
+}
+
+void dr_vfs_offload(struct dr_pool *restrict const pool) {
+  dr_vfs_pool = pool;
+}
+
+WARN_UNUSED_RESULT static struct dr_result_uint32 dr_vfs_backend_read(const struct dr_fd *restrict const fd, const uint64_t offset, const uint32_t count, void *restrict const buf) {
+  if (dr_vfs_pool == NULL || (fd->file->vtbl->flags & DR_VFS_BLOCKING) == 0) {
+    return fd->file->vtbl->read(fd, offset, count, buf);
+  }
+  struct dr_vfs_call call = {
+    .job.func = dr_vfs_call_read,
+    .fd = fd,
+    .offset = offset,
+    .count = count,
+    .buf = buf,
   };
-  return DR_RESULT_OK(fd, fd);
+  dr_pool_run(dr_vfs_pool, &call.job);
+  return call.result;
+}
+
+WARN_UNUSED_RESULT static struct dr_result_uint32 dr_vfs_backend_write(const struct dr_fd *restrict const fd, const uint64_t offset, const uint32_t count, const void *restrict const buf) {
+  if (dr_vfs_pool == NULL || (fd->file->vtbl->flags & DR_VFS_BLOCKING) == 0) {
+    return fd->file->vtbl->write(fd, offset, count, buf);
+  }
+  struct dr_vfs_call call = {
+    .job.func = dr_vfs_call_write,
+    .fd = fd,
+    .offset = offset,
+    .count = count,
+    .cbuf = buf,
+  };
+  dr_pool_run(dr_vfs_pool, &call.job);
+  return call.result;
+}
+
+WARN_UNUSED_RESULT static struct dr_fd_cache *dr_vfs_cache_get(struct dr_fd *restrict const fd) {
+  if (fd->cache == NULL) {
+    if (dr_vfs_cache_used + DR_VFS_CACHE_SIZE > DR_VFS_CACHE_LIMIT) {
+      return NULL;
+    }
+    struct dr_fd_cache *restrict const cache = (struct dr_fd_cache *)malloc(sizeof(*cache) + DR_VFS_CACHE_SIZE);
+    if (dr_unlikely(cache == NULL)) {
+      return NULL;
+    }
+    cache->fd = fd;
+    cache->offset = 0;
+    cache->len = 0;
+    cache->vers = 0;
+    cache->failed = false;
+    cache->dirty = false;
+    cache->prefetch = false;
+    cache->fetching = false;
+    dr_vfs_cache_used += DR_VFS_CACHE_SIZE;
+    fd->cache = cache;
+  }
+  return fd->cache;
 }
 
-struct dr_result_uint32 dr_vfs_read(const struct dr_fd *restrict const fd, const uint64_t offset, const uint32_t count, void *restrict const buf) {
+// Waits for a read ahead started by dr_vfs_prefetch before the window is used
+static void dr_vfs_cache_wait(struct dr_fd_cache *restrict const c) {
+  if (c != NULL && c->fetching) {
+    dr_pool_finish(&c->fetch);
+    c->fetching = false;
+  }
+}
+
+WARN_UNUSED_RESULT static struct dr_result_void dr_vfs_write_out(const struct dr_fd *restrict const fd, const struct dr_fd_cache *restrict const c, const uint32_t len) {
+  for (uint32_t pos = 0; pos < len;) {
+    const struct dr_result_uint32 r = dr_vfs_backend_write(fd, c->offset + pos, len - pos, c->buf + pos);
+    DR_IF_RESULT_ERR(r, err) {
+      return DR_RESULT_ERROR_VOID(err);
+    } DR_ELIF_RESULT_OK(uint32_t, r, value) {
+      if (dr_unlikely(value == 0)) {
+	return DR_RESULT_ERRNUM_VOID(DR_ERR_ISO_C, EIO);
+      }
+      pos += value;
+    } DR_FI_RESULT;
+  }
+  return DR_RESULT_OK_VOID();
+}
+
+// On error the buffered data is dropped and the error is kept for the next write or flush
+static void dr_vfs_writeback(struct dr_fd *restrict const fd, struct dr_fd_cache *restrict const c) {
+  const uint32_t len = c->len;
+  c->dirty = false;
+  c->len = 0;
+  const struct dr_result_void r = dr_vfs_write_out(fd, c, len);
+  DR_IF_RESULT_ERR(r, err) {
+    c->error = *err;
+    c->failed = true;
+  } DR_ELIF_RESULT_OK_VOID(r) {
+    // Stat only sees buffered writes once they have reached the backend
+    if (c->offset + len > fd->file->length) {
+      fd->file->length = c->offset + len;
+    }
+    ++fd->file->vers;
+  } DR_FI_RESULT;
+}
+
+struct dr_result_void dr_vfs_flush(struct dr_fd *restrict const fd) {
+  struct dr_fd_cache *restrict const c = fd->cache;
+  if (c == NULL) {
+    return DR_RESULT_OK_VOID();
+  }
+  dr_vfs_cache_wait(c);
+  if (c->dirty) {
+    dr_vfs_writeback(fd, c);
+  }
+  if (c->failed) {
+    c->failed = false;
+    return DR_RESULT_ERROR_VOID(&c->error);
+  }
+  return DR_RESULT_OK_VOID();
+}
+
+static void dr_vfs_fill(const struct dr_fd *restrict const fd, struct dr_fd_cache *restrict const c) {
+  const struct dr_result_uint32 r = fd->file->vtbl->read(fd, c->offset, DR_VFS_CACHE_SIZE, c->buf);
+  DR_IF_RESULT_ERR(r, err) {
+    // The next read goes to the backend and reports the error
+    (void)err;
+    c->len = 0;
+  } DR_ELIF_RESULT_OK(uint32_t, r, value) {
+    c->len = value;
+  } DR_FI_RESULT;
+}
+
+static void dr_vfs_fetch(struct dr_pool_job *restrict const job) {
+  struct dr_fd_cache *restrict const c = container_of(job, struct dr_fd_cache, fetch);
+  dr_vfs_fill(c->fd, c);
+}
+
+void dr_vfs_prefetch(struct dr_fd *restrict const fd) {
+  struct dr_fd_cache *restrict const c = fd->cache;
+  if (c == NULL || !c->prefetch || c->dirty) {
+    return;
+  }
+  c->prefetch = false;
+  c->offset = fd->next;
+  c->len = 0;
+  c->vers = fd->file->vers;
+  if ((fd->file->vtbl->flags & DR_VFS_BLOCKING) == 0) {
+    dr_vfs_fill(fd, c);
+  } else if (dr_vfs_pool != NULL) {
+    c->fetch.func = dr_vfs_fetch;
+    c->fetching = true;
+    dr_pool_start(dr_vfs_pool, &c->fetch);
+  }
+  // Otherwise filling the window would block every task, so the next read goes to the backend
+}
+
+struct dr_result_uint32 dr_vfs_read(struct dr_fd *restrict const fd, const uint64_t offset, const uint32_t count, void *restrict const buf) {
   if (dr_unlikely((fd->mode & DR_AREAD) == 0)) {
     return DR_RESULT_ERRNUM(uint32, DR_ERR_ISO_C, EBADF);
   }
   if (dr_unlikely(fd->file->vtbl->read == NULL)) {
     return DR_RESULT_ERRNUM(uint32, DR_ERR_ISO_C, ENOSYS);
   }
-  return fd->file->vtbl->read(fd, offset, count, buf);
+  struct dr_fd_cache *restrict c = fd->cache;
+  dr_vfs_cache_wait(c);
+  if (c != NULL && c->dirty) {
+    // A failure is left for the writer to see on its next write or flush
+    dr_vfs_writeback(fd, c);
+  }
+  uint32_t bytes = 0;
+  if (c != NULL && c->vers == fd->file->vers && offset >= c->offset && offset - c->offset < c->len) {
+    const uint64_t avail = c->len - (offset - c->offset);
+    bytes = count < avail ? count : avail;
+    memcpy(buf, c->buf + (offset - c->offset), bytes);
+  }
+  if (bytes < count) {
+    const struct dr_result_uint32 r = dr_vfs_backend_read(fd, offset + bytes, count - bytes, (uint8_t *)buf + bytes);
+    DR_IF_RESULT_ERR(r, err) {
+      if (bytes == 0) {
+	return DR_RESULT_ERROR(uint32, err);
+      }
+    } DR_ELIF_RESULT_OK(uint32_t, r, value) {
+      bytes += value;
+    } DR_FI_RESULT;
+  }
+  const bool sequential = offset == fd->next;
+  fd->next = offset + bytes;
+  // Fetch the next window once the current one is used up, dr_vfs_prefetch starts it after the reply is sent
+  if (sequential && bytes == count && (fd->file->vtbl->flags & DR_VFS_READAHEAD) != 0 && (c = dr_vfs_cache_get(fd)) != NULL &&
+      (c->vers != fd->file->vers || fd->next < c->offset || fd->next - c->offset >= c->len)) {
+    c->prefetch = true;
+  }
+  return DR_RESULT_OK(uint32, bytes);
 }
 
-struct dr_result_uint32 dr_vfs_write(const struct dr_fd *restrict const fd, const uint64_t offset, const uint32_t count, const void *restrict const buf) {
+struct dr_result_uint32 dr_vfs_write(struct dr_fd *restrict const fd, const uint64_t offset, const uint32_t count, const void *restrict const buf) {
   if (dr_unlikely((fd->mode & DR_AWRITE) == 0)) {
     return DR_RESULT_ERRNUM(uint32, DR_ERR_ISO_C, EBADF);
   }
   if (dr_unlikely(fd->file->vtbl->write == NULL)) {
     return DR_RESULT_ERRNUM(uint32, DR_ERR_ISO_C, ENOSYS);
   }
-  return fd->file->vtbl->write(fd, offset, count, buf);
+  struct dr_fd_cache *restrict c = fd->cache;
+  if (c != NULL) {
+    dr_vfs_cache_wait(c);
+    if (c->dirty && offset == c->offset + c->len && count <= DR_VFS_CACHE_SIZE - c->len && (fd->file->mode & DR_APPEND) == 0) {
+      memcpy(c->buf + c->len, buf, count);
+      c->len += count;
+      fd->next = offset + count;
+      return DR_RESULT_OK(uint32, count);
+    }
+    const struct dr_result_void r = dr_vfs_flush(fd);
+    DR_IF_RESULT_ERR(r, err) {
+      return DR_RESULT_ERROR(uint32, err);
+    } DR_FI_RESULT;
+    // Drop any read ahead data
+    c->len = 0;
+    c->prefetch = false;
+  }
+  const bool sequential = offset == fd->next;
+  // Appends go to the backend, which knows where the file ends
+  if (sequential && count < DR_VFS_CACHE_SIZE && (fd->file->vtbl->flags & DR_VFS_WRITEBEHIND) != 0 && (fd->file->mode & DR_APPEND) == 0 && (c = dr_vfs_cache_get(fd)) != NULL) {
+    memcpy(c->buf, buf, count);
+    c->offset = offset;
+    c->len = count;
+    c->dirty = true;
+    fd->next = offset + count;
+    return DR_RESULT_OK(uint32, count);
+  }
+  const struct dr_result_uint32 r = dr_vfs_backend_write(fd, offset, count, buf);
+  DR_IF_RESULT_OK(uint32_t, r, value) {
+    fd->next = offset + value;
+  } DR_FI_RESULT;
+  return r;
+}
+
+struct dr_result_uint32 dr_vfs_readdir(const struct dr_fd *restrict const fd, const uint64_t offset, const uint32_t count, void *restrict const buf) {
+  if (dr_unlikely(!dr_is_dir(fd->file))) {
+    return DR_RESULT_ERRNUM(uint32, DR_ERR_ISO_C, ENOTDIR);
+  }
+  if (dr_unlikely((fd->mode & DR_AREAD) == 0)) {
+    return DR_RESULT_ERRNUM(uint32, DR_ERR_ISO_C, EBADF);
+  }
+  if (dr_unlikely(fd->file->vtbl->readdir == NULL)) {
+    return DR_RESULT_ERRNUM(uint32, DR_ERR_ISO_C, ENOSYS);
+  }
+  return fd->file->vtbl->readdir(fd, offset, count, buf);
 }
 
 void dr_vfs_close(struct dr_fd *restrict const fd) {
+  if (fd->cache != NULL) {
+    const struct dr_result_void r = dr_vfs_flush(fd);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_vfs_flush failed", err);
+    } DR_FI_RESULT;
+    free(fd->cache);
+    dr_vfs_cache_used -= DR_VFS_CACHE_SIZE;
+  }
   free(fd);
 }
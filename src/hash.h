@@ -0,0 +1,148 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// Copyright (c) 2018 Drew Richardson <drewrichardson@gmail.com>
+
+#if !defined(HASH_H)
+#define HASH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "list.h"
+
+/*
+ * Intrusive open addressing hash table with linear probing. Slots keep the
+ * hash next to the node pointer so probes rarely touch the nodes, and removal
+ * shifts the rest of the cluster back instead of leaving tombstones. Keys
+ * live in the containing struct and are compared by a caller supplied
+ * function, the same key must not be inserted twice.
+ */
+
+struct hash_node {
+  uint32_t hash;
+};
+
+struct hash_slot {
+  uint32_t hash;
+  struct hash_node *node;
+};
+
+struct hash_table {
+  struct hash_slot *slots;
+  uint32_t mask;
+  uint32_t count;
+};
+
+#define HASH_TABLE_INIT { NULL, 0, 0 }
+
+#define hash_entry(ptr, type, member) \
+  container_of(ptr, type, member)
+
+// Spreads small sequential keys like fids over the table
+static inline uint32_t hash_uint32(const uint32_t key) {
+  return key*UINT32_C(0x9e3779b1);
+}
+
+static inline void hash_init(struct hash_table *table) {
+  table->slots = NULL;
+  table->mask = 0;
+  table->count = 0;
+}
+
+static inline void hash_destroy(struct hash_table *table) {
+  free(table->slots);
+  hash_init(table);
+}
+
+static inline uint32_t hash_capacity(const struct hash_table *table) {
+  return table->slots == NULL ? 0 : table->mask + 1;
+}
+
+static inline struct hash_node *hash_find(const struct hash_table *table, const uint32_t hash, bool (*eq)(const struct hash_node *, const void *), const void *key) {
+  if (table->count == 0) {
+    return NULL;
+  }
+  for (uint32_t i = hash & table->mask;; i = (i + 1) & table->mask) {
+    const struct hash_slot *slot = &table->slots[i];
+    if (slot->node == NULL) {
+      return NULL;
+    }
+    if (slot->hash == hash && eq(slot->node, key)) {
+      return slot->node;
+    }
+  }
+}
+
+static inline void __hash_place(struct hash_slot *slots, const uint32_t mask, struct hash_node *node) {
+  uint32_t i = node->hash & mask;
+  while (slots[i].node != NULL) {
+    i = (i + 1) & mask;
+  }
+  slots[i].hash = node->hash;
+  slots[i].node = node;
+}
+
+// Returns false if the table needed to grow and could not
+static inline bool hash_insert(struct hash_table *table, struct hash_node *node, const uint32_t hash) {
+  node->hash = hash;
+  const uint32_t capacity = hash_capacity(table);
+  // Keep the load at or below 3/4 so probe sequences stay short
+  if (4*(uint64_t)(table->count + 1) > 3*(uint64_t)capacity) {
+    const uint32_t new_capacity = capacity == 0 ? 8 : 2*capacity;
+    struct hash_slot *slots = (struct hash_slot *)calloc(new_capacity, sizeof(*slots));
+    if (slots == NULL) {
+      return false;
+    }
+    for (uint32_t i = 0; i < capacity; ++i) {
+      if (table->slots[i].node != NULL) {
+	__hash_place(slots, new_capacity - 1, table->slots[i].node);
+      }
+    }
+    free(table->slots);
+    table->slots = slots;
+    table->mask = new_capacity - 1;
+  }
+  __hash_place(table->slots, table->mask, node);
+  ++table->count;
+  return true;
+}
+
+// Empties slot i and moves back later nodes of the cluster that can no longer be reached
+static inline void __hash_remove_slot(struct hash_table *table, uint32_t i) {
+  const uint32_t mask = table->mask;
+  for (uint32_t j = (i + 1) & mask; table->slots[j].node != NULL; j = (j + 1) & mask) {
+    const uint32_t home = table->slots[j].hash & mask;
+    // The node at j may fill the hole unless its home lies cyclically in (i, j]
+    if (((j - home) & mask) >= ((j - i) & mask)) {
+      table->slots[i] = table->slots[j];
+      i = j;
+    }
+  }
+  table->slots[i].node = NULL;
+  --table->count;
+}
+
+static inline void hash_remove(struct hash_table *table, struct hash_node *node) {
+  uint32_t i = node->hash & table->mask;
+  while (table->slots[i].node != node) {
+    i = (i + 1) & table->mask;
+  }
+  __hash_remove_slot(table, i);
+}
+
+// The table must not change while iterating
+#define hash_for_each_slot(i, table) \
+  for (i = 0; i < hash_capacity(table); ++i) \
+    if ((table)->slots[i].node != NULL)
+
+// For tearing a table down: returns a node at or after slot *i, which starts at 0, or NULL once empty. Removing each returned node before the next call visits every node once
+static inline struct hash_node *hash_next_remaining(const struct hash_table *table, uint32_t *i) {
+  for (; *i < hash_capacity(table); ++*i) {
+    if (table->slots[*i].node != NULL) {
+      return table->slots[*i].node;
+    }
+  }
+  return NULL;
+}
+
+#endif // HASH_H
@@ -0,0 +1,136 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// Copyright (c) 2018 Drew Richardson <drewrichardson@gmail.com>
+
+#if !defined(HEAP_H)
+#define HEAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "list.h"
+
+/*
+ * Intrusive 4-ary min heap. The array holds node pointers and each node
+ * remembers its index so it can be removed from the middle. With four
+ * children a level is one cache line of pointers and the tree is half as deep
+ * as a binary heap. The order comes from a caller supplied less function.
+ */
+
+#define HEAP_ARITY 4
+
+struct heap_node {
+  uint32_t index;
+};
+
+struct heap {
+  struct heap_node **nodes;
+  uint32_t count;
+  uint32_t capacity;
+};
+
+#define HEAP_INIT { NULL, 0, 0 }
+
+#define heap_entry(ptr, type, member) \
+  container_of(ptr, type, member)
+
+static inline void heap_init(struct heap *heap) {
+  heap->nodes = NULL;
+  heap->count = 0;
+  heap->capacity = 0;
+}
+
+static inline void heap_destroy(struct heap *heap) {
+  free(heap->nodes);
+  heap_init(heap);
+}
+
+static inline bool heap_empty(const struct heap *heap) {
+  return heap->count == 0;
+}
+
+static inline struct heap_node *heap_min(const struct heap *heap) {
+  return heap->count == 0 ? NULL : heap->nodes[0];
+}
+
+static inline void __heap_set(struct heap *heap, const uint32_t i, struct heap_node *node) {
+  heap->nodes[i] = node;
+  node->index = i;
+}
+
+static inline void __heap_up(struct heap *heap, uint32_t i, bool (*less)(const struct heap_node *, const struct heap_node *)) {
+  struct heap_node *node = heap->nodes[i];
+  while (i > 0) {
+    const uint32_t parent = (i - 1)/HEAP_ARITY;
+    if (!less(node, heap->nodes[parent])) {
+      break;
+    }
+    __heap_set(heap, i, heap->nodes[parent]);
+    i = parent;
+  }
+  __heap_set(heap, i, node);
+}
+
+static inline void __heap_down(struct heap *heap, uint32_t i, bool (*less)(const struct heap_node *, const struct heap_node *)) {
+  struct heap_node *node = heap->nodes[i];
+  while (true) {
+    const uint32_t first = HEAP_ARITY*i + 1;
+    if (first >= heap->count) {
+      break;
+    }
+    const uint32_t last = first + HEAP_ARITY < heap->count ? first + HEAP_ARITY : heap->count;
+    uint32_t min = first;
+    for (uint32_t c = first + 1; c < last; ++c) {
+      if (less(heap->nodes[c], heap->nodes[min])) {
+	min = c;
+      }
+    }
+    if (!less(heap->nodes[min], node)) {
+      break;
+    }
+    __heap_set(heap, i, heap->nodes[min]);
+    i = min;
+  }
+  __heap_set(heap, i, node);
+}
+
+// Returns false if the heap needed to grow and could not
+static inline bool heap_push(struct heap *heap, struct heap_node *node, bool (*less)(const struct heap_node *, const struct heap_node *)) {
+  if (heap->count == heap->capacity) {
+    const uint32_t capacity = heap->capacity == 0 ? 16 : 2*heap->capacity;
+    struct heap_node **nodes = (struct heap_node **)realloc(heap->nodes, capacity*sizeof(*nodes));
+    if (nodes == NULL) {
+      return false;
+    }
+    heap->nodes = nodes;
+    heap->capacity = capacity;
+  }
+  heap->nodes[heap->count] = node;
+  __heap_up(heap, heap->count++, less);
+  return true;
+}
+
+static inline void heap_remove(struct heap *heap, struct heap_node *node, bool (*less)(const struct heap_node *, const struct heap_node *)) {
+  const uint32_t i = node->index;
+  struct heap_node *last = heap->nodes[--heap->count];
+  if (i == heap->count) {
+    return;
+  }
+  // The last node may belong above or below the hole
+  __heap_set(heap, i, last);
+  if (i > 0 && less(last, heap->nodes[(i - 1)/HEAP_ARITY])) {
+    __heap_up(heap, i, less);
+  } else {
+    __heap_down(heap, i, less);
+  }
+}
+
+static inline struct heap_node *heap_pop(struct heap *heap, bool (*less)(const struct heap_node *, const struct heap_node *)) {
+  struct heap_node *node = heap_min(heap);
+  if (node != NULL) {
+    heap_remove(heap, node, less);
+  }
+  return node;
+}
+
+#endif // HEAP_H
@@ -0,0 +1,297 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// Copyright (c) 2018 Drew Richardson <drewrichardson@gmail.com>
+
+#if !defined(RBTREE_H)
+#define RBTREE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "list.h"
+
+/*
+ * Intrusive red-black tree for ordered iteration. Nothing is allocated, so
+ * inserting cannot fail. The root caches the leftmost node, which makes the
+ * tree usable as a priority queue as well. Nodes that compare equal are kept
+ * in insertion order.
+ */
+
+struct rb_node {
+  struct rb_node *parent;
+  struct rb_node *left;
+  struct rb_node *right;
+  bool red;
+};
+
+struct rb_root {
+  struct rb_node *node;
+  struct rb_node *leftmost;
+};
+
+#define RB_ROOT_INIT { NULL, NULL }
+
+#define rb_entry(ptr, type, member) \
+  container_of(ptr, type, member)
+
+static inline void rb_init(struct rb_root *root) {
+  root->node = NULL;
+  root->leftmost = NULL;
+}
+
+static inline bool rb_empty(const struct rb_root *root) {
+  return root->node == NULL;
+}
+
+static inline struct rb_node *rb_first(const struct rb_root *root) {
+  return root->leftmost;
+}
+
+static inline struct rb_node *rb_last(const struct rb_root *root) {
+  struct rb_node *node = root->node;
+  if (node != NULL) {
+    while (node->right != NULL) {
+      node = node->right;
+    }
+  }
+  return node;
+}
+
+static inline struct rb_node *rb_next(struct rb_node *node) {
+  if (node->right != NULL) {
+    node = node->right;
+    while (node->left != NULL) {
+      node = node->left;
+    }
+    return node;
+  }
+  while (node->parent != NULL && node == node->parent->right) {
+    node = node->parent;
+  }
+  return node->parent;
+}
+
+static inline struct rb_node *rb_prev(struct rb_node *node) {
+  if (node->left != NULL) {
+    node = node->left;
+    while (node->right != NULL) {
+      node = node->right;
+    }
+    return node;
+  }
+  while (node->parent != NULL && node == node->parent->left) {
+    node = node->parent;
+  }
+  return node->parent;
+}
+
+#define rb_for_each(pos, root) \
+  for (pos = rb_first(root); pos != NULL; pos = rb_next(pos))
+
+static inline void __rb_replace_child(struct rb_root *root, struct rb_node *parent, struct rb_node *old, struct rb_node *new_node) {
+  if (parent == NULL) {
+    root->node = new_node;
+  } else if (parent->left == old) {
+    parent->left = new_node;
+  } else {
+    parent->right = new_node;
+  }
+}
+
+static inline void __rb_rotate_left(struct rb_root *root, struct rb_node *x) {
+  struct rb_node *y = x->right;
+  x->right = y->left;
+  if (y->left != NULL) {
+    y->left->parent = x;
+  }
+  y->parent = x->parent;
+  __rb_replace_child(root, x->parent, x, y);
+  y->left = x;
+  x->parent = y;
+}
+
+static inline void __rb_rotate_right(struct rb_root *root, struct rb_node *x) {
+  struct rb_node *y = x->left;
+  x->left = y->right;
+  if (y->right != NULL) {
+    y->right->parent = x;
+  }
+  y->parent = x->parent;
+  __rb_replace_child(root, x->parent, x, y);
+  y->right = x;
+  x->parent = y;
+}
+
+static inline void rb_insert(struct rb_root *root, struct rb_node *node, bool (*less)(const struct rb_node *, const struct rb_node *)) {
+  struct rb_node *parent = NULL;
+  struct rb_node **link = &root->node;
+  bool leftmost = true;
+  while (*link != NULL) {
+    parent = *link;
+    if (less(node, parent)) {
+      link = &parent->left;
+    } else {
+      link = &parent->right;
+      leftmost = false;
+    }
+  }
+  node->parent = parent;
+  node->left = NULL;
+  node->right = NULL;
+  node->red = true;
+  *link = node;
+  if (leftmost) {
+    root->leftmost = node;
+  }
+
+  // A red node may not have a red parent, the root is black so a red parent always has a parent
+  while (node->parent != NULL && node->parent->red) {
+    parent = node->parent;
+    struct rb_node *gparent = parent->parent;
+    if (parent == gparent->left) {
+      struct rb_node *uncle = gparent->right;
+      if (uncle != NULL && uncle->red) {
+	parent->red = false;
+	uncle->red = false;
+	gparent->red = true;
+	node = gparent;
+	continue;
+      }
+      if (node == parent->right) {
+	__rb_rotate_left(root, parent);
+	node = parent;
+	parent = node->parent;
+      }
+      parent->red = false;
+      gparent->red = true;
+      __rb_rotate_right(root, gparent);
+    } else {
+      struct rb_node *uncle = gparent->left;
+      if (uncle != NULL && uncle->red) {
+	parent->red = false;
+	uncle->red = false;
+	gparent->red = true;
+	node = gparent;
+	continue;
+      }
+      if (node == parent->left) {
+	__rb_rotate_right(root, parent);
+	node = parent;
+	parent = node->parent;
+      }
+      parent->red = false;
+      gparent->red = true;
+      __rb_rotate_left(root, gparent);
+    }
+  }
+  root->node->red = false;
+}
+
+static inline bool __rb_is_black(const struct rb_node *node) {
+  return node == NULL || !node->red;
+}
+
+// node took the place of a removed black node under parent and is one black short
+static inline void __rb_erase_fixup(struct rb_root *root, struct rb_node *node, struct rb_node *parent) {
+  while (node != root->node && __rb_is_black(node)) {
+    if (node == parent->left) {
+      struct rb_node *sibling = parent->right;
+      if (sibling->red) {
+	sibling->red = false;
+	parent->red = true;
+	__rb_rotate_left(root, parent);
+	sibling = parent->right;
+      }
+      if (__rb_is_black(sibling->left) && __rb_is_black(sibling->right)) {
+	sibling->red = true;
+	node = parent;
+	parent = node->parent;
+	continue;
+      }
+      if (__rb_is_black(sibling->right)) {
+	sibling->left->red = false;
+	sibling->red = true;
+	__rb_rotate_right(root, sibling);
+	sibling = parent->right;
+      }
+      sibling->red = parent->red;
+      parent->red = false;
+      sibling->right->red = false;
+      __rb_rotate_left(root, parent);
+    } else {
+      struct rb_node *sibling = parent->left;
+      if (sibling->red) {
+	sibling->red = false;
+	parent->red = true;
+	__rb_rotate_right(root, parent);
+	sibling = parent->left;
+      }
+      if (__rb_is_black(sibling->left) && __rb_is_black(sibling->right)) {
+	sibling->red = true;
+	node = parent;
+	parent = node->parent;
+	continue;
+      }
+      if (__rb_is_black(sibling->left)) {
+	sibling->right->red = false;
+	sibling->red = true;
+	__rb_rotate_left(root, sibling);
+	sibling = parent->left;
+      }
+      sibling->red = parent->red;
+      parent->red = false;
+      sibling->left->red = false;
+      __rb_rotate_right(root, parent);
+    }
+    node = root->node;
+  }
+  if (node != NULL) {
+    node->red = false;
+  }
+}
+
+static inline void rb_erase(struct rb_root *root, struct rb_node *node) {
+  if (root->leftmost == node) {
+    root->leftmost = rb_next(node);
+  }
+  struct rb_node *child;
+  struct rb_node *parent;
+  bool black;
+  if (node->left == NULL || node->right == NULL) {
+    child = node->left != NULL ? node->left : node->right;
+    parent = node->parent;
+    black = !node->red;
+    __rb_replace_child(root, parent, node, child);
+    if (child != NULL) {
+      child->parent = parent;
+    }
+  } else {
+    // Swap in the successor, which has no left child
+    struct rb_node *successor = node->right;
+    while (successor->left != NULL) {
+      successor = successor->left;
+    }
+    child = successor->right;
+    black = !successor->red;
+    if (successor->parent == node) {
+      parent = successor;
+    } else {
+      parent = successor->parent;
+      parent->left = child;
+      if (child != NULL) {
+	child->parent = parent;
+      }
+      successor->right = node->right;
+      successor->right->parent = successor;
+    }
+    __rb_replace_child(root, node->parent, node, successor);
+    successor->parent = node->parent;
+    successor->left = node->left;
+    successor->left->parent = successor;
+    successor->red = node->red;
+  }
+  if (black) {
+    __rb_erase_fixup(root, child, parent);
+  }
+}
+
+#endif // RBTREE_H
@@ -32,6 +32,18 @@ static struct dr_user u1 = {
 
 int main(void) {
   dr_assert(0xdeadbeef == dr_decode_uint32((const uint8_t[]) { 0xef, 0xbe, 0xad, 0xde }));
+  dr_assert(0xbeef == dr_decode_uint16((const uint8_t[]) { 0xef, 0xbe }));
+  dr_assert(0x0123456789abcdefULL == dr_decode_uint64((const uint8_t[]) { 0xef, 0xcd, 0xab, 0x89, 0x67, 0x45, 0x23, 0x01 }));
+  {
+    // Unaligned
+    uint8_t buf[1 + sizeof(uint64_t)];
+    dr_encode_uint64(buf + 1, 0x0123456789abcdefULL);
+    dr_assert(buf[1] == 0xef && buf[8] == 0x01 && dr_decode_uint64(buf + 1) == 0x0123456789abcdefULL);
+    dr_encode_uint32(buf + 1, 0xdeadbeef);
+    dr_assert(buf[1] == 0xef && buf[4] == 0xde && dr_decode_uint32(buf + 1) == 0xdeadbeef);
+    dr_encode_uint16(buf + 1, 0xbeef);
+    dr_assert(buf[1] == 0xef && buf[2] == 0xbe && dr_decode_uint16(buf + 1) == 0xbeef);
+  }
   // DR dr_9p_decode_stat
   {
     const uint8_t buf[] = { 0xff, 0xff, 0xff, 0xff, 0x12, 0x34, 0x56 };
@@ -532,6 +544,16 @@ int main(void) {
       free(b);
     }
     dr_assert(!dr_9p_decode_Rstat(&stat, buf, sizeof(buf) + 1, &pos));
+    // The stat size and the string lengths must agree
+    uint8_t b[sizeof(buf)];
+    const size_t offsets[] = { 9, 9, 50, 50, 56 };
+    const uint8_t values[] = { 0x3d, 0x3f, 0x03, 0x05, 0x02 };
+    for (size_t i = 0; i < sizeof(offsets)/sizeof(offsets[0]); ++i) {
+      memcpy(b, buf, sizeof(buf));
+      b[offsets[i]] = values[i];
+      pos = HEADER_OFFSET;
+      dr_assert(!dr_9p_decode_Rstat(&stat, b, sizeof(b), &pos));
+    }
   }
   {
     const uint8_t buf[] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xde, 0xad, 0xbe, 0xef, 0x40, 0x00, 0x3e, 0x00, 0xca, 0xfe, 0xde, 0xad, 0xbe, 0xef, 0xca, 0xef, 0xbe, 0xad, 0xde, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x0d, 0xd0, 0xfe, 0xca, 0x78, 0x56, 0x34, 0x12, 0x21, 0x43, 0x65, 0x87, 0x55, 0x34, 0x21, 0x13, 0x58, 0x23, 0x11, 0x00, 0x04, 0x00, 'f', 'i', 'l', 'e', 0x03, 0x00, 'o', 'w', 'n', 0x06, 0x00, 'o', 'g', 'r', 'o', 'u', 'p', 0x02, 0x00, 'i', 'd' };
@@ -579,6 +601,275 @@ int main(void) {
     }
     dr_assert(!dr_9p_decode_Rwstat(7 + 1, &pos));
   }
+  {
+    const uint8_t buf[] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x02, 0x00, 0x00, 0x00 };
+    uint32_t ecode;
+    uint32_t pos = HEADER_OFFSET;
+    dr_assert(dr_9p_decode_Rlerror(&ecode, buf, sizeof(buf), &pos) &&
+	      ecode == 2 &&
+	      pos == sizeof(buf));
+    for (size_t i = 0; i < sizeof(buf); ++i) {
+      uint8_t *restrict const b = (uint8_t *)malloc(i);
+      if (i > 0) {
+	memcpy(b, buf, i);
+      }
+      pos = HEADER_OFFSET;
+      dr_assert(!dr_9p_decode_Rlerror(&ecode, b, i, &pos));
+      free(b);
+    }
+    dr_assert(!dr_9p_decode_Rlerror(&ecode, buf, sizeof(buf) + 1, &pos));
+  }
+  {
+    const uint8_t buf[] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x12, 0x34, 0x56, 0x78, 0x03, 0x00, 'o', 'w', 'n', 0x01, 0x00, '/', 0xe8, 0x03, 0x00, 0x00 };
+    uint32_t afid;
+    struct dr_str uname;
+    struct dr_str aname;
+    uint32_t n_uname;
+    uint32_t pos = HEADER_OFFSET;
+    dr_assert(dr_9p_decode_Tauth_dotl(&afid, &uname, &aname, &n_uname, buf, sizeof(buf), &pos) &&
+	      afid == 0x78563412 &&
+	      uname.len == 3 &&
+	      memcmp(uname.buf, "own", 3) == 0 &&
+	      aname.len == 1 &&
+	      memcmp(aname.buf, "/", 1) == 0 &&
+	      n_uname == 1000 &&
+	      pos == sizeof(buf));
+    for (size_t i = 0; i < sizeof(buf); ++i) {
+      uint8_t *restrict const b = (uint8_t *)malloc(i);
+      if (i > 0) {
+	memcpy(b, buf, i);
+      }
+      pos = HEADER_OFFSET;
+      dr_assert(!dr_9p_decode_Tauth_dotl(&afid, &uname, &aname, &n_uname, b, i, &pos));
+      free(b);
+    }
+    dr_assert(!dr_9p_decode_Tauth_dotl(&afid, &uname, &aname, &n_uname, buf, sizeof(buf) + 1, &pos));
+    // The 9P2000 layout is shorter, so the two decoders tell the versions apart
+    pos = HEADER_OFFSET;
+    dr_assert(!dr_9p_decode_Tauth(&afid, &uname, &aname, buf, sizeof(buf), &pos));
+  }
+  {
+    const uint8_t buf[] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc, 0xde, 0xf0, 0x03, 0x00, 'o', 'w', 'n', 0x01, 0x00, '/', 0xe8, 0x03, 0x00, 0x00 };
+    uint32_t fid;
+    uint32_t afid;
+    struct dr_str uname;
+    struct dr_str aname;
+    uint32_t n_uname;
+    uint32_t pos = HEADER_OFFSET;
+    dr_assert(dr_9p_decode_Tattach_dotl(&fid, &afid, &uname, &aname, &n_uname, buf, sizeof(buf), &pos) &&
+	      fid == 0x78563412 &&
+	      afid == 0xf0debc9a &&
+	      uname.len == 3 &&
+	      memcmp(uname.buf, "own", 3) == 0 &&
+	      aname.len == 1 &&
+	      memcmp(aname.buf, "/", 1) == 0 &&
+	      n_uname == 1000 &&
+	      pos == sizeof(buf));
+    for (size_t i = 0; i < sizeof(buf); ++i) {
+      uint8_t *restrict const b = (uint8_t *)malloc(i);
+      if (i > 0) {
+	memcpy(b, buf, i);
+      }
+      pos = HEADER_OFFSET;
+      dr_assert(!dr_9p_decode_Tattach_dotl(&fid, &afid, &uname, &aname, &n_uname, b, i, &pos));
+      free(b);
+    }
+    dr_assert(!dr_9p_decode_Tattach_dotl(&fid, &afid, &uname, &aname, &n_uname, buf, sizeof(buf) + 1, &pos));
+  }
+  {
+    const uint8_t buf[] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x12, 0x34, 0x56, 0x78, 0x02, 0x02, 0x00, 0x00 };
+    uint32_t fid;
+    uint32_t flags;
+    uint32_t pos = HEADER_OFFSET;
+    dr_assert(dr_9p_decode_Tlopen(&fid, &flags, buf, sizeof(buf), &pos) &&
+	      fid == 0x78563412 &&
+	      flags == (DR_L_O_TRUNC | 2) &&
+	      pos == sizeof(buf));
+    for (size_t i = 0; i < sizeof(buf); ++i) {
+      uint8_t *restrict const b = (uint8_t *)malloc(i);
+      if (i > 0) {
+	memcpy(b, buf, i);
+      }
+      pos = HEADER_OFFSET;
+      dr_assert(!dr_9p_decode_Tlopen(&fid, &flags, b, i, &pos));
+      free(b);
+    }
+    dr_assert(!dr_9p_decode_Tlopen(&fid, &flags, buf, sizeof(buf) + 1, &pos));
+  }
+  {
+    const uint8_t buf[] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x12, 0x34, 0x56, 0x78, 0xff, 0x07, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+    uint32_t fid;
+    uint64_t request_mask;
+    uint32_t pos = HEADER_OFFSET;
+    dr_assert(dr_9p_decode_Tgetattr(&fid, &request_mask, buf, sizeof(buf), &pos) &&
+	      fid == 0x78563412 &&
+	      request_mask == DR_GETATTR_BASIC &&
+	      pos == sizeof(buf));
+    for (size_t i = 0; i < sizeof(buf); ++i) {
+      uint8_t *restrict const b = (uint8_t *)malloc(i);
+      if (i > 0) {
+	memcpy(b, buf, i);
+      }
+      pos = HEADER_OFFSET;
+      dr_assert(!dr_9p_decode_Tgetattr(&fid, &request_mask, b, i, &pos));
+      free(b);
+    }
+    dr_assert(!dr_9p_decode_Tgetattr(&fid, &request_mask, buf, sizeof(buf) + 1, &pos));
+  }
+  {
+    const uint8_t buf[] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc, 0xde, 0xf0, 0x04, 0x00, 'u', 's', 'e', 'r' };
+    uint32_t fid;
+    uint32_t newfid;
+    struct dr_str name;
+    uint32_t pos = HEADER_OFFSET;
+    dr_assert(dr_9p_decode_Txattrwalk(&fid, &newfid, &name, buf, sizeof(buf), &pos) &&
+	      fid == 0x78563412 &&
+	      newfid == 0xf0debc9a &&
+	      name.len == 4 &&
+	      memcmp(name.buf, "user", 4) == 0 &&
+	      pos == sizeof(buf));
+    for (size_t i = 0; i < sizeof(buf); ++i) {
+      uint8_t *restrict const b = (uint8_t *)malloc(i);
+      if (i > 0) {
+	memcpy(b, buf, i);
+      }
+      pos = HEADER_OFFSET;
+      dr_assert(!dr_9p_decode_Txattrwalk(&fid, &newfid, &name, b, i, &pos));
+      free(b);
+    }
+    dr_assert(!dr_9p_decode_Txattrwalk(&fid, &newfid, &name, buf, sizeof(buf) + 1, &pos));
+  }
+  {
+    const uint8_t buf[] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x12, 0x34, 0x56, 0x78, 0x01, 0x00, 0x00, 0x00 };
+    uint32_t fid;
+    uint32_t datasync;
+    uint32_t pos = HEADER_OFFSET;
+    dr_assert(dr_9p_decode_Tfsync(&fid, &datasync, buf, sizeof(buf), &pos) &&
+	      fid == 0x78563412 &&
+	      datasync == 1 &&
+	      pos == sizeof(buf));
+    pos = HEADER_OFFSET;
+    dr_assert(dr_9p_decode_Tfsync(&fid, &datasync, buf, sizeof(buf) - sizeof(uint32_t), &pos) &&
+	      fid == 0x78563412 &&
+	      datasync == 0 &&
+	      pos == sizeof(buf) - sizeof(uint32_t));
+    for (size_t i = 0; i < sizeof(buf); ++i) {
+      if (i == sizeof(buf) - sizeof(uint32_t)) {
+	continue;
+      }
+      uint8_t *restrict const b = (uint8_t *)malloc(i);
+      if (i > 0) {
+	memcpy(b, buf, i);
+      }
+      pos = HEADER_OFFSET;
+      dr_assert(!dr_9p_decode_Tfsync(&fid, &datasync, b, i, &pos));
+      free(b);
+    }
+    dr_assert(!dr_9p_decode_Tfsync(&fid, &datasync, buf, sizeof(buf) + 1, &pos));
+  }
+  {
+    const uint8_t buf[] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x12, 0x34, 0x56, 0x78, 0x04, 0x00, 'f', 'i', 'l', 'e', 0x42, 0x02, 0x00, 0x00, 0xa4, 0x01, 0x00, 0x00, 0xef, 0xbe, 0xad, 0xde };
+    uint32_t fid;
+    struct dr_str name;
+    uint32_t flags;
+    uint32_t mode;
+    uint32_t gid;
+    uint32_t pos = HEADER_OFFSET;
+    dr_assert(dr_9p_decode_Tlcreate(&fid, &name, &flags, &mode, &gid, buf, sizeof(buf), &pos) &&
+	      fid == 0x78563412 &&
+	      name.len == 4 &&
+	      memcmp(name.buf, "file", 4) == 0 &&
+	      flags == 0x242 &&
+	      mode == 0644 &&
+	      gid == 0xdeadbeef &&
+	      pos == sizeof(buf));
+    for (size_t i = 0; i < sizeof(buf); ++i) {
+      uint8_t *restrict const b = (uint8_t *)malloc(i);
+      if (i > 0) {
+	memcpy(b, buf, i);
+      }
+      pos = HEADER_OFFSET;
+      dr_assert(!dr_9p_decode_Tlcreate(&fid, &name, &flags, &mode, &gid, b, i, &pos));
+      free(b);
+    }
+    dr_assert(!dr_9p_decode_Tlcreate(&fid, &name, &flags, &mode, &gid, buf, sizeof(buf) + 1, &pos));
+  }
+  {
+    const uint8_t buf[] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x12, 0x34, 0x56, 0x78, 0x03, 0x00, 'd', 'i', 'r', 0xed, 0x01, 0x00, 0x00, 0xef, 0xbe, 0xad, 0xde };
+    uint32_t dfid;
+    struct dr_str name;
+    uint32_t mode;
+    uint32_t gid;
+    uint32_t pos = HEADER_OFFSET;
+    dr_assert(dr_9p_decode_Tmkdir(&dfid, &name, &mode, &gid, buf, sizeof(buf), &pos) &&
+	      dfid == 0x78563412 &&
+	      name.len == 3 &&
+	      memcmp(name.buf, "dir", 3) == 0 &&
+	      mode == 0755 &&
+	      gid == 0xdeadbeef &&
+	      pos == sizeof(buf));
+    for (size_t i = 0; i < sizeof(buf); ++i) {
+      uint8_t *restrict const b = (uint8_t *)malloc(i);
+      if (i > 0) {
+	memcpy(b, buf, i);
+      }
+      pos = HEADER_OFFSET;
+      dr_assert(!dr_9p_decode_Tmkdir(&dfid, &name, &mode, &gid, b, i, &pos));
+      free(b);
+    }
+    dr_assert(!dr_9p_decode_Tmkdir(&dfid, &name, &mode, &gid, buf, sizeof(buf) + 1, &pos));
+  }
+  {
+    const uint8_t buf[] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x12, 0x34, 0x56, 0x78, DR_LOCK_TYPE_WRLCK, 0x01, 0x00, 0x00, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x55, 0x34, 0x21, 0x13, 0x58, 0x23, 0x11, 0x00, 0xef, 0xbe, 0xad, 0xde, 0x04, 0x00, 'h', 'o', 's', 't' };
+    uint32_t fid;
+    struct dr_9p_flock flock;
+    uint32_t pos = HEADER_OFFSET;
+    dr_assert(dr_9p_decode_Tlock(&fid, &flock, buf, sizeof(buf), &pos) &&
+	      fid == 0x78563412 &&
+	      flock.type == DR_LOCK_TYPE_WRLCK &&
+	      flock.flags == 1 &&
+	      flock.start == 0x0807060504030201 &&
+	      flock.length == 0x0011235813213455 &&
+	      flock.proc_id == 0xdeadbeef &&
+	      flock.client_id.len == 4 &&
+	      memcmp(flock.client_id.buf, "host", 4) == 0 &&
+	      pos == sizeof(buf));
+    for (size_t i = 0; i < sizeof(buf); ++i) {
+      uint8_t *restrict const b = (uint8_t *)malloc(i);
+      if (i > 0) {
+	memcpy(b, buf, i);
+      }
+      pos = HEADER_OFFSET;
+      dr_assert(!dr_9p_decode_Tlock(&fid, &flock, b, i, &pos));
+      free(b);
+    }
+    dr_assert(!dr_9p_decode_Tlock(&fid, &flock, buf, sizeof(buf) + 1, &pos));
+  }
+  {
+    const uint8_t buf[] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x12, 0x34, 0x56, 0x78, DR_LOCK_TYPE_RDLCK, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x55, 0x34, 0x21, 0x13, 0x58, 0x23, 0x11, 0x00, 0xef, 0xbe, 0xad, 0xde, 0x04, 0x00, 'h', 'o', 's', 't' };
+    uint32_t fid;
+    struct dr_9p_flock flock;
+    uint32_t pos = HEADER_OFFSET;
+    dr_assert(dr_9p_decode_Tgetlock(&fid, &flock, buf, sizeof(buf), &pos) &&
+	      fid == 0x78563412 &&
+	      flock.type == DR_LOCK_TYPE_RDLCK &&
+	      flock.start == 0x0807060504030201 &&
+	      flock.length == 0x0011235813213455 &&
+	      flock.proc_id == 0xdeadbeef &&
+	      flock.client_id.len == 4 &&
+	      memcmp(flock.client_id.buf, "host", 4) == 0 &&
+	      pos == sizeof(buf));
+    for (size_t i = 0; i < sizeof(buf); ++i) {
+      uint8_t *restrict const b = (uint8_t *)malloc(i);
+      if (i > 0) {
+	memcpy(b, buf, i);
+      }
+      pos = HEADER_OFFSET;
+      dr_assert(!dr_9p_decode_Tgetlock(&fid, &flock, b, i, &pos));
+      free(b);
+    }
+    dr_assert(!dr_9p_decode_Tgetlock(&fid, &flock, buf, sizeof(buf) + 1, &pos));
+  }
 
   {
     uint8_t buf[BUF_SIZE];
@@ -989,6 +1280,57 @@ int main(void) {
       free(b);
     }
   }
+  {
+    // Directory reads copy each entry's cached stat until the entry changes
+    char name0_buf[] = { 'a' };
+    char name1_buf[] = { 'b', 'c' };
+    struct dr_group g = {
+      .name.len = sizeof(u1name_buf),
+      .name.buf = u1name_buf,
+    };
+    struct dr_file f0 = {
+      .mode = 0644,
+      .length = 1,
+      .name.len = sizeof(name0_buf),
+      .name.buf = name0_buf,
+      .uid = &u0,
+      .gid = &g,
+      .muid = &u0,
+    };
+    struct dr_file f1 = f0;
+    f1.name.len = sizeof(name1_buf);
+    f1.name.buf = name1_buf;
+    struct dr_file *const entries[] = { &f0, &f1 };
+    // The stats of an Rstat follow the header and n[2]
+    const uint32_t offset = HEADER_OFFSET + sizeof(uint16_t);
+    uint8_t expected[BUF_SIZE];
+    uint32_t len0;
+    uint32_t len1;
+    dr_assert(dr_9p_encode_Rstat(expected, sizeof(expected), &len0, 0, &f0));
+    len0 -= offset;
+    memmove(expected, expected + offset, len0);
+    dr_assert(dr_9p_encode_Rstat(expected + len0, sizeof(expected) - len0, &len1, 0, &f1));
+    len1 -= offset;
+    memmove(expected + len0, expected + len0 + offset, len1);
+    uint8_t buf[BUF_SIZE];
+    for (unsigned int i = 0; i < 2; ++i) {
+      dr_assert(dr_dir_read_entries(buf, sizeof(buf), 0, entries, 2) == len0 + len1 &&
+		memcmp(buf, expected, len0 + len1) == 0);
+    }
+    dr_assert(f0.stat != NULL && f1.stat != NULL);
+    dr_assert(dr_dir_read_entries(buf, len0 + len1 - 1, 0, entries, 2) == len0);
+    dr_assert(dr_dir_read_entries(buf, sizeof(buf), len0, entries, 2) == len1 &&
+	      memcmp(buf, expected + len0, len1) == 0);
+    dr_assert(dr_dir_read_entries(buf, sizeof(buf), len0 + 1, entries, 2) == 0);
+    f1.length = 2;
+    ++f1.vers;
+    dr_assert(dr_9p_encode_Rstat(expected, sizeof(expected), &len1, 0, &f1));
+    len1 -= offset;
+    dr_assert(dr_dir_read_entries(buf, sizeof(buf), len0, entries, 2) == len1 &&
+	      memcmp(buf, expected + offset, len1) == 0);
+    free(f0.stat);
+    free(f1.stat);
+  }
   // DR twstat
   {
     uint8_t buf[BUF_SIZE];
@@ -1041,6 +1383,297 @@ int main(void) {
       free(b);
     }
   }
+  {
+    uint8_t buf[BUF_SIZE];
+    uint32_t pos;
+    const struct dr_error err = {
+      .domain = DR_ERR_ISO_C,
+      .num = ENOENT,
+    };
+    const uint8_t expected[] = { 0x0b, 0x00, 0x00, 0x00, DR_RLERROR, 0x34, 0x12, ENOENT, 0x00, 0x00, 0x00 };
+    dr_9p_encode_Rlerror_err(buf, sizeof(buf), &pos, 0x1234, &err);
+    dr_assert(pos == sizeof(expected) &&
+	      memcmp(buf, expected, sizeof(expected)) == 0);
+  }
+  {
+    uint8_t buf[BUF_SIZE];
+    uint32_t pos;
+    const struct dr_file f = {
+      .vers = 0xdeadbeef,
+      .mode = 0xcafed00d,
+    };
+    const uint8_t expected[] = { 0x18, 0x00, 0x00, 0x00, DR_RLOPEN, 0x34, 0x12, 0xca, 0xef, 0xbe, 0xad, 0xde, QID_PATH(&f), 0x0d, 0xd0, 0xfe, 0xca };
+    dr_assert(dr_9p_encode_Rlopen(buf, sizeof(buf), &pos, 0x1234, &f, 0xcafed00d) &&
+	      pos == sizeof(expected) &&
+	      memcmp(buf, expected, sizeof(expected)) == 0);
+    for (size_t i = 0; i < sizeof(expected); ++i) {
+      uint8_t *restrict const b = (uint8_t *)malloc(i);
+      dr_assert(!dr_9p_encode_Rlopen(b, i, &pos, 0x1234, &f, 0xcafed00d));
+      free(b);
+    }
+  }
+  {
+    uint8_t buf[BUF_SIZE];
+    uint32_t pos;
+    const struct dr_file f = {
+      .vers = 0xdeadbeef,
+      .mode = 0644,
+    };
+    const uint8_t expected[] = { 0x18, 0x00, 0x00, 0x00, DR_RLCREATE, 0x34, 0x12, 0x00, 0xef, 0xbe, 0xad, 0xde, QID_PATH(&f), 0x0d, 0xd0, 0xfe, 0xca };
+    dr_assert(dr_9p_encode_Rlcreate(buf, sizeof(buf), &pos, 0x1234, &f, 0xcafed00d) &&
+	      pos == sizeof(expected) &&
+	      memcmp(buf, expected, sizeof(expected)) == 0);
+    for (size_t i = 0; i < sizeof(expected); ++i) {
+      uint8_t *restrict const b = (uint8_t *)malloc(i);
+      dr_assert(!dr_9p_encode_Rlcreate(b, i, &pos, 0x1234, &f, 0xcafed00d));
+      free(b);
+    }
+  }
+  {
+    uint8_t buf[BUF_SIZE];
+    uint32_t pos;
+    const struct dr_file f = {
+      .vers = 0xdeadbeef,
+      .mode = DR_DIR | 0755,
+    };
+    const uint8_t expected[] = { 0x14, 0x00, 0x00, 0x00, DR_RMKDIR, 0x34, 0x12, 0x80, 0xef, 0xbe, 0xad, 0xde, QID_PATH(&f) };
+    dr_assert(dr_9p_encode_Rmkdir(buf, sizeof(buf), &pos, 0x1234, &f) &&
+	      pos == sizeof(expected) &&
+	      memcmp(buf, expected, sizeof(expected)) == 0);
+    for (size_t i = 0; i < sizeof(expected); ++i) {
+      uint8_t *restrict const b = (uint8_t *)malloc(i);
+      dr_assert(!dr_9p_encode_Rmkdir(b, i, &pos, 0x1234, &f));
+      free(b);
+    }
+  }
+  {
+    uint8_t buf[BUF_SIZE];
+    uint32_t pos;
+    const struct dr_file f = {
+      .vers = 0xdeadbeef,
+      .mode = DR_DIR | 0755,
+      .atime = 0x12345678 * DR_NS_PER_S + 1,
+      .mtime = 0x87654321 * DR_NS_PER_S + 2,
+      .length = 513,
+    };
+    const uint8_t expected[] = { 0xa0, 0x00, 0x00, 0x00, DR_RGETATTR, 0x34, 0x12,
+				 0xff, 0x07, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+				 0x80, 0xef, 0xbe, 0xad, 0xde, QID_PATH(&f),
+				 0xed, 0x41, 0x00, 0x00,
+				 0x00, 0x00, 0x00, 0x00,
+				 0x00, 0x00, 0x00, 0x00,
+				 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+				 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+				 0x01, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+				 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+				 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+				 0x78, 0x56, 0x34, 0x12, 0x00, 0x00, 0x00, 0x00,
+				 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+				 0x21, 0x43, 0x65, 0x87, 0x00, 0x00, 0x00, 0x00,
+				 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+				 0x21, 0x43, 0x65, 0x87, 0x00, 0x00, 0x00, 0x00,
+				 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+				 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+				 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+				 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+				 0xef, 0xbe, 0xad, 0xde, 0x00, 0x00, 0x00, 0x00 };
+    dr_assert(dr_9p_encode_Rgetattr(buf, sizeof(buf), &pos, 0x1234, DR_GETATTR_BASIC, &f) &&
+	      pos == sizeof(expected) &&
+	      memcmp(buf, expected, sizeof(expected)) == 0);
+    for (size_t i = 0; i < sizeof(expected); ++i) {
+      uint8_t *restrict const b = (uint8_t *)malloc(i);
+      dr_assert(!dr_9p_encode_Rgetattr(b, i, &pos, 0x1234, DR_GETATTR_BASIC, &f));
+      free(b);
+    }
+  }
+  {
+    uint8_t buf[BUF_SIZE];
+    uint32_t pos;
+    const uint8_t expected[] = { 0x0f, 0x00, 0x00, 0x00, DR_RXATTRWALK, 0x34, 0x12, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08 };
+    dr_assert(dr_9p_encode_Rxattrwalk(buf, sizeof(buf), &pos, 0x1234, 0x0807060504030201) &&
+	      pos == sizeof(expected) &&
+	      memcmp(buf, expected, sizeof(expected)) == 0);
+    for (size_t i = 0; i < sizeof(expected); ++i) {
+      uint8_t *restrict const b = (uint8_t *)malloc(i);
+      dr_assert(!dr_9p_encode_Rxattrwalk(b, i, &pos, 0x1234, 0x0807060504030201));
+      free(b);
+    }
+  }
+  {
+    uint8_t buf[BUF_SIZE];
+    uint32_t pos;
+    char fname_buf[] = { 'f', 'i', 'l', 'e' };
+    const struct dr_file f = {
+      .vers = 0xdeadbeef,
+      .mode = 0644,
+      .name.len = sizeof(fname_buf),
+      .name.buf = fname_buf,
+    };
+    const uint8_t expected[] = { 0x27, 0x00, 0x00, 0x00, DR_RREADDIR, 0x34, 0x12, 0x1c, 0x00, 0x00, 0x00, 0x00, 0xef, 0xbe, 0xad, 0xde, QID_PATH(&f), 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, DR_L_DT_REG, 0x04, 0x00, 'f', 'i', 'l', 'e' };
+    dr_assert(dr_9p_encode_Rreaddir_iterator(buf, sizeof(buf), &pos, 0x1234));
+    const uint32_t written = dr_9p_encode_dirent(buf + pos, sizeof(buf) - pos, &f, 1);
+    dr_assert(written != FAIL_UINT32);
+    pos += written;
+    dr_assert(dr_9p_encode_Rreaddir_finish(buf, sizeof(buf), &pos, written) &&
+	      pos == sizeof(expected) &&
+	      memcmp(buf, expected, sizeof(expected)) == 0);
+    for (size_t i = 0; i < written; ++i) {
+      dr_assert(dr_9p_encode_dirent(buf, i, &f, 1) == FAIL_UINT32);
+    }
+  }
+  {
+    uint8_t buf[BUF_SIZE];
+    uint32_t pos;
+    const uint8_t expected[] = { 0x08, 0x00, 0x00, 0x00, DR_RLOCK, 0x34, 0x12, DR_LOCK_SUCCESS };
+    dr_assert(dr_9p_encode_Rlock(buf, sizeof(buf), &pos, 0x1234, DR_LOCK_SUCCESS) &&
+	      pos == sizeof(expected) &&
+	      memcmp(buf, expected, sizeof(expected)) == 0);
+    for (size_t i = 0; i < sizeof(expected); ++i) {
+      uint8_t *restrict const b = (uint8_t *)malloc(i);
+      dr_assert(!dr_9p_encode_Rlock(b, i, &pos, 0x1234, DR_LOCK_SUCCESS));
+      free(b);
+    }
+  }
+  {
+    uint8_t buf[BUF_SIZE];
+    uint32_t pos;
+    char client_id_buf[] = { 'h', 'o', 's', 't' };
+    const struct dr_9p_flock flock = {
+      .type = DR_LOCK_TYPE_UNLCK,
+      .start = 0x0807060504030201,
+      .length = 0x0011235813213455,
+      .proc_id = 0xdeadbeef,
+      .client_id.len = sizeof(client_id_buf),
+      .client_id.buf = client_id_buf,
+    };
+    const uint8_t expected[] = { 0x22, 0x00, 0x00, 0x00, DR_RGETLOCK, 0x34, 0x12, DR_LOCK_TYPE_UNLCK, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x55, 0x34, 0x21, 0x13, 0x58, 0x23, 0x11, 0x00, 0xef, 0xbe, 0xad, 0xde, 0x04, 0x00, 'h', 'o', 's', 't' };
+    dr_assert(dr_9p_encode_Rgetlock(buf, sizeof(buf), &pos, 0x1234, &flock) &&
+	      pos == sizeof(expected) &&
+	      memcmp(buf, expected, sizeof(expected)) == 0);
+    for (size_t i = 0; i < sizeof(expected); ++i) {
+      uint8_t *restrict const b = (uint8_t *)malloc(i);
+      dr_assert(!dr_9p_encode_Rgetlock(b, i, &pos, 0x1234, &flock));
+      free(b);
+    }
+  }
+  // Messages from the schema round trip and describe themselves
+  {
+    uint8_t buf[BUF_SIZE];
+    uint32_t pos;
+    char name_buf[] = { 'd', 'i', 'r' };
+    const struct dr_str name = {
+      .len = sizeof(name_buf),
+      .buf = name_buf,
+    };
+    dr_assert(dr_9p_encode_Tmkdir(buf, sizeof(buf), &pos, 0x1234, 7, &name, 0755, 100));
+    const uint32_t size = pos;
+    uint32_t dfid;
+    struct dr_str dname;
+    uint32_t mode;
+    uint32_t gid;
+    pos = HEADER_OFFSET;
+    dr_assert(dr_9p_decode_Tmkdir(&dfid, &dname, &mode, &gid, buf, size, &pos) &&
+	      dfid == 7 &&
+	      dname.len == sizeof(name_buf) &&
+	      memcmp(dname.buf, name_buf, sizeof(name_buf)) == 0 &&
+	      mode == 0755 &&
+	      gid == 100 &&
+	      pos == size);
+    char out[128];
+    const char expected[] = "Tmkdir 4660 dfid 7 name 'dir' mode 493 gid 100";
+    dr_assert(dr_9p_format(out, sizeof(out), buf, size) == sizeof(expected) - 1 &&
+	      strcmp(out, expected) == 0);
+    dr_assert(dr_9p_format(out, 8, buf, size) == 7 &&
+	      strcmp(out, "Tmkdir ") == 0);
+    for (size_t i = 0; i < size; ++i) {
+      uint8_t *restrict const b = (uint8_t *)malloc(i);
+      dr_assert(!dr_9p_encode_Tmkdir(b, i, &pos, 0x1234, 7, &name, 0755, 100));
+      free(b);
+    }
+  }
+  {
+    // 9P2000.L auth and attach carry n_uname, which dr_9p_format tells apart by size
+    uint8_t buf[BUF_SIZE];
+    uint32_t pos;
+    char uname_buf[] = { 'u' };
+    const struct dr_str uname = {
+      .len = sizeof(uname_buf),
+      .buf = uname_buf,
+    };
+    const struct dr_str aname = {
+      .len = 0,
+      .buf = NULL,
+    };
+    dr_assert(dr_9p_encode_Tattach_dotl(buf, sizeof(buf), &pos, 1, 0, DR_NOFID, &uname, &aname, 1000));
+    char out[128];
+    dr_9p_format(out, sizeof(out), buf, pos);
+    dr_assert(strcmp(out, "Tattach_dotl 1 fid 0 afid 4294967295 uname 'u' aname '' n_uname 1000") == 0);
+    dr_assert(dr_9p_encode_Tauth_dotl(buf, sizeof(buf), &pos, 3, 5, &uname, &aname, 1000));
+    dr_9p_format(out, sizeof(out), buf, pos);
+    dr_assert(strcmp(out, "Tauth_dotl 3 afid 5 uname 'u' aname '' n_uname 1000") == 0);
+    dr_assert(dr_9p_encode_Rclunk(buf, sizeof(buf), &pos, 2));
+    dr_9p_format(out, sizeof(out), buf, pos);
+    dr_assert(strcmp(out, "Rclunk 2") == 0);
+  }
+  {
+    // Pipelined messages are framed and checked together, leaving a partial message for the next read
+    uint8_t buf[BUF_SIZE];
+    uint32_t len = 0;
+    uint32_t pos;
+    char version_buf[] = { '9', 'P', '2', '0', '0', '0' };
+    const struct dr_str version = {
+      .len = sizeof(version_buf),
+      .buf = version_buf,
+    };
+    dr_assert(dr_9p_encode_Tversion(buf, sizeof(buf), &pos, 1, BUF_SIZE, &version));
+    const uint32_t tversion_size = pos;
+    len += pos;
+    dr_assert(dr_9p_encode_Tread(buf + len, sizeof(buf) - len, &pos, 2, 3, 0, 4096));
+    len += pos;
+    dr_assert(dr_9p_encode_Tclunk(buf + len, sizeof(buf) - len, &pos, 3, 3));
+    struct dr_9p_frame frames[4];
+    uint32_t used;
+    dr_assert(dr_9p_decode_frames(frames, 4, buf, len + pos - 1, BUF_SIZE, &used) == 2 &&
+	      used == len &&
+	      frames[0].pos == 0 && frames[0].size == tversion_size &&
+	      frames[1].pos == tversion_size && frames[1].size == len - tversion_size);
+    dr_assert(dr_9p_decode_frames(frames, 1, buf, len, BUF_SIZE, &used) == 1 &&
+	      used == tversion_size);
+    dr_assert(dr_9p_decode_frames(frames, 4, buf, 3, BUF_SIZE, &used) == 0 &&
+	      used == 0);
+    len += pos;
+    // Types outside the schema are left to the handlers
+    dr_assert(dr_9p_encode_Rclunk(buf + len, sizeof(buf) - len, &pos, 4));
+    buf[len + sizeof(uint32_t)] = 0xff;
+    len += pos;
+    dr_assert(dr_9p_decode_frames(frames, 4, buf, len, BUF_SIZE, &used) == 4 &&
+	      used == len);
+    // Accepted frames decode without the checks
+    {
+      uint32_t msize;
+      struct dr_str v;
+      dr_9p_decode_valid_Tversion(&msize, &v, buf + frames[0].pos, frames[0].size, &pos);
+      dr_assert(pos == tversion_size && msize == BUF_SIZE && v.len == version.len && memcmp(v.buf, version.buf, v.len) == 0);
+      uint32_t fid;
+      uint64_t offset;
+      uint32_t count;
+      dr_9p_decode_valid_Tread(&fid, &offset, &count, buf + frames[1].pos, frames[1].size, &pos);
+      dr_assert(pos == frames[1].size && fid == 3 && offset == 0 && count == 4096);
+    }
+    // A string longer or shorter than the message fails the whole batch
+    buf[HEADER_OFFSET + sizeof(uint32_t)] = sizeof(version_buf) + 1;
+    dr_assert(dr_9p_decode_frames(frames, 4, buf, len, BUF_SIZE, &used) == FAIL_UINT32);
+    buf[HEADER_OFFSET + sizeof(uint32_t)] = sizeof(version_buf) - 1;
+    dr_assert(dr_9p_decode_frames(frames, 4, buf, len, BUF_SIZE, &used) == FAIL_UINT32);
+    buf[HEADER_OFFSET + sizeof(uint32_t)] = sizeof(version_buf);
+    // Sizes smaller than a header or larger than the buffer fail, even before the message is complete
+    dr_encode_uint32(buf + tversion_size, HEADER_OFFSET - 1);
+    dr_assert(dr_9p_decode_frames(frames, 4, buf, len, BUF_SIZE, &used) == FAIL_UINT32);
+    dr_encode_uint32(buf + tversion_size, len - tversion_size);
+    dr_assert(dr_9p_decode_frames(frames, 4, buf, len, len - tversion_size - 1, &used) == FAIL_UINT32);
+    dr_encode_uint32(buf + tversion_size, BUF_SIZE + 1);
+    dr_assert(dr_9p_decode_frames(frames, 4, buf, len, BUF_SIZE, &used) == FAIL_UINT32);
+  }
   printf("OK\n");
   return 0;
 }
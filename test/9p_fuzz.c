@@ -1,310 +1,390 @@
 // SPDX-License-Identifier: GPL-2.0-only
 // Copyright (c) 2018 Drew Richardson <drewrichardson@gmail.com>
 
+/*
+ * Fuzz target for the 9p codecs. LLVMFuzzerTestOneInput decodes every
+ * message in the input, re-encodes whatever decoded and checks that the
+ * result decodes to the same fields. Build with -DDR_LIBFUZZER and
+ * -fsanitize=fuzzer to use libFuzzer's driver. Otherwise main replays the
+ * size prefixed messages read from stdin, each as one input, optionally
+ * several times over to measure throughput, and loops under AFL's persistent
+ * mode when built with afl-clang-fast. Inputs that once failed are kept in
+ * test/9p_fuzz_corpus and replayed by make check.
+ */
+
 #include "dr.h"
 
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #define DR_9P_BUF_SIZE (1<<13)
+#define STREAM_SIZE (1<<20)
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+static uint8_t out[DR_9P_BUF_SIZE];
 
-static void check_str(struct dr_str *restrict const str) {
-  memset(str->buf, 0, str->len);
+static bool same_str(const struct dr_str *restrict const a, const struct dr_str *restrict const b) {
+  return a->len == b->len && memcmp(a->buf, b->buf, a->len) == 0;
 }
 
-static void check_stat(struct dr_9p_stat *restrict const stat) {
-  check_str(&stat->name);
-  check_str(&stat->uid);
-  check_str(&stat->gid);
-  check_str(&stat->muid);
+static bool same_qid(const struct dr_9p_qid *restrict const a, const struct dr_9p_qid *restrict const b) {
+  // The path is encoded from the struct dr_file pointer, so it can not round trip
+  return a->type == b->type && a->vers == b->vers;
 }
 
-int main(void) {
-  {
-    const struct dr_result_void r = dr_console_startup();
-    DR_IF_RESULT_ERR(r, err) {
-      dr_log_error("dr_console_startup failed", err);
-      return -1;
-    } DR_FI_RESULT;
-  }
-  uint8_t buf[DR_9P_BUF_SIZE];
-  size_t bytes;
-  {
-    const struct dr_result_size r = dr_read(dr_stdin, buf, sizeof(buf));
-    DR_IF_RESULT_ERR(r, err) {
-      dr_log_error("dr_read failed", err);
-      return -1;
-    } DR_ELIF_RESULT_OK(size_t, r, value) {
-      bytes = value;
-    } DR_FI_RESULT;
-  }
-  if (dr_unlikely(bytes == 0)) {
-    dr_log("nothing read");
-    return -1;
-  }
-  if (dr_unlikely(bytes < sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint16_t))) {
-    dr_log("Short read");
-    return -1;
+static bool same_stat(const struct dr_9p_stat *restrict const a, const struct dr_9p_stat *restrict const b) {
+  return a->type == b->type && a->dev == b->dev && same_qid(&a->qid, &b->qid) && a->qid.path == b->qid.path && a->mode == b->mode && a->atime == b->atime && a->mtime == b->mtime && a->length == b->length && same_str(&a->name, &b->name) && same_str(&a->uid, &b->uid) && same_str(&a->gid, &b->gid) && same_str(&a->muid, &b->muid);
+}
+
+// Encoders take the struct dr_file a qid describes
+static const struct dr_file *file_of_qid(struct dr_file *restrict const f, const struct dr_9p_qid *restrict const qid) {
+  memset(f, 0, sizeof(*f));
+  f->mode = (uint32_t)qid->type << 24;
+  f->vers = qid->vers;
+  return f;
+}
+
+#define FUZZ_LOCAL_0(KIND, FIELD) DR_9P_TYPE_##KIND FIELD##_0;
+#define FUZZ_LOCAL_1_QID(FIELD) struct dr_9p_qid FIELD##_1; struct dr_file FIELD##_file;
+#define FUZZ_LOCAL_1_U8(FIELD) uint8_t FIELD##_1;
+#define FUZZ_LOCAL_1_U16(FIELD) uint16_t FIELD##_1;
+#define FUZZ_LOCAL_1_U32(FIELD) uint32_t FIELD##_1;
+#define FUZZ_LOCAL_1_U64(FIELD) uint64_t FIELD##_1;
+#define FUZZ_LOCAL_1_STR(FIELD) struct dr_str FIELD##_1;
+#define FUZZ_LOCAL_1(KIND, FIELD) FUZZ_LOCAL_1_##KIND(FIELD)
+
+#define FUZZ_DECODE_0(KIND, FIELD) &FIELD##_0,
+#define FUZZ_DECODE_1(KIND, FIELD) &FIELD##_1,
+
+#define FUZZ_ENCODE_U8(FIELD) , FIELD##_0
+#define FUZZ_ENCODE_U16(FIELD) , FIELD##_0
+#define FUZZ_ENCODE_U32(FIELD) , FIELD##_0
+#define FUZZ_ENCODE_U64(FIELD) , FIELD##_0
+#define FUZZ_ENCODE_STR(FIELD) , &FIELD##_0
+#define FUZZ_ENCODE_QID(FIELD) , file_of_qid(&FIELD##_file, &FIELD##_0)
+#define FUZZ_ENCODE(KIND, FIELD) FUZZ_ENCODE_##KIND(FIELD)
+
+#define FUZZ_SAME_U8(FIELD) && FIELD##_0 == FIELD##_1
+#define FUZZ_SAME_U16(FIELD) && FIELD##_0 == FIELD##_1
+#define FUZZ_SAME_U32(FIELD) && FIELD##_0 == FIELD##_1
+#define FUZZ_SAME_U64(FIELD) && FIELD##_0 == FIELD##_1
+#define FUZZ_SAME_STR(FIELD) && same_str(&FIELD##_0, &FIELD##_1)
+#define FUZZ_SAME_QID(FIELD) && same_qid(&FIELD##_0, &FIELD##_1)
+#define FUZZ_SAME(KIND, FIELD) FUZZ_SAME_##KIND(FIELD)
+
+#define FUZZ_ROUND_TRIP_BOTH(NAME) { \
+    DR_9P_FIELDS_##NAME(FUZZ_LOCAL_1) \
+    uint32_t opos; \
+    dr_assert(dr_9p_encode_##NAME(out, size, &opos, tag DR_9P_FIELDS_##NAME(FUZZ_ENCODE)) && opos == size); \
+    dr_assert(dr_9p_decode_##NAME(DR_9P_FIELDS_##NAME(FUZZ_DECODE_1) out, opos, &opos) \
+	      DR_9P_FIELDS_##NAME(FUZZ_SAME)); \
   }
-  const uint32_t size = dr_decode_uint32(buf);
-  if (dr_unlikely(bytes != size)) {
-    dr_log("Short read");
-    return -1;
+#define FUZZ_ROUND_TRIP_DEC(NAME)
+
+// Tries each schema entry of the message's type, returns whether the type is in the schema at all
+#define FUZZ_SCHEMA_ENC(NAME, TYPE)
+#define FUZZ_SCHEMA_DEC(NAME, TYPE) FUZZ_SCHEMA(DEC, NAME, TYPE)
+#define FUZZ_SCHEMA_BOTH(NAME, TYPE) FUZZ_SCHEMA(BOTH, NAME, TYPE)
+#define FUZZ_SCHEMA(DIR, NAME, TYPE) \
+  if (type == TYPE) { \
+    DR_9P_FIELDS_##NAME(FUZZ_LOCAL_0) \
+    uint32_t pos; \
+    if (dr_9p_decode_##NAME(DR_9P_FIELDS_##NAME(FUZZ_DECODE_0) buf, size, &pos)) { \
+      dr_assert(pos == size); \
+      FUZZ_ROUND_TRIP_##DIR(NAME) \
+      *decoded = true; \
+    } \
+    known = true; \
   }
+#define FUZZ_SCHEMA_ROW(DIR, NAME, TYPE) FUZZ_SCHEMA_##DIR(NAME, TYPE)
+
+static bool fuzz_schema(const uint8_t type, const uint16_t tag, const uint8_t *restrict const buf, const uint32_t size, bool *restrict const decoded) {
+  bool known = false;
+  *decoded = false;
+  DR_9P_MESSAGES(FUZZ_SCHEMA_ROW)
+  (void)tag;
+  return known;
+}
+
+// Messages written by hand
+static void fuzz_other(const uint8_t type, const uint16_t tag, const uint8_t *restrict const buf, const uint32_t size) {
   uint32_t pos;
-  uint8_t type;
-  uint16_t tag;
-  if (dr_unlikely(!dr_9p_decode_header(&type, &tag, buf, size, &pos))) {
-    dr_log("dr_9p_decode_header failed");
-    return -1;
-  }
+  uint32_t opos;
   switch (type) {
-  case DR_TVERSION: {
-    uint32_t msize;
-    struct dr_str version;
-    if (dr_unlikely(!dr_9p_decode_Tversion(&msize, &version, buf, size, &pos))) {
-      dr_log("dr_9p_decode_Tversion failed");
-      return -1;
-    }
-    check_str(&version);
-    return 0;
-  }
-  case DR_RVERSION: {
-    uint32_t msize;
-    struct dr_str version;
-    if (dr_unlikely(!dr_9p_decode_Rversion(&msize, &version, buf, size, &pos))) {
-      dr_log("dr_9p_decode_Rversion failed");
-      return -1;
-    }
-    check_str(&version);
-    return 0;
-  }
-  case DR_TAUTH: {
-    uint32_t afid;
-    struct dr_str uname;
-    struct dr_str aname;
-    if (dr_unlikely(!dr_9p_decode_Tauth(&afid, &uname, &aname, buf, size, &pos))) {
-      dr_log("dr_9p_decode_Tauth failed");
-      return -1;
-    }
-    check_str(&uname);
-    check_str(&aname);
-    return 0;
-  }
   case DR_RERROR: {
     struct dr_str ename;
-    if (dr_unlikely(!dr_9p_decode_Rerror(&ename, buf, size, &pos))) {
-      dr_log("dr_9p_decode_Rerror failed");
-      return -1;
-    }
-    check_str(&ename);
-    return 0;
-  }
-  case DR_TATTACH: {
-    uint32_t fid;
-    uint32_t afid;
-    struct dr_str uname;
-    struct dr_str aname;
-    if (dr_unlikely(!dr_9p_decode_Tattach(&fid, &afid, &uname, &aname, buf, size, &pos))) {
-      dr_log("dr_9p_decode_Tattach failed");
-      return -1;
+    if (dr_9p_decode_Rerror(&ename, buf, size, &pos)) {
+      dr_9p_encode_Rerror(out, size, &opos, tag, &ename);
+      dr_assert(opos == size && memcmp(out, buf, size) == 0);
     }
-    check_str(&uname);
-    check_str(&aname);
-    return 0;
-  }
-  case DR_RATTACH: {
-    struct dr_9p_qid qid;
-    if (dr_unlikely(!dr_9p_decode_Rattach(&qid, buf, size, &pos))) {
-      dr_log("dr_9p_decode_Rattach failed");
-      return -1;
-    }
-    return 0;
+    break;
   }
   case DR_TWALK: {
     uint32_t fid;
     uint32_t newfid;
     uint16_t nwname;
-    if (dr_unlikely(!dr_9p_decode_Twalk_iterator(&fid, &newfid, &nwname, buf, size, &pos))) {
-      dr_log("dr_9p_decode_Twalk_iterator failed");
-      return -1;
+    if (!dr_9p_decode_Twalk_iterator(&fid, &newfid, &nwname, buf, size, &pos)) {
+      break;
     }
-    for (uint_fast16_t i = 0; i < nwname; ++i) {
+    uint16_t onwname;
+    dr_assert(dr_9p_encode_Twalk_iterator(out, size, &opos, tag, fid, newfid, &onwname));
+    uint_fast16_t i = 0;
+    for (; i < nwname; ++i) {
       struct dr_str wname;
-      if (dr_unlikely(!dr_9p_decode_Twalk_advance(&wname, buf, size, &pos))) {
-	dr_log("dr_9p_decode_Twalk_advance failed");
-	return -1;
+      if (!dr_9p_decode_Twalk_advance(&wname, buf, size, &pos)) {
+	break;
       }
-      check_str(&wname);
+      dr_assert(dr_9p_encode_Twalk_add(out, size, &opos, &onwname, &wname));
     }
-    if (dr_unlikely(!dr_9p_decode_Twalk_finish(size, pos))) {
-      dr_log("dr_9p_decode_Twalk_finish failed");
-      return -1;
+    if (i == nwname && dr_9p_decode_Twalk_finish(size, pos)) {
+      dr_assert(dr_9p_encode_Twalk_finish(out, size, &opos, onwname) && opos == size && memcmp(out, buf, size) == 0);
     }
-    return 0;
+    break;
   }
   case DR_RWALK: {
     uint16_t nwqid;
-    if (dr_unlikely(!dr_9p_decode_Rwalk_iterator(&nwqid, buf, size, &pos))) {
-      dr_log("dr_9p_decode_Rwalk_iterator failed");
-      return -1;
+    if (!dr_9p_decode_Rwalk_iterator(&nwqid, buf, size, &pos)) {
+      break;
     }
-    for (uint_fast16_t i = 0; i < nwqid; ++i) {
+    uint16_t onwqid;
+    dr_assert(dr_9p_encode_Rwalk_iterator(out, size, &opos, tag, &onwqid));
+    uint_fast16_t i = 0;
+    for (; i < nwqid; ++i) {
       struct dr_9p_qid qid;
-      if (dr_unlikely(!dr_9p_decode_Rwalk_advance(&qid, buf, size, &pos))) {
-	dr_log("dr_9p_decode_Rwalk_advance failed");
-	return -1;
+      if (!dr_9p_decode_Rwalk_advance(&qid, buf, size, &pos)) {
+	break;
       }
+      struct dr_file f;
+      dr_assert(dr_9p_encode_Rwalk_add(out, size, &opos, &onwqid, file_of_qid(&f, &qid)));
     }
-    if (dr_unlikely(!dr_9p_decode_Rwalk_finish(size, pos))) {
-      dr_log("dr_9p_decode_Rwalk_finish failed");
-      return -1;
-    }
-    return 0;
-  }
-  case DR_TOPEN: {
-    uint32_t fid;
-    uint8_t mode;
-    if (dr_unlikely(!dr_9p_decode_Topen(&fid, &mode, buf, size, &pos))) {
-      dr_log("dr_9p_decode_Topen failed");
-      return -1;
-    }
-    return 0;
-  }
-  case DR_ROPEN: {
-    struct dr_9p_qid qid;
-    uint32_t iounit;
-    if (dr_unlikely(!dr_9p_decode_Ropen(&qid, &iounit, buf, size, &pos))) {
-      dr_log("dr_9p_decode_Ropen failed");
-      return -1;
-    }
-    return 0;
-  }
-  case DR_TCREATE: {
-    uint32_t fid;
-    struct dr_str name;
-    uint32_t perm;
-    uint8_t mode;
-    if (dr_unlikely(!dr_9p_decode_Tcreate(&fid, &name, &perm, &mode, buf, size, &pos))) {
-      dr_log("dr_9p_decode_Tcreate failed");
-      return -1;
-    }
-    check_str(&name);
-    return 0;
-  }
-  case DR_RCREATE: {
-    struct dr_9p_qid qid;
-    uint32_t iounit;
-    if (dr_unlikely(!dr_9p_decode_Rcreate(&qid, &iounit, buf, size, &pos))) {
-      dr_log("dr_9p_decode_Rcreate failed");
-      return -1;
-    }
-    return 0;
-  }
-  case DR_TREAD: {
-    uint32_t fid;
-    uint64_t offset;
-    uint32_t count;
-    if (dr_unlikely(!dr_9p_decode_Tread(&fid, &offset, &count, buf, size, &pos))) {
-      dr_log("dr_9p_decode_Tread failed");
-      return -1;
+    if (i == nwqid && dr_9p_decode_Rwalk_finish(size, pos)) {
+      dr_assert(dr_9p_encode_Rwalk_finish(out, size, &opos, onwqid) && opos == size);
     }
-    return 0;
+    break;
   }
   case DR_RREAD: {
     uint32_t count;
     const void *restrict data;
-    if (dr_unlikely(!dr_9p_decode_Rread(&count, &data, buf, size, &pos))) {
-      dr_log("dr_9p_decode_Rread failed");
-      return -1;
+    if (dr_9p_decode_Rread(&count, &data, buf, size, &pos)) {
+      dr_assert(dr_9p_encode_Rread_iterator(out, size, &opos, tag));
+      memcpy(out + opos, data, count);
+      dr_assert(dr_9p_encode_Rread_finish(out, size, &opos, count) && opos == size && memcmp(out, buf, size) == 0);
     }
-    memset(buf + ((intptr_t)data - (intptr_t)buf), 0, count);
-    return 0;
+    break;
   }
   case DR_TWRITE: {
     uint32_t fid;
     uint64_t offset;
     uint32_t count;
     const void *restrict data;
-    if (dr_unlikely(!dr_9p_decode_Twrite(&fid, &offset, &count, &data, buf, size, &pos))) {
-      dr_log("dr_9p_decode_Twrite failed");
-      return -1;
+    if (dr_9p_decode_Twrite(&fid, &offset, &count, &data, buf, size, &pos)) {
+      dr_assert(dr_9p_encode_Twrite_iterator(out, size, &opos, tag, fid, offset));
+      memcpy(out + opos, data, count);
+      dr_assert(dr_9p_encode_Twrite_finish(out, size, &opos, count) && opos == size && memcmp(out, buf, size) == 0);
     }
-    memset(buf + ((intptr_t)data - (intptr_t)buf), 0, count);
-    return 0;
+    break;
   }
-  case DR_RWRITE: {
-    uint32_t count;
-    if (dr_unlikely(!dr_9p_decode_Rwrite(&count, buf, size, &pos))) {
-      dr_log("dr_9p_decode_Rwrite failed");
-      return -1;
+  case DR_RCLUNK:
+    if (dr_9p_decode_Rclunk(size, &pos)) {
+      dr_assert(dr_9p_encode_Rclunk(out, size, &opos, tag) && opos == size && memcmp(out, buf, size) == 0);
     }
-    return 0;
+    break;
+  case DR_RREMOVE:
+    if (dr_9p_decode_Rremove(size, &pos)) {
+      dr_assert(dr_9p_encode_Rremove(out, size, &opos, tag) && opos == size && memcmp(out, buf, size) == 0);
+    }
+    break;
+  case DR_RSTAT: {
+    struct dr_9p_stat stat;
+    if (dr_9p_decode_Rstat(&stat, buf, size, &pos)) {
+      dr_assert(pos == size);
+    }
+    break;
   }
-  case DR_TCLUNK: {
+  case DR_TWSTAT: {
     uint32_t fid;
-    if (dr_unlikely(!dr_9p_decode_Tclunk(&fid, buf, size, &pos))) {
-      dr_log("dr_9p_decode_Tclunk failed");
-      return -1;
+    struct dr_9p_stat stat;
+    if (dr_9p_decode_Twstat(&fid, &stat, buf, size, &pos)) {
+      dr_assert(dr_9p_encode_Twstat(out, size, &opos, tag, fid, &stat) && opos == size && memcmp(out, buf, size) == 0);
+      struct dr_9p_stat ostat;
+      dr_assert(dr_9p_decode_Twstat(&fid, &ostat, out, opos, &opos) && same_stat(&stat, &ostat));
     }
-    return 0;
+    break;
   }
-  case DR_RCLUNK: {
-    if (dr_unlikely(!dr_9p_decode_Rclunk(size, &pos))) {
-      dr_log("dr_9p_decode_Rclunk failed");
-      return -1;
+  case DR_RWSTAT:
+    if (dr_9p_decode_Rwstat(size, &pos)) {
+      dr_assert(dr_9p_encode_Rwstat(out, size, &opos, tag) && opos == size && memcmp(out, buf, size) == 0);
     }
-    return 0;
+    break;
+  case DR_RLERROR: {
+    uint32_t ecode;
+    if (dr_9p_decode_Rlerror(&ecode, buf, size, &pos)) {
+      dr_9p_encode_Rlerror(out, size, &opos, tag, ecode);
+      dr_assert(opos == size && memcmp(out, buf, size) == 0);
+    }
+    break;
   }
-  case DR_TREMOVE: {
+  case DR_TFSYNC: {
     uint32_t fid;
-    if (dr_unlikely(!dr_9p_decode_Tremove(&fid, buf, size, &pos))) {
-      dr_log("dr_9p_decode_Tremove failed");
-      return -1;
+    uint32_t datasync;
+    if (dr_9p_decode_Tfsync(&fid, &datasync, buf, size, &pos)) {
+      dr_assert(pos == size);
     }
-    return 0;
+    break;
   }
-  case DR_RREMOVE: {
-    if (dr_unlikely(!dr_9p_decode_Rremove(size, &pos))) {
-      dr_log("dr_9p_decode_Rremove failed");
-      return -1;
+  case DR_TLOCK: {
+    uint32_t fid;
+    struct dr_9p_flock flock;
+    if (dr_9p_decode_Tlock(&fid, &flock, buf, size, &pos)) {
+      dr_assert(pos == size && flock.client_id.buf + flock.client_id.len == (const char *)buf + size);
     }
-    return 0;
+    break;
   }
-  case DR_TSTAT: {
+  case DR_TGETLOCK: {
     uint32_t fid;
-    if (dr_unlikely(!dr_9p_decode_Tstat(&fid, buf, size, &pos))) {
-      dr_log("dr_9p_decode_Tstat failed");
-      return -1;
+    struct dr_9p_flock flock;
+    if (dr_9p_decode_Tgetlock(&fid, &flock, buf, size, &pos)) {
+      dr_assert(pos == size && flock.client_id.buf + flock.client_id.len == (const char *)buf + size);
     }
+    break;
+  }
+  }
+}
+
+static void fuzz_message(const uint8_t *restrict const buf, const uint32_t size) {
+  {
+    char desc[128];
+    const size_t len = dr_9p_format(desc, sizeof(desc), buf, size);
+    dr_assert(len < sizeof(desc) && desc[len] == '\0');
+  }
+  uint32_t pos;
+  uint8_t type;
+  uint16_t tag;
+  // Larger messages are refused before they are decoded
+  if (!dr_9p_decode_header(&type, &tag, buf, size, &pos) || size > sizeof(out)) {
+    return;
+  }
+  bool decoded;
+  const bool known = fuzz_schema(type, tag, buf, size, &decoded);
+  // Batch validation must agree with the message decoders, but it takes the length from the size prefix and they take it from size
+  if (known && dr_decode_uint32(buf) == size) {
+    struct dr_9p_frame frame;
+    uint32_t used;
+    const uint32_t count = dr_9p_decode_frames(&frame, 1, buf, size, DR_9P_BUF_SIZE, &used);
+    dr_assert((count == 1) == decoded);
+  }
+  fuzz_other(type, tag, buf, size);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  if (size > STREAM_SIZE) {
     return 0;
   }
-  case DR_RSTAT: {
-    struct dr_9p_stat stat;
-    if (dr_unlikely(!dr_9p_decode_Rstat(&stat, buf, size, &pos))) {
-      dr_log("dr_9p_decode_Rstat failed");
-      return -1;
+  // An exact copy so reads past the end are caught by the sanitizers
+  uint8_t *restrict const buf = (uint8_t *)malloc(size == 0 ? 1 : size);
+  dr_assert(buf != NULL);
+  memcpy(buf, data, size);
+  {
+    struct dr_9p_frame frames[16];
+    uint32_t used;
+    const uint32_t count = dr_9p_decode_frames(frames, sizeof(frames)/sizeof(frames[0]), buf, size, DR_9P_BUF_SIZE, &used);
+    dr_assert(count == FAIL_UINT32 || (count <= sizeof(frames)/sizeof(frames[0]) && used <= size));
+  }
+  // Each size prefix starts another message, anything left over is tried as one
+  uint32_t pos = 0;
+  while (size - pos >= sizeof(uint32_t)) {
+    const uint32_t msize = dr_decode_uint32(buf + pos);
+    if (msize < sizeof(uint32_t) || msize > size - pos) {
+      break;
     }
-    check_stat(&stat);
-    return 0;
+    fuzz_message(buf + pos, msize);
+    pos += msize;
   }
-  case DR_TWSTAT: {
-    uint32_t fid;
-    struct dr_9p_stat stat;
-    if (dr_unlikely(!dr_9p_decode_Twstat(&fid, &stat, buf, size, &pos))) {
-      dr_log("dr_9p_decode_Twstat failed");
-      return -1;
+  if (pos < size) {
+    fuzz_message(buf + pos, size - pos);
+  }
+  free(buf);
+  return 0;
+}
+
+#if !defined(DR_LIBFUZZER)
+
+static uint8_t stream[STREAM_SIZE];
+
+WARN_UNUSED_RESULT static uint32_t read_stream(void) {
+  uint32_t len = 0;
+  while (len < sizeof(stream)) {
+    const struct dr_result_size r = dr_read(dr_stdin, stream + len, sizeof(stream) - len);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_read failed", err);
+      exit(-1);
+    } DR_ELIF_RESULT_OK(size_t, r, value) {
+      if (value == 0) {
+	return len;
+      }
+      len += value;
+    } DR_FI_RESULT;
+  }
+  return len;
+}
+
+// Runs each message in the stream as its own input and returns how many there were
+static unsigned long replay(const uint32_t len) {
+  unsigned long inputs = 0;
+  uint32_t pos = 0;
+  while (pos < len) {
+    uint32_t msize = len - pos;
+    if (msize >= sizeof(uint32_t)) {
+      const uint32_t prefix = dr_decode_uint32(stream + pos);
+      if (prefix >= sizeof(uint32_t) && prefix < msize) {
+	msize = prefix;
+      }
     }
-    return 0;
+    LLVMFuzzerTestOneInput(stream + pos, msize);
+    ++inputs;
+    pos += msize;
+  }
+  return inputs;
+}
+
+int main(int argc, char *argv[]) {
+  {
+    const struct dr_result_void r = dr_console_startup();
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_console_startup failed", err);
+      return -1;
+    } DR_FI_RESULT;
+  }
+#if defined(__AFL_LOOP)
+  (void)argc;
+  (void)argv;
+  while (__AFL_LOOP(10000)) {
+    replay(read_stream());
   }
-  case DR_RWSTAT: {
-    if (dr_unlikely(!dr_9p_decode_Rwstat(size, &pos))) {
-      dr_log("dr_9p_decode_Rwstat failed");
+#else
+  unsigned long passes = 1;
+  if (argc > 1) {
+    char *end;
+    passes = strtoul(argv[1], &end, 10);
+    if (argc > 2 || *argv[1] == '\0' || *end != '\0' || passes == 0) {
+      fprintf(stderr, "usage: %s [passes] < messages\n", argv[0]);
       return -1;
     }
-    return 0;
   }
-  default:
-    dr_log("Unrecognized message");
-    return -1;
+  const uint32_t len = read_stream();
+  const int64_t start = dr_monotonic_ns();
+  unsigned long inputs = 0;
+  for (unsigned long i = 0; i < passes; ++i) {
+    inputs += replay(len);
   }
+  const int64_t elapsed = dr_monotonic_ns() - start;
+  if (passes > 1) {
+    fprintf(stderr, "%lu inputs, %.0f inputs/s\n", inputs, (double)inputs*DR_NS_PER_S/elapsed);
+  }
+#endif
+  return 0;
 }
+
+#endif
@@ -0,0 +1,301 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// Copyright (c) 2018 Drew Richardson <drewrichardson@gmail.com>
+
+#include "dr.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+static char user_name[] = {'u','s','e','r'};
+
+static struct dr_group group;
+
+static struct dr_user user = {
+  .name.len = sizeof(user_name),
+  .name.buf = user_name,
+  .group_count = 1,
+  .groups = { &group },
+};
+
+#define BACKING_SIZE (4*DR_VFS_CACHE_SIZE)
+
+static uint8_t backing[BACKING_SIZE];
+static unsigned int reads;
+static unsigned int writes;
+static bool fail_writes;
+
+static struct dr_result_uint32 backing_read(const struct dr_fd *restrict const fd, const uint64_t offset, const uint32_t count, void *restrict const buf) {
+  (void)fd;
+  ++reads;
+  if (offset >= sizeof(backing)) {
+    return DR_RESULT_OK(uint32, 0);
+  }
+  const uint32_t bytes = offset + count <= sizeof(backing) ? count : sizeof(backing) - offset;
+  memcpy(buf, backing + offset, bytes);
+  return DR_RESULT_OK(uint32, bytes);
+}
+
+static struct dr_result_uint32 backing_write(const struct dr_fd *restrict const fd, const uint64_t offset, const uint32_t count, const void *restrict const buf) {
+  ++writes;
+  if (fail_writes) {
+    return DR_RESULT_ERRNUM(uint32, DR_ERR_ISO_C, ENOSPC);
+  }
+  dr_assert(offset + count <= sizeof(backing));
+  memcpy(backing + offset, buf, count);
+  ++fd->file->vers;
+  return DR_RESULT_OK(uint32, count);
+}
+
+static struct dr_file_vtbl backing_vtbl = {
+  .read = backing_read,
+  .write = backing_write,
+  .flags = DR_VFS_READAHEAD | DR_VFS_WRITEBEHIND,
+};
+
+static struct dr_file file = {
+  .mode = 0600,
+  .length = BACKING_SIZE,
+  .uid = &user,
+  .gid = &group,
+  .muid = &user,
+  .vtbl = &backing_vtbl,
+};
+
+static struct dr_fd *open_file(const uint8_t mode) {
+  struct dr_fd *restrict fd = NULL;
+  const struct dr_result_fd r = dr_vfs_open(&user, &file, mode);
+  DR_IF_RESULT_ERR(r, err) {
+    dr_log_error("dr_vfs_open failed", err);
+    dr_assert(false);
+  } DR_ELIF_RESULT_OK(struct dr_fd *restrict, r, value) {
+    fd = value;
+  } DR_FI_RESULT;
+  return fd;
+}
+
+static uint32_t read_file(struct dr_fd *restrict const fd, const uint64_t offset, const uint32_t count, void *restrict const buf) {
+  uint32_t bytes = 0;
+  const struct dr_result_uint32 r = dr_vfs_read(fd, offset, count, buf);
+  DR_IF_RESULT_ERR(r, err) {
+    dr_log_error("dr_vfs_read failed", err);
+    dr_assert(false);
+  } DR_ELIF_RESULT_OK(uint32_t, r, value) {
+    bytes = value;
+  } DR_FI_RESULT;
+  return bytes;
+}
+
+static void write_file(struct dr_fd *restrict const fd, const uint64_t offset, const uint32_t count, const void *restrict const buf) {
+  const struct dr_result_uint32 r = dr_vfs_write(fd, offset, count, buf);
+  DR_IF_RESULT_ERR(r, err) {
+    dr_log_error("dr_vfs_write failed", err);
+    dr_assert(false);
+  } DR_ELIF_RESULT_OK(uint32_t, r, value) {
+    dr_assert(value == count);
+  } DR_FI_RESULT;
+}
+
+int main(void) {
+  for (uint32_t i = 0; i < sizeof(backing); ++i) {
+    backing[i] = (uint8_t)(i*7);
+  }
+
+  // Sequential reads are served from the read ahead window
+  {
+    struct dr_fd *restrict const fd = open_file(DR_OREAD);
+    uint8_t buf[4096];
+    uint64_t offset = 0;
+    for (;;) {
+      const uint32_t bytes = read_file(fd, offset, sizeof(buf), buf);
+      if (bytes == 0) {
+	break;
+      }
+      dr_assert(memcmp(buf, backing + offset, bytes) == 0);
+      offset += bytes;
+      dr_vfs_prefetch(fd);
+    }
+    dr_assert(offset == sizeof(backing));
+    // One direct read, one fill per window, an empty fill at EOF and the final read
+    dr_assert(reads == 1 + sizeof(backing)/DR_VFS_CACHE_SIZE + 2);
+    dr_vfs_close(fd);
+  }
+
+  // Random reads go to the backend
+  {
+    struct dr_fd *restrict const fd = open_file(DR_OREAD);
+    uint8_t buf[100];
+    reads = 0;
+    for (uint64_t offset = sizeof(backing) - sizeof(buf); offset > 0; offset /= 2) {
+      dr_assert(read_file(fd, offset, sizeof(buf), buf) == sizeof(buf));
+      dr_assert(memcmp(buf, backing + offset, sizeof(buf)) == 0);
+      dr_vfs_prefetch(fd);
+    }
+    dr_assert(reads == 18);
+    dr_vfs_close(fd);
+  }
+
+  // Small sequential writes are coalesced
+  {
+    struct dr_fd *restrict const fd = open_file(DR_ORDWR);
+    uint8_t buf[1000];
+    memset(buf, 0xa5, sizeof(buf));
+    writes = 0;
+    for (uint32_t i = 0; i < 100; ++i) {
+      write_file(fd, i*sizeof(buf), sizeof(buf), buf);
+    }
+    // 65 writes fit in the first window
+    dr_assert(writes == 1);
+    dr_assert(backing[0] == 0xa5 && backing[65*sizeof(buf) - 1] == 0xa5 && backing[65*sizeof(buf)] != 0xa5);
+    // Reads see the buffered data
+    uint8_t rbuf[sizeof(buf)];
+    dr_assert(read_file(fd, 99*sizeof(buf), sizeof(rbuf), rbuf) == sizeof(rbuf));
+    dr_assert(memcmp(rbuf, buf, sizeof(buf)) == 0);
+    dr_assert(writes == 2);
+    {
+      const struct dr_result_void r = dr_vfs_flush(fd);
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_vfs_flush failed", err);
+	dr_assert(false);
+      } DR_FI_RESULT;
+    }
+    dr_assert(writes == 2);
+
+    // Non sequential writes flush
+    write_file(fd, 0, 10, buf);
+    dr_assert(writes == 3);
+    write_file(fd, 10, 10, buf);
+    dr_assert(writes == 3);
+    write_file(fd, 100, 10, buf);
+    dr_assert(writes == 5);
+    write_file(fd, 110, 10, buf);
+    dr_assert(writes == 5);
+    dr_vfs_close(fd);
+    dr_assert(writes == 6);
+  }
+
+  // Read ahead data is dropped when the file changes
+  {
+    struct dr_fd *restrict const r = open_file(DR_OREAD);
+    struct dr_fd *restrict const w = open_file(DR_OWRITE);
+    uint8_t buf[16];
+    dr_assert(read_file(r, 0, sizeof(buf), buf) == sizeof(buf));
+    dr_vfs_prefetch(r);
+    memset(buf, 0x5a, sizeof(buf));
+    write_file(w, sizeof(buf), sizeof(buf), buf);
+    {
+      const struct dr_result_void res = dr_vfs_flush(w);
+      DR_IF_RESULT_ERR(res, err) {
+	dr_log_error("dr_vfs_flush failed", err);
+	dr_assert(false);
+      } DR_FI_RESULT;
+    }
+    memset(buf, 0, sizeof(buf));
+    dr_assert(read_file(r, sizeof(buf), sizeof(buf), buf) == sizeof(buf));
+    dr_assert(buf[0] == 0x5a && buf[sizeof(buf) - 1] == 0x5a);
+    dr_vfs_close(w);
+    dr_vfs_close(r);
+  }
+
+  // Buffered writes only show up in the length and version once they are flushed
+  {
+    struct dr_fd *restrict const fd = open_file(DR_OWRITE);
+    uint8_t buf[100];
+    memset(buf, 0x3c, sizeof(buf));
+    file.length = 50;
+    writes = 0;
+    uint32_t vers = file.vers;
+    write_file(fd, 0, sizeof(buf), buf);
+    write_file(fd, sizeof(buf), sizeof(buf), buf);
+    dr_assert(writes == 0);
+    dr_assert(file.length == 50);
+    dr_assert(file.vers == vers);
+    {
+      const struct dr_result_void r = dr_vfs_flush(fd);
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_vfs_flush failed", err);
+	dr_assert(false);
+      } DR_FI_RESULT;
+    }
+    dr_assert(writes == 1);
+    dr_assert(file.length == 2*sizeof(buf));
+    dr_assert(file.vers != vers);
+    // Appends are not buffered
+    file.mode |= DR_APPEND;
+    vers = file.vers;
+    write_file(fd, 2*sizeof(buf), sizeof(buf), buf);
+    dr_assert(writes == 2);
+    dr_assert(file.vers != vers);
+    file.mode &= ~DR_APPEND;
+    dr_vfs_close(fd);
+    file.length = BACKING_SIZE;
+  }
+
+  // Errors from buffered writes are reported by flush
+  {
+    struct dr_fd *restrict const fd = open_file(DR_OWRITE);
+    uint8_t buf[16] = { 0 };
+    write_file(fd, 0, sizeof(buf), buf);
+    fail_writes = true;
+    {
+      const struct dr_result_void r = dr_vfs_flush(fd);
+      DR_IF_RESULT_ERR(r, err) {
+	dr_assert(err->domain == DR_ERR_ISO_C && err->num == ENOSPC);
+      } DR_ELIF_RESULT_OK_VOID(r) {
+	dr_assert(false);
+      } DR_FI_RESULT;
+    }
+    fail_writes = false;
+    dr_vfs_close(fd);
+  }
+
+  // A write behind that fails on a read is reported once by the next flush
+  {
+    struct dr_fd *restrict const fd = open_file(DR_ORDWR);
+    uint8_t buf[16] = { 0 };
+    file.length = 0;
+    const uint32_t vers = file.vers;
+    write_file(fd, 0, sizeof(buf), buf);
+    fail_writes = true;
+    dr_assert(read_file(fd, 0, sizeof(buf), buf) == sizeof(buf));
+    fail_writes = false;
+    dr_assert(file.length == 0 && file.vers == vers);
+    {
+      const struct dr_result_void r = dr_vfs_flush(fd);
+      DR_IF_RESULT_ERR(r, err) {
+	dr_assert(err->domain == DR_ERR_ISO_C && err->num == ENOSPC);
+      } DR_ELIF_RESULT_OK_VOID(r) {
+	dr_assert(false);
+      } DR_FI_RESULT;
+    }
+    {
+      const struct dr_result_void r = dr_vfs_flush(fd);
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_vfs_flush failed", err);
+	dr_assert(false);
+      } DR_FI_RESULT;
+    }
+
+    // And by the next write
+    write_file(fd, sizeof(buf), sizeof(buf), buf);
+    fail_writes = true;
+    dr_assert(read_file(fd, sizeof(buf), sizeof(buf), buf) == sizeof(buf));
+    fail_writes = false;
+    {
+      const struct dr_result_uint32 r = dr_vfs_write(fd, 2*sizeof(buf), sizeof(buf), buf);
+      DR_IF_RESULT_ERR(r, err) {
+	dr_assert(err->domain == DR_ERR_ISO_C && err->num == ENOSPC);
+      } DR_ELIF_RESULT_OK(uint32_t, r, value) {
+	(void)value;
+	dr_assert(false);
+      } DR_FI_RESULT;
+    }
+    write_file(fd, 2*sizeof(buf), sizeof(buf), buf);
+    dr_vfs_close(fd);
+    file.length = BACKING_SIZE;
+  }
+
+  printf("OK\n");
+
+  return 0;
+}
@@ -0,0 +1,203 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// Copyright (c) 2018 Drew Richardson <drewrichardson@gmail.com>
+
+#include "dr.h"
+
+#include <errno.h>
+#include <stdio.h>
+
+#define STACK_SIZE (1<<16)
+#define CAPACITY 8
+#define PRODUCERS 3
+#define CONSUMERS 2
+#define MESSAGES 1000
+
+struct message {
+  uint32_t producer;
+  uint32_t seq;
+};
+
+static struct dr_chan chan;
+static struct dr_task tasks[PRODUCERS + CONSUMERS];
+static unsigned int finished;
+static uint32_t next_seq[PRODUCERS];
+static unsigned int received;
+
+static void check_errnum(const struct dr_result_void r, const int errnum) {
+  bool matches = false;
+  DR_IF_RESULT_ERR(r, err) {
+    matches = err->domain == DR_ERR_ISO_C && err->num == errnum;
+  } DR_FI_RESULT;
+  dr_assert(matches);
+}
+
+static void producer_func(void *restrict const arg) {
+  const uint32_t producer = *(const uint32_t *)arg;
+  for (uint32_t seq = 0; seq < MESSAGES;) {
+    // Alternate single sends with batches that wrap the ring
+    if (seq % 2 == 0) {
+      const struct message m = {
+	.producer = producer,
+	.seq = seq,
+      };
+      const struct dr_result_void r = dr_chan_send(&chan, &m);
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_chan_send failed", err);
+	dr_assert(false);
+      } DR_FI_RESULT;
+      ++seq;
+    } else {
+      struct message batch[5];
+      const unsigned int count = MESSAGES - seq < 5 ? MESSAGES - seq : 5;
+      for (unsigned int i = 0; i < count; ++i) {
+	batch[i] = (struct message) {
+	  .producer = producer,
+	  .seq = seq + i,
+	};
+      }
+      const struct dr_result_uint r = dr_chan_send_batch(&chan, batch, count);
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_chan_send_batch failed", err);
+	dr_assert(false);
+      } DR_ELIF_RESULT_OK(unsigned int, r, value) {
+	dr_assert(value > 0 && value <= count);
+	seq += value;
+      } DR_FI_RESULT;
+    }
+  }
+  ++finished;
+}
+
+// Messages from one producer arrive in order even when split across consumers
+static void consumer_func(void *restrict const arg) {
+  (void)arg;
+  while (true) {
+    struct message batch[3];
+    unsigned int count = 0;
+    {
+      const struct dr_result_uint r = dr_chan_recv_batch(&chan, batch, sizeof(batch)/sizeof(batch[0]));
+      DR_IF_RESULT_ERR(r, err) {
+	dr_assert(err->domain == DR_ERR_ISO_C && err->num == EPIPE);
+	break;
+      } DR_ELIF_RESULT_OK(unsigned int, r, value) {
+	count = value;
+      } DR_FI_RESULT;
+    }
+    dr_assert(count > 0);
+    for (unsigned int i = 0; i < count; ++i) {
+      dr_assert(batch[i].producer < PRODUCERS);
+      dr_assert(batch[i].seq == next_seq[batch[i].producer]);
+      ++next_seq[batch[i].producer];
+    }
+    received += count;
+  }
+  ++finished;
+}
+
+int main(void) {
+  {
+    const struct dr_result_void r = dr_chan_init(&chan, sizeof(struct message), CAPACITY);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_chan_init failed", err);
+      return -1;
+    } DR_FI_RESULT;
+  }
+  {
+    struct dr_chan bad;
+    check_errnum(dr_chan_init(&bad, sizeof(struct message), CAPACITY + 1), EINVAL);
+  }
+
+  // The try variants never wait
+  {
+    struct message m = {
+      .seq = 0,
+    };
+    check_errnum(dr_chan_try_recv(&chan, &m), EAGAIN);
+    for (unsigned int i = 0; i < CAPACITY; ++i) {
+      m.seq = i;
+      const struct dr_result_void r = dr_chan_try_send(&chan, &m);
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_chan_try_send failed", err);
+	return -1;
+      } DR_FI_RESULT;
+    }
+    check_errnum(dr_chan_try_send(&chan, &m), EAGAIN);
+    for (unsigned int i = 0; i < CAPACITY; ++i) {
+      const struct dr_result_void r = dr_chan_try_recv(&chan, &m);
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_chan_try_recv failed", err);
+	return -1;
+      } DR_FI_RESULT;
+      dr_assert(m.seq == i);
+    }
+    check_errnum(dr_chan_try_recv(&chan, &m), EAGAIN);
+  }
+
+  // Producers and consumers block on the small ring in turn
+  {
+    static uint32_t args[PRODUCERS];
+    for (uint32_t i = 0; i < PRODUCERS + CONSUMERS; ++i) {
+      if (i < PRODUCERS) {
+	args[i] = i;
+      }
+      const struct dr_result_void r = dr_task_create(&tasks[i], STACK_SIZE, i < PRODUCERS ? producer_func : consumer_func, i < PRODUCERS ? &args[i] : NULL);
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_task_create failed", err);
+	return -1;
+      } DR_FI_RESULT;
+    }
+    while (finished < PRODUCERS) {
+      dr_schedule(false);
+    }
+    // Closing wakes the consumers once the ring is drained
+    dr_chan_close(&chan);
+    while (finished < PRODUCERS + CONSUMERS) {
+      dr_schedule(false);
+    }
+    dr_assert(received == PRODUCERS*MESSAGES);
+    for (unsigned int i = 0; i < PRODUCERS; ++i) {
+      dr_assert(next_seq[i] == MESSAGES);
+    }
+    for (unsigned int i = 0; i < PRODUCERS + CONSUMERS; ++i) {
+      dr_task_destroy(&tasks[i]);
+    }
+  }
+
+  // Elements sent before the close are still received
+  dr_chan_destroy(&chan);
+  {
+    const struct dr_result_void r = dr_chan_init(&chan, sizeof(uint32_t), 4);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_chan_init failed", err);
+      return -1;
+    } DR_FI_RESULT;
+  }
+  {
+    uint32_t value = 7;
+    {
+      const struct dr_result_void r = dr_chan_send(&chan, &value);
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_chan_send failed", err);
+	return -1;
+      } DR_FI_RESULT;
+    }
+    dr_chan_close(&chan);
+    check_errnum(dr_chan_send(&chan, &value), EPIPE);
+    check_errnum(dr_chan_try_send(&chan, &value), EPIPE);
+    value = 0;
+    {
+      const struct dr_result_void r = dr_chan_recv(&chan, &value);
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_chan_recv failed", err);
+	return -1;
+      } DR_FI_RESULT;
+    }
+    dr_assert(value == 7);
+    check_errnum(dr_chan_recv(&chan, &value), EPIPE);
+    check_errnum(dr_chan_try_recv(&chan, &value), EPIPE);
+  }
+  dr_chan_destroy(&chan);
+
+  printf("OK\n");
+  return 0;
+}
@@ -49,6 +49,8 @@ int main(int argc, char *argv[]) {
     } DR_FI_RESULT;
   }
 
+  // This client blocks on stdin and the socket in turn and runs no equeue or tasks, which dr_equeue_connect needs.
+  // check_server_client starts the server alongside it, so a refused connect is retried briefly
   dr_handle_t cfd;
   for (int i = 0;; ++i) {
     const struct dr_result_handle r = dr_sock_connect("localhost", port, DR_CLOEXEC);
@@ -0,0 +1,243 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// Copyright (c) 2018 Drew Richardson <drewrichardson@gmail.com>
+
+#include "dr.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BUF_SIZE (1<<10)
+#define ITERATIONS 1000000
+#define STAT_RECORDS 100000
+#define STAT_PASSES 10
+#define DIR_ENTRIES 1000
+#define DIR_PASSES 1000
+#define TRACE_RECORDS (1<<16)
+#define TRACE_PASSES 100
+
+static char user_name[] = {'u','s','e','r'};
+static char file_name[] = {'w','o','r','l','d'};
+static char walk0[] = {'u','s','r'};
+static char walk1[] = {'s','h','a','r','e'};
+static char walk2[] = {'d','o','c'};
+
+static struct dr_group group = {
+  .name.len = sizeof(user_name),
+  .name.buf = user_name,
+};
+
+static struct dr_user user = {
+  .name.len = sizeof(user_name),
+  .name.buf = user_name,
+  .group_count = 1,
+  .groups = { &group },
+};
+
+static struct dr_file file = {
+  .vers = 7,
+  .mode = 0644,
+  .atime = 1511944580,
+  .mtime = 1511944580,
+  .length = 4096,
+  .name.len = sizeof(file_name),
+  .name.buf = file_name,
+  .uid = &user,
+  .gid = &group,
+  .muid = &user,
+};
+
+static const struct dr_str walk_names[] = {
+  { .buf = walk0, .len = sizeof(walk0) },
+  { .buf = walk1, .len = sizeof(walk1) },
+  { .buf = walk2, .len = sizeof(walk2) },
+};
+
+static uint8_t tread[BUF_SIZE];
+static uint32_t tread_size;
+static uint8_t twalk[BUF_SIZE];
+static uint32_t twalk_size;
+static uint8_t rstat[BUF_SIZE];
+static uint32_t rstat_size;
+
+// Encodes a Tread, a Twalk of three names and an Rstat
+static void encode(const uint32_t i) {
+  uint16_t nwname;
+  dr_assert(dr_9p_encode_Tread(tread, sizeof(tread), &tread_size, i, i, (uint64_t)i << 12, 4096));
+  dr_assert(dr_9p_encode_Twalk_iterator(twalk, sizeof(twalk), &twalk_size, i, 0, i, &nwname));
+  for (size_t j = 0; j < sizeof(walk_names)/sizeof(walk_names[0]); ++j) {
+    dr_assert(dr_9p_encode_Twalk_add(twalk, sizeof(twalk), &twalk_size, &nwname, &walk_names[j]));
+  }
+  dr_assert(dr_9p_encode_Twalk_finish(twalk, sizeof(twalk), &twalk_size, nwname));
+  dr_assert(dr_9p_encode_Rstat(rstat, sizeof(rstat), &rstat_size, i, &file));
+}
+
+// Decodes the messages from encode and returns a value that depends on all of them
+WARN_UNUSED_RESULT static uint64_t decode(void) {
+  uint64_t sum = 0;
+  uint8_t type;
+  uint16_t tag;
+  uint32_t pos;
+  {
+    uint32_t fid;
+    uint64_t offset;
+    uint32_t count;
+    dr_assert(dr_9p_decode_header(&type, &tag, tread, tread_size, &pos));
+    dr_assert(dr_9p_decode_Tread(&fid, &offset, &count, tread, tread_size, &pos));
+    sum += tag + fid + offset + count;
+  }
+  {
+    uint32_t fid;
+    uint32_t newfid;
+    uint16_t nwname;
+    dr_assert(dr_9p_decode_header(&type, &tag, twalk, twalk_size, &pos));
+    dr_assert(dr_9p_decode_Twalk_iterator(&fid, &newfid, &nwname, twalk, twalk_size, &pos));
+    for (uint16_t j = 0; j < nwname; ++j) {
+      struct dr_str name;
+      dr_assert(dr_9p_decode_Twalk_advance(&name, twalk, twalk_size, &pos));
+      sum += name.len;
+    }
+    dr_assert(dr_9p_decode_Twalk_finish(twalk_size, pos));
+    sum += tag + fid + newfid;
+  }
+  {
+    struct dr_9p_stat stat;
+    dr_assert(dr_9p_decode_header(&type, &tag, rstat, rstat_size, &pos));
+    dr_assert(dr_9p_decode_Rstat(&stat, rstat, rstat_size, &pos));
+    sum += tag + stat.qid.vers + stat.mode + stat.length + stat.name.len;
+  }
+  return sum;
+}
+
+// Fills a directory listing of STAT_RECORDS stats and returns its size
+WARN_UNUSED_RESULT static uint32_t encode_stats(uint8_t *restrict const buf, const uint32_t size) {
+  uint32_t len = 0;
+  for (uint32_t i = 0; i < STAT_RECORDS; ++i) {
+    uint8_t msg[BUF_SIZE];
+    uint32_t msg_size;
+    file.length = i;
+    dr_assert(dr_9p_encode_Rstat(msg, sizeof(msg), &msg_size, 0, &file));
+    // Skip the message header and the Rstat n[2]
+    const uint32_t offset = sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint16_t) + sizeof(uint16_t);
+    dr_assert(len + msg_size - offset <= size);
+    memcpy(buf + len, msg + offset, msg_size - offset);
+    len += msg_size - offset;
+  }
+  return len;
+}
+
+// Decodes a directory listing the way 9p_client ls does
+WARN_UNUSED_RESULT static uint64_t decode_stats(const uint8_t *restrict const buf, const uint32_t size) {
+  uint64_t sum = 0;
+  for (uint32_t pos = 0; pos < size;) {
+    struct dr_9p_stat stat;
+    const uint32_t read = dr_9p_decode_stat(&stat, buf + pos, size - pos);
+    dr_assert(read != FAIL_UINT32);
+    pos += read;
+    sum += stat.mode + stat.length + stat.name.len + stat.muid.len;
+  }
+  return sum;
+}
+
+// Reads a directory of DIR_ENTRIES files the way a 9P2000 client listing it does
+WARN_UNUSED_RESULT static uint64_t read_dir(struct dr_file *restrict const *restrict const entries, uint8_t *restrict const buf, const uint32_t size) {
+  uint64_t sum = 0;
+  for (uint64_t offset = 0;;) {
+    const uint32_t read = dr_dir_read_entries(buf, size, offset, entries, DIR_ENTRIES);
+    if (read == 0) {
+      break;
+    }
+    offset += read;
+    sum += read + buf[read - 1];
+  }
+  return sum;
+}
+
+int main(void) {
+  const unsigned int messages = 3;
+  {
+    const int64_t start = dr_monotonic_ns();
+    for (uint32_t i = 0; i < ITERATIONS; ++i) {
+      encode(i);
+    }
+    const int64_t elapsed = dr_monotonic_ns() - start;
+    printf("encode %6.1f ns/message\n", (double)elapsed/(ITERATIONS*messages));
+  }
+  {
+    uint64_t sum = 0;
+    const int64_t start = dr_monotonic_ns();
+    for (uint32_t i = 0; i < ITERATIONS; ++i) {
+      sum += decode();
+    }
+    const int64_t elapsed = dr_monotonic_ns() - start;
+    printf("decode %6.1f ns/message (%" PRIu64 ")\n", (double)elapsed/(ITERATIONS*messages), sum);
+  }
+  {
+    const uint32_t size = STAT_RECORDS*BUF_SIZE/8;
+    uint8_t *restrict const buf = (uint8_t *)malloc(size);
+    dr_assert(buf != NULL);
+    const uint32_t len = encode_stats(buf, size);
+    uint64_t sum = 0;
+    const int64_t start = dr_monotonic_ns();
+    for (unsigned int i = 0; i < STAT_PASSES; ++i) {
+      sum += decode_stats(buf, len);
+    }
+    const int64_t elapsed = dr_monotonic_ns() - start;
+    printf("stat   %6.1f ns/record  (%" PRIu64 ")\n", (double)elapsed/(STAT_RECORDS*STAT_PASSES), sum);
+    free(buf);
+  }
+  {
+    struct dr_file **const entries = (struct dr_file **)malloc(DIR_ENTRIES*sizeof(*entries));
+    struct dr_file *restrict const files = (struct dr_file *)calloc(DIR_ENTRIES, sizeof(*files));
+    dr_assert(entries != NULL && files != NULL);
+    for (uint32_t i = 0; i < DIR_ENTRIES; ++i) {
+      files[i] = file;
+      files[i].length = i;
+      entries[i] = &files[i];
+    }
+    uint8_t buf[8*BUF_SIZE];
+    uint64_t sum = 0;
+    const int64_t start = dr_monotonic_ns();
+    for (unsigned int i = 0; i < DIR_PASSES; ++i) {
+      sum += read_dir(entries, buf, sizeof(buf));
+    }
+    const int64_t elapsed = dr_monotonic_ns() - start;
+    printf("dir    %6.1f ns/entry   (%" PRIu64 ")\n", (double)elapsed/(DIR_ENTRIES*DIR_PASSES), sum);
+    for (uint32_t i = 0; i < DIR_ENTRIES; ++i) {
+      free(files[i].stat);
+    }
+    free(files);
+    free(entries);
+  }
+  {
+    // What 9p_server -T adds to each request
+    struct dr_trace trace;
+    {
+      const struct dr_result_void r = dr_trace_open(&trace, "build/bench.trace", TRACE_RECORDS);
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_trace_open failed", err);
+	return -1;
+      } DR_FI_RESULT;
+    }
+    const int64_t start = dr_monotonic_ns();
+    for (uint32_t i = 0; i < TRACE_RECORDS*TRACE_PASSES; ++i) {
+      const struct dr_trace_record record = {
+	.start = start + i,
+	.end = start + 2*i,
+	.offset = i,
+	.conn = i & 7,
+	.fid = i,
+	.count = 1<<12,
+	.tag = (uint16_t)i,
+	.type = DR_TREAD,
+      };
+      dr_trace_write(&trace, &record);
+    }
+    const int64_t elapsed = dr_monotonic_ns() - start;
+    printf("trace  %6.1f ns/record  (%" PRIu64 ")\n", (double)elapsed/((uint64_t)TRACE_RECORDS*TRACE_PASSES), trace.header->head);
+    dr_trace_close(&trace);
+    remove("build/bench.trace");
+  }
+  return 0;
+}
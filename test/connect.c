@@ -0,0 +1,179 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// Copyright (c) 2018 Drew Richardson <drewrichardson@gmail.com>
+
+#include "dr.h"
+
+#include <errno.h>
+#include <stdio.h>
+
+#define STACK_SIZE (1<<16)
+#define CONN_COUNT 8
+#define PORT "6003"
+// Nothing listens here
+#define CLOSED_PORT "6004"
+
+struct conn {
+  struct dr_equeue_client c;
+  struct dr_task task;
+};
+
+static struct dr_equeue equeue;
+static struct dr_equeue_server server;
+static struct dr_task server_task;
+static struct dr_task refused_task;
+static struct conn conns[CONN_COUNT];
+static unsigned int finished;
+
+static void server_func(void *restrict const arg) {
+  (void)arg;
+  dr_handle_t fds[CONN_COUNT];
+  for (unsigned int i = 0; i < CONN_COUNT; ++i) {
+    const struct dr_result_handle r = dr_equeue_accept(&equeue, &server);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_equeue_accept failed", err);
+      dr_assert(false);
+    } DR_ELIF_RESULT_OK(dr_handle_t, r, value) {
+      fds[i] = value;
+    } DR_FI_RESULT;
+  }
+  // Every client is waiting to read by now, closing wakes them with EOF
+  for (unsigned int i = 0; i < CONN_COUNT; ++i) {
+    dr_close(fds[i]);
+  }
+  ++finished;
+}
+
+static void conn_func(void *restrict const arg) {
+  struct conn *restrict const conn = (struct conn *)arg;
+  {
+    const struct dr_result_handle r = dr_equeue_connect(&equeue, "localhost", PORT);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_equeue_connect failed", err);
+      dr_assert(false);
+    } DR_ELIF_RESULT_OK(dr_handle_t, r, value) {
+      dr_equeue_client_init(&conn->c, value);
+    } DR_FI_RESULT;
+  }
+  // The socket is no longer watched for the connect, so the client can subscribe to it
+  {
+    char buf[1];
+    const struct dr_result_size r = dr_equeue_read(&equeue, &conn->c, buf, sizeof(buf));
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_equeue_read failed", err);
+      dr_assert(false);
+    } DR_ELIF_RESULT_OK(size_t, r, value) {
+      dr_assert(value == 0);
+    } DR_FI_RESULT;
+  }
+  dr_equeue_client_destroy(&conn->c);
+  ++finished;
+}
+
+static void refused_func(void *restrict const arg) {
+  (void)arg;
+  const struct dr_result_handle r = dr_equeue_connect(&equeue, "localhost", CLOSED_PORT);
+  DR_IF_RESULT_ERR(r, err) {
+    dr_assert(err->domain == DR_ERR_ISO_C && err->num == ECONNREFUSED);
+  } DR_ELIF_RESULT_OK(dr_handle_t, r, value) {
+    dr_close(value);
+    dr_assert(false);
+  } DR_FI_RESULT;
+  ++finished;
+}
+
+int main(void) {
+  {
+    const struct dr_result_void r = dr_socket_startup();
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_socket_startup failed", err);
+      return -1;
+    } DR_FI_RESULT;
+  }
+  {
+    const struct dr_result_void r = dr_equeue_init(&equeue);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_equeue_init failed", err);
+      return -1;
+    } DR_FI_RESULT;
+  }
+  {
+    dr_handle_t sfd;
+    {
+      const struct dr_result_handle r = dr_sock_bind("localhost", PORT, DR_CLOEXEC | DR_NONBLOCK | DR_REUSEADDR);
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_sock_bind failed", err);
+	return -1;
+      } DR_ELIF_RESULT_OK(dr_handle_t, r, value) {
+	sfd = value;
+      } DR_FI_RESULT;
+    }
+    {
+      const struct dr_result_void r = dr_listen(sfd, CONN_COUNT);
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_listen failed", err);
+	return -1;
+      } DR_FI_RESULT;
+    }
+    dr_equeue_server_init(&server, sfd);
+  }
+  {
+    const struct dr_result_void r = dr_task_create(&server_task, STACK_SIZE, server_func, NULL);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_task_create failed", err);
+      return -1;
+    } DR_FI_RESULT;
+  }
+  // The connections are all in progress at once
+  for (unsigned int i = 0; i < CONN_COUNT; ++i) {
+    const struct dr_result_void r = dr_task_create(&conns[i].task, STACK_SIZE, conn_func, &conns[i]);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_task_create failed", err);
+      return -1;
+    } DR_FI_RESULT;
+  }
+  {
+    const struct dr_result_void r = dr_task_create(&refused_task, STACK_SIZE, refused_func, NULL);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_task_create failed", err);
+      return -1;
+    } DR_FI_RESULT;
+  }
+  dr_schedule(true);
+  while (finished < CONN_COUNT + 2) {
+    struct dr_event events[16];
+    unsigned int event_count = 0;
+    {
+      const struct dr_result_uint r = dr_equeue_dequeue(&equeue, events, sizeof(events));
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_equeue_dequeue failed", err);
+	return -1;
+      } DR_ELIF_RESULT_OK(unsigned int, r, value) {
+	event_count = value;
+      } DR_FI_RESULT;
+    }
+    // Connect attempts never show up here, only handles the tasks own
+    for (unsigned int i = 0; i < event_count; ++i) {
+      void *restrict const key = dr_event_key(events, i);
+      if (key == &server) {
+	dr_task_runnable(&server_task);
+      } else {
+	struct conn *restrict const conn = container_of(key, struct conn, c);
+	dr_assert(conn >= conns && conn < conns + CONN_COUNT);
+	dr_task_runnable(&conn->task);
+      }
+    }
+    dr_schedule(true);
+  }
+
+  for (unsigned int i = 0; i < CONN_COUNT; ++i) {
+    dr_task_destroy(&conns[i].task);
+  }
+  dr_task_destroy(&refused_task);
+  dr_task_destroy(&server_task);
+  dr_equeue_server_destroy(&server);
+  dr_equeue_destroy(&equeue);
+
+  printf("OK\n");
+
+  return 0;
+}
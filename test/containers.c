@@ -0,0 +1,191 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// Copyright (c) 2018 Drew Richardson <drewrichardson@gmail.com>
+
+#include "dr.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "hash.h"
+#include "heap.h"
+#include "rbtree.h"
+
+#define COUNT 10000
+
+struct item {
+  struct hash_node hash;
+  struct heap_node heap;
+  struct rb_node rb;
+  uint32_t key;
+  uint32_t seq;
+  bool present;
+};
+
+static struct item items[COUNT];
+static uint32_t seed = 1;
+
+static uint32_t next_random(void) {
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+static bool item_eq(const struct hash_node *restrict const node, const void *restrict const key) {
+  const struct item *restrict const item = container_of_const(node, const struct item, hash);
+  return item->key == *(const uint32_t *)key;
+}
+
+static bool heap_less(const struct heap_node *restrict const a, const struct heap_node *restrict const b) {
+  const struct item *restrict const ia = container_of_const(a, const struct item, heap);
+  const struct item *restrict const ib = container_of_const(b, const struct item, heap);
+  return ia->key < ib->key;
+}
+
+static bool rb_less(const struct rb_node *restrict const a, const struct rb_node *restrict const b) {
+  const struct item *restrict const ia = container_of_const(a, const struct item, rb);
+  const struct item *restrict const ib = container_of_const(b, const struct item, rb);
+  return ia->key < ib->key;
+}
+
+// Returns the black height after checking the colors, links and order below node
+static unsigned int rb_check(const struct rb_node *restrict const node, const struct rb_node *restrict const parent) {
+  if (node == NULL) {
+    return 1;
+  }
+  dr_assert(node->parent == parent);
+  if (node->red) {
+    dr_assert(node->left == NULL || !node->left->red);
+    dr_assert(node->right == NULL || !node->right->red);
+  }
+  if (node->left != NULL) {
+    dr_assert(!rb_less(node, node->left));
+  }
+  if (node->right != NULL) {
+    dr_assert(!rb_less(node->right, node));
+  }
+  const unsigned int left = rb_check(node->left, node);
+  dr_assert(left == rb_check(node->right, node));
+  return left + (node->red ? 0 : 1);
+}
+
+// Mostly colliding hashes keep long clusters so removal has to shift nodes back
+static void test_hash(const uint32_t modulus) {
+  struct hash_table table = HASH_TABLE_INIT;
+  for (uint32_t i = 0; i < COUNT; ++i) {
+    items[i].key = i;
+    items[i].present = true;
+    dr_assert(hash_insert(&table, &items[i].hash, modulus == 0 ? hash_uint32(i) : i % modulus));
+  }
+  dr_assert(table.count == COUNT);
+  for (uint32_t i = 0; i < COUNT; i += 3) {
+    hash_remove(&table, &items[i].hash);
+    items[i].present = false;
+  }
+  for (uint32_t i = 0; i < COUNT; ++i) {
+    const struct hash_node *restrict const node = hash_find(&table, modulus == 0 ? hash_uint32(i) : i % modulus, item_eq, &i);
+    dr_assert(items[i].present ? node == &items[i].hash : node == NULL);
+  }
+  {
+    uint32_t i;
+    uint32_t found = 0;
+    hash_for_each_slot(i, &table) {
+      ++found;
+    }
+    dr_assert(found == table.count);
+  }
+  {
+    uint32_t i = 0;
+    uint32_t removed = 0;
+    struct hash_node *restrict node;
+    while ((node = hash_next_remaining(&table, &i)) != NULL) {
+      struct item *restrict const item = hash_entry(node, struct item, hash);
+      dr_assert(item->present);
+      item->present = false;
+      hash_remove(&table, node);
+      ++removed;
+    }
+    dr_assert(removed == COUNT - (COUNT + 2)/3);
+    dr_assert(table.count == 0);
+  }
+  hash_destroy(&table);
+}
+
+static void test_heap(void) {
+  struct heap heap = HEAP_INIT;
+  for (uint32_t i = 0; i < COUNT; ++i) {
+    items[i].key = next_random() % 1000;
+    items[i].present = true;
+    dr_assert(heap_push(&heap, &items[i].heap, heap_less));
+  }
+  for (uint32_t i = 0; i < COUNT; i += 2) {
+    heap_remove(&heap, &items[i].heap, heap_less);
+    items[i].present = false;
+  }
+  uint32_t last = 0;
+  uint32_t popped = 0;
+  struct heap_node *restrict node;
+  while ((node = heap_pop(&heap, heap_less)) != NULL) {
+    const struct item *restrict const item = heap_entry(node, struct item, heap);
+    dr_assert(item->present);
+    dr_assert(item->key >= last);
+    last = item->key;
+    ++popped;
+  }
+  dr_assert(popped == COUNT/2);
+  heap_destroy(&heap);
+}
+
+static void test_rbtree(void) {
+  struct rb_root root = RB_ROOT_INIT;
+  for (uint32_t i = 0; i < COUNT; ++i) {
+    items[i].key = next_random() % 1000;
+    items[i].seq = i;
+    items[i].present = true;
+    rb_insert(&root, &items[i].rb, rb_less);
+  }
+  rb_check(root.node, NULL);
+  for (uint32_t i = 0; i < COUNT; ++i) {
+    if (next_random() % 2 == 0) {
+      rb_erase(&root, &items[i].rb);
+      items[i].present = false;
+    }
+    if (i % 1000 == 0) {
+      dr_assert(!root.node->red);
+      rb_check(root.node, NULL);
+    }
+  }
+  rb_check(root.node, NULL);
+  uint32_t count = 0;
+  const struct item *restrict prev = NULL;
+  struct rb_node *restrict pos;
+  rb_for_each(pos, &root) {
+    const struct item *restrict const item = rb_entry(pos, struct item, rb);
+    dr_assert(item->present);
+    // Equal keys stay in insertion order
+    dr_assert(prev == NULL || prev->key < item->key || (prev->key == item->key && prev->seq < item->seq));
+    prev = item;
+    ++count;
+  }
+  for (uint32_t i = 0; i < COUNT; ++i) {
+    count -= items[i].present ? 1 : 0;
+  }
+  dr_assert(count == 0);
+  dr_assert(rb_last(&root) == &prev->rb);
+  while (!rb_empty(&root)) {
+    struct rb_node *restrict const first = rb_first(&root);
+    dr_assert(first->left == NULL && rb_prev(first) == NULL);
+    rb_erase(&root, first);
+  }
+  dr_assert(rb_first(&root) == NULL);
+}
+
+int main(void) {
+  test_hash(0);
+  test_hash(7);
+  test_heap();
+  test_rbtree();
+
+  printf("OK\n");
+  return 0;
+}
@@ -0,0 +1,190 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// Copyright (c) 2018 Drew Richardson <drewrichardson@gmail.com>
+
+#include "dr.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "hash.h"
+#include "heap.h"
+#include "rbtree.h"
+
+#define LOOKUPS (1<<22)
+#define TIMER_OPS (1<<21)
+#define MAX_ITEMS (1<<14)
+
+struct item {
+  struct list_head items;
+  struct hash_node hash;
+  struct heap_node heap;
+  struct rb_node rb;
+  uint32_t key;
+  int64_t deadline;
+};
+
+static struct item items[MAX_ITEMS];
+static uint32_t seed = 1;
+
+static uint32_t next_random(void) {
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+static bool item_eq(const struct hash_node *restrict const node, const void *restrict const key) {
+  const struct item *restrict const item = container_of_const(node, const struct item, hash);
+  return item->key == *(const uint32_t *)key;
+}
+
+static bool heap_less(const struct heap_node *restrict const a, const struct heap_node *restrict const b) {
+  const struct item *restrict const ia = container_of_const(a, const struct item, heap);
+  const struct item *restrict const ib = container_of_const(b, const struct item, heap);
+  return ia->deadline < ib->deadline;
+}
+
+static bool rb_less(const struct rb_node *restrict const a, const struct rb_node *restrict const b) {
+  const struct item *restrict const ia = container_of_const(a, const struct item, rb);
+  const struct item *restrict const ib = container_of_const(b, const struct item, rb);
+  return ia->deadline < ib->deadline;
+}
+
+// Looks up random keys among count items the way dr_fid_get scans its list and with the hash table
+static void bench_lookup(const uint32_t count) {
+  struct list_head list = LIST_HEAD_INIT(list);
+  struct hash_table table = HASH_TABLE_INIT;
+  for (uint32_t i = 0; i < count; ++i) {
+    items[i].key = i;
+    list_add(&items[i].items, &list);
+    dr_assert(hash_insert(&table, &items[i].hash, hash_uint32(i)));
+  }
+  const uint32_t lookups = LOOKUPS/(count < 64 ? 1 : count/64);
+  uint64_t sum = 0;
+  int64_t list_ns;
+  {
+    const int64_t start = dr_monotonic_ns();
+    for (uint32_t i = 0; i < lookups; ++i) {
+      const uint32_t key = next_random() % count;
+      struct item *restrict pos;
+      list_for_each_entry(pos, &list, struct item, items) {
+	if (pos->key == key) {
+	  sum += pos->key;
+	  break;
+	}
+      }
+    }
+    list_ns = dr_monotonic_ns() - start;
+  }
+  int64_t hash_ns;
+  {
+    const int64_t start = dr_monotonic_ns();
+    for (uint32_t i = 0; i < lookups; ++i) {
+      const uint32_t key = next_random() % count;
+      const struct hash_node *restrict const node = hash_find(&table, hash_uint32(key), item_eq, &key);
+      const struct item *restrict const item = container_of_const(node, const struct item, hash);
+      sum += item->key;
+    }
+    hash_ns = dr_monotonic_ns() - start;
+  }
+  printf("lookup %6" PRIu32 " items  list %8.1f ns  hash %5.1f ns  (%" PRIu64 ")\n", count, (double)list_ns/lookups, (double)hash_ns/lookups, sum);
+  hash_destroy(&table);
+}
+
+// Keeps count timers pending, repeatedly expiring the earliest and starting a new one with a random delay
+static void bench_timers(const uint32_t count) {
+  int64_t now = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    items[i].deadline = now + next_random() % 1000000;
+  }
+  const uint32_t seed_start = seed;
+  // The list is linear in the number pending, so give it fewer operations
+  const uint32_t list_ops = TIMER_OPS/(count < 64 ? 1 : count/64);
+  int64_t list_ns;
+  {
+    struct list_head list = LIST_HEAD_INIT(list);
+    for (uint32_t i = 0; i < count; ++i) {
+      // The same sorted insert dr_timer_start used, searching from the latest deadline
+      struct list_head *restrict pos;
+      for (pos = list.prev; pos != &list; pos = pos->prev) {
+	const struct item *restrict const item = list_entry(pos, struct item, items);
+	if (item->deadline <= items[i].deadline) {
+	  break;
+	}
+      }
+      list_add(&items[i].items, pos);
+    }
+    const int64_t start = dr_monotonic_ns();
+    for (uint32_t i = 0; i < list_ops; ++i) {
+      struct item *restrict const first = list_first_entry(&list, struct item, items);
+      list_del(&first->items);
+      now = first->deadline;
+      first->deadline = now + next_random() % 1000000;
+      struct list_head *restrict pos;
+      for (pos = list.prev; pos != &list; pos = pos->prev) {
+	const struct item *restrict const item = list_entry(pos, struct item, items);
+	if (item->deadline <= first->deadline) {
+	  break;
+	}
+      }
+      list_add(&first->items, pos);
+    }
+    list_ns = dr_monotonic_ns() - start;
+  }
+  // Replay the same deadlines for the others
+  seed = seed_start;
+  now = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    items[i].deadline = now + next_random() % 1000000;
+  }
+  const uint32_t seed_replay = seed;
+  int64_t heap_ns;
+  {
+    struct heap heap = HEAP_INIT;
+    for (uint32_t i = 0; i < count; ++i) {
+      dr_assert(heap_push(&heap, &items[i].heap, heap_less));
+    }
+    const int64_t start = dr_monotonic_ns();
+    for (uint32_t i = 0; i < TIMER_OPS; ++i) {
+      struct item *restrict const first = heap_entry(heap_pop(&heap, heap_less), struct item, heap);
+      now = first->deadline;
+      first->deadline = now + next_random() % 1000000;
+      dr_assert(heap_push(&heap, &first->heap, heap_less));
+    }
+    heap_ns = dr_monotonic_ns() - start;
+    heap_destroy(&heap);
+  }
+  seed = seed_replay;
+  now = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    items[i].deadline = now + next_random() % 1000000;
+  }
+  int64_t rb_ns;
+  {
+    struct rb_root root = RB_ROOT_INIT;
+    for (uint32_t i = 0; i < count; ++i) {
+      rb_insert(&root, &items[i].rb, rb_less);
+    }
+    const int64_t start = dr_monotonic_ns();
+    for (uint32_t i = 0; i < TIMER_OPS; ++i) {
+      struct item *restrict const first = rb_entry(rb_first(&root), struct item, rb);
+      rb_erase(&root, &first->rb);
+      now = first->deadline;
+      first->deadline = now + next_random() % 1000000;
+      rb_insert(&root, &first->rb, rb_less);
+    }
+    rb_ns = dr_monotonic_ns() - start;
+  }
+  printf("timers %6" PRIu32 " pending  list %8.1f ns  heap %5.1f ns  rbtree %5.1f ns\n", count, (double)list_ns/list_ops, (double)heap_ns/TIMER_OPS, (double)rb_ns/TIMER_OPS);
+}
+
+int main(void) {
+  for (uint32_t count = 4; count <= MAX_ITEMS; count *= 8) {
+    bench_lookup(count);
+  }
+  for (uint32_t count = 4; count <= MAX_ITEMS; count *= 8) {
+    bench_timers(count);
+  }
+  return 0;
+}
@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// Copyright (c) 2018 Drew Richardson <drewrichardson@gmail.com>
+
+#include "dr.h"
+
+#include <stdio.h>
+
+int main(void) {
+  struct dr_hist a;
+  struct dr_hist b;
+
+  // Empty
+  dr_hist_init(&a);
+  dr_assert(a.count == 0);
+  dr_assert(dr_hist_percentile(&a, 500) == 0);
+
+  // Small values are exact
+  for (uint64_t i = 0; i < 8; ++i) {
+    dr_hist_record(&a, i);
+  }
+  dr_assert(a.count == 8);
+  dr_assert(a.max == 7);
+  dr_assert(dr_hist_percentile(&a, 0) == 0);
+  dr_assert(dr_hist_percentile(&a, 500) == 3);
+  dr_assert(dr_hist_percentile(&a, 1000) == 7);
+
+  // Larger values are within 1/8
+  dr_hist_init(&a);
+  for (uint64_t i = 1; i <= 1000; ++i) {
+    dr_hist_record(&a, i*1000);
+  }
+  dr_assert(a.max == 1000000);
+  {
+    const uint64_t p50 = dr_hist_percentile(&a, 500);
+    dr_assert(p50 >= 500000 && p50 <= 500000 + 500000/8);
+    const uint64_t p99 = dr_hist_percentile(&a, 990);
+    dr_assert(p99 >= 990000 && p99 <= 1000000);
+    dr_assert(dr_hist_percentile(&a, 1000) == 1000000);
+  }
+
+  // Extremes
+  dr_hist_init(&b);
+  dr_hist_record(&b, UINT64_MAX);
+  dr_assert(dr_hist_percentile(&b, 500) == UINT64_MAX);
+
+  // Merge
+  dr_hist_merge(&a, &b);
+  dr_assert(a.count == 1001);
+  dr_assert(a.max == UINT64_MAX);
+  dr_assert(dr_hist_percentile(&a, 500) <= 500000 + 500000/8);
+
+  printf("OK\n");
+
+  return 0;
+}
@@ -0,0 +1,286 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// Copyright (c) 2018 Drew Richardson <drewrichardson@gmail.com>
+
+#include "dr.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#define STACK_SIZE (1<<16)
+#define TASK_COUNT 16
+#define BUF_SIZE (1<<12)
+
+static struct dr_equeue equeue;
+static struct dr_equeue_server server;
+static struct dr_equeue_client conn;
+static struct dr_9p_client client;
+static struct dr_task server_task;
+static struct dr_task client_task;
+static struct dr_task tasks[TASK_COUNT + 1];
+static unsigned int finished;
+
+WARN_UNUSED_RESULT static uint32_t server_read(uint8_t *restrict const buf, uint32_t len, const unsigned int count) {
+  for (unsigned int found = 0; found < count;) {
+    const struct dr_result_size r = dr_equeue_read(&equeue, &conn, buf + len, BUF_SIZE - len);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_equeue_read failed", err);
+      dr_assert(false);
+    } DR_ELIF_RESULT_OK(size_t, r, value) {
+      dr_assert(value > 0);
+      len += value;
+    } DR_FI_RESULT;
+    found = 0;
+    for (uint32_t pos = 0; len - pos >= sizeof(uint32_t) && len - pos >= dr_decode_uint32(buf + pos); pos += dr_decode_uint32(buf + pos)) {
+      ++found;
+    }
+  }
+  return len;
+}
+
+// Waits until every task has a request in flight, then answers them in reverse order
+static void server_func(void *restrict const arg) {
+  (void)arg;
+  {
+    const struct dr_result_handle r = dr_equeue_accept(&equeue, &server);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_equeue_accept failed", err);
+      dr_assert(false);
+    } DR_ELIF_RESULT_OK(dr_handle_t, r, value) {
+      dr_equeue_client_init(&conn, value);
+    } DR_FI_RESULT;
+  }
+  uint8_t tbuf[BUF_SIZE];
+  const uint32_t tlen = server_read(tbuf, 0, TASK_COUNT);
+  uint16_t tags[TASK_COUNT];
+  uint32_t fids[TASK_COUNT];
+  {
+    uint32_t pos = 0;
+    for (unsigned int i = 0; i < TASK_COUNT; ++i) {
+      const uint32_t size = dr_decode_uint32(tbuf + pos);
+      uint32_t mpos;
+      uint8_t type;
+      uint64_t offset;
+      uint32_t count;
+      dr_assert(dr_9p_decode_header(&type, &tags[i], tbuf + pos, size, &mpos));
+      dr_assert(type == DR_TREAD);
+      dr_assert(dr_9p_decode_Tread(&fids[i], &offset, &count, tbuf + pos, size, &mpos));
+      for (unsigned int j = 0; j < i; ++j) {
+	dr_assert(tags[j] != tags[i]);
+      }
+      pos += size;
+    }
+    dr_assert(pos == tlen);
+  }
+  uint8_t rbuf[BUF_SIZE];
+  uint32_t rlen = 0;
+  for (unsigned int i = TASK_COUNT; i-- > 0;) {
+    uint32_t rpos = rlen;
+    dr_assert(dr_9p_encode_Rread_iterator(rbuf + rlen, sizeof(rbuf) - rlen, &rpos, tags[i]));
+    memcpy(rbuf + rlen + rpos, &fids[i], sizeof(fids[i]));
+    dr_assert(dr_9p_encode_Rread_finish(rbuf + rlen, sizeof(rbuf) - rlen, &rpos, sizeof(fids[i])));
+    rlen += rpos;
+  }
+  {
+    const struct dr_result_size r = dr_equeue_write(&equeue, &conn, rbuf, rlen);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_equeue_write failed", err);
+      dr_assert(false);
+    } DR_ELIF_RESULT_OK(size_t, r, value) {
+      dr_assert(value == rlen);
+    } DR_FI_RESULT;
+  }
+  // Drop the connection with the last request unanswered
+  const uint32_t len = server_read(tbuf, 0, 1);
+  (void)len;
+  dr_equeue_client_destroy(&conn);
+}
+
+WARN_UNUSED_RESULT static struct dr_result_uint32 read_fid(const uint32_t fid, uint8_t *restrict const buf) {
+  uint32_t tpos;
+  dr_assert(dr_9p_encode_Tread(buf, BUF_SIZE, &tpos, 0, fid, 0, sizeof(fid)));
+  return dr_9p_client_call(&client, buf, tpos, BUF_SIZE);
+}
+
+static void read_func(void *restrict const arg) {
+  const uint32_t fid = *(const uint32_t *)arg;
+  uint8_t buf[BUF_SIZE];
+  const struct dr_result_uint32 r = read_fid(fid, buf);
+  DR_IF_RESULT_ERR(r, err) {
+    dr_log_error("dr_9p_client_call failed", err);
+    dr_assert(false);
+  } DR_ELIF_RESULT_OK(uint32_t, r, value) {
+    uint32_t pos;
+    uint8_t type;
+    uint16_t tag;
+    uint32_t count;
+    const void *restrict data;
+    dr_assert(dr_9p_decode_header(&type, &tag, buf, value, &pos));
+    dr_assert(type == DR_RREAD);
+    dr_assert(dr_9p_decode_Rread(&count, &data, buf, value, &pos));
+    dr_assert(count == sizeof(fid) && memcmp(data, &fid, sizeof(fid)) == 0);
+  } DR_FI_RESULT;
+  ++finished;
+}
+
+static void closed_func(void *restrict const arg) {
+  (void)arg;
+  uint8_t buf[BUF_SIZE];
+  {
+    const struct dr_result_uint32 r = read_fid(0, buf);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_assert(err->domain == DR_ERR_ISO_C && err->num == EPIPE);
+    } DR_ELIF_RESULT_OK(uint32_t, r, value) {
+      (void)value;
+      dr_assert(false);
+    } DR_FI_RESULT;
+  }
+  // Later calls fail without being sent
+  {
+    const struct dr_result_uint32 r = read_fid(0, buf);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_assert(err->domain == DR_ERR_ISO_C && err->num == EPIPE);
+    } DR_ELIF_RESULT_OK(uint32_t, r, value) {
+      (void)value;
+      dr_assert(false);
+    } DR_FI_RESULT;
+  }
+  ++finished;
+}
+
+static void run(const unsigned int count) {
+  while (finished < count) {
+    struct dr_event events[16];
+    unsigned int event_count = 0;
+    {
+      const struct dr_result_uint r = dr_equeue_dequeue(&equeue, events, sizeof(events));
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_equeue_dequeue failed", err);
+	dr_assert(false);
+      } DR_ELIF_RESULT_OK(unsigned int, r, value) {
+	event_count = value;
+      } DR_FI_RESULT;
+    }
+    for (unsigned int i = 0; i < event_count; ++i) {
+      void *restrict const key = dr_event_key(events, i);
+      if (key == &client) {
+	dr_9p_client_ready(&client, events, i);
+      } else {
+	dr_task_runnable(&server_task);
+      }
+    }
+    dr_schedule(true);
+  }
+}
+
+int main(void) {
+  {
+    const struct dr_result_void r = dr_socket_startup();
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_socket_startup failed", err);
+      return -1;
+    } DR_FI_RESULT;
+  }
+  {
+    const struct dr_result_void r = dr_equeue_init(&equeue);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_equeue_init failed", err);
+      return -1;
+    } DR_FI_RESULT;
+  }
+  {
+    dr_handle_t sfd;
+    {
+      const struct dr_result_handle r = dr_sock_bind("localhost", "6001", DR_CLOEXEC | DR_NONBLOCK | DR_REUSEADDR);
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_sock_bind failed", err);
+	return -1;
+      } DR_ELIF_RESULT_OK(dr_handle_t, r, value) {
+	sfd = value;
+      } DR_FI_RESULT;
+    }
+    {
+      const struct dr_result_void r = dr_listen(sfd, 1);
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_listen failed", err);
+	return -1;
+      } DR_FI_RESULT;
+    }
+    dr_equeue_server_init(&server, sfd);
+  }
+  {
+    dr_handle_t fd;
+    {
+      const struct dr_result_handle r = dr_sock_connect("localhost", "6001", DR_CLOEXEC);
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_sock_connect failed", err);
+	return -1;
+      } DR_ELIF_RESULT_OK(dr_handle_t, r, value) {
+	fd = value;
+      } DR_FI_RESULT;
+    }
+    {
+      const struct dr_result_void r = dr_set_nonblock(fd);
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_set_nonblock failed", err);
+	return -1;
+      } DR_FI_RESULT;
+    }
+    const struct dr_result_void r = dr_9p_client_init(&client, &equeue, fd, BUF_SIZE);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_9p_client_init failed", err);
+      return -1;
+    } DR_FI_RESULT;
+  }
+  {
+    const struct dr_result_void r = dr_task_create(&server_task, STACK_SIZE, server_func, NULL);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_task_create failed", err);
+      return -1;
+    } DR_FI_RESULT;
+  }
+  {
+    const struct dr_result_void r = dr_task_create(&client_task, STACK_SIZE, dr_9p_client_task, &client);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_task_create failed", err);
+      return -1;
+    } DR_FI_RESULT;
+  }
+
+  // Responses arriving out of order reach the right tasks
+  static uint32_t fids[TASK_COUNT];
+  for (unsigned int i = 0; i < TASK_COUNT; ++i) {
+    fids[i] = 100 + i;
+    const struct dr_result_void r = dr_task_create(&tasks[i], STACK_SIZE, read_func, &fids[i]);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_task_create failed", err);
+      return -1;
+    } DR_FI_RESULT;
+  }
+  dr_schedule(true);
+  run(TASK_COUNT);
+
+  // Outstanding calls fail when the connection is lost
+  {
+    const struct dr_result_void r = dr_task_create(&tasks[TASK_COUNT], STACK_SIZE, closed_func, NULL);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_task_create failed", err);
+      return -1;
+    } DR_FI_RESULT;
+  }
+  dr_schedule(true);
+  run(TASK_COUNT + 1);
+
+  for (unsigned int i = 0; i <= TASK_COUNT; ++i) {
+    dr_task_destroy(&tasks[i]);
+  }
+  dr_task_destroy(&client_task);
+  dr_task_destroy(&server_task);
+  dr_9p_client_destroy(&client);
+  dr_equeue_server_destroy(&server);
+  dr_equeue_destroy(&equeue);
+
+  printf("OK\n");
+
+  return 0;
+}
@@ -0,0 +1,228 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// Copyright (c) 2018 Drew Richardson <drewrichardson@gmail.com>
+
+#include "dr.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define STACK_SIZE (1<<16)
+#define TASK_COUNT 4
+#define SLEEP_NS 100000000
+
+static struct dr_equeue equeue;
+static struct dr_pool pool;
+static struct dr_task pool_task;
+static struct dr_task tasks[TASK_COUNT];
+static unsigned int finished;
+
+static char user_name[] = {'u','s','e','r'};
+
+static struct dr_group group;
+
+static struct dr_user user = {
+  .name.len = sizeof(user_name),
+  .name.buf = user_name,
+  .group_count = 1,
+  .groups = { &group },
+};
+
+static uint8_t backing[4096];
+
+static struct dr_result_uint32 backing_read(const struct dr_fd *restrict const fd, const uint64_t offset, const uint32_t count, void *restrict const buf) {
+  (void)fd;
+  // Make sure the scheduler thread can make progress while the read sleeps
+  const struct dr_result_void r = dr_system_sleep_ns(SLEEP_NS);
+  DR_IF_RESULT_ERR(r, err) {
+    return DR_RESULT_ERROR(uint32, err);
+  } DR_FI_RESULT;
+  const uint32_t bytes = offset + count <= sizeof(backing) ? count : sizeof(backing) - offset;
+  memcpy(buf, backing + offset, bytes);
+  return DR_RESULT_OK(uint32, bytes);
+}
+
+static struct dr_file_vtbl backing_vtbl = {
+  .read = backing_read,
+  .flags = DR_VFS_READAHEAD | DR_VFS_BLOCKING,
+};
+
+static struct dr_file file = {
+  .mode = 0400,
+  .length = sizeof(backing),
+  .uid = &user,
+  .gid = &group,
+  .muid = &user,
+  .vtbl = &backing_vtbl,
+};
+
+static void sleep_job(struct dr_pool_job *restrict const job) {
+  (void)job;
+  const struct dr_result_void r = dr_system_sleep_ns(SLEEP_NS);
+  DR_IF_RESULT_ERR(r, err) {
+    dr_log_error("dr_system_sleep_ns failed", err);
+    dr_assert(false);
+  } DR_FI_RESULT;
+}
+
+static void sleep_func(void *restrict const arg) {
+  (void)arg;
+  struct dr_pool_job job = {
+    .func = sleep_job,
+  };
+  dr_pool_run(&pool, &job);
+  ++finished;
+}
+
+static void read_func(void *restrict const arg) {
+  const unsigned int i = *(const unsigned int *)arg;
+  struct dr_fd *restrict fd = NULL;
+  {
+    const struct dr_result_fd r = dr_vfs_open(&user, &file, DR_OREAD);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_vfs_open failed", err);
+      dr_assert(false);
+    } DR_ELIF_RESULT_OK(struct dr_fd *restrict, r, value) {
+      fd = value;
+    } DR_FI_RESULT;
+  }
+  uint8_t buf[100];
+  {
+    const struct dr_result_uint32 r = dr_vfs_read(fd, 100*i, sizeof(buf), buf);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_vfs_read failed", err);
+      dr_assert(false);
+    } DR_ELIF_RESULT_OK(uint32_t, r, value) {
+      dr_assert(value == sizeof(buf));
+    } DR_FI_RESULT;
+  }
+  dr_assert(memcmp(buf, backing + 100*i, sizeof(buf)) == 0);
+  dr_vfs_close(fd);
+  ++finished;
+}
+
+static void prefetch_func(void *restrict const arg) {
+  (void)arg;
+  struct dr_fd *restrict fd = NULL;
+  {
+    const struct dr_result_fd r = dr_vfs_open(&user, &file, DR_OREAD);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_vfs_open failed", err);
+      dr_assert(false);
+    } DR_ELIF_RESULT_OK(struct dr_fd *restrict, r, value) {
+      fd = value;
+    } DR_FI_RESULT;
+  }
+  uint8_t buf[100];
+  for (uint64_t offset = 0; offset < 2*sizeof(buf); offset += sizeof(buf)) {
+    const struct dr_result_uint32 r = dr_vfs_read(fd, offset, sizeof(buf), buf);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_vfs_read failed", err);
+      dr_assert(false);
+    } DR_ELIF_RESULT_OK(uint32_t, r, value) {
+      dr_assert(value == sizeof(buf));
+    } DR_FI_RESULT;
+    dr_assert(memcmp(buf, backing + offset, sizeof(buf)) == 0);
+    // The window is filled on the pool while the task carries on
+    const int64_t start = dr_monotonic_ns();
+    dr_vfs_prefetch(fd);
+    dr_assert(dr_monotonic_ns() - start < SLEEP_NS);
+  }
+  dr_vfs_close(fd);
+  ++finished;
+}
+
+// Runs the tasks until they have all finished and returns the elapsed time
+static int64_t run(void (*func)(void *restrict const)) {
+  static unsigned int args[TASK_COUNT];
+  const int64_t start = dr_monotonic_ns();
+  finished = 0;
+  for (unsigned int i = 0; i < TASK_COUNT; ++i) {
+    args[i] = i;
+    const struct dr_result_void r = dr_task_create(&tasks[i], STACK_SIZE, func, &args[i]);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_task_create failed", err);
+      dr_assert(false);
+    } DR_FI_RESULT;
+  }
+  dr_schedule(true);
+  while (finished < TASK_COUNT) {
+    struct dr_event events[16];
+    unsigned int count = 0;
+    {
+      const struct dr_result_uint r = dr_equeue_dequeue(&equeue, events, sizeof(events));
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_equeue_dequeue failed", err);
+	dr_assert(false);
+      } DR_ELIF_RESULT_OK(unsigned int, r, value) {
+	count = value;
+      } DR_FI_RESULT;
+    }
+    for (unsigned int i = 0; i < count; ++i) {
+      void *restrict const key = dr_event_key(events, i);
+      dr_assert(key == &pool);
+      dr_task_runnable(&pool_task);
+    }
+    dr_schedule(true);
+  }
+  for (unsigned int i = 0; i < TASK_COUNT; ++i) {
+    dr_task_destroy(&tasks[i]);
+  }
+  return dr_monotonic_ns() - start;
+}
+
+int main(void) {
+  for (unsigned int i = 0; i < sizeof(backing); ++i) {
+    backing[i] = (uint8_t)(i*13);
+  }
+  {
+    const struct dr_result_void r = dr_equeue_init(&equeue);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_equeue_init failed", err);
+      return -1;
+    } DR_FI_RESULT;
+  }
+  {
+    const struct dr_result_void r = dr_pool_init(&pool, &equeue, TASK_COUNT);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_pool_init failed", err);
+      return -1;
+    } DR_FI_RESULT;
+  }
+  {
+    const struct dr_result_void r = dr_task_create(&pool_task, STACK_SIZE, dr_pool_task, &pool);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_task_create failed", err);
+      return -1;
+    } DR_FI_RESULT;
+  }
+
+  // Jobs from different tasks run concurrently
+  {
+    const int64_t elapsed = run(sleep_func);
+    dr_assert(elapsed >= SLEEP_NS);
+    dr_assert(elapsed < (TASK_COUNT - 1)*SLEEP_NS);
+  }
+
+  // Blocking backends are called on the pool
+  dr_vfs_offload(&pool);
+  {
+    const int64_t elapsed = run(read_func);
+    dr_assert(elapsed >= SLEEP_NS);
+    dr_assert(elapsed < (TASK_COUNT - 1)*SLEEP_NS);
+  }
+  // Read ahead does not hold up the task that started it
+  {
+    const int64_t elapsed = run(prefetch_func);
+    dr_assert(elapsed >= 2*SLEEP_NS);
+    dr_assert(elapsed < (TASK_COUNT - 1)*SLEEP_NS);
+  }
+  dr_vfs_offload(NULL);
+
+  dr_pool_destroy(&pool);
+  dr_task_destroy(&pool_task);
+  dr_equeue_destroy(&equeue);
+
+  printf("OK\n");
+
+  return 0;
+}
@@ -3,236 +3,195 @@
 
 #include "dr.h"
 
+#include <errno.h>
 #include <stdio.h>
+#include <string.h>
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+// Places head and tail at the given positions and checks the totals and how the regions split at the end of the buffer
+static void check(struct dr_ring *restrict const ring, const uint32_t head, const uint32_t tail, const uint32_t readable, const uint32_t read_first, const uint32_t writable, const uint32_t write_first) {
+  ring->head = head;
+  ring->tail = tail;
+  dr_assert(dr_ring_readable(ring) == readable);
+  dr_assert(dr_ring_writable(ring) == writable);
+  struct dr_iovec iov[2];
+  {
+    const unsigned int count = dr_ring_read_iov(ring, iov);
+    dr_assert(iov[0].len == read_first);
+    dr_assert(iov[0].base == ring->buf + (head & ring->mask));
+    dr_assert(count == (read_first == readable ? 1U : 2U));
+    dr_assert(iov[0].len + iov[1].len == readable);
+  }
+  {
+    const unsigned int count = dr_ring_write_iov(ring, iov);
+    dr_assert(iov[0].len == write_first);
+    dr_assert(iov[0].base == ring->buf + (tail & ring->mask));
+    dr_assert(count == (write_first == writable ? 1U : 2U));
+    dr_assert(iov[0].len + iov[1].len == writable);
+  }
+}
 
-int main(void) {
-  struct {
-    size_t read_pos;
-    size_t write_pos;
-    char buf[16];
-  } q = {
-    .read_pos = 0,
-  };
+static void ring_init(struct dr_ring *restrict const ring, const uint32_t capacity) {
+  const struct dr_result_void r = dr_ring_init(ring, capacity);
+  DR_IF_RESULT_ERR(r, err) {
+    dr_log_error("dr_ring_init failed", err);
+    dr_assert(false);
+  } DR_FI_RESULT;
+}
 
-  // 0123456789012345
-  // ????????????????
-  // | read_pos
-  // | write_pos
-  // readable = 0
-  // writable = 15
-  q.read_pos = 0;
-  q.write_pos = 0;
-  dr_assert(DR_QUEUE_READABLE(&q) == 0);
-  dr_assert(DR_QUEUE_WRITABLE(&q) == 15);
+// Moves bytes through the ring in uneven chunks so copies wrap in both directions
+static void round_trip(struct dr_ring *restrict const ring) {
+  uint8_t in[100];
+  uint8_t out[100];
+  uint8_t next_in = 0;
+  uint8_t next_out = 0;
+  for (unsigned int i = 0; i < 1000; ++i) {
+    const uint32_t put_len = i % 7 + 1;
+    for (uint32_t j = 0; j < put_len; ++j) {
+      in[j] = (uint8_t)(next_in + j);
+    }
+    const uint32_t put = dr_ring_put(ring, in, put_len);
+    next_in = (uint8_t)(next_in + put);
+    const uint32_t got = dr_ring_get(ring, out, i % 5 + 1);
+    for (uint32_t j = 0; j < got; ++j) {
+      dr_assert(out[j] == next_out++);
+    }
+  }
+}
 
-  // 0123456789012345
-  // ????????????????
-  //  | read_pos
-  //  | write_pos
-  // readable = 0
-  // writable = 15
-  q.read_pos = 1;
-  q.write_pos = 1;
-  dr_assert(DR_QUEUE_READABLE(&q) == 0);
-  dr_assert(DR_QUEUE_WRITABLE(&q) == 15);
+int main(void) {
+  {
+    struct dr_ring ring;
+    const struct dr_result_void r = dr_ring_init(&ring, 12);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_assert(err->domain == DR_ERR_ISO_C && err->num == EINVAL);
+    } DR_ELIF_RESULT_OK_VOID(r) {
+      dr_assert(false);
+    } DR_FI_RESULT;
+  }
+
+  struct dr_ring ring;
+  ring_init(&ring, 16);
 
   // 0123456789012345
   // ????????????????
-  //       | read_pos
-  //       | write_pos
-  // readable = 0
-  // writable = 15
-  q.read_pos = 6;
-  q.write_pos = 6;
-  dr_assert(DR_QUEUE_READABLE(&q) == 0);
-  dr_assert(DR_QUEUE_WRITABLE(&q) == 10);
+  // | head
+  // | tail
+  check(&ring, 0, 0, 0, 0, 16, 16);
 
   // 0123456789012345
   // ????????????????
-  //               | read_pos
-  //               | write_pos
-  // readable = 0
-  // writable = 2
-  q.read_pos = 14;
-  q.write_pos = 14;
-  dr_assert(DR_QUEUE_READABLE(&q) == 0);
-  dr_assert(DR_QUEUE_WRITABLE(&q) == 2);
+  //       | head
+  //       | tail
+  check(&ring, 6, 6, 0, 0, 16, 10);
 
   // 0123456789012345
   // ????????????????
-  //                | read_pos
-  //                | write_pos
-  // readable = 0
-  // writable = 1
-  q.read_pos = 15;
-  q.write_pos = 15;
-  dr_assert(DR_QUEUE_READABLE(&q) == 0);
-  dr_assert(DR_QUEUE_WRITABLE(&q) == 1);
+  //                | head
+  //                | tail
+  check(&ring, 15, 15, 0, 0, 16, 1);
 
   // 0123456789012345
   // xxxxx???????????
-  // | read_pos
-  //      | write_pos
-  // readable = 5
-  // writable = 10
-  q.read_pos = 0;
-  q.write_pos = 5;
-  dr_assert(DR_QUEUE_READABLE(&q) == 5);
-  dr_assert(DR_QUEUE_WRITABLE(&q) == 10);
-
-  // 0123456789012345
-  // ?xxxxx??????????
-  //  | read_pos
-  //       | write_pos
-  // readable = 5
-  // writable = 10
-  q.read_pos = 1;
-  q.write_pos = 6;
-  dr_assert(DR_QUEUE_READABLE(&q) == 5);
-  dr_assert(DR_QUEUE_WRITABLE(&q) == 10);
+  // | head
+  //      | tail
+  check(&ring, 0, 5, 5, 5, 11, 11);
 
   // 0123456789012345
   // ???xxxxx????????
-  //    | read_pos
-  //         | write_pos
-  // readable = 5
-  // writable = 8
-  q.read_pos = 3;
-  q.write_pos = 8;
-  dr_assert(DR_QUEUE_READABLE(&q) == 5);
-  dr_assert(DR_QUEUE_WRITABLE(&q) == 8);
-
-  // 0123456789012345
-  // ?????????xxxxx??
-  //          | read_pos
-  //               | write_pos
-  // readable = 5
-  // writable = 2
-  q.read_pos = 9;
-  q.write_pos = 14;
-  dr_assert(DR_QUEUE_READABLE(&q) == 5);
-  dr_assert(DR_QUEUE_WRITABLE(&q) == 2);
-
-  // 0123456789012345
-  // ??????????xxxxx?
-  //           | read_pos
-  //                | write_pos
-  // readable = 5
-  // writable = 1
-  q.read_pos = 10;
-  q.write_pos = 15;
-  dr_assert(DR_QUEUE_READABLE(&q) == 5);
-  dr_assert(DR_QUEUE_WRITABLE(&q) == 1);
-
-  // 0123456789012345
-  // ???????????xxxxx
-  //            | read_pos
-  // | write_pos
-  // readable = 5
-  // writable = 10
-  q.read_pos = 11;
-  q.write_pos = 0;
-  dr_assert(DR_QUEUE_READABLE(&q) == 5);
-  dr_assert(DR_QUEUE_WRITABLE(&q) == 10);
-
-  // 0123456789012345
-  // x???????????xxxx
-  //             | read_pos
-  //  | write_pos
-  // readable = 4
-  // writable = 10
-  q.read_pos = 12;
-  q.write_pos = 1;
-  dr_assert(DR_QUEUE_READABLE(&q) == 4);
-  dr_assert(DR_QUEUE_WRITABLE(&q) == 10);
-
-  // 0123456789012345
-  // xxx???????????xx
-  //               | read_pos
-  //    | write_pos
-  // readable = 2
-  // writable = 10
-  q.read_pos = 14;
-  q.write_pos = 3;
-  dr_assert(DR_QUEUE_READABLE(&q) == 2);
-  dr_assert(DR_QUEUE_WRITABLE(&q) == 10);
-
-  // 0123456789012345
-  // xxxx???????????x
-  //                | read_pos
-  //     | write_pos
-  // readable = 1
-  // writable = 10
-  q.read_pos = 15;
-  q.write_pos = 4;
-  dr_assert(DR_QUEUE_READABLE(&q) == 1);
-  dr_assert(DR_QUEUE_WRITABLE(&q) == 10);
-
-  // 0123456789012345
-  // xxxxxxxxxxxxxxx?
-  // | read_pos
-  //                | write_pos
-  // readable = 15
-  // writable = 0
-  q.read_pos = 0;
-  q.write_pos = 15;
-  dr_assert(DR_QUEUE_READABLE(&q) == 15);
-  dr_assert(DR_QUEUE_WRITABLE(&q) == 0);
-
-  // 0123456789012345
-  // ?xxxxxxxxxxxxxxx
-  //  | read_pos
-  // | write_pos
-  // readable = 15
-  // writable = 0
-  q.read_pos = 1;
-  q.write_pos = 0;
-  dr_assert(DR_QUEUE_READABLE(&q) == 15);
-  dr_assert(DR_QUEUE_WRITABLE(&q) == 0);
-
-  // 0123456789012345
-  // x?xxxxxxxxxxxxxx
-  //   | read_pos
-  //  | write_pos
-  // readable = 14
-  // writable = 0
-  q.read_pos = 2;
-  q.write_pos = 1;
-  dr_assert(DR_QUEUE_READABLE(&q) == 14);
-  dr_assert(DR_QUEUE_WRITABLE(&q) == 0);
-
-  // 0123456789012345
-  // xxxxxx?xxxxxxxxx
-  //        | read_pos
-  //       | write_pos
-  // readable = 9
-  // writable = 0
-  q.read_pos = 7;
-  q.write_pos = 6;
-  dr_assert(DR_QUEUE_READABLE(&q) == 9);
-  dr_assert(DR_QUEUE_WRITABLE(&q) == 0);
-
-  // 0123456789012345
-  // xxxxxxxxxxxxx?xx
-  //               | read_pos
-  //              | write_pos
-  // readable = 2
-  // writable = 0
-  q.read_pos = 14;
-  q.write_pos = 13;
-  dr_assert(DR_QUEUE_READABLE(&q) == 2);
-  dr_assert(DR_QUEUE_WRITABLE(&q) == 0);
-
-  // 0123456789012345
-  // xxxxxxxxxxxxxx?x
-  //                | read_pos
-  //               | write_pos
-  // readable = 1
-  // writable = 0
-  q.read_pos = 15;
-  q.write_pos = 14;
-  dr_assert(DR_QUEUE_READABLE(&q) == 1);
-  dr_assert(DR_QUEUE_WRITABLE(&q) == 0);
+  //    | head
+  //         | tail
+  check(&ring, 3, 8, 5, 5, 11, 8);
+
+  // 0123456789012345
+  // xx?????????xxxxx
+  //            | head
+  //   | tail
+  check(&ring, 11, 18, 7, 5, 9, 9);
+
+  // Every slot is usable, a full ring is told apart from an empty one by the free running indices
+  // 0123456789012345
+  // xxxxxxxxxxxxxxxx
+  //     | head
+  //     | tail
+  check(&ring, 4, 20, 16, 12, 0, 0);
+
+  // The indices may wrap around 2^32
+  // 0123456789012345
+  // xxx?????????xxxx
+  //             | head
+  //    | tail
+  check(&ring, UINT32_MAX - 3, 3, 7, 4, 9, 9);
+
+  ring.head = UINT32_MAX - 20;
+  ring.tail = UINT32_MAX - 20;
+  round_trip(&ring);
+  dr_ring_destroy(&ring);
+
+  // A mirrored ring is always one region
+  {
+    const struct dr_result_void r = dr_ring_init_mirror(&ring, 1<<16);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_assert(err->domain == DR_ERR_ISO_C && err->num == ENOSYS);
+    } DR_ELIF_RESULT_OK_VOID(r) {
+      check(&ring, (1<<16) - 10, (1<<16) + 20, 30, 30, (1<<16) - 30, (1<<16) - 30);
+      ring.buf[(1<<16) - 1] = 'a';
+      dr_assert(ring.buf[2*(1<<16) - 1] == 'a');
+      ring.head = UINT32_MAX - 20;
+      ring.tail = UINT32_MAX - 20;
+      round_trip(&ring);
+      dr_ring_destroy(&ring);
+    } DR_FI_RESULT;
+  }
+
+#if !defined(_WIN32)
+  // Both halves move in one call
+  {
+    int fds[2];
+    dr_assert(pipe(fds) == 0);
+    ring_init(&ring, 16);
+    ring.head = ring.tail = 10;
+    for (uint8_t i = 0; i < 12; ++i) {
+      dr_assert(dr_ring_put(&ring, &i, 1) == 1);
+    }
+    struct dr_iovec iov[2];
+    {
+      const unsigned int count = dr_ring_read_iov(&ring, iov);
+      dr_assert(count == 2);
+      const struct dr_result_size r = dr_writev(fds[1], iov, count);
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_writev failed", err);
+	return -1;
+      } DR_ELIF_RESULT_OK(size_t, r, value) {
+	dr_assert(value == 12);
+	dr_ring_consume(&ring, (uint32_t)value);
+      } DR_FI_RESULT;
+    }
+    {
+      const unsigned int count = dr_ring_write_iov(&ring, iov);
+      dr_assert(count == 2);
+      const struct dr_result_size r = dr_readv(fds[0], iov, count);
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_readv failed", err);
+	return -1;
+      } DR_ELIF_RESULT_OK(size_t, r, value) {
+	dr_assert(value == 12);
+	dr_ring_produce(&ring, (uint32_t)value);
+      } DR_FI_RESULT;
+    }
+    uint8_t out[12];
+    dr_assert(dr_ring_get(&ring, out, sizeof(out)) == sizeof(out));
+    for (uint8_t i = 0; i < 12; ++i) {
+      dr_assert(out[i] == i);
+    }
+    dr_ring_destroy(&ring);
+    close(fds[0]);
+    close(fds[1]);
+  }
+#endif
 
   printf("OK\n");
 
@@ -0,0 +1,184 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// Copyright (c) 2018 Drew Richardson <drewrichardson@gmail.com>
+
+#include "dr.h"
+
+#include <stdio.h>
+
+#define STACK_SIZE (1<<16)
+#define TASK_COUNT 4
+#define PORT "6005"
+#define SHORT_TTL_NS 1000
+
+static struct dr_equeue equeue;
+static struct dr_pool pool;
+static struct dr_task pool_task;
+static struct dr_task tasks[TASK_COUNT];
+static struct dr_resolved *restrict answers[TASK_COUNT];
+static unsigned int finished;
+
+static struct dr_resolved *resolve(const char *restrict const hostname, const char *restrict const port, const bool passive) {
+  struct dr_resolved *restrict resolved = NULL;
+  const struct dr_result_resolved r = dr_resolve(hostname, port, passive);
+  DR_IF_RESULT_ERR(r, err) {
+    dr_log_error("dr_resolve failed", err);
+    dr_assert(false);
+  } DR_ELIF_RESULT_OK(struct dr_resolved *restrict, r, value) {
+    resolved = value;
+  } DR_FI_RESULT;
+  dr_assert(dr_resolved_addrs(resolved) != NULL);
+  return resolved;
+}
+
+static void test_cache(void) {
+  struct dr_resolved *restrict const a = resolve("localhost", PORT, false);
+  struct dr_resolved *restrict const b = resolve("localhost", PORT, false);
+  dr_assert(a == b);
+  // Binding and connecting are cached separately, as is a NULL hostname
+  struct dr_resolved *restrict const c = resolve("localhost", PORT, true);
+  dr_assert(c != a);
+  struct dr_resolved *restrict const d = resolve(NULL, PORT, true);
+  dr_assert(d != c);
+  dr_assert(resolve(NULL, PORT, true) == d);
+  dr_resolve_release(d);
+  dr_resolve_release(d);
+  dr_resolve_release(c);
+  dr_resolve_release(b);
+
+  // Entries in use outlive the cache
+  dr_resolve_flush();
+  struct dr_resolved *restrict const e = resolve("localhost", PORT, false);
+  dr_assert(e != a);
+  dr_resolve_release(a);
+  dr_resolve_release(e);
+
+  // Answers already cached keep their expiry when the TTL is lowered, and answers cached after it expire first
+  struct dr_resolved *restrict const h = resolve("localhost", PORT, false);
+  dr_resolve_cache_ttl(SHORT_TTL_NS);
+  struct dr_resolved *restrict const i = resolve(NULL, PORT, true);
+  const int64_t start = dr_monotonic_ns();
+  while (dr_monotonic_ns() - start <= 2*SHORT_TTL_NS) {
+  }
+  dr_assert(resolve("localhost", PORT, false) == h);
+  struct dr_resolved *restrict const j = resolve(NULL, PORT, true);
+  dr_assert(j != i);
+  dr_resolve_release(j);
+  dr_resolve_release(i);
+  dr_resolve_release(h);
+  dr_resolve_release(h);
+
+  // A TTL of 0 turns caching off
+  dr_resolve_cache_ttl(0);
+  dr_resolve_flush();
+  struct dr_resolved *restrict const f = resolve("localhost", PORT, false);
+  struct dr_resolved *restrict const g = resolve("localhost", PORT, false);
+  dr_assert(g != f);
+  dr_resolve_release(g);
+  dr_resolve_release(f);
+  dr_resolve_cache_ttl(DR_RESOLVE_TTL_NS);
+}
+
+static void test_failure(void) {
+  for (unsigned int i = 0; i < 2; ++i) {
+    const struct dr_result_resolved r = dr_resolve("localhost", "no-such-service", false);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_assert(err->domain == DR_ERR_GAI);
+    } DR_ELIF_RESULT_OK(struct dr_resolved *restrict, r, value) {
+      dr_resolve_release(value);
+      dr_assert(false);
+    } DR_FI_RESULT;
+  }
+}
+
+static void resolve_func(void *restrict const arg) {
+  const unsigned int i = *(const unsigned int *)arg;
+  answers[i] = resolve("localhost", PORT, false);
+  ++finished;
+}
+
+// Tasks asking while the first lookup is still on the pool share its answer
+static void test_offload(void) {
+  static unsigned int args[TASK_COUNT];
+  dr_resolve_flush();
+  dr_resolve_offload(&pool);
+  finished = 0;
+  for (unsigned int i = 0; i < TASK_COUNT; ++i) {
+    args[i] = i;
+    const struct dr_result_void r = dr_task_create(&tasks[i], STACK_SIZE, resolve_func, &args[i]);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_task_create failed", err);
+      dr_assert(false);
+    } DR_FI_RESULT;
+  }
+  dr_schedule(true);
+  while (finished < TASK_COUNT) {
+    struct dr_event events[16];
+    unsigned int count = 0;
+    {
+      const struct dr_result_uint r = dr_equeue_dequeue(&equeue, events, sizeof(events));
+      DR_IF_RESULT_ERR(r, err) {
+	dr_log_error("dr_equeue_dequeue failed", err);
+	dr_assert(false);
+      } DR_ELIF_RESULT_OK(unsigned int, r, value) {
+	count = value;
+      } DR_FI_RESULT;
+    }
+    for (unsigned int i = 0; i < count; ++i) {
+      void *restrict const key = dr_event_key(events, i);
+      dr_assert(key == &pool);
+      dr_task_runnable(&pool_task);
+    }
+    dr_schedule(true);
+  }
+  for (unsigned int i = 0; i < TASK_COUNT; ++i) {
+    dr_task_destroy(&tasks[i]);
+  }
+  dr_resolve_offload(NULL);
+  for (unsigned int i = 0; i < TASK_COUNT; ++i) {
+    dr_assert(answers[i] == answers[0]);
+    dr_resolve_release(answers[i]);
+  }
+}
+
+int main(void) {
+  {
+    const struct dr_result_void r = dr_socket_startup();
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_socket_startup failed", err);
+      return -1;
+    } DR_FI_RESULT;
+  }
+  {
+    const struct dr_result_void r = dr_equeue_init(&equeue);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_equeue_init failed", err);
+      return -1;
+    } DR_FI_RESULT;
+  }
+  {
+    const struct dr_result_void r = dr_pool_init(&pool, &equeue, 1);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_pool_init failed", err);
+      return -1;
+    } DR_FI_RESULT;
+  }
+  {
+    const struct dr_result_void r = dr_task_create(&pool_task, STACK_SIZE, dr_pool_task, &pool);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_task_create failed", err);
+      return -1;
+    } DR_FI_RESULT;
+  }
+
+  test_cache();
+  test_failure();
+  test_offload();
+
+  dr_resolve_flush();
+  dr_pool_destroy(&pool);
+  dr_task_destroy(&pool_task);
+  dr_equeue_destroy(&equeue);
+
+  printf("OK\n");
+  return 0;
+}
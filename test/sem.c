@@ -1,4 +1,204 @@
 // SPDX-License-Identifier: GPL-2.0-only
 // Copyright (c) 2018 Drew Richardson <drewrichardson@gmail.com>
 
-// DR ...
+#include "dr.h"
+
+#include <errno.h>
+#include <stdio.h>
+
+#define STACK_SIZE (1<<16)
+#define TASK_COUNT 3
+#define TIMEOUT_NS 20000000
+
+static struct dr_equeue equeue;
+static struct dr_task tasks[TASK_COUNT];
+static unsigned int finished;
+
+static struct dr_sem sem;
+static struct dr_sem lock;
+static struct dr_cond cond;
+static struct dr_wait wait;
+static bool ready;
+static unsigned int woken;
+
+static void sem_init(struct dr_sem *restrict const s, const unsigned int value) {
+  const struct dr_result_void r = dr_sem_init(s, value);
+  DR_IF_RESULT_ERR(r, err) {
+    dr_log_error("dr_sem_init failed", err);
+    dr_assert(false);
+  } DR_FI_RESULT;
+}
+
+static void check_ok(const struct dr_result_void r) {
+  DR_IF_RESULT_ERR(r, err) {
+    dr_log_error("Unexpected error", err);
+    dr_assert(false);
+  } DR_FI_RESULT;
+}
+
+static void check_timedout(const struct dr_result_void r) {
+  bool timedout = false;
+  DR_IF_RESULT_ERR(r, err) {
+    timedout = err->domain == DR_ERR_ISO_C && err->num == ETIMEDOUT;
+  } DR_FI_RESULT;
+  dr_assert(timedout);
+}
+
+// Runs count tasks until they have all finished and returns the elapsed time
+static int64_t run(void (*func)(void *restrict const), const unsigned int count) {
+  const int64_t start = dr_monotonic_ns();
+  finished = 0;
+  for (unsigned int i = 0; i < count; ++i) {
+    const struct dr_result_void r = dr_task_create(&tasks[i], STACK_SIZE, func, NULL);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_task_create failed", err);
+      dr_assert(false);
+    } DR_FI_RESULT;
+  }
+  dr_schedule(true);
+  while (finished < count) {
+    struct dr_event events[16];
+    const struct dr_result_uint r = dr_equeue_dequeue(&equeue, events, sizeof(events));
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_equeue_dequeue failed", err);
+      dr_assert(false);
+    } DR_ELIF_RESULT_OK(unsigned int, r, value) {
+      // Nothing is registered, only timers wake the queue
+      dr_assert(value == 0);
+    } DR_FI_RESULT;
+    dr_schedule(true);
+  }
+  for (unsigned int i = 0; i < count; ++i) {
+    dr_task_destroy(&tasks[i]);
+  }
+  return dr_monotonic_ns() - start;
+}
+
+static void timedwait_func(void *restrict const arg) {
+  (void)arg;
+  check_timedout(dr_sem_timedwait(&sem, dr_now_ns() + TIMEOUT_NS));
+  ++finished;
+}
+
+// The last task wakes the others once they are all waiting
+static void notify_all_func(void *restrict const arg) {
+  (void)arg;
+  if (&tasks[TASK_COUNT - 1] == dr_task_self()) {
+    dr_sleep_until(dr_now_ns() + TIMEOUT_NS);
+    dr_wait_notify_all(&wait);
+  } else {
+    dr_assert(dr_wait_wait_until(&wait, DR_NEVER));
+    ++woken;
+  }
+  ++finished;
+}
+
+static void wait_until_func(void *restrict const arg) {
+  (void)arg;
+  if (&tasks[0] == dr_task_self()) {
+    dr_assert(dr_wait_wait_until(&wait, dr_now_ns() + 100*TIMEOUT_NS));
+    ++woken;
+  } else {
+    dr_sleep_until(dr_now_ns() + TIMEOUT_NS);
+    dr_wait_notify(&wait);
+  }
+  ++finished;
+}
+
+static void cond_func(void *restrict const arg) {
+  (void)arg;
+  check_ok(dr_sem_wait(&lock));
+  if (&tasks[TASK_COUNT - 1] == dr_task_self()) {
+    dr_sleep_until(dr_now_ns() + TIMEOUT_NS);
+    ready = true;
+    dr_cond_broadcast(&cond);
+  } else {
+    while (!ready) {
+      check_ok(dr_cond_wait(&cond, &lock));
+    }
+    ++woken;
+  }
+  check_ok(dr_sem_post(&lock));
+  ++finished;
+}
+
+static void cond_timedwait_func(void *restrict const arg) {
+  (void)arg;
+  check_ok(dr_sem_wait(&lock));
+  check_timedout(dr_cond_timedwait(&cond, &lock, dr_now_ns() + TIMEOUT_NS));
+  // The lock is held again after a timeout
+  dr_assert(lock.value == 0);
+  check_ok(dr_sem_post(&lock));
+  ++finished;
+}
+
+// The last task posts once per waiter with a single call
+static void post_count_func(void *restrict const arg) {
+  (void)arg;
+  if (&tasks[TASK_COUNT - 1] == dr_task_self()) {
+    dr_sleep_until(dr_now_ns() + TIMEOUT_NS);
+    check_ok(dr_sem_post_count(&sem, TASK_COUNT - 1));
+  } else {
+    check_ok(dr_sem_timedwait(&sem, dr_now_ns() + 100*TIMEOUT_NS));
+    ++woken;
+  }
+  ++finished;
+}
+
+int main(void) {
+  {
+    const struct dr_result_void r = dr_equeue_init(&equeue);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_equeue_init failed", err);
+      return -1;
+    } DR_FI_RESULT;
+  }
+  sem_init(&sem, 0);
+  sem_init(&lock, 1);
+  dr_cond_init(&cond);
+  dr_wait_init(&wait);
+
+  // Waits time out together rather than one after another
+  {
+    const int64_t elapsed = run(timedwait_func, TASK_COUNT);
+    dr_assert(elapsed >= TIMEOUT_NS);
+    dr_assert(elapsed < TASK_COUNT*TIMEOUT_NS);
+    dr_assert(sem.value == 0);
+    dr_assert(list_empty(&sem.wait.waiters));
+  }
+
+  woken = 0;
+  (void)run(notify_all_func, TASK_COUNT);
+  dr_assert(woken == TASK_COUNT - 1);
+
+  // A notify before the deadline cancels the timer
+  woken = 0;
+  {
+    const int64_t elapsed = run(wait_until_func, 2);
+    dr_assert(woken == 1);
+    dr_assert(elapsed < 100*TIMEOUT_NS);
+    dr_assert(dr_timer_timeout_ns() == -1);
+  }
+
+  woken = 0;
+  (void)run(cond_func, TASK_COUNT);
+  dr_assert(woken == TASK_COUNT - 1);
+  dr_assert(lock.value == 1);
+
+  (void)run(cond_timedwait_func, 1);
+  dr_assert(lock.value == 1);
+
+  woken = 0;
+  (void)run(post_count_func, TASK_COUNT);
+  dr_assert(woken == TASK_COUNT - 1);
+  dr_assert(sem.value == 0);
+
+  dr_wait_destroy(&wait);
+  dr_cond_destroy(&cond);
+  dr_sem_destroy(&lock);
+  dr_sem_destroy(&sem);
+  dr_equeue_destroy(&equeue);
+
+  printf("OK\n");
+  return 0;
+}
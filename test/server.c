@@ -9,17 +9,16 @@
 
 #define STACK_SIZE (1<<16)
 
+#define CHAN_SIZE (1<<10)
+
+// read_task passes the bytes it reads to write_task over chan
 struct client {
   struct list_head clients;
-  struct dr_wait read_wait;
+  struct dr_chan chan;
   struct dr_task read_task;
-  struct dr_wait write_wait;
   struct dr_task write_task;
   struct dr_equeue_client c;
-  size_t read_pos;
-  size_t write_pos;
   bool cleanup;
-  char buf[1<<10];
 };
 
 static struct list_head clients;
@@ -39,23 +38,28 @@ static WARN_UNUSED_RESULT struct dr_result_void client_init(dr_handle_t fd) {
     .clients = LIST_HEAD_INIT(c->clients),
   };
   dr_equeue_client_init(&c->c, fd);
-  dr_wait_init(&c->read_wait);
+  {
+    const struct dr_result_void r = dr_chan_init(&c->chan, 1, CHAN_SIZE);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_equeue_client_destroy(&c->c);
+      free(c);
+      return DR_RESULT_ERROR_VOID(err);
+    } DR_FI_RESULT;
+  }
   {
     const struct dr_result_void r = dr_task_create(&c->read_task, STACK_SIZE, read_func, c);
     DR_IF_RESULT_ERR(r, err) {
-      dr_wait_destroy(&c->read_wait);
+      dr_chan_destroy(&c->chan);
       dr_equeue_client_destroy(&c->c);
       free(c);
       return DR_RESULT_ERROR_VOID(err);
     } DR_FI_RESULT;
   }
-  dr_wait_init(&c->write_wait);
   {
     const struct dr_result_void r = dr_task_create(&c->write_task, STACK_SIZE, write_func, c);
     DR_IF_RESULT_ERR(r, err) {
-      dr_wait_destroy(&c->write_wait);
       dr_task_destroy(&c->read_task);
-      dr_wait_destroy(&c->read_wait);
+      dr_chan_destroy(&c->chan);
       dr_equeue_client_destroy(&c->c);
       free(c);
       return DR_RESULT_ERROR_VOID(err);
@@ -69,25 +73,19 @@ static void client_destroy(struct client *restrict const c) {
   dr_log("Closing client");
   list_del(&c->clients);
   dr_task_destroy(&c->write_task);
-  dr_wait_destroy(&c->write_wait);
   dr_task_destroy(&c->read_task);
-  dr_wait_destroy(&c->read_wait);
+  dr_chan_destroy(&c->chan);
   dr_equeue_client_destroy(&c->c);
   free(c);
 }
 
 static void read_func(void *restrict const arg) {
   struct client *restrict const c = (struct client *)arg;
+  char buf[CHAN_SIZE];
   while (dr_likely(!cleanup)) {
-    while (DR_QUEUE_WRITABLE(c) <= 0) {
-      if (cleanup) {
-	goto done;
-      }
-      dr_wait_wait(&c->read_wait);
-    }
     size_t bytes;
     {
-      const struct dr_result_size r = dr_equeue_read(&equeue, &c->c, c->buf + c->write_pos, DR_QUEUE_WRITABLE(c));
+      const struct dr_result_size r = dr_equeue_read(&equeue, &c->c, buf, sizeof(buf));
       DR_IF_RESULT_ERR(r, err) {
 	dr_log_error("dr_equeue_read failed", err);
 	goto done;
@@ -98,49 +96,60 @@ static void read_func(void *restrict const arg) {
     if (bytes == 0) {
       goto done; // DR ...
     }
-    c->write_pos = (c->write_pos + bytes) % sizeof(c->buf);
-    dr_wait_notify(&c->write_wait);
+    for (size_t pos = 0; pos < bytes;) {
+      const struct dr_result_uint r = dr_chan_send_batch(&c->chan, buf + pos, bytes - pos);
+      DR_IF_RESULT_ERR(r, err) {
+	// write_func closed the channel
+	(void)err;
+	goto done;
+      } DR_ELIF_RESULT_OK(unsigned int, r, value) {
+	pos += value;
+      } DR_FI_RESULT;
+    }
   }
  done:
+  dr_chan_close(&c->chan);
   if (c->cleanup) {
     dr_task_exit(c, (void (*)(void *restrict const))client_destroy);
   }
   c->cleanup = true;
-  dr_wait_notify(&c->write_wait);
   dr_log("Exiting");
 }
 
 static void write_func(void *restrict const arg) {
   struct client *restrict const c = (struct client *)arg;
+  char buf[CHAN_SIZE];
   while (dr_likely(!cleanup)) {
-    while (DR_QUEUE_READABLE(c) <= 0) {
-      if (cleanup || c->cleanup) {
+    unsigned int count;
+    {
+      const struct dr_result_uint r = dr_chan_recv_batch(&c->chan, buf, sizeof(buf));
+      DR_IF_RESULT_ERR(r, err) {
+	// read_func closed the channel and everything it sent has been written
+	(void)err;
 	goto done;
-      }
-      dr_wait_wait(&c->write_wait);
+      } DR_ELIF_RESULT_OK(unsigned int, r, value) {
+	count = value;
+      } DR_FI_RESULT;
     }
-    size_t bytes;
-    {
-      const struct dr_result_size r = dr_equeue_write(&equeue, &c->c, c->buf + c->read_pos, DR_QUEUE_READABLE(c));
+    for (size_t pos = 0; pos < count;) {
+      const struct dr_result_size r = dr_equeue_write(&equeue, &c->c, buf + pos, count - pos);
       DR_IF_RESULT_ERR(r, err) {
 	dr_log_error("dr_equeue_write failed", err);
 	goto done;
       } DR_ELIF_RESULT_OK(size_t, r, value) {
-	bytes = value;
+	if (value == 0) {
+	  goto done; // DR ...
+	}
+	pos += value;
       } DR_FI_RESULT;
     }
-    if (bytes == 0) {
-      goto done; // DR ...
-    }
-    c->read_pos = (c->read_pos + bytes) % sizeof(c->buf);
-    dr_wait_notify(&c->read_wait);
   }
  done:
+  dr_chan_close(&c->chan);
   if (c->cleanup) {
     dr_task_exit(c, (void (*)(void *restrict const))client_destroy);
   }
   c->cleanup = true;
-  dr_wait_notify(&c->read_wait);
   dr_log("Exiting");
 }
 
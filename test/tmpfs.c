@@ -0,0 +1,320 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// Copyright (c) 2018 Drew Richardson <drewrichardson@gmail.com>
+
+#include "dr.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#define PAGE DR_TMPFS_PAGE_SIZE
+
+static char user_name[] = {'u','s','e','r'};
+
+static struct dr_group group;
+
+static struct dr_user user = {
+  .name.len = sizeof(user_name),
+  .name.buf = user_name,
+  .group_count = 1,
+  .groups = { &group },
+};
+
+static struct dr_dir root = {
+  .file = {
+    .mode = DR_DIR | 0555,
+    .uid = &user,
+    .gid = &group,
+    .muid = &user,
+    .vtbl = &dr_dir_vtbl,
+    .refs = 1,
+  },
+};
+
+static uint8_t wbuf[4*PAGE];
+static uint8_t rbuf[4*PAGE];
+
+// Names are only read, so string literals can be used
+static struct dr_str str(const char *restrict const s) {
+  const struct dr_str result = {
+    .len = strlen(s),
+    .buf = (char *)s,
+  };
+  return result;
+}
+
+// Opens a new file the way Tlcreate does, with a reference held for the fid
+static struct dr_fd *create(struct dr_file *restrict const dir, const char *restrict const name, const uint32_t perm, const uint8_t mode) {
+  const struct dr_str n = str(name);
+  struct dr_fd *restrict fd = NULL;
+  const struct dr_result_fd r = dr_vfs_create(&user, dir, &n, perm, mode);
+  DR_IF_RESULT_ERR(r, err) {
+    dr_log_error("dr_vfs_create failed", err);
+    dr_assert(false);
+  } DR_ELIF_RESULT_OK(struct dr_fd *restrict, r, value) {
+    fd = value;
+  } DR_FI_RESULT;
+  dr_vfs_ref(fd->file);
+  return fd;
+}
+
+static void clunk(struct dr_fd *restrict const fd) {
+  struct dr_file *restrict const file = fd->file;
+  dr_vfs_close(fd);
+  dr_vfs_unref(file);
+}
+
+static void remove_file(struct dr_file *restrict const file) {
+  const struct dr_result_void r = dr_vfs_remove(&user, file);
+  DR_IF_RESULT_ERR(r, err) {
+    dr_log_error("dr_vfs_remove failed", err);
+    dr_assert(false);
+  } DR_FI_RESULT;
+}
+
+static uint32_t write_at(struct dr_fd *restrict const fd, const uint64_t offset, const uint32_t count, int *restrict const errnum) {
+  uint32_t bytes = 0;
+  *errnum = 0;
+  const struct dr_result_uint32 r = dr_vfs_write(fd, offset, count, wbuf);
+  DR_IF_RESULT_ERR(r, err) {
+    dr_assert(err->domain == DR_ERR_ISO_C);
+    *errnum = err->num;
+  } DR_ELIF_RESULT_OK(uint32_t, r, value) {
+    bytes = value;
+  } DR_FI_RESULT;
+  return bytes;
+}
+
+static uint32_t read_at(struct dr_fd *restrict const fd, const uint64_t offset, const uint32_t count) {
+  uint32_t bytes = 0;
+  const struct dr_result_uint32 r = dr_vfs_read(fd, offset, count, rbuf);
+  DR_IF_RESULT_ERR(r, err) {
+    dr_log_error("dr_vfs_read failed", err);
+    dr_assert(false);
+  } DR_ELIF_RESULT_OK(uint32_t, r, value) {
+    bytes = value;
+  } DR_FI_RESULT;
+  return bytes;
+}
+
+static bool is_zero(const uint8_t *restrict const buf, const uint32_t count) {
+  for (uint32_t i = 0; i < count; ++i) {
+    if (buf[i] != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void truncate_file(struct dr_file *restrict const file, const uint64_t length) {
+  const struct dr_result_void r = file->vtbl->truncate(file, length);
+  DR_IF_RESULT_ERR(r, err) {
+    dr_log_error("truncate failed", err);
+    dr_assert(false);
+  } DR_FI_RESULT;
+  dr_assert(file->length == length);
+}
+
+static void test_data(struct dr_tmpfs *restrict const fs) {
+  int errnum;
+  struct dr_fd *restrict const fd = create(&fs->root.file, "data", 0644, DR_ORDWR);
+  // Unaligned so every page boundary is crossed mid write
+  dr_assert(write_at(fd, 100, 3*PAGE, &errnum) == 3*PAGE);
+  dr_assert(fd->file->length == 3*PAGE + 100);
+  dr_assert(read_at(fd, 0, sizeof(rbuf)) == 3*PAGE + 100);
+  dr_assert(is_zero(rbuf, 100));
+  dr_assert(memcmp(rbuf + 100, wbuf, 3*PAGE) == 0);
+  dr_assert(read_at(fd, PAGE - 1, 2) == 2);
+  dr_assert(rbuf[0] == wbuf[PAGE - 101] && rbuf[1] == wbuf[PAGE - 100]);
+
+  // Truncating down drops the tail, growing again reads back zeros
+  truncate_file(fd->file, PAGE + 10);
+  dr_assert(read_at(fd, PAGE + 10, 1) == 0);
+  truncate_file(fd->file, 3*PAGE);
+  dr_assert(read_at(fd, 0, sizeof(rbuf)) == 3*PAGE);
+  dr_assert(memcmp(rbuf + 100, wbuf, PAGE - 90) == 0);
+  dr_assert(is_zero(rbuf + PAGE + 10, 2*PAGE - 10));
+  truncate_file(fd->file, 0);
+  dr_assert(read_at(fd, 0, sizeof(rbuf)) == 0);
+
+  remove_file(fd->file);
+  clunk(fd);
+}
+
+static void test_sparse(struct dr_tmpfs *restrict const fs) {
+  int errnum;
+  struct dr_fd *restrict const fd = create(&fs->root.file, "sparse", 0644, DR_ORDWR);
+  const uint64_t used = fs->used;
+  dr_assert(write_at(fd, 10*PAGE, 10, &errnum) == 10);
+  dr_assert(fd->file->length == 10*PAGE + 10);
+  // Only the written page and the page array are allocated
+  dr_assert(fs->used - used == PAGE + 16*sizeof(uint8_t *));
+  dr_assert(read_at(fd, 5*PAGE, PAGE) == PAGE);
+  dr_assert(is_zero(rbuf, PAGE));
+  dr_assert(read_at(fd, 10*PAGE - 1, 100) == 11);
+  dr_assert(rbuf[0] == 0 && memcmp(rbuf + 1, wbuf, 10) == 0);
+  remove_file(fd->file);
+  clunk(fd);
+}
+
+static void test_full(void) {
+  int errnum;
+  struct dr_tmpfs fs;
+  const struct dr_str name = str("small");
+  // Room for one file with four pages
+  const uint64_t cap = sizeof(struct dr_tmpfs_node) + strlen("full") + 4*sizeof(uint8_t *) + 2*PAGE;
+  dr_tmpfs_init(&fs, cap, &root.file, &name, &user, &group, 0777);
+  struct dr_fd *restrict const fd = create(&fs.root.file, "full", 0644, DR_ORDWR);
+  // A write that does not fit is cut short rather than failing
+  dr_assert(write_at(fd, 0, 3*PAGE, &errnum) == 2*PAGE);
+  dr_assert(fd->file->length == 2*PAGE);
+  dr_assert(fs.used == fs.cap);
+  dr_assert(write_at(fd, 2*PAGE, 1, &errnum) == 0 && errnum == ENOSPC);
+  // Overwriting allocated pages still works
+  dr_assert(write_at(fd, 0, PAGE, &errnum) == PAGE);
+  // A write far past the end would need a huge page array, which is charged like the pages
+  dr_assert(write_at(fd, UINT64_C(1)<<40, 1, &errnum) == 0 && errnum == ENOSPC);
+  dr_assert(write_at(fd, UINT64_C(1)<<50, 1, &errnum) == 0 && errnum == EFBIG);
+  dr_assert(fd->file->length == 2*PAGE);
+  dr_assert(fs.used == fs.cap);
+  // Freeing space makes room again
+  truncate_file(fd->file, 0);
+  dr_assert(write_at(fd, 0, PAGE, &errnum) == PAGE);
+  remove_file(fd->file);
+  clunk(fd);
+  dr_assert(fs.used == 0 && fs.nodes == 1);
+  dr_tmpfs_destroy(&fs);
+}
+
+static void test_remove_open(struct dr_tmpfs *restrict const fs) {
+  int errnum;
+  const uint64_t used = fs->used;
+  struct dr_fd *restrict const fd = create(&fs->root.file, "open", 0644, DR_ORDWR);
+  dr_assert(write_at(fd, 0, PAGE + 1, &errnum) == PAGE + 1);
+  remove_file(fd->file);
+  {
+    const struct dr_str name = str("open");
+    const struct dr_result_file r = dr_vfs_walk(&user, &fs->root.file, &name);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_assert(err->domain == DR_ERR_ISO_C && err->num == ENOENT);
+    } DR_ELIF_RESULT_OK(struct dr_file *restrict, r, value) {
+      (void)value;
+      dr_assert(false);
+    } DR_FI_RESULT;
+  }
+  // The open fid keeps the data until it is clunked
+  dr_assert(read_at(fd, 0, sizeof(rbuf)) == PAGE + 1);
+  dr_assert(memcmp(rbuf, wbuf, PAGE + 1) == 0);
+  dr_assert(write_at(fd, PAGE + 1, 1, &errnum) == 1);
+  {
+    const struct dr_result_void r = dr_vfs_remove(&user, fd->file);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_assert(err->domain == DR_ERR_ISO_C && err->num == ENOENT);
+    } DR_ELIF_RESULT_OK_VOID(r) {
+      dr_assert(false);
+    } DR_FI_RESULT;
+  }
+  dr_assert(fs->used > used);
+  clunk(fd);
+  dr_assert(fs->used == used);
+}
+
+// Tmkdir creates a directory and closes it, Tlcreate opens the new file
+static void test_create(struct dr_tmpfs *restrict const fs) {
+  const uint64_t nodes = fs->nodes;
+  struct dr_file *restrict dir;
+  {
+    struct dr_fd *restrict const fd = create(&fs->root.file, "dir", DR_DIR | 0750, DR_OREAD);
+    dir = fd->file;
+    clunk(fd);
+  }
+  {
+    const struct dr_str name = str("dir");
+    const struct dr_result_file r = dr_vfs_walk(&user, &fs->root.file, &name);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_vfs_walk failed", err);
+      dr_assert(false);
+    } DR_ELIF_RESULT_OK(struct dr_file *restrict, r, value) {
+      dr_assert(value == dir);
+    } DR_FI_RESULT;
+  }
+  dr_assert((dir->mode & (DR_DIR | 0777)) == (DR_DIR | 0750));
+  {
+    const struct dr_str name = str("dir");
+    const struct dr_result_fd r = dr_vfs_create(&user, &fs->root.file, &name, 0644, DR_OWRITE);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_assert(err->domain == DR_ERR_ISO_C && err->num == EEXIST);
+    } DR_ELIF_RESULT_OK(struct dr_fd *restrict, r, value) {
+      dr_vfs_close(value);
+      dr_assert(false);
+    } DR_FI_RESULT;
+  }
+  struct dr_fd *restrict const fd = create(dir, "file", 0666, DR_OWRITE);
+  // The parent's permissions mask the new file's
+  dr_assert((fd->file->mode & 0777) == 0640);
+  {
+    const struct dr_str name = str("..");
+    const struct dr_result_file r = dr_vfs_walk(&user, dir, &name);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_vfs_walk failed", err);
+      dr_assert(false);
+    } DR_ELIF_RESULT_OK(struct dr_file *restrict, r, value) {
+      dr_assert(value == &fs->root.file);
+    } DR_FI_RESULT;
+  }
+  dr_assert(fs->nodes == nodes + 2);
+  {
+    const struct dr_result_void r = dr_vfs_remove(&user, dir);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_assert(err->domain == DR_ERR_ISO_C && err->num == ENOTEMPTY);
+    } DR_ELIF_RESULT_OK_VOID(r) {
+      dr_assert(false);
+    } DR_FI_RESULT;
+  }
+  remove_file(fd->file);
+  clunk(fd);
+  remove_file(dir);
+  dr_assert(fs->nodes == nodes);
+}
+
+// An open directory that was removed cannot gain entries, which would keep it and them alive forever
+static void test_create_removed(struct dr_tmpfs *restrict const fs) {
+  const uint64_t used = fs->used;
+  struct dr_fd *restrict const fd = create(&fs->root.file, "gone", DR_DIR | 0777, DR_OREAD);
+  remove_file(fd->file);
+  {
+    const struct dr_str name = str("file");
+    const struct dr_result_fd r = dr_vfs_create(&user, fd->file, &name, 0666, DR_OWRITE);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_assert(err->domain == DR_ERR_ISO_C && err->num == ENOENT);
+    } DR_ELIF_RESULT_OK(struct dr_fd *restrict, r, value) {
+      dr_vfs_close(value);
+      dr_assert(false);
+    } DR_FI_RESULT;
+  }
+  clunk(fd);
+  dr_assert(fs->used == used);
+}
+
+int main(void) {
+  for (uint32_t i = 0; i < sizeof(wbuf); ++i) {
+    wbuf[i] = i*7 + 1;
+  }
+  struct dr_tmpfs fs;
+  const struct dr_str name = str("scratch");
+  dr_tmpfs_init(&fs, UINT64_C(1)<<20, &root.file, &name, &user, &group, 0777);
+
+  test_data(&fs);
+  test_sparse(&fs);
+  test_full();
+  test_remove_open(&fs);
+  test_create(&fs);
+  test_create_removed(&fs);
+
+  // Everything charged was given back
+  dr_assert(fs.used == 0 && fs.nodes == 1);
+  dr_tmpfs_destroy(&fs);
+
+  printf("OK\n");
+  return 0;
+}
@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// Copyright (c) 2018 Drew Richardson <drewrichardson@gmail.com>
+
+#include "dr.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// check_trace decodes this file with 9p_trace
+#define TRACE_PATH "build/trace.bin"
+#define CAPACITY 4
+#define RECORDS 6
+
+int main(void) {
+  struct dr_trace trace;
+  {
+    const struct dr_result_void r = dr_trace_open(&trace, TRACE_PATH, CAPACITY);
+    DR_IF_RESULT_ERR(r, err) {
+      dr_log_error("dr_trace_open failed", err);
+      return -1;
+    } DR_FI_RESULT;
+  }
+  // The ring wraps, so only the last CAPACITY records are kept
+  for (uint32_t i = 0; i < RECORDS; ++i) {
+    const struct dr_trace_record record = {
+      .start = i*DR_NS_PER_S + i,
+      .end = i*DR_NS_PER_S + i + 1000*i,
+      .offset = i % 2 == 0 ? 4096*i : 0,
+      .conn = 1 + i/4,
+      .fid = i == RECORDS - 1 ? DR_NOFID : i,
+      .count = i % 2 == 0 ? 512 : 0,
+      .tag = (uint16_t)i,
+      .type = i % 2 == 0 ? DR_TREAD : DR_TCLUNK,
+    };
+    dr_trace_write(&trace, &record);
+  }
+  dr_assert(trace.header->head == RECORDS);
+  dr_trace_close(&trace);
+  dr_assert(trace.header == NULL);
+  dr_trace_close(&trace);
+
+  FILE *restrict const file = fopen(TRACE_PATH, "rb");
+  dr_assert(file != NULL);
+  struct dr_trace_header header;
+  dr_assert(fread(&header, sizeof(header), 1, file) == 1);
+  dr_assert(memcmp(header.magic, DR_TRACE_MAGIC, sizeof(header.magic)) == 0 &&
+	    header.record_size == sizeof(struct dr_trace_record) &&
+	    header.capacity == CAPACITY &&
+	    header.head == RECORDS);
+  struct dr_trace_record records[CAPACITY];
+  dr_assert(fread(records, sizeof(records[0]), CAPACITY, file) == CAPACITY);
+  dr_assert(fgetc(file) == EOF);
+  fclose(file);
+  for (uint32_t i = RECORDS - CAPACITY; i < RECORDS; ++i) {
+    const struct dr_trace_record *restrict const record = &records[i % CAPACITY];
+    dr_assert(record->tag == i && record->start == i*DR_NS_PER_S + i);
+  }
+
+  printf("OK\n");
+  return 0;
+}